@@ -10,6 +10,7 @@ class Shar(ConanFile):
         "sdl/2.0.20",             # window, input, OpenGL loader
         "spdlog/1.9.2",           # logs
         "gtest/1.8.1",            # UTs
+        "benchmark/1.6.0",        # microbenchmarks
         "jsonformoderncpp/3.7.0", # config deserialization
         "cli11/1.9.1",            # command line options
         "nuklear/4.06.1",         # gui
@@ -49,7 +49,7 @@ static Context make_context(Config c) {
   }
 
   init_log(config->logs_location, shar_loglvl);
-  auto metrics = std::make_shared<Metrics>(20);
+  auto metrics = std::make_shared<Metrics>(32);
 
   return Context{std::move(config), std::move(metrics)};
 }
@@ -1,6 +1,7 @@
 #include "broadcast.hpp"
 #include "net/sender_factory.hpp"
 
+#include <algorithm>
 #include <fstream>
 
 
@@ -34,17 +35,49 @@ static Capture create_capture(Context context, sc::Monitor monitor) {
   return Capture{ std::move(context), interval, std::move(monitor) };
 }
 
-static codec::Encoder create_encoder(Context context, const sc::Monitor& monitor) {
-  const auto fps = context.m_config->fps;
+// minimal bitrate of simulcast layer (in kbits)
+static const usize MIN_LAYER_BITRATE = 200;
+
+// layer i has 2^i times smaller resolution and 4^i times smaller bitrate
+static std::vector<usize> layer_bitrates(const Context& context) {
+  const auto layers = std::max<usize>(context.m_config->simulcast, 1);
 
-  return codec::Encoder{
-    std::move(context),
-    Size{
-      static_cast<usize>(monitor.Height),
-      static_cast<usize>(monitor.Width)
-    },
-    fps
+  std::vector<usize> bitrates;
+  for (usize i = 0; i < layers; ++i) {
+    bitrates.push_back(std::max(context.m_config->bitrate >> (2 * i), MIN_LAYER_BITRATE));
+  }
+  return bitrates;
+}
+
+static std::vector<EncoderPtr> create_encoders(const Context& context,
+                                               const sc::Monitor& monitor,
+                                               const std::vector<usize>& bitrates) {
+  const auto fps = context.m_config->fps;
+  const auto size = Size{
+    static_cast<usize>(monitor.Height),
+    static_cast<usize>(monitor.Width)
   };
+
+  std::vector<EncoderPtr> encoders;
+  for (usize i = 0; i < bitrates.size(); ++i) {
+    auto config = std::make_shared<Config>(*context.m_config);
+    config->bitrate = bitrates[i];
+
+    const auto layer_size = codec::downscaled_size(size, i);
+    if (bitrates.size() > 1) {
+      LOG_INFO("Simulcast layer {}: {}x{} {}kb/s", i,
+               layer_size.width(), layer_size.height(), bitrates[i]);
+    }
+
+    encoders.emplace_back(std::make_unique<codec::Encoder>(
+      Context{ std::move(config), context.m_metrics },
+      layer_size,
+      fps,
+      i == 0 ? "Encoder" : fmt::format("Encoder {}", i)
+    ));
+  }
+
+  return encoders;
 }
 
 static SenderPtr create_network(Context context) {
@@ -57,34 +90,85 @@ Broadcast::Broadcast(Context context)
   : m_context(context)
   , m_monitor(select_monitor(m_context))
   , m_capture(create_capture(m_context, m_monitor))
-  , m_encoder(create_encoder(m_context, m_monitor))
+  , m_scaler(m_context)
+  , m_bitrates(layer_bitrates(m_context))
   , m_network(create_network(m_context))
   , m_errors(channel<std::string>(1))
-{}
+{
+  m_encoders = create_encoders(m_context, m_monitor, m_bitrates);
+}
 
 Receiver<BGRAFrame> Broadcast::start() {
   auto[display_frames_tx, display_frames_rx] = channel<BGRAFrame>(30);
   auto[frames_tx, frames_rx] = channel<codec::ffmpeg::Frame>(30);
-  auto[packets_tx, packets_rx] = channel<codec::ffmpeg::Unit>(30);
+
+  // NOTE: with simulcast encoder bitrate is fixed, sender switches layers instead
+  std::optional<Receiver<usize>> bitrate_rx;
+  if (m_context.m_config->adaptive_bitrate && m_encoders.size() == 1) {
+    auto [tx, rx] = channel<usize>(8);
+    m_network->set_bitrate_output(std::move(tx));
+    bitrate_rx = std::move(rx);
+  }
 
   // NOTE: current capture implementation starts background thread.
   m_capture.run(std::move(frames_tx), std::move(display_frames_tx));
 
-  m_encoder_thread = std::thread{ [this,
-                                   rx{std::move(frames_rx)},
-                                   tx{std::move(packets_tx)}] () mutable {
-    try {
-      m_encoder.run(std::move(rx), std::move(tx));
+  std::vector<Receiver<codec::ffmpeg::Frame>> layer_frames;
+  if (m_encoders.size() == 1) {
+    layer_frames.push_back(std::move(frames_rx));
+  } else {
+    std::vector<Sender<codec::ffmpeg::Frame>> outputs;
+    for (usize i = 0; i < m_encoders.size(); ++i) {
+      auto [tx, rx] = channel<codec::ffmpeg::Frame>(30);
+      outputs.push_back(std::move(tx));
+      layer_frames.push_back(std::move(rx));
     }
-    catch (const std::exception& e) {
-      m_errors.first.try_send(e.what());
+
+    m_scaler_thread = std::thread{ [this,
+                                    rx{std::move(frames_rx)},
+                                    outputs{std::move(outputs)}] () mutable {
+      try {
+        m_scaler.run(std::move(rx), std::move(outputs));
+      }
+      catch (const std::exception& e) {
+        m_errors.first.try_send(e.what());
+      }
+    } };
+  }
+
+  std::vector<net::Layer> layers;
+  for (usize i = 0; i < m_encoders.size(); ++i) {
+    auto[packets_tx, packets_rx] = channel<codec::ffmpeg::Unit>(30);
+    layers.push_back(net::Layer{ m_bitrates[i], std::move(packets_rx) });
+
+    std::optional<Receiver<usize>> bitrate;
+    if (i == 0) {
+      bitrate = std::move(bitrate_rx);
     }
-  } };
+
+    auto& encoder = *m_encoders[i];
+    m_encoder_threads.emplace_back([this,
+                                    &encoder,
+                                    rx{std::move(layer_frames[i])},
+                                    tx{std::move(packets_tx)},
+                                    bitrate{std::move(bitrate)}] () mutable {
+      try {
+        encoder.run(std::move(rx), std::move(tx), std::move(bitrate));
+      }
+      catch (const std::exception& e) {
+        m_errors.first.try_send(e.what());
+      }
+    });
+  }
 
   m_network_thread = std::thread{ [this,
-                                   rx{std::move(packets_rx)}]() mutable {
+                                   layers{std::move(layers)}]() mutable {
     try {
-      m_network->run(std::move(rx));
+      if (layers.size() == 1) {
+        m_network->run(std::move(layers.front().m_units));
+      } else {
+        m_network->run_simulcast(std::move(layers));
+      }
     }
     catch (const std::exception& e) {
       m_errors.first.try_send(e.what());
@@ -96,10 +180,18 @@ Receiver<BGRAFrame> Broadcast::start() {
 
 void Broadcast::stop() {
   m_capture.shutdown();
-  m_encoder.shutdown();
+  m_scaler.shutdown();
+  for (auto& encoder: m_encoders) {
+    encoder->shutdown();
+  }
   m_network->shutdown();
 
-  m_encoder_thread.join();
+  if (m_scaler_thread.joinable()) {
+    m_scaler_thread.join();
+  }
+  for (auto& thread: m_encoder_threads) {
+    thread.join();
+  }
   m_network_thread.join();
 }
 
@@ -3,18 +3,21 @@
 #include <memory>
 #include <thread>
 #include <utility>
+#include <vector>
 
 #include "context.hpp"
 #include "channel.hpp"
 #include "capture/capture.hpp"
 #include "net/sender.hpp"
 #include "codec/encoder.hpp"
+#include "codec/scaler.hpp"
 #include "codec/ffmpeg/frame.hpp"
 
 
 namespace shar {
 
 using SenderPtr = std::unique_ptr<net::IPacketSender>;
+using EncoderPtr = std::unique_ptr<codec::Encoder>;
 
 class Broadcast {
 public:
@@ -35,10 +38,16 @@ private:
 
   sc::Monitor m_monitor;
   Capture m_capture;
-  codec::Encoder m_encoder;
+
+  // simulcast layers, from the best to the worst
+  codec::Scaler m_scaler;
+  std::vector<EncoderPtr> m_encoders;
+  std::vector<usize> m_bitrates; // in kbits
+
   SenderPtr m_network;
 
-  std::thread m_encoder_thread;
+  std::thread m_scaler_thread;
+  std::vector<std::thread> m_encoder_threads;
   std::thread m_network_thread;
 
   std::pair<Sender<std::string>, Receiver<std::string>> m_errors;
@@ -29,12 +29,14 @@ View::View(Context context)
     : m_context(context)
     , m_receiver(make_receiver(m_context))
     , m_decoder(make_decoder(m_context))
+    , m_first_frame(m_context.m_metrics, "Time to first frame (ms)", Metrics::Format::Count)
     , m_errors(channel<std::string>(1)) {}
 
 Receiver<BGRAFrame> View::start() {
   auto [packets_tx, packets_rx] = channel<codec::ffmpeg::Unit>(30);
   auto [frames_tx, frames_rx] = channel<codec::ffmpeg::Frame>(30);
   auto [bgra_tx, bgra_rx] = channel<BGRAFrame>(30);
+  m_started = Clock::now();
 
   m_network_thread = std::thread{[this, tx{std::move(packets_tx)}]() mutable {
     try {
@@ -56,9 +58,16 @@ Receiver<BGRAFrame> View::start() {
   m_converter_thread = std::thread{
       [this, rx{std::move(frames_rx)}, tx{std::move(bgra_tx)}]() mutable {
         try {
+          bool first = true;
           while (!m_converter.m_running.expired() && tx.connected() &&
                  rx.connected()) {
             if (auto frame = rx.receive()) {
+              if (first) {
+                // includes connection setup, e.g. ICE checks
+                first = false;
+                const auto elapsed = std::chrono::duration_cast<Milliseconds>(Clock::now() - m_started);
+                m_first_frame.set(static_cast<usize>(elapsed.count()));
+              }
 
               auto bgra = frame->to_bgra();
               tx.send({std::move(bgra.data), frame->sizes()});
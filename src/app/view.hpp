@@ -5,7 +5,9 @@
 #include "codec/decoder.hpp"
 #include "codec/ffmpeg/frame.hpp"
 #include "context.hpp"
+#include "metrics.hpp"
 #include "net/receiver.hpp"
+#include "time.hpp"
 
 #include <memory>
 #include <thread>
@@ -38,6 +40,9 @@ private:
   codec::Decoder m_decoder;
   Converter m_converter;
 
+  TimePoint m_started;
+  Metric m_first_frame; // time from start() to first displayed frame (in ms)
+
   std::thread m_network_thread;
   std::thread m_decoder_thread;
   std::thread m_converter_thread;
@@ -1,5 +1,9 @@
 #include "convert.hpp"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SHAR_CONVERT_SSE2
+#endif
 
 namespace shar::codec {
 
@@ -124,4 +128,83 @@ Slice yuv420_to_bgra(const u8* ys,
   return bgra;
 }
 
-}
\ No newline at end of file
+Size downscaled_size(Size size, usize levels) {
+  usize height = size.height();
+  usize width = size.width();
+  for (usize i = 0; i < levels; ++i) {
+    // keep dimensions even, chroma planes are subsampled
+    height = (height / 2) & ~usize{ 1 };
+    width = (width / 2) & ~usize{ 1 };
+  }
+  return Size{ height, width };
+}
+
+static u8 average(u8 a, u8 b) noexcept {
+  return static_cast<u8>((a + b + 1) >> 1);
+}
+
+void downscale_2x(const u8* src, usize src_stride,
+                  u8* dst, usize dst_stride,
+                  usize width, usize height) noexcept {
+  for (usize line = 0; line < height; ++line) {
+    const u8* top = src + 2 * line * src_stride;
+    const u8* bottom = top + src_stride;
+    u8* out = dst + line * dst_stride;
+
+    usize x = 0;
+
+#if defined(SHAR_CONVERT_SSE2)
+    // NOTE: rounding matches scalar version below:
+    //       average of vertical pairs first, then of horizontal ones
+    const __m128i low_bytes = _mm_set1_epi16(0x00ff);
+    for (; x + 16 <= width; x += 16) {
+      const auto t0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(top + 2 * x));
+      const auto t1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(top + 2 * x + 16));
+      const auto b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bottom + 2 * x));
+      const auto b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bottom + 2 * x + 16));
+
+      const auto v0 = _mm_avg_epu8(t0, b0);
+      const auto v1 = _mm_avg_epu8(t1, b1);
+
+      const auto h0 = _mm_avg_epu16(_mm_and_si128(v0, low_bytes), _mm_srli_epi16(v0, 8));
+      const auto h1 = _mm_avg_epu16(_mm_and_si128(v1, low_bytes), _mm_srli_epi16(v1, 8));
+
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm_packus_epi16(h0, h1));
+    }
+#endif
+
+    for (; x < width; ++x) {
+      const u8 left = average(top[2 * x], bottom[2 * x]);
+      const u8 right = average(top[2 * x + 1], bottom[2 * x + 1]);
+      out[x] = average(left, right);
+    }
+  }
+}
+
+YUVImage downscale_yuv420(const u8* ys, usize y_stride,
+                          const u8* us, const u8* vs, usize uv_stride,
+                          Size size) {
+  const auto scaled = downscaled_size(size, 1);
+  const usize width = scaled.width();
+  const usize height = scaled.height();
+
+  YUVImage image;
+  image.y_size = width * height;
+  image.u_size = image.y_size / 4;
+  image.v_size = image.y_size / 4;
+
+  Slice buffer = alloc(image.y_size + image.u_size + image.v_size);
+  u8* y = buffer.data.get();
+  u8* u = y + image.y_size;
+  u8* v = u + image.u_size;
+
+  downscale_2x(ys, y_stride, y, width, width, height);
+  downscale_2x(us, uv_stride, u, width / 2, width / 2, height / 2);
+  downscale_2x(vs, uv_stride, v, width / 2, width / 2, height / 2);
+
+  image.data = std::move(buffer.data);
+  image.size = buffer.size;
+  return image;
+}
+
+}
@@ -31,4 +31,20 @@ Slice yuv420_to_bgra(const u8* ys,
 
 YUVImage bgra_to_yuv420(const char* data, Size size);
 
-}
\ No newline at end of file
+
+// size of image after |levels| 2x downscales, dimensions are kept even
+Size downscaled_size(Size size, usize levels);
+
+// downscale plane 2 times in each dimension (2x2 box filter)
+// |width| and |height| are dimensions of |dst|, |src| should be
+// at least 2 * |width| x 2 * |height|
+void downscale_2x(const u8* src, usize src_stride,
+                  u8* dst, usize dst_stride,
+                  usize width, usize height) noexcept;
+
+// downscale yuv420 image of |size| 2 times, see downscaled_size()
+YUVImage downscale_yuv420(const u8* ys, usize y_stride,
+                          const u8* us, const u8* vs, usize uv_stride,
+                          Size size);
+
+}
@@ -3,20 +3,38 @@
 
 namespace shar::codec {
 
-Encoder::Encoder(Context context, Size frame_size, usize fps)
+Encoder::Encoder(Context context, Size frame_size, usize fps, std::string name)
   : Context(context)
+  , m_name(std::move(name))
   , m_codec(std::move(context), frame_size, fps) {
 }
 
-void Encoder::run(Receiver<ffmpeg::Frame> input, Sender<ffmpeg::Unit> output) {
-  Metric bytes_in{ m_metrics, "Encoder in", Metrics::Format::Bytes };
-  Metric bytes_out{ m_metrics, "Encoder out", Metrics::Format::Bytes };
+void Encoder::run(Receiver<ffmpeg::Frame> input,
+                  Sender<ffmpeg::Unit> output,
+                  std::optional<Receiver<usize>> bitrate) {
+  Metric bytes_in{ m_metrics, m_name + " in", Metrics::Format::Bytes };
+  Metric bytes_out{ m_metrics, m_name + " out", Metrics::Format::Bytes };
+  Metric target{ m_metrics, m_name + " bitrate", Metrics::Format::Bits };
+  target.set(m_codec.bitrate() * 1024);
 
   while (auto frame = input.receive()) {
     if (m_running.expired() || !output.connected()) {
       break;
     }
 
+    if (bitrate) {
+      // only the most recent estimation matters
+      std::optional<usize> kbits;
+      while (auto update = bitrate->try_receive()) {
+        kbits = update;
+      }
+
+      if (kbits) {
+        m_codec.set_bitrate(*kbits);
+        target.set(*kbits * 1024);
+      }
+    }
+
     bytes_in += frame->total_size();
     auto units = m_codec.encode(std::move(*frame));
     for (auto& unit: units) {
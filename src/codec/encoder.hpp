@@ -1,5 +1,8 @@
 #pragma once
 
+#include <optional>
+#include <string>
+
 #include "context.hpp"
 #include "size.hpp"
 #include "channel.hpp"
@@ -16,16 +19,22 @@ namespace shar::codec {
 
 class Encoder: protected Context {
 public:
-  Encoder(Context context, Size frame_size, usize fps);
+  // |name| is used as prefix for metrics, e.g. to distinguish simulcast layers
+  Encoder(Context context, Size frame_size, usize fps, std::string name = "Encoder");
   Encoder(const Encoder&) = delete;
   Encoder& operator=(const Encoder&) = delete;
   ~Encoder() = default;
 
-  void run(Receiver<ffmpeg::Frame> input, Sender<ffmpeg::Unit> output);
+  // |bitrate| is optional stream of target bitrate updates (in kbits),
+  // e.g. from network congestion control
+  void run(Receiver<ffmpeg::Frame> input,
+           Sender<ffmpeg::Unit> output,
+           std::optional<Receiver<usize>> bitrate);
   void shutdown();
 
 private:
   Cancellation m_running;
+  std::string m_name;
   ffmpeg::Codec m_codec;
 };
 
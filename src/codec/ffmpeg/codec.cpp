@@ -110,6 +110,7 @@ static const int CLOCK_RATE = 90000;
 
 Codec::Codec(Context context, Size frame_size, usize fps)
   : Context(std::move(context))
+  , m_kbits(m_config->bitrate)
   , m_frame_counter(0) {
 
   if (!logger_enabled) {
@@ -212,6 +213,23 @@ std::optional<Frame> Codec::decode(Unit unit) {
   return std::move(frame);
 }
 
+void Codec::set_bitrate(usize kbits) {
+  if (kbits == m_kbits) {
+    return;
+  }
+
+  LOG_DEBUG("Changing bitrate from {}kbit to {}kbit", m_kbits, kbits);
+  m_kbits = kbits;
+
+  // NOTE: libx264 reconfigures itself when bit_rate changes between frames,
+  //       other encoders will pick up new value only after reopen (e.g. on resize)
+  m_context->bit_rate = static_cast<int>(kbits * 1024);
+}
+
+usize Codec::bitrate() const noexcept {
+  return m_kbits;
+}
+
 void Codec::set_log_level(LogLevel level) {
   av_log_set_level(log_level_to_ffmpeg(level));
 }
@@ -271,7 +289,7 @@ AVCodec* Codec::select_codec(ffmpeg::Options& opts,
   };
 
   const std::string codec_name = m_config->codec;
-  const usize kbits = m_config->bitrate;
+  const usize kbits = m_kbits;
 
   if (!codec_name.empty()) {
     if (auto* codec = find_codec_by_name(codec_name.c_str())) {
@@ -33,6 +33,11 @@ public:
 
   std::vector<Unit> encode(Frame image);
   std::optional<Frame> decode(Unit unit);
+
+  // change target bitrate of running encoder (in kbits)
+  void set_bitrate(usize kbits);
+  usize bitrate() const noexcept;
+
   static void set_log_level(LogLevel level);
 
 private:
@@ -56,6 +61,7 @@ private:
 
   AVContextPtr       m_context;
   AVCodec*           m_codec; // static lifetime
+  usize              m_kbits;  // current target bitrate
   
   //TODO: implement Format::Histogram or rewrite this to Format::Count
   //metrics::Histogram m_full_delay;
@@ -20,7 +20,10 @@ Frame::Frame(FramePtr frame, std::unique_ptr<u8[]> data)
 
 Frame Frame::from_bgra(const char* data, Size size) {
   // TODO: use AVBuffer to allow sharing Frame
-  auto image = bgra_to_yuv420(data, size);
+  return from_yuv420(bgra_to_yuv420(data, size), size);
+}
+
+Frame Frame::from_yuv420(YUVImage image, Size size) {
   assert(image.size == image.y_size + image.u_size + image.v_size);
 
   auto frame = FramePtr(av_frame_alloc());
@@ -101,20 +104,21 @@ usize Frame::height() const noexcept {
 
 static Frame::Channel make_channel(const u8* data,
                                    usize width,
-                                   usize height) {
-  return Frame::Channel{data, width, height, width * height};
+                                   usize height,
+                                   int stride) {
+  return Frame::Channel{data, width, height, width * height, static_cast<usize>(stride)};
 }
 
 Frame::Channel Frame::y() const noexcept {
-  return m_frame ? make_channel(m_frame->data[0], width(), height()) : Channel{};
+  return m_frame ? make_channel(m_frame->data[0], width(), height(), m_frame->linesize[0]) : Channel{};
 }
 
 Frame::Channel Frame::u() const noexcept {
-  return m_frame ? make_channel(m_frame->data[1], width() / 2, height() / 2) : Channel{};
+  return m_frame ? make_channel(m_frame->data[1], width() / 2, height() / 2, m_frame->linesize[1]) : Channel{};
 }
 
 Frame::Channel Frame::v() const noexcept {
-  return m_frame ? make_channel(m_frame->data[2], width() / 2, height() / 2) : Channel{};
+  return m_frame ? make_channel(m_frame->data[2], width() / 2, height() / 2, m_frame->linesize[2]) : Channel{};
 }
 
 AVFrame* Frame::raw() noexcept {
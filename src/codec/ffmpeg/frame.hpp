@@ -27,6 +27,8 @@ public:
   ~Frame() = default;
 
   static Frame from_bgra(const char* data, Size size);
+  // |image| planes are expected to have no padding
+  static Frame from_yuv420(YUVImage image, Size size);
   static Frame alloc();
   Slice to_bgra() const;
 
@@ -44,6 +46,7 @@ public:
     usize width{ 0 };
     usize height{ 0 };
     usize size { 0 };
+    usize stride{ 0 }; // distance between lines, in bytes
   };
 
   Channel y() const noexcept;
@@ -56,6 +56,10 @@ Unit::Type Unit::type() const noexcept {
   return is_idr ? Type::IDR : Type::Unknown;
 }
 
+NalIterator Unit::nal_units() const noexcept {
+  return NalIterator(BytesRef(data(), size()));
+}
+
 AVPacket *Unit::raw() noexcept {
   return m_packet.get();
 }
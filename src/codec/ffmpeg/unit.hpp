@@ -2,6 +2,7 @@
 
 #include <memory>
 
+#include "annexb.hpp"
 #include "int.hpp"
 
 
@@ -42,6 +43,9 @@ public:
   u32 timestamp() const noexcept;
   Type type() const noexcept;
 
+  // iterate over NAL units in this unit (Annex B byte stream)
+  NalIterator nal_units() const noexcept;
+
   AVPacket* raw() noexcept;
 
 private:
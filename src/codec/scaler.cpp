@@ -0,0 +1,66 @@
+#include "scaler.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+#include "metrics.hpp"
+
+
+namespace shar::codec {
+
+ffmpeg::Frame downscale(const ffmpeg::Frame& frame) {
+  const auto y = frame.y();
+  const auto u = frame.u();
+  const auto v = frame.v();
+  assert(u.stride == v.stride);
+
+  auto image = downscale_yuv420(y.data, y.stride, u.data, v.data, u.stride, frame.sizes());
+  auto scaled = ffmpeg::Frame::from_yuv420(std::move(image), downscaled_size(frame.sizes(), 1));
+  scaled.set_timestamp(frame.timestamp());
+  return scaled;
+}
+
+Scaler::Scaler(Context context)
+  : Context(std::move(context))
+  {}
+
+void Scaler::run(Receiver<ffmpeg::Frame> input,
+                 std::vector<Sender<ffmpeg::Frame>> outputs) {
+  Metric dropped{ m_metrics, "Scaler dropped", Metrics::Format::Count };
+
+  const auto connected = [&outputs] {
+    return std::any_of(outputs.begin(), outputs.end(), [](const auto& output) {
+      return output.connected();
+    });
+  };
+
+  std::vector<ffmpeg::Frame> layers;
+  layers.reserve(outputs.size());
+
+  while (auto frame = input.receive()) {
+    if (m_running.expired() || !connected()) {
+      break;
+    }
+
+    // each layer is downscaled from the previous one
+    layers.clear();
+    layers.emplace_back(std::move(*frame));
+    for (usize i = 1; i < outputs.size(); ++i) {
+      layers.emplace_back(downscale(layers.back()));
+    }
+
+    for (usize i = 0; i < outputs.size(); ++i) {
+      if (outputs[i].connected() && outputs[i].try_send(std::move(layers[i]))) {
+        dropped += 1;
+      }
+    }
+  }
+
+  shutdown();
+}
+
+void Scaler::shutdown() {
+  m_running.cancel();
+}
+
+}
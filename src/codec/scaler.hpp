@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vector>
+
+#include "context.hpp"
+#include "channel.hpp"
+#include "cancellation.hpp"
+
+#include "ffmpeg/frame.hpp"
+
+
+namespace shar::codec {
+
+// downscale frame 2 times in each dimension
+ffmpeg::Frame downscale(const ffmpeg::Frame& frame);
+
+// Produces resolution layers for simulcast from single stream of frames.
+// |outputs[0]| receives original frames, every next output receives frames
+// downscaled 2 times relative to the previous one.
+class Scaler: protected Context {
+public:
+  explicit Scaler(Context context);
+  Scaler(const Scaler&) = delete;
+  Scaler& operator=(const Scaler&) = delete;
+  ~Scaler() = default;
+
+  // NOTE: frames are dropped for outputs that are not keeping up
+  void run(Receiver<ffmpeg::Frame> input,
+           std::vector<Sender<ffmpeg::Frame>> outputs);
+  void shutdown();
+
+private:
+  Cancellation m_running;
+};
+
+}
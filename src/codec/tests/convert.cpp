@@ -0,0 +1,78 @@
+#include <vector>
+
+#include "disable_warnings_push.hpp"
+#include <gtest/gtest.h>
+#include "disable_warnings_pop.hpp"
+
+#include "codec/convert.hpp"
+
+using namespace shar;
+using namespace shar::codec;
+
+TEST(convert, downscaled_size) {
+  EXPECT_EQ(downscaled_size(Size{1080, 1920}, 0), (Size{1080, 1920}));
+  EXPECT_EQ(downscaled_size(Size{1080, 1920}, 1), (Size{540, 960}));
+  EXPECT_EQ(downscaled_size(Size{1080, 1920}, 2), (Size{270, 480}));
+  EXPECT_EQ(downscaled_size(Size{1080, 1920}, 3), (Size{134, 240}));
+}
+
+TEST(convert, downscale_2x_box) {
+  // 4x2 -> 2x1
+  const u8 src[] = {
+    0,   2,   100, 200,
+    4,   6,   50,  255,
+  };
+  u8 dst[2] = {};
+
+  downscale_2x(src, 4, dst, 2, 2, 1);
+  EXPECT_EQ(dst[0], 3);
+  EXPECT_EQ(dst[1], 152);
+}
+
+TEST(convert, downscale_2x_matches_scalar) {
+  // wide enough to hit vectorized path and the tail
+  const usize width = 37;
+  const usize height = 5;
+  const usize src_stride = 2 * width + 3;
+
+  std::vector<u8> src(src_stride * 2 * height);
+  for (usize i = 0; i < src.size(); ++i) {
+    src[i] = static_cast<u8>(i * 31 + (i >> 3));
+  }
+
+  const usize dst_stride = width + 1;
+  std::vector<u8> dst(dst_stride * height, 0);
+  downscale_2x(src.data(), src_stride, dst.data(), dst_stride, width, height);
+
+  const auto average = [](int a, int b) { return (a + b + 1) >> 1; };
+  for (usize y = 0; y < height; ++y) {
+    for (usize x = 0; x < width; ++x) {
+      const u8* top = &src[2 * y * src_stride + 2 * x];
+      const u8* bottom = top + src_stride;
+      const int expected = average(average(top[0], bottom[0]),
+                                   average(top[1], bottom[1]));
+      ASSERT_EQ(dst[y * dst_stride + x], expected) << "x=" << x << " y=" << y;
+    }
+  }
+}
+
+TEST(convert, downscale_yuv420) {
+  const Size size{8, 8};
+  std::vector<u8> ys(64, 100);
+  std::vector<u8> us(16, 50);
+  std::vector<u8> vs(16, 200);
+
+  auto image = downscale_yuv420(ys.data(), 8, us.data(), vs.data(), 4, size);
+  ASSERT_EQ(image.y_size, 16);
+  ASSERT_EQ(image.u_size, 4);
+  ASSERT_EQ(image.v_size, 4);
+  ASSERT_EQ(image.size, 24);
+
+  for (usize i = 0; i < image.y_size; ++i) {
+    EXPECT_EQ(image.data[i], 100);
+  }
+  for (usize i = 0; i < image.u_size; ++i) {
+    EXPECT_EQ(image.data[image.y_size + i], 50);
+    EXPECT_EQ(image.data[image.y_size + image.u_size + i], 200);
+  }
+}
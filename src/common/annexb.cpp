@@ -0,0 +1,163 @@
+#include "annexb.hpp"
+
+#include <cstring> // memchr
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SHAR_ANNEXB_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SHAR_ANNEXB_SSE2
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+
+namespace shar {
+
+static const usize START_CODE_SIZE = 3;
+
+#if defined(SHAR_ANNEXB_AVX2) || defined(SHAR_ANNEXB_SSE2)
+static u32 count_trailing_zeros(u32 mask) noexcept {
+#if defined(_MSC_VER)
+  unsigned long index = 0;
+  _BitScanForward(&index, mask);
+  return static_cast<u32>(index);
+#else
+  return static_cast<u32>(__builtin_ctz(mask));
+#endif
+}
+#endif
+
+#if defined(SHAR_ANNEXB_AVX2)
+
+// checks 32 positions at once, returns pointer to first position
+// which was not checked if start code was not found
+static const u8* find_start_code_simd(const u8* p, const u8* end) noexcept {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i one = _mm256_set1_epi8(1);
+
+  // bytes [p, p + 32 + 2) are read on each iteration
+  while (end - p >= static_cast<isize>(32 + START_CODE_SIZE - 1)) {
+    const auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    const auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1));
+    const auto c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 2));
+
+    const auto zeros = _mm256_and_si256(_mm256_cmpeq_epi8(a, zero),
+                                        _mm256_cmpeq_epi8(b, zero));
+    const auto matches = _mm256_and_si256(zeros, _mm256_cmpeq_epi8(c, one));
+    const auto mask = static_cast<u32>(_mm256_movemask_epi8(matches));
+    if (mask != 0) {
+      return p + count_trailing_zeros(mask);
+    }
+
+    p += 32;
+  }
+
+  return p;
+}
+
+#elif defined(SHAR_ANNEXB_SSE2)
+
+// checks 16 positions at once, returns pointer to first position
+// which was not checked if start code was not found
+static const u8* find_start_code_simd(const u8* p, const u8* end) noexcept {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i one = _mm_set1_epi8(1);
+
+  // bytes [p, p + 16 + 2) are read on each iteration
+  while (end - p >= static_cast<isize>(16 + START_CODE_SIZE - 1)) {
+    const auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    const auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+    const auto c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 2));
+
+    const auto zeros = _mm_and_si128(_mm_cmpeq_epi8(a, zero),
+                                     _mm_cmpeq_epi8(b, zero));
+    const auto matches = _mm_and_si128(zeros, _mm_cmpeq_epi8(c, one));
+    const auto mask = static_cast<u32>(_mm_movemask_epi8(matches));
+    if (mask != 0) {
+      return p + count_trailing_zeros(mask);
+    }
+
+    p += 16;
+  }
+
+  return p;
+}
+
+#else
+
+static const u8* find_start_code_simd(const u8* p, const u8* /* end */) noexcept {
+  return p;
+}
+
+#endif
+
+// look for 0x01 with memchr and check two preceding bytes
+static const u8* find_start_code_scalar(const u8* begin, const u8* end) noexcept {
+  if (end - begin < static_cast<isize>(START_CODE_SIZE)) {
+    return end;
+  }
+
+  const u8* p = begin + START_CODE_SIZE - 1;
+  while (p < end) {
+    const auto size = static_cast<usize>(end - p);
+    p = static_cast<const u8*>(std::memchr(p, 0x01, size));
+    if (p == nullptr) {
+      return end;
+    }
+
+    if (p[-1] == 0 && p[-2] == 0) {
+      return p - 2;
+    }
+
+    // 0x01 can't be part of next start code
+    if (static_cast<usize>(end - p) <= START_CODE_SIZE) {
+      return end;
+    }
+    p += START_CODE_SIZE;
+  }
+
+  return end;
+}
+
+const u8* find_start_code(const u8* begin, const u8* end) noexcept {
+  // simd version stops either at start code or at the tail of the range
+  const u8* p = find_start_code_simd(begin, end);
+  return find_start_code_scalar(p, end);
+}
+
+NalIterator::NalIterator(BytesRef stream) noexcept
+  : m_position(stream.begin())
+  , m_end(stream.end())
+{}
+
+BytesRef NalIterator::next() noexcept {
+  while (m_position != m_end) {
+    const u8* code = find_start_code(m_position, m_end);
+    if (code == m_end) {
+      m_position = m_end;
+      break;
+    }
+
+    const u8* start = code + START_CODE_SIZE;
+    const u8* end = find_start_code(start, m_end);
+    m_position = end;
+
+    if (end != m_end && end != start && end[-1] == 0) {
+      // it was 0x00 0x00 0x00 0x01
+      --end;
+    }
+
+    // skip empty units
+    if (start != end) {
+      return BytesRef(start, end);
+    }
+  }
+
+  return BytesRef();
+}
+
+} // namespace shar
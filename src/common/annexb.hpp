@@ -0,0 +1,37 @@
+#pragma once
+
+#include "bytes_ref.hpp"
+#include "int.hpp"
+
+
+namespace shar {
+
+// returns pointer to first byte of 3 byte start code (0x00 0x00 0x01)
+// in range [begin, end) or |end| if there is no start code.
+// NOTE: uses AVX2 or SSE2 if available at compile time
+const u8* find_start_code(const u8* begin, const u8* end) noexcept;
+
+// iterates over NAL units of H264 Annex B byte stream, e.g.
+//
+//   NalIterator it{ stream };
+//   while (auto nal = it.next()) {
+//     ...
+//   }
+class NalIterator {
+public:
+  NalIterator() noexcept = default;
+  NalIterator(BytesRef stream) noexcept;
+  NalIterator(const NalIterator&) noexcept = default;
+  NalIterator& operator=(const NalIterator&) noexcept = default;
+  ~NalIterator() = default;
+
+  // returns next NAL unit (starting from NAL header, without start code)
+  // or empty BytesRef if there are no more units
+  BytesRef next() noexcept;
+
+private:
+  const u8* m_position{ nullptr };
+  const u8* m_end{ nullptr };
+};
+
+} // namespace shar
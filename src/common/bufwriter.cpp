@@ -13,17 +13,20 @@ std::optional<BytesRef> BufWriter::write(BytesRef bytes) {
   }
 
   u8* begin = m_data + m_written_bytes;
-  std::memcpy(m_data + m_written_bytes, bytes.ptr(), bytes.len());
+  // NOTE: empty BytesRef may hold nullptr, which memcpy doesn't accept
+  if (!bytes.empty()) {
+    std::memcpy(m_data + m_written_bytes, bytes.ptr(), bytes.len());
+  }
   m_written_bytes += bytes.len();
 
   return BytesRef(begin, bytes.len());
 }
 
-std::optional<BytesRef> BufWriter::format(usize number) {
+std::optional<BytesRef> BufWriter::format(usize number, int base) {
   u8* begin = m_data + m_written_bytes;
   char* curr = reinterpret_cast<char*>(begin);
   auto [end, ec] =
-      std::to_chars(curr, curr + (m_size - m_written_bytes), number);
+      std::to_chars(curr, curr + (m_size - m_written_bytes), number, base);
 
   if (ec == std::errc()) {
     m_written_bytes += static_cast<usize>(end - curr);
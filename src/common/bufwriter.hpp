@@ -13,7 +13,7 @@ public:
   BufWriter(u8* buffer, usize size);
 
   std::optional<BytesRef> write(BytesRef bytes);
-  std::optional<BytesRef> format(usize number);
+  std::optional<BytesRef> format(usize number, int base = 10);
 
   u8* data() noexcept;
   usize written_bytes() const noexcept;
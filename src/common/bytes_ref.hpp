@@ -80,7 +80,7 @@ public:
   }
 
   bool operator==(const BytesRef rhs) const noexcept {
-    return len() == rhs.len() && std::memcmp(ptr(), rhs.ptr(), len()) == 0;
+    return len() == rhs.len() && (len() == 0 || std::memcmp(ptr(), rhs.ptr(), len()) == 0);
   }
 
 protected:
@@ -137,6 +137,12 @@ public:
     return !m_state->disconnected;
   }
 
+  // number of values waiting to be received
+  usize size() const {
+    std::unique_lock<std::mutex> lock(m_state->mutex);
+    return m_state->buffer.size;
+  }
+
 private:
   StatePtr m_state;
 };
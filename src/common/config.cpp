@@ -168,6 +168,12 @@ Config Config::from_args(int argc, char* argv[]) {
   std::string loglvl;
   std::string encoder_loglvl;
 
+  std::set<std::string> socket_profiles{
+    "default",
+    "latency",
+    "throughput"
+  };
+
   std::set<std::string> loglvl_options{
     "none",
     "trace",
@@ -186,9 +192,14 @@ Config Config::from_args(int argc, char* argv[]) {
   app.add_flag("--p2p", config.p2p, "Enable p2p mode, makes sense only for sender");
   app.add_option("url,-u,--url", config.url, "Url for stream or connect");
   app.add_option("-m,--monitor", config.monitor, "Which monitor to capture");
+  app.add_option("--stream_id", config.stream_id, "RTP stream id (SSRC), receiver picks the first stream if it is 0", true);
   app.add_option("-f,--fps", config.fps, "Desired fps", true);
   app.add_option("--codec", config.codec, "Which codec to use");
   app.add_option("-b,--bitrate", config.bitrate, "Target bitrate (kbit)", true);
+  app.add_flag("--adaptive_bitrate", config.adaptive_bitrate, "Adjust bitrate to network conditions");
+  app.add_option("--simulcast", config.simulcast, "Number of simulcast layers", true);
+  app.add_option("--io_threads", config.io_threads, "Number of RTSP server threads (0 - one per core)", true);
+  app.add_set("--socket_profile", config.socket_profile, socket_profiles, "TCP socket options profile", true);
   app.add_option("--metrics", config.metrics, "Where to expose metrics", true);
   app.add_option("--logs", config.logs_location, "Log files location", true);
   app.add_set("--log_level", loglvl, loglvl_options, "common log level", true);
@@ -243,17 +254,22 @@ std::string Config::to_string() const {
     string_options.push_back(fmt::format("{}={}", option.first, option.second));
   }
 
+  config["adaptive_bitrate"] = adaptive_bitrate;
   config["bitrate"] = bitrate;
   config["codec"] = codec;
   config["connect"] = connect;
   config["encoder_loglevel"] = log_level_to_string(encoder_log_level);
   config["fps"] = fps;
+  config["io_threads"] = io_threads;
   config["logs"] = logs_location;
   config["log_level"] = log_level_to_string(log_level);
   config["metrics"] = metrics;
   config["monitor"] = monitor;
   config["options"] = string_options;
   config["p2p"] = p2p;
+  config["simulcast"] = simulcast;
+  config["socket_profile"] = socket_profile;
+  config["stream_id"] = stream_id;
   config["url"] = url;
 
   return config.dump(4 /* spaces */);
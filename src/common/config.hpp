@@ -33,9 +33,19 @@ struct Config {
   bool p2p{ false };                                 // enable p2p mode, used only for sender
   std::string url{ "tcp://127.0.0.1:1337" };         // url to stream to
   usize monitor{ 0 };                          // which monitor to capture
+  usize stream_id{ 0 };                        // RTP SSRC of the stream, allows to
+                                                     // send several streams to the same port
   usize fps{ 30 };                             // desired fps (for encoder)
   std::string codec;                                 // which codec to use
   usize bitrate{ 5000 };                       // target bitrate (in kbits)
+  bool adaptive_bitrate{ false };                    // adjust bitrate to network conditions,
+                                                     // |bitrate| is used as upper bound
+  usize simulcast{ 1 };                        // number of simulcast layers, each next
+                                                     // layer has half the resolution of previous
+  usize io_threads{ 0 };                       // number of network threads of RTSP server,
+                                                     // 0 means one per CPU core
+  std::string socket_profile{ "default" };           // kernel options of TCP connections,
+                                                     // one of: default, latency, throughput
   std::string metrics{ "127.0.0.1:3228" };           // where to expose metrics
   LogLevel log_level{ DEFAULT_LOG_LEVEL };           // common log level
   std::string logs_location{ "" };                   // logs location, set to ~/.shar/logs
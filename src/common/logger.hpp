@@ -24,3 +24,7 @@ extern spdlog::logger g_logger;
 #define LOG_WARN(...) ::shar::g_logger.warn(__VA_ARGS__)
 #define LOG_ERROR(...)  ::shar::g_logger.error(__VA_ARGS__)
 #define LOG_FATAL(...) ::shar::g_logger.critical(__VA_ARGS__)
+
+// true if messages of level |lvl| (e.g. debug) are logged, allows
+// to skip preparation of arguments that are expensive to format
+#define LOG_ENABLED(lvl) ::shar::g_logger.should_log(::spdlog::level::lvl)
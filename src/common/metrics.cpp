@@ -1,3 +1,4 @@
+#include <algorithm> // max
 #include <cassert>
 #include <array>
 
@@ -61,19 +62,33 @@ FormatData human_readable(usize value, const Suffixes& suffixes) {
 namespace shar {
 
 Metrics::Metrics(usize size)
-    : m_metrics(size) {}
+    : m_block_size(std::max<usize>(size, 1)) {
+  m_blocks[0] = std::make_unique<Slot[]>(m_block_size);
+}
+
+Metrics::Slot& Metrics::slot(MetricId id) const noexcept {
+  return m_blocks[id.get() / m_block_size][id.get() % m_block_size];
+}
 
 bool Metrics::valid(shar::MetricId id) const noexcept {
-  return id.valid() && id.get() < m_metrics.size() && m_metrics[id.get()].has_value();
+  return id.valid() && id.get() < m_block_size * MAX_BLOCKS &&
+         m_blocks[id.get() / m_block_size] && slot(id).has_value();
 }
 
 MetricId Metrics::add(std::string name, Format format) noexcept {
   std::lock_guard<std::mutex> lock(m_mutex);
 
-  for (usize i = 0; i < m_metrics.size(); ++i) {
-    if (!m_metrics[i]) {
-      m_metrics[i].emplace(std::move(name), format);
-      return MetricId(i);
+  for (usize block = 0; block < MAX_BLOCKS; ++block) {
+    if (!m_blocks[block]) {
+      m_blocks[block] = std::make_unique<Slot[]>(m_block_size);
+    }
+
+    for (usize i = 0; i < m_block_size; ++i) {
+      auto& metric = m_blocks[block][i];
+      if (!metric) {
+        metric.emplace(std::move(name), format);
+        return MetricId(block * m_block_size + i);
+      }
     }
   }
 
@@ -84,21 +99,28 @@ void Metrics::remove(MetricId id) noexcept {
   assert(valid(id));
   if (valid(id)) {
     std::lock_guard<std::mutex> lock(m_mutex);
-    m_metrics[id.get()].reset();
+    slot(id).reset();
   }
 }
 
 void Metrics::increase(shar::MetricId id, usize delta) {
   assert(valid(id));
   if (valid(id)) {
-    m_metrics[id.get()]->m_value.fetch_add(delta, std::memory_order_relaxed);
+    slot(id)->m_value.fetch_add(delta, std::memory_order_relaxed);
   }
 }
 
 void Metrics::decrease(shar::MetricId id, usize delta) {
   assert(valid(id));
   if (valid(id)) {
-    m_metrics[id.get()]->m_value.fetch_sub(delta, std::memory_order_relaxed);
+    slot(id)->m_value.fetch_sub(delta, std::memory_order_relaxed);
+  }
+}
+
+void Metrics::set(shar::MetricId id, usize value) {
+  assert(valid(id));
+  if (valid(id)) {
+    slot(id)->m_value.store(value, std::memory_order_relaxed);
   }
 }
 
@@ -132,18 +154,29 @@ Metric::Metric(MetricsPtr metrics, std::string name, Metrics::Format format)
   , m_id(m_metrics->add(std::move(name), format))
 {}
 
+// NOTE: id is invalid if the table couldn't grow any further
 Metric::~Metric() {
-  if (m_metrics) {
+  if (m_metrics && m_id.valid()) {
     m_metrics->remove(m_id);
   }
 }
 
 void Metric::operator+=(usize delta) {
-  m_metrics->increase(m_id, delta);
+  if (m_id.valid()) {
+    m_metrics->increase(m_id, delta);
+  }
 }
 
 void Metric::operator-=(usize delta) {
-  m_metrics->decrease(m_id, delta);
+  if (m_id.valid()) {
+    m_metrics->decrease(m_id, delta);
+  }
+}
+
+void Metric::set(usize value) {
+  if (m_id.valid()) {
+    m_metrics->set(m_id, value);
+  }
 }
 
 }
\ No newline at end of file
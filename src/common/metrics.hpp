@@ -1,7 +1,8 @@
 #pragma once
 
+#include <array>
 #include <atomic>
-#include <vector>
+#include <memory>
 #include <optional>
 #include <limits>
 #include <mutex>
@@ -42,6 +43,8 @@ public:
     Bits
   };
 
+  // |size| slots are allocated at once, the table grows by |size|
+  // slots whenever it is full, up to MAX_BLOCKS times
   Metrics(usize size);
 
   MetricId add(std::string name, Format format) noexcept;
@@ -50,14 +53,21 @@ public:
   // Modify metric value. Does nothing if |id| is invalid
   void increase(MetricId id, usize delta);
   void decrease(MetricId id, usize delta);
+  void set(MetricId id, usize value);
 
   template <typename Fn>
   void for_each(Fn&& f) {
     std::lock_guard<std::mutex> lock(m_mutex);
 
-    for (auto& metric : m_metrics) {
-      if (metric) {
-        f(*metric);
+    for (auto& block : m_blocks) {
+      if (!block) {
+        break;
+      }
+
+      for (usize i = 0; i < m_block_size; ++i) {
+        if (block[i]) {
+          f(*block[i]);
+        }
       }
     }
   }
@@ -77,11 +87,19 @@ public:
   };
 
 private:
+  using Slot = std::optional<MetricData>;
+
+  static const usize MAX_BLOCKS = 64;
+
+  Slot& slot(MetricId id) const noexcept;
+
   // mutex to prevent data races when adding/removing/reporting metrics
   std::mutex m_mutex;
 
-  // TODO: refactor to Slab<MetricData>
-  std::vector<std::optional<MetricData>> m_metrics;
+  // NOTE: blocks are never moved or freed, so metrics can be
+  //       modified without the lock while the table grows
+  usize m_block_size;
+  std::array<std::unique_ptr<Slot[]>, MAX_BLOCKS> m_blocks;
 };
 
 class Metric {
@@ -98,6 +116,9 @@ public:
   void operator+=(usize delta);
   void operator-=(usize delta);
 
+  // overwrite metric value, useful for gauges
+  void set(usize value);
+
 private:
   MetricsPtr m_metrics;
   MetricId m_id;
@@ -0,0 +1,99 @@
+#include <iterator> // std::size
+#include <vector>
+
+#include "disable_warnings_push.hpp"
+#include <gtest/gtest.h>
+#include "disable_warnings_pop.hpp"
+
+#include "annexb.hpp"
+
+using namespace shar;
+
+// reference implementation
+static const u8* find_start_code_naive(const u8* begin, const u8* end) {
+  for (const u8* p = begin; p + 2 < end; ++p) {
+    if (p[0] == 0 && p[1] == 0 && p[2] == 1) {
+      return p;
+    }
+  }
+  return end;
+}
+
+TEST(annexb, find_start_code) {
+  const u8 DATA[] = {0x01, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01, 0x67};
+  const u8* begin = &DATA[0];
+  const u8* end = begin + std::size(DATA);
+
+  EXPECT_EQ(find_start_code(begin, end), begin + 4);
+  EXPECT_EQ(find_start_code(begin + 5, end), end);
+  EXPECT_EQ(find_start_code(begin, begin + 6), begin + 6);
+  EXPECT_EQ(find_start_code(begin, begin), begin);
+}
+
+TEST(annexb, find_start_code_all_offsets) {
+  // covers both vectorized and scalar paths
+  for (usize size = 3; size < 100; ++size) {
+    for (usize position = 0; position + 3 <= size; ++position) {
+      std::vector<u8> data(size, 0xff);
+      data[position] = 0x00;
+      data[position + 1] = 0x00;
+      data[position + 2] = 0x01;
+
+      const u8* begin = data.data();
+      const u8* end = begin + data.size();
+      ASSERT_EQ(find_start_code(begin, end), begin + position);
+    }
+  }
+}
+
+TEST(annexb, find_start_code_random) {
+  u32 state = 0xd34d10cc;
+  std::vector<u8> data(4096);
+  for (auto& byte : data) {
+    // xorshift with lots of zeros and ones
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    byte = static_cast<u8>(state % 4 == 0 ? state % 3 : state);
+  }
+
+  const u8* end = data.data() + data.size();
+  for (const u8* p = data.data(); p < end; ++p) {
+    ASSERT_EQ(find_start_code(p, end), find_start_code_naive(p, end));
+  }
+}
+
+TEST(annexb, nal_iterator) {
+  const u8 DATA[] = {
+    0x00, 0x00, 0x00, 0x01, 0x09, 0x10,
+    0x00, 0x00, 0x01, 0x67, 0x42, 0x00, 0x20,
+    0x00, 0x00, 0x01, // empty unit
+    0x00, 0x00, 0x00, 0x01, 0x68, 0xce, 0x3c, 0x80
+  };
+
+  NalIterator it{BytesRef(&DATA[0], std::size(DATA))};
+
+  auto nal = it.next();
+  ASSERT_TRUE(nal);
+  EXPECT_EQ(nal, BytesRef(&DATA[4], 2));
+
+  nal = it.next();
+  ASSERT_TRUE(nal);
+  EXPECT_EQ(nal, BytesRef(&DATA[9], 4));
+
+  nal = it.next();
+  ASSERT_TRUE(nal);
+  EXPECT_EQ(nal, BytesRef(&DATA[20], 4));
+
+  EXPECT_FALSE(it.next());
+  EXPECT_FALSE(it.next());
+}
+
+TEST(annexb, nal_iterator_empty) {
+  NalIterator it;
+  EXPECT_FALSE(it.next());
+
+  const u8 DATA[] = {0x00, 0x00, 0x00};
+  it = NalIterator(BytesRef(&DATA[0], std::size(DATA)));
+  EXPECT_FALSE(it.next());
+}
@@ -0,0 +1,100 @@
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+#include "annexb.hpp"
+#include "int.hpp"
+
+// clang-format off
+#include "disable_warnings_push.hpp"
+#include <benchmark/benchmark.h>
+#include "disable_warnings_pop.hpp"
+// clang-format on
+
+
+using namespace shar;
+
+// start code search as it was done by rtp::Packetizer
+static const u8* find_start_code_loop(const u8* begin, const u8* end) {
+  const u8* p = begin;
+  while (p + 2 < end && (p[0] != 0 || p[1] != 0 || p[2] != 1)) {
+    ++p;
+  }
+  return p + 2 < end ? p : end;
+}
+
+// synthetic stream: random payload with start codes every ~64kb
+static std::vector<u8> generate(usize size) {
+  std::vector<u8> data(size);
+  u32 state = 0xd34d10cc;
+  for (usize i = 0; i < size; ++i) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    data[i] = static_cast<u8>(state);
+    if (i % (64 * 1024) == 0 && i + 4 < size) {
+      data[i] = 0x00;
+      data[i + 1] = 0x00;
+      data[i + 2] = 0x00;
+      data[i + 3] = 0x01;
+      i += 3;
+    }
+  }
+  return data;
+}
+
+// input stream, generated unless a file is given
+static std::vector<u8> input;
+
+template <typename F>
+static void scan(benchmark::State& state, F find) {
+  const u8* end = input.data() + input.size();
+  usize units = 0;
+
+  for (auto _ : state) {
+    units = 0;
+    const u8* p = find(input.data(), end);
+    while (p != end) {
+      ++units;
+      p = find(p + 3, end);
+    }
+    benchmark::DoNotOptimize(units);
+  }
+
+  state.counters["start_codes"] = static_cast<double>(units);
+  state.SetBytesProcessed(static_cast<i64>(state.iterations() * input.size()));
+}
+
+static void byte_loop(benchmark::State& state) {
+  scan(state, find_start_code_loop);
+}
+
+static void start_code(benchmark::State& state) {
+  scan(state, find_start_code);
+}
+
+BENCHMARK(byte_loop);
+BENCHMARK(start_code);
+
+// usage: annexbbench [benchmark options] [file.h264]
+// raw encoder output can be obtained with e.g.
+//   ffmpeg -i input.mp4 -c:v libx264 -bsf:v h264_mp4toannexb -f h264 out.h264
+// NOTE: should be built in release mode to get meaningful numbers
+int main(int argc, char* argv[]) {
+  benchmark::Initialize(&argc, argv);
+  if (argc > 1) {
+    std::ifstream file{argv[1], std::ios::binary};
+    if (!file) {
+      std::cerr << "Failed to open " << argv[1] << std::endl;
+      return EXIT_FAILURE;
+    }
+    input.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  } else {
+    input = generate(64 * 1024 * 1024);
+  }
+
+  benchmark::RunSpecifiedBenchmarks();
+  return EXIT_SUCCESS;
+}
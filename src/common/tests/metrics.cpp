@@ -0,0 +1,53 @@
+#include <string>
+#include <vector>
+
+#include "disable_warnings_push.hpp"
+#include <gtest/gtest.h>
+#include "disable_warnings_pop.hpp"
+
+#include "metrics.hpp"
+
+using namespace shar;
+
+TEST(metrics, grows) {
+  auto metrics = std::make_shared<Metrics>(2);
+  Metric first{ metrics, "first" };
+  first += 1;
+
+  // more metrics than initially allocated, e.g. per-client ones
+  std::vector<Metric> clients;
+  for (usize i = 0; i < 10; ++i) {
+    clients.emplace_back(metrics, "client " + std::to_string(i));
+    clients.back().set(i);
+  }
+
+  // metrics added before the table grew are still updated
+  first += 1;
+
+  std::vector<std::string> reported;
+  metrics->for_each([&](Metrics::MetricData& metric) {
+    reported.push_back(metric.format());
+  });
+
+  ASSERT_EQ(reported.size(), 11u);
+  EXPECT_EQ(reported.front(), "first 2");
+  EXPECT_EQ(reported.back(), "client 9 9");
+}
+
+TEST(metrics, reuses_slots) {
+  auto metrics = std::make_shared<Metrics>(2);
+  {
+    Metric a{ metrics, "a" };
+    Metric b{ metrics, "b" };
+  }
+
+  Metric c{ metrics, "c" };
+  c.set(3);
+
+  usize count = 0;
+  metrics->for_each([&](Metrics::MetricData& metric) {
+    EXPECT_EQ(metric.format(), "c 3");
+    ++count;
+  });
+  EXPECT_EQ(count, 1u);
+}
@@ -0,0 +1,189 @@
+#include "bandwidth_estimator.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace shar::net {
+
+// overuse detector parameters (see section 5.4 of GCC draft)
+static const double INITIAL_THRESHOLD = 12.5; // ms
+static const double MIN_THRESHOLD = 6.0;      // ms
+static const double MAX_THRESHOLD = 600.0;    // ms
+static const double THRESHOLD_GAIN_UP = 0.01;
+static const double THRESHOLD_GAIN_DOWN = 0.00018;
+static const double MAX_THRESHOLD_DT = 100.0; // ms
+
+// weight of new delay gradient sample
+static const double GRADIENT_SMOOTHING = 0.5;
+
+// rate controller parameters (see section 5.5 of GCC draft)
+static const double DECREASE_FACTOR = 0.85;
+static const double INCREASE_FACTOR = 1.08; // per second
+
+// loss based controller parameters (see section 6 of GCC draft)
+static const double HIGH_LOSS = 0.10;
+static const double LOW_LOSS = 0.02;
+static const double LOSS_INCREASE_FACTOR = 1.05;
+
+// target bitrate changes smaller than 1/TARGET_STEP are not reported to encoder
+static const usize TARGET_STEP = 20;
+
+BandwidthEstimator::BandwidthEstimator(usize min_kbits, usize max_kbits)
+  : m_min(std::min(min_kbits, max_kbits))
+  , m_max(max_kbits)
+  , m_loss_rate(static_cast<double>(max_kbits))
+  , m_delay_rate(static_cast<double>(max_kbits))
+  , m_threshold(INITIAL_THRESHOLD)
+  {}
+
+void BandwidthEstimator::on_sent(usize bytes) {
+  m_bytes_sent += bytes;
+}
+
+void BandwidthEstimator::on_feedback(u8 fraction_lost, double delay_ms, TimePoint now) {
+  double dt_ms = 0.0;
+  if (m_has_feedback) {
+    const auto elapsed = std::chrono::duration_cast<Microseconds>(now - m_last_feedback);
+    dt_ms = static_cast<double>(elapsed.count()) / 1000.0;
+  }
+
+  if (dt_ms > 0.0) {
+    const double kbits = static_cast<double>(m_bytes_sent * 8) / 1024.0;
+    m_send_rate = static_cast<usize>(kbits * 1000.0 / dt_ms);
+  }
+
+  m_bytes_sent = 0;
+  m_last_feedback = now;
+  m_has_feedback = true;
+
+  const double loss = static_cast<double>(fraction_lost) / 256.0;
+  m_loss = static_cast<usize>(loss * 100.0);
+  update_loss_based(loss);
+
+  const auto usage = detect(delay_ms, dt_ms);
+  update_delay_based(usage, dt_ms);
+}
+
+BandwidthEstimator::Usage BandwidthEstimator::detect(double delay_ms, double dt_ms) {
+  if (!m_has_delay) {
+    m_has_delay = true;
+    m_last_delay = delay_ms;
+    return Usage::Normal;
+  }
+
+  const double gradient = delay_ms - m_last_delay;
+  m_last_delay = delay_ms;
+  m_gradient = GRADIENT_SMOOTHING * gradient + (1.0 - GRADIENT_SMOOTHING) * m_gradient;
+
+  Usage usage = Usage::Normal;
+  if (m_gradient > m_threshold) {
+    usage = Usage::Overuse;
+  } else if (m_gradient < -m_threshold) {
+    usage = Usage::Underuse;
+  }
+
+  // adapt threshold to the delay variation, so that the detector is
+  // not starved by concurrent TCP flows. Outliers are ignored.
+  const double magnitude = std::abs(m_gradient);
+  if (magnitude < m_threshold + 15.0) {
+    const double gain = magnitude < m_threshold ? THRESHOLD_GAIN_DOWN
+                                                : THRESHOLD_GAIN_UP;
+    const double dt = std::min(dt_ms, MAX_THRESHOLD_DT);
+    m_threshold += dt * gain * (magnitude - m_threshold);
+    m_threshold = std::clamp(m_threshold, MIN_THRESHOLD, MAX_THRESHOLD);
+  }
+
+  return usage;
+}
+
+void BandwidthEstimator::update_delay_based(Usage usage, double dt_ms) {
+  switch (usage) {
+    case Usage::Overuse:
+      m_state = State::Decrease;
+      break;
+    case Usage::Underuse:
+      m_state = State::Hold;
+      break;
+    case Usage::Normal:
+      m_state = m_state == State::Decrease ? State::Hold : State::Increase;
+      break;
+  }
+
+  switch (m_state) {
+    case State::Increase: {
+      const double seconds = std::min(dt_ms / 1000.0, 1.0);
+      m_delay_rate *= std::pow(INCREASE_FACTOR, seconds);
+      break;
+    }
+    case State::Decrease: {
+      // NOTE: send rate could be much lower than target if encoder
+      //       is not saturated (e.g. static picture)
+      const double incoming = m_send_rate != 0
+                                  ? static_cast<double>(m_send_rate)
+                                  : m_delay_rate;
+      m_delay_rate = DECREASE_FACTOR * std::min(incoming, m_delay_rate);
+      break;
+    }
+    case State::Hold:
+      break;
+  }
+
+  m_delay_rate = std::clamp(m_delay_rate,
+                            static_cast<double>(m_min),
+                            static_cast<double>(m_max));
+}
+
+void BandwidthEstimator::update_loss_based(double loss) {
+  if (loss > HIGH_LOSS) {
+    m_loss_rate *= 1.0 - 0.5 * loss;
+  } else if (loss < LOW_LOSS) {
+    m_loss_rate *= LOSS_INCREASE_FACTOR;
+  }
+
+  m_loss_rate = std::clamp(m_loss_rate,
+                           static_cast<double>(m_min),
+                           static_cast<double>(m_max));
+}
+
+usize BandwidthEstimator::target() const noexcept {
+  return static_cast<usize>(std::min(m_loss_rate, m_delay_rate));
+}
+
+usize BandwidthEstimator::send_rate() const noexcept {
+  return m_send_rate;
+}
+
+BandwidthEstimator::State BandwidthEstimator::state() const noexcept {
+  return m_state;
+}
+
+usize BandwidthEstimator::loss() const noexcept {
+  return m_loss;
+}
+
+double BandwidthEstimator::gradient() const noexcept {
+  return m_gradient;
+}
+
+double BandwidthEstimator::threshold() const noexcept {
+  return m_threshold;
+}
+
+TargetReporter::TargetReporter(Sender<usize> output, usize kbits)
+  : m_output(std::move(output))
+  , m_reported(kbits) {}
+
+void TargetReporter::report(usize target_kbits) {
+  const usize diff = target_kbits > m_reported
+                         ? target_kbits - m_reported
+                         : m_reported - target_kbits;
+  if (diff > m_reported / TARGET_STEP) {
+    // NOTE: dropping update is fine, next one will correct it
+    if (!m_output.try_send(target_kbits)) {
+      m_reported = target_kbits;
+    }
+  }
+}
+
+}
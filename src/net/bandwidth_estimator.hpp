@@ -0,0 +1,105 @@
+#pragma once
+
+#include "channel.hpp"
+#include "int.hpp"
+#include "time.hpp"
+
+
+namespace shar::net {
+
+// Sender side bandwidth estimator, loosely based on Google Congestion
+// Control (draft-ietf-rmcat-gcc-02).
+//
+// Two controllers are running side by side:
+//  - loss based: decreases rate on high packet loss and slowly
+//    probes for more bandwidth when there is (almost) no loss
+//  - delay based: watches the gradient of queuing delay reported by
+//    receiver (e.g. RTCP interarrival jitter). Growing delay means that
+//    some queue along the path is filling up, so the rate is decreased
+//    before any loss occurs.
+//
+// Target bitrate is the minimum of both estimations.
+class BandwidthEstimator {
+public:
+  enum class State {
+    Increase,
+    Hold,
+    Decrease
+  };
+
+  // |min_kbits| and |max_kbits| are bounds for the target bitrate,
+  // estimation starts from |max_kbits|
+  BandwidthEstimator(usize min_kbits, usize max_kbits);
+
+  // account |bytes| sent to the network
+  void on_sent(usize bytes);
+
+  // update estimation with receiver feedback
+  // |fraction_lost| - fraction of lost packets as in RTCP report block
+  //                   (i.e. lost / expected * 256)
+  // |delay_ms|      - queuing delay indicator (in milliseconds)
+  void on_feedback(u8 fraction_lost, double delay_ms, TimePoint now);
+
+  // target bitrate (in kbits)
+  usize target() const noexcept;
+
+  // rate at which data was sent since last feedback (in kbits)
+  usize send_rate() const noexcept;
+
+  State state() const noexcept;
+
+  // last reported loss, in percents
+  usize loss() const noexcept;
+
+  // smoothed delay gradient and current overuse threshold (in ms)
+  double gradient() const noexcept;
+  double threshold() const noexcept;
+
+private:
+  enum class Usage {
+    Normal,
+    Underuse,
+    Overuse
+  };
+
+  Usage detect(double delay_ms, double dt_ms);
+  void update_delay_based(Usage usage, double dt_ms);
+  void update_loss_based(double loss);
+
+  usize m_min;
+  usize m_max;
+
+  // loss based estimation
+  double m_loss_rate;
+  usize m_loss{ 0 };
+
+  // delay based estimation
+  double m_delay_rate;
+  State m_state{ State::Increase };
+  bool m_has_delay{ false };
+  double m_last_delay{ 0.0 };
+  double m_gradient{ 0.0 };
+  double m_threshold;
+
+  // send rate measurement
+  usize m_bytes_sent{ 0 };
+  usize m_send_rate{ 0 };
+  bool m_has_feedback{ false };
+  TimePoint m_last_feedback;
+};
+
+// Sends target bitrate estimations to encoder, skipping changes that
+// are too small to be worth reconfiguring it
+class TargetReporter {
+public:
+  // |kbits| is the bitrate encoder was started with
+  TargetReporter(Sender<usize> output, usize kbits);
+
+  void report(usize target_kbits);
+
+private:
+  Sender<usize> m_output;
+  usize m_reported; // last target sent to |m_output|
+};
+
+}
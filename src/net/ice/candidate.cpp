@@ -1,100 +1,360 @@
 #include "candidate.hpp"
 
+#include "logger.hpp"
 #include "net/dns.hpp"
 #include "net/stun/message.hpp"
 #include "net/stun/request.hpp"
 #include "forwarding.hpp"
 
+#include "disable_warnings_push.hpp"
+#include <asio/thread_pool.hpp>
+#include "disable_warnings_pop.hpp"
+
+#include <algorithm> // sort, any_of
+#include <array>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <stdexcept>
 
 
 namespace shar::net::ice {
 
-// TODO: add timeout
-// TODO: use ErrorCode instead of exceptions
-static Candidate get_external_candidate(udp::Socket& socket) {
-  auto server_addr = dns::resolve("stun1.l.google.com", 19302);
-  // FIXME: check error first
-  udp::Endpoint server{*server_addr, 19302};
+// type preferences recommended by RFC 8445 Section 5.1.2.2,
+// forwarded port is preferred over address allocated by NAT
+static u32 type_preference(CandidateType type) {
+  switch (type) {
+    case CandidateType::Local:
+      return 126;
+    case CandidateType::Forwarded:
+      return 110;
+    case CandidateType::ServerReflexive:
+      return 100;
+    case CandidateType::Relayed:
+      return 0;
+  }
 
-  stun::Request request;
+  return 0;
+}
 
-  if (auto ec = request.send(socket, server)) {
-    throw std::runtime_error("Failed to send stun request: " + ec.message());
-  }
+u32 priority(CandidateType type, u16 local_preference) {
+  // NOTE: single component (RTP and RTCP are multiplexed)
+  const u32 component = 1;
+  return (type_preference(type) << 24) | (u32{ local_preference } << 8) | (256 - component);
+}
+
+// initial retransmission timeout of STUN requests, doubled on
+// each retransmission (RFC 5389 Section 7.2.1)
+static const Milliseconds STUN_RTO{ 100 };
 
-  std::array<u8, 2048> buffer;
-  std::fill_n(buffer.data(), 2048, static_cast<u8>(0));
-  udp::Endpoint responder;
+// how often retransmissions and results of blocking lookups are checked
+static const Milliseconds TICK{ 20 };
 
-  // FIXME: no timeout
-  usize n = socket.receive_from(span(buffer.data(), buffer.size()), responder);
-  assert(stun::is_message(buffer.data(), n));
+namespace {
 
-  stun::Message response{buffer.data(), n};
-  // TODO: remove this check after adding timeout
-  if (responder != server) {
-    throw std::runtime_error("Received response from unexpected host: " +
-                             responder.address().to_string());
+// host name resolution and UPnP have no async API, so they run here.
+// NOTE: pool outlives all io contexts and is joined on exit, so lookups
+//       that take longer than gathering itself don't block io threads
+asio::thread_pool& blocking_pool() {
+  static asio::thread_pool pool;
+  return pool;
+}
+
+// candidates found by blocking lookups, shared with the pool
+struct Lookups {
+  std::mutex mutex;
+  std::vector<Candidate> candidates; // found, but not added yet
+  usize finished{ 0 };               // lookups finished since last poll
+
+  void publish(std::vector<Candidate> found) {
+    std::lock_guard<std::mutex> lock(mutex);
+    candidates.insert(candidates.end(), found.begin(), found.end());
+    ++finished;
   }
+};
+
+class Gathering : public std::enable_shared_from_this<Gathering> {
+public:
+  Gathering(udp::Socket& socket, GatherOptions options, OnGathered on_gathered)
+    : m_socket(socket)
+    , m_options(std::move(options))
+    , m_on_gathered(std::move(on_gathered))
+    , m_resolver(socket.get_executor())
+    , m_deadline(socket.get_executor())
+    , m_tick(socket.get_executor())
+    , m_queries(m_options.stun_servers.size())
+    , m_lookups(std::make_shared<Lookups>())
+  {}
+
+  void start() {
+    m_deadline.expires_after(m_options.deadline);
+    m_deadline.async_wait([self = shared_from_this()](const ErrorCode& ec) {
+      if (!ec) {
+        self->finish();
+      }
+    });
+
+    // NOTE: all sources are started before any of them can finish
+    m_pending = m_queries.size() + (m_options.forward_port ? 2 : 1);
+    start_lookups();
+    for (usize i = 0; i < m_queries.size(); ++i) {
+      start_resolve(i);
+    }
+
+    if (!m_queries.empty()) {
+      start_receive();
+    }
 
-  auto endpoint = request.process_response(response);
-  if (auto ec = endpoint.err()) {
-    throw std::runtime_error("Failed to process response: " + ec.message());
+    start_tick();
   }
 
+private:
+  struct StunQuery {
+    stun::Request request;
+    std::optional<udp::Endpoint> server; // empty until resolved
+    Milliseconds rto{ STUN_RTO };
+    TimePoint next_send;
+    bool done{ false };
+  };
 
-  return Candidate{CandidateType::ServerReflexive,
-                   endpoint->address(),
-                   endpoint->port()};
-}
+  // NOTE: lookups only publish results, they are picked up by tick.
+  //       Neither |this| nor executor is used by the pool, so they
+  //       can be gone by the time lookups finish
+  void start_lookups() {
+    const auto port = m_socket.local_endpoint().port();
+    asio::post(blocking_pool(), [lookups = m_lookups, port] {
+      lookups->publish(gather_local(port));
+    });
+
+    if (m_options.forward_port) {
+      asio::post(blocking_pool(), [lookups = m_lookups, port, timeout = m_options.deadline] {
+        std::vector<Candidate> forwarded;
+        try {
+          const bool is_tcp = false;
+          const auto wan_address = forward_port(port, port, is_tcp, timeout);
+          forwarded.push_back(Candidate{ CandidateType::Forwarded, wan_address, port,
+                                         priority(CandidateType::Forwarded, 65535) });
+        } catch (const std::exception&) {
+          // logged in forward_port()
+        }
+        lookups->publish(std::move(forwarded));
+      });
+    }
+  }
+
+  static std::vector<Candidate> gather_local(Port port) {
+    std::vector<Candidate> candidates;
+    ErrorCode ec;
+    auto host = host_name(ec);
+    if (ec) {
+      LOG_WARN("Failed to get host name: {}", ec.message());
+      return candidates;
+    }
 
-std::vector<Candidate> gather_candidates(udp::Socket& socket, ErrorCode& ec) {
-  std::vector<Candidate> candidates;
+    auto addresses = dns::resolve_all(host, port);
+    if (auto e = addresses.err()) {
+      LOG_WARN("Failed to resolve local addresses: {}", e.message());
+      return candidates;
+    }
 
-  // local candidates
-  auto host = host_name(ec);
-  if (ec) {
+    u16 preference = 65535;
+    for (const auto& address : *addresses) {
+      candidates.push_back(Candidate{ CandidateType::Local, address, port, priority(CandidateType::Local, preference) });
+      --preference;
+    }
     return candidates;
   }
 
-  auto local_port = socket.local_endpoint().port();
-  auto local_addresses = dns::resolve_all(host, local_port);
-  if (auto e = local_addresses.err()) {
-    ec = e;
-    return candidates;
+  void poll_lookups() {
+    std::vector<Candidate> candidates;
+    usize finished = 0;
+    {
+      std::lock_guard<std::mutex> lock(m_lookups->mutex);
+      candidates = std::move(m_lookups->candidates);
+      m_lookups->candidates.clear();
+      finished = m_lookups->finished;
+      m_lookups->finished = 0;
+    }
+
+    for (auto& candidate : candidates) {
+      add(candidate);
+    }
+
+    for (usize i = 0; i < finished; ++i) {
+      source_done();
+    }
   }
 
-  for (const auto& addr : *local_addresses) {
-    candidates.push_back(Candidate{CandidateType::Local, addr, local_port});
+  void start_resolve(usize i) {
+    const auto& server = m_options.stun_servers[i];
+    m_resolver.async_resolve(
+      udp::v4(), server.host, std::to_string(server.port),
+      [this, i, self = shared_from_this()](const ErrorCode& ec, udp::Resolver::results_type results) {
+        if (m_done) {
+          return;
+        }
+
+        if (ec || results.empty()) {
+          LOG_WARN("Failed to resolve STUN server {}: {}", m_options.stun_servers[i].host, ec.message());
+          m_queries[i].done = true;
+          source_done();
+          return;
+        }
+
+        auto& query = m_queries[i];
+        query.server = results.begin()->endpoint();
+        query.next_send = Clock::now();
+        send(query);
+      }
+    );
   }
 
-  // forwarded candidates
-  // TODO: remove exceptions from forward_port()
-  bool forward_success = true;
-  IpAddress wan_address;
-  try {
-    bool is_tcp = false;
-    wan_address = forward_port(local_port, local_port, is_tcp);
-  } catch (const std::runtime_error&) {
-    forward_success = false;
-    // logged in forward_port()
+  void send(StunQuery& query) {
+    if (auto ec = query.request.send(m_socket, *query.server)) {
+      LOG_WARN("Failed to send STUN request: {}", ec.message());
+    }
+
+    query.next_send += query.rto;
+    query.rto *= 2;
   }
 
-  if (forward_success) {
-    candidates.push_back(
-        Candidate{CandidateType::Forwarded, wan_address, local_port});
+  void start_tick() {
+    m_tick.expires_after(TICK);
+    m_tick.async_wait([this, self = shared_from_this()](const ErrorCode& ec) {
+      if (ec || m_done) {
+        return;
+      }
+
+      const auto now = Clock::now();
+      for (auto& query : m_queries) {
+        if (!query.done && query.server && query.next_send <= now) {
+          send(query);
+        }
+      }
+
+      poll_lookups();
+      if (!m_done) {
+        start_tick();
+      }
+    });
   }
 
-  // ip:port pair for UDP hole punching
-  auto external_addr = get_external_candidate(socket);
-  if (forward_success) {
-    // TODO: check if this address can ever be valid
-    candidates.push_back(
-        Candidate{CandidateType::Forwarded, external_addr.ip, local_port});
+  void start_receive() {
+    m_socket.async_receive_from(
+      span(m_buffer.data(), m_buffer.size()),
+      m_sender,
+      [this, self = shared_from_this()](const ErrorCode& ec, usize size) {
+        if (m_done) {
+          return;
+        }
+
+        if (ec) {
+          // NOTE: ICMP errors of previous requests are reported here
+          LOG_WARN("STUN receive failed: {}", ec.message());
+        } else {
+          on_receive(size);
+        }
+
+        if (!m_done) {
+          start_receive();
+        }
+      }
+    );
+  }
+
+  void on_receive(usize size) {
+    if (!stun::is_message(m_buffer.data(), size)) {
+      return;
+    }
+
+    stun::Message message{ m_buffer.data(), size };
+    if (stun::Message::MIN_SIZE + message.length() > size) {
+      return;
+    }
+
+    for (auto& query : m_queries) {
+      if (query.done || !query.request.matches(message)) {
+        continue;
+      }
+
+      query.done = true;
+      auto endpoint = query.request.process_response(message);
+      if (auto e = endpoint.err()) {
+        LOG_WARN("Invalid STUN response from {}: {}", m_sender.address().to_string(), e.message());
+      } else {
+        add(Candidate{ CandidateType::ServerReflexive, endpoint->address(), endpoint->port(),
+                       priority(CandidateType::ServerReflexive, 65535) });
+      }
+
+      source_done();
+      return;
+    }
   }
-  candidates.push_back(external_addr);
-  return candidates;
+
+  void add(Candidate candidate) {
+    const bool duplicate = std::any_of(m_candidates.begin(), m_candidates.end(), [&](const Candidate& c) {
+      return c.type == candidate.type && c.ip == candidate.ip && c.port == candidate.port;
+    });
+
+    if (!duplicate && !m_done) {
+      m_candidates.push_back(candidate);
+    }
+  }
+
+  void source_done() {
+    --m_pending;
+    check_done();
+  }
+
+  void check_done() {
+    if (m_pending == 0) {
+      finish();
+    }
+  }
+
+  void finish() {
+    if (m_done) {
+      return;
+    }
+
+    m_done = true;
+    m_deadline.cancel();
+    m_tick.cancel();
+    m_resolver.cancel();
+    if (!m_queries.empty()) {
+      ErrorCode ignored;
+      m_socket.cancel(ignored);
+    }
+
+    std::sort(m_candidates.begin(), m_candidates.end(), [](const Candidate& lhs, const Candidate& rhs) {
+      return lhs.priority > rhs.priority;
+    });
+
+    LOG_INFO("Gathered {} candidates", m_candidates.size());
+    m_on_gathered(std::move(m_candidates));
+  }
+
+  udp::Socket& m_socket;
+  GatherOptions m_options;
+  OnGathered m_on_gathered;
+  udp::Resolver m_resolver;
+  Timer m_deadline;
+  Timer m_tick;
+
+  std::vector<StunQuery> m_queries; // one per STUN server
+  usize m_pending{ 0 };             // sources that didn't finish yet
+  bool m_done{ false };
+  std::vector<Candidate> m_candidates;
+  std::shared_ptr<Lookups> m_lookups;
+
+  std::array<u8, 2048> m_buffer;
+  udp::Endpoint m_sender;
+};
+
+} // namespace
+
+void gather_candidates(udp::Socket& socket, GatherOptions options, OnGathered on_gathered) {
+  std::make_shared<Gathering>(socket, std::move(options), std::move(on_gathered))->start();
 }
 
-}
\ No newline at end of file
+}
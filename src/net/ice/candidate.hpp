@@ -1,8 +1,10 @@
 #pragma once
 
 #include "net/types.hpp"
-#include "common/logger.hpp"
+#include "time.hpp"
 
+#include <functional>
+#include <string>
 #include <vector>
 
 
@@ -44,15 +46,41 @@ enum class CandidateType {
 	Local,           // port on local network interface
 	Forwarded,       // port forwarded via IGD
 	ServerReflexive, // NAT allocated port (obtained via STUN)
-	Relayed          // TURN allocated address
+	Relayed          // TURN allocated address (or shar server relay, see Relay)
 };
 
 struct Candidate {
   CandidateType type;
   IpAddress ip;
   Port port;
+  u32 priority{ 0 };
 };
 
-std::vector<Candidate> gather_candidates(udp::Socket& socket, ErrorCode& ec);
+// candidate priority (RFC 8445 Section 5.1.2), |local_preference|
+// orders candidates of the same type, e.g. of different interfaces
+u32 priority(CandidateType type, u16 local_preference);
+
+struct StunServer {
+  std::string host;
+  Port port;
+};
+
+struct GatherOptions {
+  // candidates that weren't gathered by then are skipped
+  Milliseconds deadline{ 1000 };
+  std::vector<StunServer> stun_servers{
+    { "stun1.l.google.com", 19302 },
+    { "stun2.l.google.com", 19302 }
+  };
+  bool forward_port{ true };
+};
+
+using OnGathered = std::function<void(std::vector<Candidate>)>;
+
+// Gathers local, forwarded (UPnP) and server reflexive (STUN) candidates of
+// |socket| concurrently. |on_gathered| is called on |socket|'s executor once
+// all of them are gathered or deadline expires, with whatever was gathered.
+// NOTE: |socket| should stay alive and not be read by anyone else until then
+void gather_candidates(udp::Socket& socket, GatherOptions options, OnGathered on_gathered);
 
 }
\ No newline at end of file
@@ -0,0 +1,277 @@
+#include "checker.hpp"
+
+#include "logger.hpp"
+#include "net/stun/message.hpp"
+
+#include <algorithm> // max, min, any_of, find_if, stable_sort
+
+
+namespace shar::net::ice {
+
+// initial retransmission timeout of a check (RFC 8445 Section 14.3)
+static const Milliseconds CHECK_RTO{ 100 };
+
+// max number of binding requests sent for one pair (Rc, RFC 5389 Section 7.2.1)
+static const usize MAX_ATTEMPTS = 7;
+
+u64 Checker::pair_priority(u32 controlling, u32 controlled) {
+  const u64 g = controlling;
+  const u64 d = controlled;
+  return (std::min(g, d) << 32) + 2 * std::max(g, d) + (g > d ? 1 : 0);
+}
+
+std::shared_ptr<Checker> Checker::create(udp::Socket& socket,
+                                         const std::vector<Candidate>& local,
+                                         const std::vector<Candidate>& remote,
+                                         Options options,
+                                         OnSelected on_selected) {
+  std::shared_ptr<Checker> checker{ new Checker(socket, options, std::move(on_selected)) };
+
+  // NOTE: all local candidates share the same socket (base), so pairs
+  //       that differ only in local candidate are redundant, only the one
+  //       with highest priority is kept (RFC 8445 Section 6.1.2.4)
+  u32 local_priority = 0;
+  for (const auto& candidate : local) {
+    if (candidate.ip.is_v4()) {
+      local_priority = std::max(local_priority, candidate.priority);
+    }
+  }
+
+  for (const auto& candidate : remote) {
+    if (!candidate.ip.is_v4()) {
+      continue;
+    }
+
+    const auto priority = options.controlling ? pair_priority(local_priority, candidate.priority)
+                                              : pair_priority(candidate.priority, local_priority);
+    checker->add_pair(udp::Endpoint{ candidate.ip, candidate.port }, priority);
+  }
+
+  std::stable_sort(checker->m_pairs.begin(), checker->m_pairs.end(), [](const Pair& lhs, const Pair& rhs) {
+    return lhs.priority > rhs.priority;
+  });
+
+  return checker;
+}
+
+Checker::Checker(udp::Socket& socket, Options options, OnSelected on_selected)
+  : m_socket(socket)
+  , m_options(options)
+  , m_on_selected(std::move(on_selected))
+  , m_tick(socket.get_executor())
+  , m_timeout(socket.get_executor())
+{}
+
+void Checker::add_pair(const udp::Endpoint& remote, u64 priority) {
+  auto pair = std::find_if(m_pairs.begin(), m_pairs.end(), [&](const Pair& p) { return p.remote == remote; });
+  if (pair != m_pairs.end()) {
+    pair->priority = std::max(pair->priority, priority);
+    return;
+  }
+
+  m_pairs.push_back(Pair{ remote, priority, State::Waiting, stun::Request{}, CHECK_RTO, TimePoint{}, 0 });
+}
+
+void Checker::start() {
+  m_running = true;
+  m_started = Clock::now();
+
+  m_timeout.expires_after(m_options.timeout);
+  m_timeout.async_wait([this, self = shared_from_this()](const ErrorCode& ec) {
+    if (!ec && m_running) {
+      complete(ErrorCode(std::make_error_code(std::errc::timed_out)));
+    }
+  });
+
+  start_receive();
+  tick();
+}
+
+void Checker::stop() {
+  if (!m_running) {
+    return;
+  }
+
+  m_running = false;
+  m_tick.cancel();
+  m_timeout.cancel();
+
+  ErrorCode ignored;
+  m_socket.cancel(ignored);
+}
+
+void Checker::start_tick() {
+  m_tick.expires_after(m_options.pacing);
+  m_tick.async_wait([this, self = shared_from_this()](const ErrorCode& ec) {
+    if (!ec && m_running && !m_completed) {
+      tick();
+    }
+  });
+}
+
+void Checker::tick() {
+  const auto now = Clock::now();
+
+  // retransmit checks that weren't answered in time
+  for (auto& pair : m_pairs) {
+    if (pair.state != State::InProgress || pair.next_send > now) {
+      continue;
+    }
+
+    if (pair.attempts >= MAX_ATTEMPTS) {
+      pair.state = State::Failed;
+      continue;
+    }
+
+    send(pair);
+  }
+
+  // start one new check per tick, triggered ones go first
+  Pair* next = nullptr;
+  while (!m_triggered.empty() && !next) {
+    auto& pair = m_pairs[m_triggered.front()];
+    m_triggered.pop_front();
+    if (pair.state == State::Waiting) {
+      next = &pair;
+    }
+  }
+
+  if (!next) {
+    auto waiting = std::find_if(m_pairs.begin(), m_pairs.end(), [](const Pair& p) { return p.state == State::Waiting; });
+    if (waiting != m_pairs.end()) {
+      next = &*waiting;
+    }
+  }
+
+  if (next) {
+    next->state = State::InProgress;
+    send(*next);
+  }
+
+  const bool all_failed = !m_pairs.empty() && std::all_of(m_pairs.begin(), m_pairs.end(), [](const Pair& p) {
+    return p.state == State::Failed;
+  });
+
+  if (all_failed) {
+    complete(ErrorCode(std::make_error_code(std::errc::host_unreachable)));
+    return;
+  }
+
+  start_tick();
+}
+
+void Checker::send(Pair& pair) {
+  if (auto ec = pair.request.send(m_socket, pair.remote)) {
+    // NOTE: same as lost request, it is retransmitted
+    LOG_WARN("Failed to send check to {}:{}: {}", pair.remote.address().to_string(), pair.remote.port(), ec.message());
+  }
+
+  ++pair.attempts;
+  pair.next_send = Clock::now() + pair.rto;
+  pair.rto *= 2;
+}
+
+void Checker::start_receive() {
+  m_socket.async_receive_from(
+    span(m_buffer.data(), m_buffer.size()),
+    m_sender,
+    [this, self = shared_from_this()](const ErrorCode& ec, usize size) {
+      if (!m_running) {
+        return;
+      }
+
+      // NOTE: ICMP errors of previous checks are reported as receive errors
+      if (!ec && stun::is_message(m_buffer.data(), size)) {
+        stun::Message message{ m_buffer.data(), size };
+        if (stun::Message::MIN_SIZE + message.length() <= size) {
+          if (message.type() == 0b00) {
+            on_request(message);
+          } else {
+            on_response(message);
+          }
+        }
+      }
+
+      if (m_running) {
+        start_receive();
+      }
+    }
+  );
+}
+
+void Checker::on_request(const stun::Message& message) {
+  const usize size = stun::write_binding_response(BytesRefMut(m_response.data(), m_response.size()),
+                                                  message.transaction(), m_sender);
+  if (size == 0) {
+    return;
+  }
+
+  ErrorCode ec;
+  m_socket.send_to(span(m_response.data(), size), m_sender, 0, ec);
+  if (ec) {
+    LOG_WARN("Failed to answer check of {}: {}", m_sender.address().to_string(), ec.message());
+  }
+
+  if (m_completed) {
+    return;
+  }
+
+  // triggered check (RFC 8445 Section 7.3.1.4), unknown address is
+  // peer reflexive candidate of remote peer, it is checked last
+  auto pair = std::find_if(m_pairs.begin(), m_pairs.end(), [&](const Pair& p) { return p.remote == m_sender; });
+  if (pair == m_pairs.end()) {
+    add_pair(m_sender, 0);
+    pair = m_pairs.end() - 1;
+  }
+
+  if (pair->state == State::Failed) {
+    pair->state = State::Waiting;
+    pair->attempts = 0;
+    pair->rto = CHECK_RTO;
+  }
+
+  if (pair->state == State::Waiting) {
+    m_triggered.push_back(static_cast<usize>(pair - m_pairs.begin()));
+  }
+}
+
+void Checker::on_response(stun::Message& message) {
+  for (auto& pair : m_pairs) {
+    if (pair.state != State::InProgress || !pair.request.matches(message)) {
+      continue;
+    }
+
+    // NOTE: response should come from the address request was sent to
+    if (m_sender != pair.remote || pair.request.process_response(message).err()) {
+      pair.state = State::Failed;
+      return;
+    }
+
+    pair.state = State::Succeeded;
+    complete(pair.remote);
+    return;
+  }
+}
+
+void Checker::complete(ErrorOr<udp::Endpoint> result) {
+  if (m_completed) {
+    return;
+  }
+
+  m_completed = true;
+  m_tick.cancel();
+  m_timeout.cancel();
+
+  const auto elapsed = std::chrono::duration_cast<Milliseconds>(Clock::now() - m_started);
+  if (auto e = result.err()) {
+    LOG_WARN("Connectivity checks failed after {}ms: {}", elapsed.count(), e.message());
+  } else {
+    LOG_INFO("Selected {}:{} after {}ms", result->address().to_string(), result->port(), elapsed.count());
+  }
+
+  // NOTE: remote peer might still be checking, so its requests are
+  //       answered until stop() is called
+  m_on_selected(std::move(result));
+}
+
+} // namespace shar::net::ice
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "candidate.hpp"
+#include "error_or.hpp"
+#include "net/types.hpp"
+#include "net/stun/request.hpp"
+#include "time.hpp"
+
+#include <array>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+
+namespace shar::net::ice {
+
+// Connectivity checks (RFC 8445 Section 6.1.4 and 7.2) over a single socket.
+// Pairs of local and remote candidates are checked in order of their
+// priority, one new check is started every |pacing| (Ta). Binding requests of
+// the remote peer are answered and trigger a check of the pair they came from.
+// First pair that succeeds is selected (aggressive nomination).
+// NOTE: checks are not authenticated, USERNAME and MESSAGE-INTEGRITY
+//       attributes are not supported by stun::Request yet
+class Checker : public std::enable_shared_from_this<Checker> {
+public:
+  using OnSelected = std::function<void(ErrorOr<udp::Endpoint>)>;
+
+  struct Options {
+    Milliseconds pacing{ 50 };    // Ta
+    Milliseconds timeout{ 5000 }; // checks fail if no pair succeeded by then
+    bool controlling{ false };    // agent that initiated the connection
+  };
+
+  enum class State {
+    Waiting,
+    InProgress,
+    Succeeded,
+    Failed
+  };
+
+  struct Pair {
+    udp::Endpoint remote;
+    u64 priority;
+    State state{ State::Waiting };
+    stun::Request request;
+    Milliseconds rto;
+    TimePoint next_send;
+    usize attempts{ 0 };
+  };
+
+  // pair priority (RFC 8445 Section 6.1.2.3)
+  static u64 pair_priority(u32 controlling, u32 controlled);
+
+  // |on_selected| is called once, on |socket|'s executor, with remote
+  // endpoint of selected pair or error if all checks failed
+  static std::shared_ptr<Checker> create(udp::Socket& socket,
+                                         const std::vector<Candidate>& local,
+                                         const std::vector<Candidate>& remote,
+                                         Options options,
+                                         OnSelected on_selected);
+
+  Checker(const Checker&) = delete;
+  Checker(Checker&&) = delete;
+  Checker& operator=(const Checker&) = delete;
+  Checker& operator=(Checker&&) = delete;
+  ~Checker() = default;
+
+  void start();
+
+  // stop checks and answering remote peer, should be called
+  // before |socket| is used for anything else
+  void stop();
+
+  // pairs in order of priority
+  const std::vector<Pair>& pairs() const { return m_pairs; }
+
+private:
+  Checker(udp::Socket& socket, Options options, OnSelected on_selected);
+
+  void add_pair(const udp::Endpoint& remote, u64 priority);
+
+  void start_tick();
+  void tick();
+  void send(Pair& pair);
+
+  void start_receive();
+  void on_request(const stun::Message& message);
+  void on_response(stun::Message& message);
+
+  void complete(ErrorOr<udp::Endpoint> result);
+
+  udp::Socket& m_socket;
+  Options m_options;
+  OnSelected m_on_selected;
+  Timer m_tick;
+  Timer m_timeout;
+  bool m_running{ false };
+  bool m_completed{ false };
+  TimePoint m_started;
+
+  std::vector<Pair> m_pairs;
+  std::deque<usize> m_triggered; // pairs to be checked before others
+
+  std::array<u8, 2048> m_buffer;
+  std::array<u8, 64> m_response;
+  udp::Endpoint m_sender;
+};
+
+} // namespace shar::net::ice
@@ -45,7 +45,7 @@ void Client::disconnect(ErrorCode ec) {
   }
 
   m_socket.shutdown(tcp::Socket::shutdown_both);
-  m_messages.clear();
+  m_queue.clear();
   m_connected = false;
   m_on_connect(ec);
 }
@@ -64,11 +64,19 @@ void Client::open_session(
   message.set_request_id(id);
   proto::Open* open = message.mutable_open();
   open->set_name(std::string(name));
-  send_message(std::move(message));
+  send_message(message);
 }
 
-void Client::send_message(proto::ClientMessage message) {
-  m_messages.emplace_back(std::move(message));
+void Client::send_message(const proto::ClientMessage& message) {
+  const usize offset = m_queue.size();
+  const u32 message_size = static_cast<u32>(message.ByteSizeLong());
+  m_queue.resize(offset + 4 + message_size);
+  write_u32_le(m_queue.data() + offset, message_size);
+  if (!message.SerializeToArray(m_queue.data() + offset + 4, static_cast<int>(message_size))) {
+    LOG_FATAL("Failed to serialize message");
+    assert(false);
+  }
+
   if (!m_send_running) {
     start_send();
   }
@@ -76,22 +84,15 @@ void Client::send_message(proto::ClientMessage message) {
 
 void Client::start_send() {
   if (m_sent >= m_send_buffer.size()) {
+    // NOTE: all messages queued so far are sent at once,
+    //       buffers are swapped to keep their capacity
     m_send_buffer.clear();
+    std::swap(m_send_buffer, m_queue);
+    m_sent = 0;
 
-    if (m_messages.empty()) {
+    if (m_send_buffer.empty()) {
       return;
     }
-
-    auto& message = m_messages.front();
-    u32 message_size = static_cast<u32>(message.ByteSizeLong());
-    m_send_buffer.resize(4 + message_size);
-    write_u32_le(m_send_buffer.data(), message_size);
-    if (!message.SerializeToArray(m_send_buffer.data()+4, m_send_buffer.size()-4)) {
-      LOG_FATAL("Failed to serialize message");
-      assert(false);
-    }
-
-    m_sent = 0;
   }
 
   auto buffer = span(m_send_buffer.data() + m_sent, m_send_buffer.size() - m_sent);
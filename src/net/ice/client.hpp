@@ -8,7 +8,7 @@
 
 #include <functional>
 #include <string>
-#include <deque>
+#include <vector>
 
 
 namespace shar::net::ice {
@@ -43,7 +43,8 @@ public:
   );
 
 private:
-  void send_message(proto::ClientMessage message);
+  // serialize |message| to the end of send queue
+  void send_message(const proto::ClientMessage& message);
   void start_send();
 
   IOContext& m_context;
@@ -54,8 +55,8 @@ private:
   std::function<void(ErrorCode ec)> m_on_connect;
 
   bool m_send_running{ false };
-  std::deque<proto::ClientMessage> m_messages;
-  std::vector<u8> m_send_buffer;
+  std::vector<u8> m_queue;       // serialized messages waiting to be sent
+  std::vector<u8> m_send_buffer; // messages being sent
   usize m_sent{ 0 };
 };
 
@@ -12,10 +12,10 @@
 namespace shar::net::ice {
 
 // TODO: extract port forwarding to a class
-IpAddress forward_port(Port local, Port remote, bool is_tcp) {
+IpAddress forward_port(Port local, Port remote, bool is_tcp, Milliseconds discover_timeout) {
   int           error      = 0;
   //get a list of upnp devices (asks on the broadcast address and returns the responses)
-  struct UPNPDev* upnp_dev = upnpDiscover(1000,     //timeout in milliseconds
+  struct UPNPDev* upnp_dev = upnpDiscover(static_cast<int>(discover_timeout.count()), //timeout in milliseconds
                                           nullptr,  //multicast address, default = "239.255.255.250"
                                           nullptr,  //minissdpd socket, default = "/var/run/minissdpd.sock"
                                           0,        //source port, default = 1900
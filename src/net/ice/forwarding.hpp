@@ -1,6 +1,7 @@
 #pragma once
 
 #include "net/types.hpp"
+#include "time.hpp"
 
 #include <cstdint>
 
@@ -11,6 +12,9 @@ using Port = u16;
 
 // returns external WAN address on success
 // throws exception on failure
-IpAddress forward_port(Port local, Port remote, bool is_tcp);
+// NOTE: blocks for up to |discover_timeout| looking for IGD, and then
+//       for as long as IGD takes to answer
+IpAddress forward_port(Port local, Port remote, bool is_tcp,
+                       Milliseconds discover_timeout = Milliseconds(1000));
 
 }
\ No newline at end of file
@@ -0,0 +1,240 @@
+#include "relay.hpp"
+
+#include "logger.hpp"
+
+#include <cerrno>
+#include <cstring> // memcmp, memcpy
+
+
+namespace shar::net::ice {
+
+ErrorOr<std::shared_ptr<Relay>> Relay::create(IOContext& context, IpAddress ip,
+                                               std::array<IpAddress, 2> peers) {
+  std::shared_ptr<Relay> relay{ new Relay(context) };
+  for (usize i = 0; i < relay->m_sides.size(); ++i) {
+    auto& side = relay->m_sides[i];
+    side.expected = peers[i];
+
+    const udp::Endpoint endpoint{ ip, 0 };
+    ErrorCode ec;
+    side.socket.open(endpoint.protocol(), ec);
+    if (ec) {
+      return ec;
+    }
+
+    side.socket.bind(endpoint, ec);
+    if (ec) {
+      return ec;
+    }
+
+    // NOTE: sockets are drained until they would block, see forward()
+    side.socket.non_blocking(true, ec);
+    if (ec) {
+      return ec;
+    }
+  }
+
+  return relay;
+}
+
+Relay::Relay(IOContext& context)
+  : m_sides{ Side(context), Side(context) }
+  , m_buffer(BATCH_SIZE * MAX_DATAGRAM_SIZE)
+{
+#ifdef __linux__
+  for (usize i = 0; i < BATCH_SIZE; ++i) {
+    m_iovecs[i].iov_base = m_buffer.data() + i * MAX_DATAGRAM_SIZE;
+    m_iovecs[i].iov_len = MAX_DATAGRAM_SIZE;
+  }
+#endif
+}
+
+std::array<Port, 2> Relay::ports() const {
+  return {
+    m_sides[0].socket.local_endpoint().port(),
+    m_sides[1].socket.local_endpoint().port()
+  };
+}
+
+void Relay::start() {
+  m_running = true;
+  start_wait(0);
+  start_wait(1);
+}
+
+void Relay::stop() {
+  if (!m_running) {
+    return;
+  }
+
+  m_running = false;
+  for (auto& side : m_sides) {
+    ErrorCode ignored;
+    side.socket.close(ignored);
+  }
+}
+
+void Relay::start_wait(usize side) {
+  m_sides[side].socket.async_wait(
+    udp::Socket::wait_read,
+    [this, side, self = shared_from_this()](ErrorCode ec) {
+      if (!m_running) {
+        return;
+      }
+
+      if (ec) {
+        LOG_ERROR("Relay port {} failed: {}", side, ec.message());
+        stop();
+        return;
+      }
+
+      forward(side);
+      start_wait(side);
+    }
+  );
+}
+
+#ifdef __linux__
+
+static bool is_transient(int error) {
+  // NOTE: ICMP errors for previous datagrams are reported on next call
+  return error == EAGAIN || error == EWOULDBLOCK || error == EINTR ||
+         error == ECONNREFUSED || error == EHOSTUNREACH || error == ENETUNREACH;
+}
+
+// true if |address| received by recvmmsg() has |ip|
+static bool has_ip(const sockaddr_storage& address, socklen_t size, const IpAddress& ip) {
+  if (ip.is_v4()) {
+    const auto bytes = ip.to_v4().to_bytes();
+    const auto* in = reinterpret_cast<const sockaddr_in*>(&address);
+    return size >= sizeof(sockaddr_in) && in->sin_family == AF_INET &&
+           std::memcmp(&in->sin_addr, bytes.data(), bytes.size()) == 0;
+  }
+
+  const auto bytes = ip.to_v6().to_bytes();
+  const auto* in = reinterpret_cast<const sockaddr_in6*>(&address);
+  return size >= sizeof(sockaddr_in6) && in->sin6_family == AF_INET6 &&
+         std::memcmp(&in->sin6_addr, bytes.data(), bytes.size()) == 0;
+}
+
+void Relay::forward(usize side) {
+  auto& in = m_sides[side];
+  auto& out = m_sides[1 - side];
+  const int in_fd = in.socket.native_handle();
+  const int out_fd = out.socket.native_handle();
+
+  while (true) {
+    for (usize i = 0; i < BATCH_SIZE; ++i) {
+      auto& header = m_received[i].msg_hdr;
+      header = msghdr{};
+      header.msg_name = &m_addresses[i];
+      header.msg_namelen = sizeof(m_addresses[i]);
+      header.msg_iov = &m_iovecs[i];
+      header.msg_iovlen = 1;
+    }
+
+    const int n = ::recvmmsg(in_fd, m_received.data(), BATCH_SIZE, MSG_DONTWAIT, nullptr);
+    if (n < 0) {
+      if (!is_transient(errno)) {
+        LOG_ERROR("Relay recvmmsg() failed: {}", std::strerror(errno));
+      }
+      return;
+    }
+
+    usize count = 0;
+    for (usize i = 0; i < static_cast<usize>(n); ++i) {
+      const auto& header = m_received[i].msg_hdr;
+      if (!in.latched && has_ip(m_addresses[i], header.msg_namelen, in.expected)) {
+        std::memcpy(&in.peer, header.msg_name, header.msg_namelen);
+        in.peer_size = header.msg_namelen;
+        in.latched = true;
+      }
+
+      const bool from_peer = in.latched && header.msg_namelen == in.peer_size &&
+                             std::memcmp(header.msg_name, &in.peer, in.peer_size) == 0;
+      if (!from_peer || !out.latched || (header.msg_flags & MSG_TRUNC)) {
+        ++m_stats.dropped;
+        continue;
+      }
+
+      // NOTE: datagram is sent right from the buffer it was received into
+      auto& sent = m_sent[count++].msg_hdr;
+      sent = msghdr{};
+      sent.msg_name = &out.peer;
+      sent.msg_namelen = out.peer_size;
+      sent.msg_iov = &m_iovecs[i];
+      sent.msg_iovlen = 1;
+      m_iovecs[i].iov_len = m_received[i].msg_len;
+    }
+
+    usize offset = 0;
+    while (offset < count) {
+      const int sent = ::sendmmsg(out_fd, m_sent.data() + offset, static_cast<unsigned>(count - offset), MSG_DONTWAIT);
+      if (sent < 0) {
+        if (!is_transient(errno)) {
+          LOG_ERROR("Relay sendmmsg() failed: {}", std::strerror(errno));
+        }
+
+        // NOTE: relay doesn't buffer, same as a congested router
+        m_stats.dropped += count - offset;
+        break;
+      }
+
+      for (usize i = offset; i < offset + static_cast<usize>(sent); ++i) {
+        m_stats.bytes += m_sent[i].msg_hdr.msg_iov->iov_len;
+      }
+      m_stats.packets += static_cast<usize>(sent);
+      offset += static_cast<usize>(sent);
+    }
+
+    for (auto& iovec : m_iovecs) {
+      iovec.iov_len = MAX_DATAGRAM_SIZE;
+    }
+
+    if (static_cast<usize>(n) < BATCH_SIZE) {
+      return; // drained
+    }
+  }
+}
+
+#else
+
+void Relay::forward(usize side) {
+  auto& in = m_sides[side];
+  auto& out = m_sides[1 - side];
+
+  while (true) {
+    ErrorCode ec;
+    udp::Endpoint sender;
+    const usize n = in.socket.receive_from(span(m_buffer.data(), MAX_DATAGRAM_SIZE), sender, 0, ec);
+    if (ec) {
+      if (ec != std::errc::operation_would_block) {
+        LOG_ERROR("Relay receive failed: {}", ec.message());
+      }
+      return;
+    }
+
+    if (!in.latched && sender.address() == in.expected) {
+      in.peer = sender;
+      in.latched = true;
+    }
+
+    if (!in.latched || sender != in.peer || !out.latched) {
+      ++m_stats.dropped;
+      continue;
+    }
+
+    out.socket.send_to(span(m_buffer.data(), n), out.peer, 0, ec);
+    if (ec) {
+      ++m_stats.dropped;
+      continue;
+    }
+
+    ++m_stats.packets;
+    m_stats.bytes += n;
+  }
+}
+
+#endif
+
+} // namespace shar::net::ice
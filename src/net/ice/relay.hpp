@@ -0,0 +1,102 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "net/types.hpp"
+#include "error_or.hpp"
+
+#ifdef __linux__
+#include <netinet/in.h> // sockaddr_in, sockaddr_in6
+#include <sys/socket.h> // mmsghdr, sockaddr_storage
+#include <sys/uio.h>    // iovec
+#endif
+
+
+namespace shar::net::ice {
+
+// TURN-like relay for peers that can't reach each other directly (see
+// CandidateType::Relayed). Each of two peers gets its own relay port, first
+// address with the peer's expected IP that sends a datagram to the port is
+// latched as the peer, then datagrams are forwarded to the other peer as is.
+// Datagrams from other addresses, or sent before the other peer is latched,
+// are dropped.
+// NOTE: expected IPs are the ones server sees on signaling connections, they
+//       keep hosts that scan relay ports from taking over a relay, but not
+//       other hosts behind the same NAT as the peer
+// On linux datagrams are received and sent in batches (recvmmsg/sendmmsg)
+// into preallocated buffers, so there is no allocation per datagram.
+// NOTE: handlers should not run concurrently, i.e. context should be
+//       run by a single thread
+class Relay : public std::enable_shared_from_this<Relay> {
+public:
+  static const usize BATCH_SIZE = 64;
+  static const usize MAX_DATAGRAM_SIZE = 2048;
+
+  struct Stats {
+    usize packets{ 0 }; // forwarded datagrams
+    usize bytes{ 0 };   // forwarded bytes
+    usize dropped{ 0 }; // datagrams from unknown address or with no receiver
+  };
+
+  // bind both relay ports on |ip|, ports are picked by OS,
+  // port i only accepts datagrams sent from |peers[i]|
+  static ErrorOr<std::shared_ptr<Relay>> create(IOContext& context, IpAddress ip,
+                                                std::array<IpAddress, 2> peers);
+
+  Relay(const Relay&) = delete;
+  Relay(Relay&&) = delete;
+  Relay& operator=(const Relay&) = delete;
+  Relay& operator=(Relay&&) = delete;
+  ~Relay() = default;
+
+  // relay port of each peer
+  std::array<Port, 2> ports() const;
+
+  void start();
+
+  // close relay ports, relay is freed once pending handlers are done
+  void stop();
+
+  const Stats& stats() const { return m_stats; }
+
+private:
+  explicit Relay(IOContext& context);
+
+  void start_wait(usize side);
+
+  // receive everything that is available on |side| and send it to the other one
+  void forward(usize side);
+
+  struct Side {
+    explicit Side(IOContext& context)
+      : socket(context)
+    {}
+
+    udp::Socket socket;
+    IpAddress expected; // IP of the peer
+    bool latched{ false };
+#ifdef __linux__
+    sockaddr_storage peer{};
+    socklen_t peer_size{ 0 };
+#else
+    udp::Endpoint peer;
+#endif
+  };
+
+  std::array<Side, 2> m_sides;
+  bool m_running{ false };
+  Stats m_stats;
+
+  // storage of a single batch, reused by both sides
+  std::vector<u8> m_buffer;
+#ifdef __linux__
+  std::array<mmsghdr, BATCH_SIZE> m_received;
+  std::array<mmsghdr, BATCH_SIZE> m_sent;
+  std::array<iovec, BATCH_SIZE> m_iovecs;
+  std::array<sockaddr_storage, BATCH_SIZE> m_addresses;
+#endif
+};
+
+} // namespace shar::net::ice
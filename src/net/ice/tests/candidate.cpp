@@ -0,0 +1,117 @@
+#include "net/ice/candidate.hpp"
+#include "net/ice/tests/common.hpp"
+#include "net/stun/message.hpp"
+#include "net/stun/request.hpp"
+#include "time.hpp"
+
+#include <algorithm>
+#include <array>
+#include <optional>
+#include <vector>
+
+// clang-format off
+#include "disable_warnings_push.hpp"
+#include <gtest/gtest.h>
+#include "disable_warnings_pop.hpp"
+// clang-format on
+
+using namespace shar;
+using namespace shar::net;
+using namespace shar::net::ice::test;
+
+// answer all pending binding requests on |server|
+static void answer(udp::Socket& server) {
+  std::array<u8, 2048> buffer;
+  std::array<u8, 64> response;
+  udp::Endpoint sender;
+  while (true) {
+    ErrorCode ec;
+    const usize n = server.receive_from(span(buffer.data(), buffer.size()), sender, 0, ec);
+    if (ec) {
+      return;
+    }
+
+    if (!stun::is_message(buffer.data(), n)) {
+      continue;
+    }
+
+    stun::Message request{ buffer.data(), n };
+    const usize size = stun::write_binding_response(BytesRefMut(response.data(), response.size()),
+                                                    request.transaction(), sender);
+    server.send_to(span(response.data(), size), sender);
+  }
+}
+
+static ice::GatherOptions options_for(const udp::Socket& server) {
+  ice::GatherOptions options;
+  options.forward_port = false;
+  options.stun_servers = { ice::StunServer{ "127.0.0.1", server.local_endpoint().port() } };
+  return options;
+}
+
+TEST(ice_candidate, priority) {
+  using ice::CandidateType;
+
+  EXPECT_GT(ice::priority(CandidateType::Local, 0), ice::priority(CandidateType::Forwarded, 65535));
+  EXPECT_GT(ice::priority(CandidateType::Forwarded, 0), ice::priority(CandidateType::ServerReflexive, 65535));
+  EXPECT_GT(ice::priority(CandidateType::ServerReflexive, 0), ice::priority(CandidateType::Relayed, 65535));
+  EXPECT_GT(ice::priority(CandidateType::Local, 2), ice::priority(CandidateType::Local, 1));
+
+  // (2^24)*(type preference) + (2^8)*(local preference) + (256 - component ID)
+  EXPECT_EQ(ice::priority(CandidateType::Local, 65535), 2130706431u);
+}
+
+TEST(ice_candidate, gather) {
+  IOContext context;
+  auto server = make_socket(context);
+  server.non_blocking(true);
+  auto socket = make_socket(context);
+
+  std::optional<std::vector<ice::Candidate>> gathered;
+  ice::gather_candidates(socket, options_for(server), [&](std::vector<ice::Candidate> candidates) {
+    gathered = std::move(candidates);
+  });
+
+  run_until(context, [&] {
+    answer(server);
+    return gathered.has_value();
+  });
+
+  ASSERT_TRUE(gathered);
+  const auto reflexive = std::find_if(gathered->begin(), gathered->end(), [](const ice::Candidate& c) {
+    return c.type == ice::CandidateType::ServerReflexive;
+  });
+
+  // NOTE: there is no NAT on loopback
+  ASSERT_NE(reflexive, gathered->end());
+  EXPECT_EQ(reflexive->ip, loopback());
+  EXPECT_EQ(reflexive->port, socket.local_endpoint().port());
+
+  EXPECT_TRUE(std::is_sorted(gathered->begin(), gathered->end(), [](const ice::Candidate& lhs, const ice::Candidate& rhs) {
+    return lhs.priority > rhs.priority;
+  }));
+}
+
+TEST(ice_candidate, deadline) {
+  IOContext context;
+  auto server = make_socket(context); // never answers
+  auto socket = make_socket(context);
+
+  auto options = options_for(server);
+  options.deadline = Milliseconds(100);
+
+  std::optional<std::vector<ice::Candidate>> gathered;
+  const auto start = Clock::now();
+  ice::gather_candidates(socket, options, [&](std::vector<ice::Candidate> candidates) {
+    gathered = std::move(candidates);
+  });
+
+  context.run_for(Milliseconds(1000));
+  const auto elapsed = Clock::now() - start;
+
+  ASSERT_TRUE(gathered);
+  EXPECT_LT(elapsed, Milliseconds(500));
+  EXPECT_TRUE(std::none_of(gathered->begin(), gathered->end(), [](const ice::Candidate& c) {
+    return c.type == ice::CandidateType::ServerReflexive;
+  }));
+}
@@ -0,0 +1,107 @@
+#include "net/ice/checker.hpp"
+#include "net/ice/tests/common.hpp"
+#include "time.hpp"
+
+#include <optional>
+#include <vector>
+
+// clang-format off
+#include "disable_warnings_push.hpp"
+#include <gtest/gtest.h>
+#include "disable_warnings_pop.hpp"
+// clang-format on
+
+using namespace shar;
+using namespace shar::net;
+using namespace shar::net::ice::test;
+
+static ice::Candidate local_candidate(const udp::Socket& socket, u16 preference = 65535) {
+  const auto endpoint = socket.local_endpoint();
+  return ice::Candidate{ ice::CandidateType::Local, endpoint.address(), endpoint.port(),
+                         ice::priority(ice::CandidateType::Local, preference) };
+}
+
+TEST(ice_checker, pair_priority) {
+  using ice::Checker;
+
+  // symmetric for both agents, except for the tie breaker bit
+  EXPECT_EQ(Checker::pair_priority(1, 2) + 1, Checker::pair_priority(2, 1));
+  EXPECT_EQ(Checker::pair_priority(5, 5), (u64{ 5 } << 32) + 10);
+
+  // pair with better worst candidate goes first
+  EXPECT_GT(Checker::pair_priority(10, 10), Checker::pair_priority(100, 9));
+}
+
+TEST(ice_checker, select) {
+  IOContext context;
+  auto a = make_socket(context);
+  auto b = make_socket(context);
+
+  // unreachable candidate is checked first, but it never succeeds
+  auto unused = make_socket(context);
+  const auto unreachable = local_candidate(unused, 65535);
+  unused.close();
+
+  const std::vector<ice::Candidate> a_candidates{ local_candidate(a, 65534) };
+  const std::vector<ice::Candidate> b_candidates{ unreachable, local_candidate(b, 65534) };
+
+  ice::Checker::Options options;
+  options.pacing = Milliseconds(5);
+  options.timeout = Milliseconds(1000);
+
+  std::optional<ErrorOr<udp::Endpoint>> a_selected;
+  std::optional<ErrorOr<udp::Endpoint>> b_selected;
+
+  options.controlling = true;
+  auto a_checker = ice::Checker::create(a, a_candidates, b_candidates, options, [&](ErrorOr<udp::Endpoint> remote) {
+    a_selected = std::move(remote);
+  });
+
+  options.controlling = false;
+  auto b_checker = ice::Checker::create(b, b_candidates, a_candidates, options, [&](ErrorOr<udp::Endpoint> remote) {
+    b_selected = std::move(remote);
+  });
+
+  ASSERT_EQ(a_checker->pairs().size(), 2);
+  EXPECT_EQ(a_checker->pairs().front().remote.port(), unreachable.port);
+
+  a_checker->start();
+  b_checker->start();
+  run_until(context, [&] { return a_selected && b_selected; }, 200);
+
+  ASSERT_TRUE(a_selected);
+  ASSERT_TRUE(b_selected);
+  ASSERT_FALSE(a_selected->err());
+  ASSERT_FALSE(b_selected->err());
+  EXPECT_EQ(**a_selected, b.local_endpoint());
+  EXPECT_EQ(**b_selected, a.local_endpoint());
+
+  a_checker->stop();
+  b_checker->stop();
+  context.run_for(POLL_INTERVAL);
+}
+
+TEST(ice_checker, timeout) {
+  IOContext context;
+  auto a = make_socket(context);
+  auto silent = make_socket(context); // receives checks, but never answers
+
+  ice::Checker::Options options;
+  options.pacing = Milliseconds(5);
+  options.timeout = Milliseconds(100);
+
+  std::optional<ErrorOr<udp::Endpoint>> selected;
+  auto checker = ice::Checker::create(a, { local_candidate(a) }, { local_candidate(silent) }, options,
+                                      [&](ErrorOr<udp::Endpoint> remote) {
+    selected = std::move(remote);
+  });
+
+  checker->start();
+  run_until(context, [&] { return selected.has_value(); });
+
+  ASSERT_TRUE(selected);
+  EXPECT_EQ(selected->err(), std::make_error_code(std::errc::timed_out));
+
+  checker->stop();
+  context.run_for(POLL_INTERVAL);
+}
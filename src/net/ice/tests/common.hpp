@@ -0,0 +1,42 @@
+#pragma once
+
+#include "int.hpp"
+#include "time.hpp"
+#include "net/types.hpp"
+
+
+// helpers shared by ICE tests and benchmarks
+namespace shar::net::ice::test {
+
+// time |context| is run for between checks of run_until()
+static const Milliseconds POLL_INTERVAL{ 5 };
+
+inline IpAddress loopback() {
+  return IpAddress{ IPv4::loopback() };
+}
+
+// socket bound to random port of |ip|
+inline udp::Socket make_socket(IOContext& context, IpAddress ip = loopback()) {
+  udp::Socket socket{ context };
+  socket.open(udp::v4());
+  socket.bind(udp::Endpoint{ ip, 0 });
+  return socket;
+}
+
+// run |context| until |done()| returns true, but no longer than |steps| * POLL_INTERVAL.
+// Returns last result of |done()|
+template <typename F>
+bool run_until(IOContext& context, F done, usize steps = 100) {
+  for (usize i = 0; i < steps; ++i) {
+    if (done()) {
+      return true;
+    }
+
+    context.run_for(POLL_INTERVAL);
+    context.restart();
+  }
+
+  return done();
+}
+
+}
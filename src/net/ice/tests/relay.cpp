@@ -0,0 +1,143 @@
+#include "net/ice/relay.hpp"
+#include "net/ice/tests/common.hpp"
+#include "time.hpp"
+
+#include <optional>
+#include <string>
+
+// clang-format off
+#include "disable_warnings_push.hpp"
+#include <gtest/gtest.h>
+#include "disable_warnings_pop.hpp"
+// clang-format on
+
+using namespace shar;
+using namespace shar::net;
+using namespace shar::net::ice::test;
+
+static udp::Socket make_peer(IOContext& context, IpAddress ip = loopback()) {
+  auto socket = make_socket(context, ip);
+  socket.non_blocking(true);
+  return socket;
+}
+
+static void send(udp::Socket& socket, Port port, const std::string& data) {
+  socket.send_to(span(data.data(), data.size()), udp::Endpoint{ loopback(), port });
+}
+
+// run relay until |socket| receives a datagram or timeout expires
+static std::optional<std::string> receive(IOContext& context, udp::Socket& socket) {
+  std::array<char, 2048> buffer;
+  std::optional<std::string> received;
+  run_until(context, [&] {
+    ErrorCode ec;
+    udp::Endpoint sender;
+    const usize n = socket.receive_from(span(buffer.data(), buffer.size()), sender, 0, ec);
+    if (!ec) {
+      received.emplace(buffer.data(), n);
+    }
+    return received.has_value();
+  });
+
+  return received;
+}
+
+TEST(ice_relay, forward) {
+  IOContext context;
+  auto relay = ice::Relay::create(context, loopback(), { loopback(), loopback() });
+  ASSERT_FALSE(relay.err());
+  (*relay)->start();
+  const auto ports = (*relay)->ports();
+  EXPECT_NE(ports[0], ports[1]);
+
+  auto a = make_peer(context);
+  auto b = make_peer(context);
+
+  // dropped, |b| isn't latched yet
+  send(a, ports[0], "early");
+  EXPECT_EQ(receive(context, b), std::nullopt);
+
+  send(b, ports[1], "hello");
+  EXPECT_EQ(receive(context, a), "hello");
+
+  send(a, ports[0], "world");
+  EXPECT_EQ(receive(context, b), "world");
+
+  // only latched peer can send to the port
+  auto c = make_peer(context);
+  send(c, ports[0], "intruder");
+  EXPECT_EQ(receive(context, b), std::nullopt);
+
+  const auto& stats = (*relay)->stats();
+  EXPECT_EQ(stats.packets, 2);
+  EXPECT_EQ(stats.bytes, 10);
+  EXPECT_EQ(stats.dropped, 2);
+
+  (*relay)->stop();
+  context.run_for(POLL_INTERVAL);
+}
+
+TEST(ice_relay, batch) {
+  IOContext context;
+  auto relay = ice::Relay::create(context, loopback(), { loopback(), loopback() });
+  ASSERT_FALSE(relay.err());
+  (*relay)->start();
+  const auto ports = (*relay)->ports();
+
+  auto a = make_peer(context);
+  auto b = make_peer(context);
+  send(a, ports[0], "latch");
+  ASSERT_EQ(receive(context, b), std::nullopt);
+  send(b, ports[1], "latch");
+  ASSERT_EQ(receive(context, a), "latch");
+
+  // more than one batch is queued before relay is run
+  const usize count = ice::Relay::BATCH_SIZE * 3 + 1;
+  for (usize i = 0; i < count; ++i) {
+    send(a, ports[0], std::to_string(i));
+  }
+
+  for (usize i = 0; i < count; ++i) {
+    ASSERT_EQ(receive(context, b), std::to_string(i));
+  }
+
+  EXPECT_EQ((*relay)->stats().packets, count + 1);
+  EXPECT_EQ((*relay)->stats().dropped, 1);
+
+  (*relay)->stop();
+  context.run_for(POLL_INTERVAL);
+}
+
+TEST(ice_relay, expected_ip) {
+  // NOTE: whole 127.0.0.0/8 is routed to loopback on linux
+  const IpAddress owner_ip{ IPv4::from_string("127.0.0.2") };
+
+  IOContext context;
+  auto relay = ice::Relay::create(context, loopback(), { owner_ip, loopback() });
+  ASSERT_FALSE(relay.err());
+  (*relay)->start();
+  const auto ports = (*relay)->ports();
+
+  // port scanner from other address can't take over the relay
+  auto scanner = make_peer(context);
+  send(scanner, ports[0], "scan");
+  EXPECT_EQ(receive(context, scanner), std::nullopt);
+
+  auto a = make_peer(context, owner_ip);
+  auto b = make_peer(context);
+  send(a, ports[0], "latch");
+  ASSERT_EQ(receive(context, b), std::nullopt);
+  send(b, ports[1], "hello");
+  EXPECT_EQ(receive(context, a), "hello");
+  EXPECT_EQ(receive(context, scanner), std::nullopt);
+
+  send(scanner, ports[0], "intruder");
+  send(a, ports[0], "world");
+  EXPECT_EQ(receive(context, b), "world");
+
+  EXPECT_EQ((*relay)->stats().packets, 2);
+  EXPECT_EQ((*relay)->stats().dropped, 3);
+
+  (*relay)->stop();
+  context.run_for(POLL_INTERVAL);
+}
@@ -0,0 +1,146 @@
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "int.hpp"
+#include "time.hpp"
+#include "net/types.hpp"
+#include "net/ice/relay.hpp"
+#include "net/ice/tests/common.hpp"
+
+
+using namespace shar;
+using namespace shar::net;
+using namespace shar::net::ice::test;
+
+// Two peers on loopback exchange datagrams through ice::Relay running on its
+// own thread. Measures relay throughput and latency it adds compared to
+// peers talking directly.
+
+static const usize PING_SIZE = 64;
+static const usize PACKET_SIZE = 1200; // typical RTP packet
+
+// max number of packets in flight, so that socket buffers don't overflow
+static const usize WINDOW = 256;
+
+static udp::Socket make_peer(IOContext& context) {
+  auto socket = make_socket(context);
+  socket.set_option(udp::Socket::receive_buffer_size(4 * 1024 * 1024));
+  return socket;
+}
+
+// average round trip time (in microseconds) of |count| pings,
+// |a| sends to |to_b| and |b| answers to |to_a|
+static double ping(udp::Socket& a, const udp::Endpoint& to_b,
+                   udp::Socket& b, const udp::Endpoint& to_a, usize count) {
+  std::array<u8, PING_SIZE> buffer{};
+  udp::Endpoint sender;
+
+  const auto start = Clock::now();
+  for (usize i = 0; i < count; ++i) {
+    a.send_to(span(buffer.data(), buffer.size()), to_b);
+    b.receive_from(span(buffer.data(), buffer.size()), sender);
+    b.send_to(span(buffer.data(), buffer.size()), to_a);
+    a.receive_from(span(buffer.data(), buffer.size()), sender);
+  }
+  const auto elapsed = Clock::now() - start;
+
+  const auto us = std::chrono::duration_cast<Microseconds>(elapsed).count();
+  return static_cast<double>(us) / static_cast<double>(count);
+}
+
+// usage: relaybench [packets]
+// NOTE: should be built in release mode to get meaningful numbers
+int main(int argc, char* argv[]) {
+  const usize packets = argc > 1 ? static_cast<usize>(std::stoul(argv[1])) : 1000000;
+  const usize pings = 10000;
+
+  try {
+    IOContext relay_context;
+    auto relay = ice::Relay::create(relay_context, loopback(), { loopback(), loopback() });
+    if (auto e = relay.err()) {
+      std::cerr << "Failed to create relay: " << e.message() << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    (*relay)->start();
+    const auto ports = (*relay)->ports();
+    std::thread relay_thread{[&relay_context] {
+      auto work = asio::make_work_guard(relay_context);
+      relay_context.run();
+    }};
+
+    IOContext context;
+    auto a = make_peer(context);
+    auto b = make_peer(context);
+    const udp::Endpoint relay_a{ loopback(), ports[0] };
+    const udp::Endpoint relay_b{ loopback(), ports[1] };
+
+    // latch both peers
+    std::array<u8, PING_SIZE> buffer{};
+    udp::Endpoint sender;
+    a.send_to(span(buffer.data(), buffer.size()), relay_a);
+    std::this_thread::sleep_for(Milliseconds(100));
+    b.send_to(span(buffer.data(), buffer.size()), relay_b);
+    a.receive_from(span(buffer.data(), buffer.size()), sender);
+
+    const double direct = ping(a, b.local_endpoint(), b, a.local_endpoint(), pings);
+    const double relayed = ping(a, relay_a, b, relay_b, pings);
+    std::cout << "rtt: " << direct << " us direct, " << relayed << " us relayed, "
+              << (relayed - direct) / 2.0 << " us added per direction" << std::endl;
+
+    // |b| counts datagrams until there is none for a while
+    std::atomic<usize> received{ 0 };
+    TimePoint last_received;
+    std::thread receiver{[&] {
+      std::array<u8, ice::Relay::MAX_DATAGRAM_SIZE> data;
+      udp::Endpoint from;
+      b.non_blocking(true);
+      last_received = Clock::now();
+      while (Clock::now() - last_received < Milliseconds(500)) {
+        ErrorCode ec;
+        b.receive_from(span(data.data(), data.size()), from, 0, ec);
+        if (ec) {
+          std::this_thread::yield();
+          continue;
+        }
+
+        ++received;
+        last_received = Clock::now();
+      }
+    }};
+
+    std::array<u8, PACKET_SIZE> packet{};
+    const auto start = Clock::now();
+    for (usize i = 0; i < packets; ++i) {
+      while (i - received.load() >= WINDOW && Clock::now() - start < Seconds(60)) {
+        std::this_thread::yield();
+      }
+      a.send_to(span(packet.data(), packet.size()), relay_a);
+    }
+    receiver.join();
+
+    const auto us = std::chrono::duration_cast<Microseconds>(last_received - start).count();
+    const double seconds = static_cast<double>(us) / 1e6;
+    const double mb = static_cast<double>(received.load() * PACKET_SIZE) / (1024.0 * 1024.0);
+    std::cout << "throughput: " << received << "/" << packets << " packets relayed, "
+              << (seconds > 0.0 ? static_cast<double>(received.load()) / seconds : 0.0) << " packets/s, "
+              << (seconds > 0.0 ? mb / seconds : 0.0) << " MB/s" << std::endl;
+
+    relay_context.stop();
+    relay_thread.join();
+
+    const auto& stats = (*relay)->stats();
+    std::cout << "relay: " << stats.packets << " packets, " << stats.dropped << " dropped" << std::endl;
+    (*relay)->stop();
+  } catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -93,7 +93,8 @@ usize Header::packet_size() const noexcept {
 
 Header Header::next() noexcept {
   assert(valid());
-  u16 len = static_cast<u16>(packet_size());
+  // NOTE: packet size doesn't fit into u16 if length is 0x3fff or more
+  const usize len = packet_size();
   if (len + Header::MIN_SIZE > m_size) {
     return Header{};
   }
@@ -9,16 +9,67 @@ using Buffer = Depacketizer::Buffer;
 
 bool Depacketizer::push(const Fragment& fragment) {
   assert(fragment.valid());
+
+  switch (fragment.packet_type()) {
+    case Fragment::PACKET_TYPE_FU_A:
+      push_fu(fragment);
+      break;
+    case Fragment::PACKET_TYPE_STAP_A:
+      push_stap(fragment);
+      break;
+    default:
+      if (fragment.packet_type() < Fragment::PACKET_TYPE_STAP_A) {
+        // single NAL unit packet
+        push_nal(fragment.data(), fragment.size());
+        m_completed = true;
+      }
+      // NOTE: other packet types (STAP-B, MTAP, FU-B) are ignored
+      break;
+  }
+
+  return m_completed;
+}
+
+void Depacketizer::push_prefix() {
+  // setup nal unit prefix
+  if (m_buffer.empty()) {
+    m_buffer.push_back(0x00);
+  }
+  m_buffer.push_back(0x00);
+  m_buffer.push_back(0x00);
+  m_buffer.push_back(0x01);
+}
+
+void Depacketizer::push_nal(const u8* data, usize size) {
+  push_prefix();
+  m_buffer.insert(m_buffer.end(), data, data + size);
+}
+
+void Depacketizer::push_stap(const Fragment& fragment) {
+  const u8* data = fragment.data() + 1; // skip STAP-A indicator
+  const u8* end = fragment.data() + fragment.size();
+
+  while (end - data >= static_cast<isize>(Fragment::STAP_SIZE_FIELD)) {
+    const auto size = static_cast<usize>((data[0] << 8) | data[1]);
+    data += Fragment::STAP_SIZE_FIELD;
+
+    if (size == 0 || static_cast<usize>(end - data) < size) {
+      // malformed packet
+      break;
+    }
+
+    push_nal(data, size);
+    data += size;
+  }
+
+  m_completed = true;
+}
+
+void Depacketizer::push_fu(const Fragment& fragment) {
   assert(fragment.is_first() || !m_buffer.empty());
 
   if (fragment.is_first()) {
-    // setup nal unit prefix
-    if (m_buffer.empty()) {
-      m_buffer.push_back(0x00);
-    }
-    m_buffer.push_back(0x00);
-    m_buffer.push_back(0x00);
-    m_buffer.push_back(0x01);
+    push_prefix();
 
     // recover nal header
     u8 nri = static_cast<u8>(fragment.nri() << 5);
@@ -35,7 +86,6 @@ bool Depacketizer::push(const Fragment& fragment) {
   //                to one in the same FU header
   assert(!fragment.is_first() || !fragment.is_last());
   m_completed = fragment.is_last();
-  return m_completed;
 }
 
 bool Depacketizer::completed() const {
@@ -15,6 +15,7 @@ public:
   Depacketizer() = default;
 
   // push fragment to the buffer
+  // supports single NAL unit, STAP-A and FU-A packets
   // returns values of complete()
   bool push(const Fragment& fragment);
 
@@ -25,6 +26,11 @@ public:
   void reset();
 
 private:
+  void push_prefix();
+  void push_nal(const u8* data, usize size);
+  void push_stap(const Fragment& fragment);
+  void push_fu(const Fragment& fragment);
+
   Buffer m_buffer;
   bool m_completed{ false };
 };
@@ -19,7 +19,13 @@ usize Fragment::size() const noexcept {
 }
 
 bool Fragment::valid() const noexcept {
-  return m_data != nullptr && m_size >= MIN_SIZE;
+  if (m_data == nullptr || m_size < MIN_SIZE) {
+    return false;
+  }
+
+  // FU-A and STAP-A have at least one byte after indicator
+  const u8 type = m_data[0] & PACKET_TYPE_MASK;
+  return type < PACKET_TYPE_STAP_A || m_size >= FU_HEADER_SIZE;
 }
 
 Fragment::operator bool() const noexcept {
@@ -57,10 +63,15 @@ void Fragment::set_packet_type(u8 type) noexcept {
 
 u8 Fragment::header() const noexcept {
   assert(valid());
+  assert(is_fragmented());
   return m_data[1];
 }
 
 bool Fragment::is_first() const noexcept {
+  if (!is_fragmented()) {
+    return true;
+  }
+
   return (header() & START_FLAG_MASK) != 0;
 }
 
@@ -75,6 +86,10 @@ void Fragment::set_first(bool flag) noexcept {
 }
 
 bool Fragment::is_last() const noexcept {
+  if (!is_fragmented()) {
+    return true;
+  }
+
   return (header() & END_FLAG_MASK) != 0;
 }
 
@@ -89,7 +104,16 @@ void Fragment::set_last(bool flag) noexcept {
 }
 
 u8 Fragment::nal_type() const noexcept {
-  return header() & NAL_TYPE_MASK;
+  switch (packet_type()) {
+    case PACKET_TYPE_FU_A:
+      return header() & NAL_TYPE_MASK;
+    case PACKET_TYPE_STAP_A: {
+      const usize header_offset = 1 + STAP_SIZE_FIELD;
+      return m_size > header_offset ? m_data[header_offset] & NAL_TYPE_MASK : 0;
+    }
+    default:
+      return indicator() & NAL_TYPE_MASK;
+  }
 }
 
 void Fragment::set_nal_type(u8 type) noexcept {
@@ -100,18 +124,24 @@ void Fragment::set_nal_type(u8 type) noexcept {
   m_data[1] |= type;
 }
 
+bool Fragment::is_fragmented() const noexcept {
+  return packet_type() == PACKET_TYPE_FU_A;
+}
+
 u8* Fragment::payload() noexcept {
   assert(valid());
-  return m_data + MIN_SIZE;
+  assert(is_fragmented());
+  return m_data + FU_HEADER_SIZE;
 }
 
 const u8* Fragment::payload() const noexcept {
   assert(valid());
-  return m_data + MIN_SIZE;
+  assert(is_fragmented());
+  return m_data + FU_HEADER_SIZE;
 }
 
 usize Fragment::payload_size() const noexcept {
-  return size() - MIN_SIZE;
+  return size() - FU_HEADER_SIZE;
 }
 
 }
\ No newline at end of file
@@ -5,7 +5,26 @@
 
 namespace shar::net::rtp {
 
-// Fragment of NAL
+// Payload of H264 RTP packet (RFC 6184). Depending on packet type it is
+// either a single NAL unit (types 1-23), an aggregation of several NAL
+// units (STAP-A, type 24) or a fragment of NAL unit (FU-A, type 28).
+//
+// Single NAL unit packet is NAL unit itself, so indicator is NAL unit header.
+//
+// STAP-A:
+// 	+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+// 	|STAP-A NAL HDR |         NALU 1 Size           | NALU 1 HDR    |
+// 	+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+// 	|                         NALU 1 Data                         |
+// 	:                                                             :
+// 	+               +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+// 	|               | NALU 2 Size                   | NALU 2 HDR    |
+// 	+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+// 	|                         NALU 2 Data                         |
+// 	:                                                             :
+// 	+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+//
+// FU-A:
 // 	0               1               2               3
 // 	7 6 5 4 3 2 1 0 7 6 5 4 3 2 1 0 7 6 5 4 3 2 1 0 7 6 5 4 3 2 1 0
 // 	+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
@@ -19,7 +38,17 @@ namespace shar::net::rtp {
 // 	+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
 class Fragment {
 public:
-  static const usize MIN_SIZE = 2;
+  static const usize MIN_SIZE = 1;
+
+  // size of FU indicator + FU header
+  static const usize FU_HEADER_SIZE = 2;
+
+  // size of NAL unit size field in STAP-A
+  static const usize STAP_SIZE_FIELD = 2;
+
+  // packet types
+  static const u8 PACKET_TYPE_STAP_A = 24;
+  static const u8 PACKET_TYPE_FU_A   = 28;
 
   // indicator fields
   static const u8 NRI_MASK         = 0b01100000;
@@ -68,11 +97,11 @@ public:
   void set_nri(u8 nri) noexcept;
 
   // packet_type - returns packet type of this fragment
-  // NOTE: currently only FU-A (28) is supported
+  // NOTE: only single NAL unit, STAP-A (24) and FU-A (28) are supported
   u8 packet_type() const noexcept;
   void set_packet_type(u8 type) noexcept;
 
-  // Header - returns fragment header
+  // Header - returns fragment header (FU-A only)
   // Fragment header has following fields
   //
   //	+---------------+
@@ -86,19 +115,25 @@ public:
 
   // is_first - returns true if this fragment is first fragment of NAL unit
   //           (value of S flag from fragment header)
+  // NOTE: always true for single NAL unit and STAP-A packets
   bool is_first() const noexcept;
   void set_first(bool flag) noexcept;
 
   // is_last - returns true if this fragment is last fragment of NAL unit
   //          (value of E flag from fragment header)
+  // NOTE: always true for single NAL unit and STAP-A packets
   bool is_last() const noexcept;
   void set_last(bool flag) noexcept;
 
   // nal_type - returns type of fragmented nal unit
+  // for STAP-A returns type of first aggregated nal unit
   u8 nal_type() const noexcept;
   void set_nal_type(u8 type) noexcept;
 
-  // payload - returns pointer to start of payload
+  // is_fragmented - returns true if this is FU-A packet
+  bool is_fragmented() const noexcept;
+
+  // payload - returns pointer to start of payload (FU-A only)
   u8* payload() noexcept;
   const u8* payload() const noexcept;
   usize payload_size() const noexcept;
@@ -1,14 +1,22 @@
 #include <cassert>   // assert
-#include <algorithm> // min
+#include <algorithm> // min, max
+#include <cstring>   // memcpy
 
 #include "packetizer.hpp"
 
+#include "annexb.hpp"
+
 namespace shar::net::rtp {
 
-static const u8 PACKET_TYPE_FU_A = 28;
+static const u8 FORBIDDEN_MASK = 0b10000000;
+
+Packetizer::Packetizer()
+  : m_aggregate(m_mtu)
+{}
 
-Packetizer::Packetizer(u16 mtu) noexcept
+Packetizer::Packetizer(u16 mtu)
   : m_mtu(mtu)
+  , m_aggregate(mtu)
 {}
 
 bool Packetizer::valid() const noexcept {
@@ -25,7 +33,6 @@ void Packetizer::set(u8* data, usize size) noexcept {
   m_nal_start = data;
   m_nal_end = data;
   m_position = data;
-  m_last_packet_full_nal_unit = false;
 
   [[maybe_unused]] bool found = next_nal(); // move to start of NAL unit
   assert(found);
@@ -38,20 +45,50 @@ void Packetizer::reset() noexcept {
 Fragment Packetizer::next() noexcept {
   assert(valid());
 
-  if (m_last_packet_full_nal_unit) {
-    auto start = m_nal_start;
-    assert(start - m_data >= 2);
-    m_last_packet_full_nal_unit = false;
+  // skip empty NAL units
+  while (m_position == m_nal_end) {
+    if (!next_nal()) {
+      return Fragment();
+    }
+  }
+
+  if (m_position != m_nal_start) {
+    // continuation of fragmented NAL unit
+    return next_fu();
+  }
 
-    // remove start bit and set end bit
-    *start = (*start & ~Fragment::START_FLAG_MASK) | Fragment::END_FLAG_MASK;
-    return Fragment{start - 1, 2};
+  const auto size = static_cast<usize>(m_nal_end - m_nal_start);
+  if (size > m_mtu) {
+    return next_fu();
   }
 
-  u8* start = next_fragment();
-  if (start == nullptr) {
-    return Fragment();
+  if (auto fragment = aggregate()) {
+    return fragment;
   }
+
+  // single NAL unit packet, NAL unit header serves as payload header
+  m_position = m_nal_end;
+  return Fragment{m_nal_start, size};
+}
+
+bool Packetizer::done() const noexcept {
+  if (m_position != m_nal_end) {
+    return false;
+  }
+
+  u8* start = m_nal_end;
+  u8* end = m_nal_end;
+  while (start == end) {
+    if (!find_nal(end, start, end)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+Fragment Packetizer::next_fu() noexcept {
+  u8* start = m_position;
   assert(start - m_data >= 2);
 
   // For first fragment, data looks like this:
@@ -83,19 +120,15 @@ Fragment Packetizer::next() noexcept {
 
   u8* end = start - 2 + first + m_mtu;
   if (end >= m_nal_end) {
+    // NOTE: from RFC6184: Start bit and End bit MUST NOT both be set
+    //       to one in the same FU header. This can't happen here, since
+    //       NAL units that fit into mtu are sent as single NAL unit packets
+    assert(first == 0);
     end = m_nal_end;
-
-    if (first == 1) {
-      // from RFC6184: Start bit and End bit MUST NOT both be set
-      //               to one in the same FU header
-      // ... so we have to generate entire (though empty) packet just for end flag
-      m_last_packet_full_nal_unit = true;
-    } else {
-      last = 1;
-    }
+    last = 1;
   }
 
-  u8 indicator = nri | PACKET_TYPE_FU_A;
+  u8 indicator = nri | Fragment::PACKET_TYPE_FU_A;
   u8 header = static_cast<u8>(first << u8{7}) |
                         static_cast<u8>(last << u8{6}) |
                         nal_type;
@@ -108,22 +141,71 @@ Fragment Packetizer::next() noexcept {
   return Fragment{fragment, static_cast<usize>(end - fragment)};
 }
 
-u8* Packetizer::next_fragment() noexcept {
-  if (m_position == m_nal_end) {
-    if (!next_nal()) {
-      return nullptr;
+Fragment Packetizer::aggregate() noexcept {
+  const usize limit = std::min(static_cast<usize>(m_mtu), m_aggregate.size());
+
+  // find out how many NAL units fit into single packet
+  u8* start = m_nal_start;
+  u8* end = m_nal_end;
+  u8* last_start = start;
+  u8* last_end = end;
+  usize size = 1; // STAP-A indicator
+  usize count = 0;
+  do {
+    const auto nal_size = static_cast<usize>(end - start);
+    if (nal_size == 0 || size + Fragment::STAP_SIZE_FIELD + nal_size > limit) {
+      break;
+    }
+
+    size += Fragment::STAP_SIZE_FIELD + nal_size;
+    last_start = start;
+    last_end = end;
+    ++count;
+  } while (find_nal(end, start, end));
+
+  if (count < 2) {
+    // nothing to aggregate
+    return Fragment();
+  }
+
+  u8 forbidden = 0;
+  u8 nri = 0;
+  u8* out = m_aggregate.data() + 1;
+
+  start = m_nal_start;
+  end = m_nal_end;
+  for (usize i = 0; i < count; ++i) {
+    if (i != 0) {
+      [[maybe_unused]] bool found = find_nal(end, start, end);
+      assert(found);
     }
+
+    const auto nal_size = static_cast<usize>(end - start);
+    forbidden |= *start & FORBIDDEN_MASK;
+    nri = std::max(nri, static_cast<u8>(*start & Fragment::NRI_MASK));
+
+    out[0] = static_cast<u8>(nal_size >> 8);
+    out[1] = static_cast<u8>(nal_size & 0xff);
+    std::memcpy(out + Fragment::STAP_SIZE_FIELD, start, nal_size);
+    out += Fragment::STAP_SIZE_FIELD + nal_size;
   }
-  return m_position;
+
+  m_aggregate[0] = forbidden | nri | Fragment::PACKET_TYPE_STAP_A;
+
+  // skip aggregated units
+  m_nal_start = last_start;
+  m_nal_end = last_end;
+  m_position = last_end;
+  return Fragment{m_aggregate.data(), size};
 }
 
-bool Packetizer::next_nal() noexcept {
+bool Packetizer::find_nal(u8* from, u8*& nal_start, u8*& nal_end) const noexcept {
   u8* data_end = m_data + m_size;
-  if (m_nal_end == data_end) {
+  if (from == data_end) {
     return false;
   }
 
-  u8* start = m_nal_end;
+  u8* start = from;
 
   // skip pattern
   while ((start < data_end) && *start == 0) {
@@ -137,22 +219,27 @@ bool Packetizer::next_nal() noexcept {
   ++start; // skip 0x01
 
   // find 0x00 0x00 0x01 pattern
-  u8* end = start;
-  while (end + 2 < data_end && (end[0] != 0 || end[1] != 0 || end[2] != 1)) {
-    ++end;
-  }
+  const auto offset = find_start_code(start, data_end) - start;
+  u8* end = start + offset;
 
-  if (end + 2 < data_end) {
+  if (end != data_end) {
     // or was it 0x00 0x00 0x00 0x01 ?
-    m_nal_end = end[-1] == 0 ? end - 1 : end;
+    nal_end = end[-1] == 0 ? end - 1 : end;
   } else {
     // it is last nal unit
-    m_nal_end = data_end;
+    nal_end = data_end;
   }
 
-  m_nal_start = start;
-  m_position = m_nal_start;
+  nal_start = start;
+  return true;
+}
 
+bool Packetizer::next_nal() noexcept {
+  if (!find_nal(m_nal_end, m_nal_start, m_nal_end)) {
+    return false;
+  }
+
+  m_position = m_nal_start;
   return true;
 }
 
@@ -2,34 +2,50 @@
 
 #include <cstdint>
 #include <utility>
+#include <vector>
 
 #include "fragment.hpp"
 
 
 namespace shar::net::rtp {
 
-// H264 packetizer
+// H264 packetizer (RFC 6184, non-interleaved mode)
+//  - NAL units that fit into mtu are sent as is (single NAL unit packet)
+//  - consecutive small NAL units (e.g. SPS, PPS, SEI) are aggregated
+//    into single STAP-A packet
+//  - NAL units bigger than mtu are split into FU-A fragments
 class Packetizer {
 public:
-  Packetizer() noexcept = default;
-  Packetizer(u16 mtu) noexcept;
-  Packetizer(const Packetizer&) noexcept = default;
+  Packetizer();
+  Packetizer(u16 mtu);
+  Packetizer(const Packetizer&) = default;
   Packetizer(Packetizer&&) noexcept = default;
-  Packetizer& operator=(const Packetizer&) noexcept = default;
+  Packetizer& operator=(const Packetizer&) = default;
   Packetizer& operator=(Packetizer&&) noexcept = default;
   ~Packetizer() = default;
 
+  // NOTE: |data| is modified in place during packetization
   void set(u8* data, usize size) noexcept;
   void reset() noexcept;
 
   // return next chunk of data
   Fragment next() noexcept;
 
+  // returns true if there are no more fragments,
+  // i.e. last fragment returned by next() was the last one of access unit
+  bool done() const noexcept;
+
 private:
   bool valid() const noexcept;
 
-  // returns nullptr if there are no more fragments
-  u8* next_fragment() noexcept;
+  Fragment next_fu() noexcept;
+
+  // returns empty fragment if there is nothing to aggregate
+  Fragment aggregate() noexcept;
+
+  // find NAL unit starting search from |from|
+  // returns true on success
+  bool find_nal(u8* from, u8*& start, u8*& end) const noexcept;
 
   // returns true on success
   bool next_nal() noexcept;
@@ -46,9 +62,8 @@ private:
   // positon of current fragment inside current NAL unit
   u8* m_position{nullptr};
 
-  // true if size of last packet from |m_data| was less than mtu
-  // in this case we should send empty packet with E flag
-  bool m_last_packet_full_nal_unit{false};
+  // STAP-A is assembled here, NAL units are not contiguous in |m_data|
+  std::vector<u8> m_aggregate;
 };
 
 } // namespace shar::net::rtp
\ No newline at end of file
@@ -2,15 +2,46 @@
 
 #include "packet.hpp"
 #include "time.hpp"
+#include "net/rtcp/receiver_report.hpp"
 
+#include <algorithm>
 #include <stdexcept>
 #include <cassert>
+#include <cstring>
 
 
 namespace shar::net::rtp {
 
 static const u16 MAX_MTU = 2048;
 
+// Clock rate (number of ticks in 1 second) for H264 video. (RFC 6184 Section 8.2.1)
+static const u64 CLOCK_RATE = 90000;
+
+// SSRC of receiver, used in RTCP reports
+static const u32 RECEIVER_STREAM_ID = 0xd34d10cc;
+
+// state of stream is dropped if none of its packets were received for that long
+static const Seconds STREAM_TIMEOUT{ 5 };
+
+#ifdef SHAR_IO_URING
+// number of recvmsg() queued in io_uring at once
+static const usize RECEIVE_BATCH = 32;
+
+// max time receive_ring() waits for packets, so that shutdown is noticed
+static const Milliseconds RECEIVE_TIMEOUT{ 250 };
+
+// user data of operations other than recvmsg()
+static const u64 TIMEOUT_ID = ~u64{ 0 };
+static const u64 CANCEL_ID = TIMEOUT_ID - 1;
+#endif
+
+// current time in RTP timestamp units
+static u32 arrival_time() {
+  const auto now = Clock::now().time_since_epoch();
+  const auto us = std::chrono::duration_cast<Microseconds>(now).count();
+  return static_cast<u32>(static_cast<u64>(us) * CLOCK_RATE / 1'000'000);
+}
+
 Receiver::Receiver(Context context, IpAddress ip, Port port)
   : Context(std::move(context))
   , m_socket(m_context)
@@ -19,6 +50,10 @@ Receiver::Receiver(Context context, IpAddress ip, Port port)
   m_socket.open(udp::v4());
 }
 
+void Receiver::add_stream(u32 stream_id, Output units) {
+  m_outputs.emplace(stream_id, std::move(units));
+}
+
 void Receiver::run(Output units) {
   ErrorCode code;
   m_socket.bind(m_endpoint, code);
@@ -27,18 +62,33 @@ void Receiver::run(Output units) {
     throw std::runtime_error("Failed to bind UDP socket: " + code.message());
   }
 
+#ifdef SHAR_IO_URING
+  setup_ring();
+#endif
+
+  // NOTE: viewer can pick the stream when several senders share the port
+  std::optional<Output> fallback;
+  if (m_config->stream_id != 0) {
+    add_stream(static_cast<u32>(m_config->stream_id), std::move(units));
+  } else {
+    fallback.emplace(std::move(units));
+    m_fallback = &*fallback;
+  }
+
   auto last_report_time = Clock::now();
   usize total_received = 0;
   usize total_dropped = 0;
 
-  while (!m_running.expired() && units.connected()) {
-    if (auto unit = receive()) {
-      units.send(std::move(*unit));
-    }
+  while (!m_running.expired() && connected()) {
+    receive();
 
     const auto now = Clock::now();
     if (last_report_time + Seconds(1) < now) {
       LOG_INFO("RTP receiver: rate {}kb/s dropped {} bytes", m_received/1024, m_dropped);
+      expire(now);
+      for (auto& [stream_id, stream] : m_streams) {
+        send_report(stream_id, stream);
+      }
 
       total_received += m_received;
       total_dropped += m_dropped;
@@ -51,6 +101,11 @@ void Receiver::run(Output units) {
   }
 
   LOG_INFO("RTP receiver: total={}kb dropped={}kb", total_received/1024, total_dropped/1024);
+#ifdef SHAR_IO_URING
+  stop_ring();
+#endif
+  m_streams.clear();
+  m_fallback = nullptr;
   shutdown();
 }
 
@@ -59,9 +114,19 @@ void Receiver::shutdown() {
   m_socket.close(); // to cancel receive_from()
 }
 
+bool Receiver::connected() const {
+  if (m_fallback && m_fallback->connected()) {
+    return true;
+  }
+
+  return std::any_of(m_outputs.begin(), m_outputs.end(), [](const auto& output) {
+    return output.second.connected();
+  });
+}
+
 using Unit = Receiver::Unit;
 
-std::optional<Unit> Receiver::accept(const Packet& packet, const Fragment& fragment) {
+std::optional<Unit> Receiver::accept(Stream& stream, const Packet& packet, const Fragment& fragment) {
   std::optional<Unit> result;
   if (!packet.valid() || !fragment.valid()) {
     assert(false);
@@ -72,43 +137,110 @@ std::optional<Unit> Receiver::accept(const Packet& packet, const Fragment& fragm
   assert(!packet.has_extensions());
   assert(packet.contributors_count() == 0);
 
-  bool in_sequence = packet.sequence() == m_sequence + 1;
-  if (!in_sequence && !m_drop) {
-    m_drop = true;
+  bool in_sequence = packet.sequence() == stream.m_sequence + 1;
+  if (!in_sequence && !stream.m_drop) {
+    stream.m_drop = true;
     LOG_WARN("Dropped a packet. NAL type: {}", fragment.nal_type());
   }
 
-  bool flush = m_timestamp != packet.timestamp();
+  bool flush = stream.m_timestamp != packet.timestamp();
   if (flush) {
-    if (m_depacketizer.completed()) {
-      const auto& buffer = m_depacketizer.buffer();
+    if (stream.m_depacketizer.completed()) {
+      const auto& buffer = stream.m_depacketizer.buffer();
       result = Unit::from_data(buffer.data(), buffer.size());
     }
 
-    m_timestamp = packet.timestamp();
-    m_depacketizer.reset();
+    stream.m_timestamp = packet.timestamp();
+    stream.m_depacketizer.reset();
   }
 
-  bool process = m_drop ? fragment.is_first() : in_sequence;
+  bool process = stream.m_drop ? fragment.is_first() : in_sequence;
   if (!process) {
     m_dropped += packet.len();
     return result;
   }
 
-  if (m_drop) {
-    m_depacketizer.reset();
+  if (stream.m_drop) {
+    stream.m_depacketizer.reset();
     LOG_DEBUG("Recovered from drop. NAL type: {}", fragment.nal_type());
   }
 
-  m_drop = false;
-  m_sequence = packet.sequence();
-  m_depacketizer.push(fragment);
+  stream.m_drop = false;
+  stream.m_sequence = packet.sequence();
+  stream.m_depacketizer.push(fragment);
   return result;
 }
 
-std::optional<Unit> Receiver::receive() {
+Receiver::Stream* Receiver::find_stream(u32 stream_id, const udp::Endpoint& endpoint) {
+  const auto str = [](const udp::Endpoint& e) {
+    return e.address().to_string() + ":" + std::to_string(e.port());
+  };
+
+  auto it = m_streams.find(stream_id);
+  if (it == m_streams.end()) {
+    Output* output = nullptr;
+    if (auto registered = m_outputs.find(stream_id); registered != m_outputs.end()) {
+      output = &registered->second;
+    } else if (m_fallback && !m_fallback_used) {
+      output = m_fallback;
+      m_fallback_used = true;
+    }
+
+    if (!output) {
+      // NOTE: logged on each packet, so not as warning
+      if (LOG_ENABLED(debug)) {
+        LOG_DEBUG("Ignoring stream {:#x} from: {}", stream_id, str(endpoint));
+      }
+      return nullptr;
+    }
+
+    LOG_INFO("Started receiving stream {:#x} from: {}", stream_id, str(endpoint));
+    Stream stream;
+    stream.m_output = output;
+    stream.m_sender = endpoint;
+    it = m_streams.emplace(stream_id, std::move(stream)).first;
+  }
+
+  auto& stream = it->second;
+  if (stream.m_sender != endpoint) {
+    LOG_WARN("Stream {:#x} switched from: {} to {}", stream_id, str(stream.m_sender), str(endpoint));
+
+    // sender address has changed, reset state
+    stream.m_drop = true;
+    stream.m_sender = endpoint;
+    stream.m_statistics.reset();
+  }
+
+  return &stream;
+}
+
+void Receiver::expire(TimePoint now) {
+  for (auto it = m_streams.begin(); it != m_streams.end();) {
+    auto& stream = it->second;
+    if (stream.m_last_packet + STREAM_TIMEOUT > now) {
+      ++it;
+      continue;
+    }
+
+    LOG_INFO("Stream {:#x} timed out", it->first);
+    if (stream.m_output == m_fallback) {
+      m_fallback_used = false;
+    }
+
+    it = m_streams.erase(it);
+  }
+}
+
+void Receiver::receive() {
+#ifdef SHAR_IO_URING
+  if (m_ring) {
+    receive_ring();
+    return;
+  }
+#endif
+
   static const usize HEADER_SIZE = rtp::Packet::MIN_SIZE;
-  std::array<u8, MAX_MTU + HEADER_SIZE> buffer;
+  alignas(u32) std::array<u8, MAX_MTU + HEADER_SIZE> buffer;
 
   udp::Endpoint endpoint;
   ErrorCode ec;
@@ -120,31 +252,154 @@ std::optional<Unit> Receiver::receive() {
 
   if (ec) {
     LOG_ERROR("Failed to receive rtp packet: {}", ec.message());
-    return std::nullopt;
+    return;
   }
 
-  if (endpoint != m_sender) {
-    const auto str = [](udp::Endpoint e) {
-      return e.address().to_string() + ":" + std::to_string(e.port());
-    };
+  process(buffer.data(), n, endpoint, Clock::now());
+}
+
+#ifdef SHAR_IO_URING
+void Receiver::setup_ring() {
+  // NOTE: cancellations of all slots are queued at once by stop_ring()
+  auto ring = Ring::create(2 * RECEIVE_BATCH);
+  if (auto ec = ring.err()) {
+    LOG_WARN("io_uring is not available, falling back to receive_from(): {}", ec.message());
+    return;
+  }
 
-    if (m_sender) {
-      assert(false);
-      LOG_WARN("Switching stream from: {} to {}", str(*m_sender), str(endpoint));
+  m_ring = std::move(*ring);
+  m_slots.resize(RECEIVE_BATCH);
+  for (usize i = 0; i < m_slots.size(); ++i) {
+    m_slots[i].m_data.assign(MAX_MTU + rtp::Packet::MIN_SIZE, 0);
+    queue(i);
+  }
+
+  LOG_INFO("RTP receiver: using io_uring");
+}
+
+void Receiver::queue(usize slot) {
+  auto& s = m_slots[slot];
+  s.m_iov.iov_base = s.m_data.data();
+  s.m_iov.iov_len = s.m_data.size();
+
+  // NOTE: recvmsg() writes address of the sender into the endpoint
+  std::memset(&s.m_message, 0, sizeof(s.m_message));
+  s.m_message.msg_name = s.m_sender.data();
+  s.m_message.msg_namelen = static_cast<socklen_t>(s.m_sender.capacity());
+  s.m_message.msg_iov = &s.m_iov;
+  s.m_message.msg_iovlen = 1;
+
+  const bool queued = m_ring->prepare_recvmsg(m_socket.native_handle(), &s.m_message, slot);
+  assert(queued);
+  (void)queued;
+}
+
+void Receiver::receive_ring() {
+  if (!m_waiting) {
+    m_waiting = m_ring->prepare_timeout(RECEIVE_TIMEOUT, 1, TIMEOUT_ID);
+  }
+
+  // NOTE: packets received while previous ones were processed are
+  //       reaped together, without extra syscalls
+  auto submitted = m_ring->submit(1);
+  if (auto ec = submitted.err()) {
+    LOG_ERROR("Failed to wait for rtp packets: {}", ec.message());
+    return;
+  }
+
+  const auto now = Clock::now();
+  m_ring->reap([&](u64 user_data, i32 result) {
+    if (user_data == TIMEOUT_ID) {
+      m_waiting = false;
+      return;
+    }
+
+    auto& slot = m_slots[user_data];
+    if (result < 0) {
+      LOG_ERROR("Failed to receive rtp packet: {}", std::strerror(-result));
     } else {
-      LOG_INFO("Started receiving stream from: {}", str(endpoint));
+      slot.m_sender.resize(slot.m_message.msg_namelen);
+      process(slot.m_data.data(), static_cast<usize>(result), slot.m_sender, now);
     }
 
-    // sender address has changed, reset state
-    m_drop = true;
-    m_sender = endpoint;
+    if (!m_running.expired()) {
+      queue(user_data);
+    }
+  });
+}
+
+void Receiver::stop_ring() {
+  if (!m_ring) {
+    return;
+  }
+
+  for (usize i = 0; i < m_slots.size(); ++i) {
+    m_ring->prepare_cancel(i, CANCEL_ID);
+  }
+
+  // NOTE: queued timeout is waited for as well, it expires soon
+  while (m_ring->inflight() != 0 || m_ring->pending() != 0) {
+    if (auto ec = m_ring->submit(1).err()) {
+      LOG_ERROR("Failed to cancel rtp receive: {}", ec.message());
+      break;
+    }
+
+    m_ring->reap([](u64 /* user_data */, i32 /* result */) {});
+  }
+
+  m_ring.reset();
+  m_slots.clear();
+  m_waiting = false;
+}
+#endif
+
+void Receiver::process(u8* data, usize size, const udp::Endpoint& sender, TimePoint now) {
+  rtp::Packet packet{ data, size };
+  if (!packet.valid() || packet.payload_size() == 0) {
+    m_dropped += size;
+    return;
   }
 
-  rtp::Packet packet{ buffer.data(), n };
-  assert(packet.len() == n);
+  assert(packet.len() == size);
+  Stream* stream = find_stream(packet.stream_id(), sender);
+  if (stream == nullptr) {
+    m_dropped += packet.len();
+    return;
+  }
+
+  stream->m_last_packet = now;
+  stream->m_statistics.update(packet.sequence(), packet.timestamp(), arrival_time());
   Fragment fragment{ packet.payload(), packet.payload_size() };
   m_received += packet.len();
-  return accept(packet, fragment);
+
+  if (auto unit = accept(*stream, packet, fragment)) {
+    if (stream->m_output->connected()) {
+      stream->m_output->send(std::move(*unit));
+    }
+  }
+}
+
+void Receiver::send_report(u32 stream_id, Stream& stream) {
+  static const usize SIZE = rtcp::ReceiverReport::MIN_SIZE + rtcp::Block::MIN_SIZE;
+  alignas(u32) std::array<u8, SIZE> buffer{};
+
+  rtcp::ReceiverReport report{ buffer.data(), buffer.size() };
+  report.set_version(2);
+  report.set_has_padding(false);
+  report.set_nblocks(1);
+  report.set_packet_type(rtcp::PacketType::RECEIVER_REPORT);
+  report.set_length(rtcp::ReceiverReport::NWORDS + rtcp::Block::NWORDS - 1);
+  report.set_stream_id(RECEIVER_STREAM_ID);
+
+  rtcp::Block block = report.block();
+  block.set_stream_id(stream_id);
+  stream.m_statistics.report(block);
+
+  ErrorCode ec;
+  m_socket.send_to(span(buffer.data(), buffer.size()), stream.m_sender, 0, ec);
+  if (ec) {
+    LOG_WARN("Failed to send receiver report: {}", ec.message());
+  }
 }
 
 }
@@ -2,6 +2,12 @@
 
 #include <cstdint>
 #include <optional>
+#include <unordered_map>
+#include <vector>
+#ifdef SHAR_IO_URING
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
 
 #include "context.hpp"
 #include "cancellation.hpp"
@@ -10,6 +16,11 @@
 #include "net/receiver.hpp"
 #include "net/rtp/packet.hpp"
 #include "net/rtp/depacketizer.hpp"
+#include "net/rtp/statistics.hpp"
+#ifdef SHAR_IO_URING
+#include "net/uring.hpp"
+#endif
+#include "time.hpp"
 
 
 namespace shar::net::rtp {
@@ -25,12 +36,51 @@ public:
 
   Receiver(Context context, IpAddress ip, Port port);
 
+  // route units of stream with |stream_id| (SSRC) to |units|
+  // NOTE: should be called before run()
+  void add_stream(u32 stream_id, Output units);
+
+  // |units| receives stream selected by stream_id option if it is not 0,
+  // otherwise the first stream without explicitly registered output,
+  // other unregistered streams are ignored
   void run(Output units) override;
   void shutdown() override;
 
+  // handle RTP packet received from |sender|
+  // NOTE: called by run(), public for tests
+  void process(u8* data, usize size, const udp::Endpoint& sender, TimePoint now);
+
+  // forget state of streams that weren't received for a while,
+  // output of expired fallback stream can be taken by another stream
+  void expire(TimePoint now);
+
+  // number of streams with state, ignored streams have none
+  usize streams() const { return m_streams.size(); }
+
 private:
-  std::optional<Unit> receive();
-  std::optional<Unit> accept(const Packet& packet, const Fragment& fragment);
+  // per-source rtp session state
+  struct Stream {
+    Output* m_output{ nullptr };
+    udp::Endpoint m_sender;
+    TimePoint m_last_packet;
+    u16 m_sequence{ 0 };
+    u32 m_timestamp{ 0 }; // current timestamp
+    bool m_drop{ true }; // true if drop occured
+    Depacketizer m_depacketizer;
+    Statistics m_statistics;
+  };
+
+  void receive();
+  std::optional<Unit> accept(Stream& stream, const Packet& packet, const Fragment& fragment);
+
+  // returns nullptr if stream should be ignored
+  Stream* find_stream(u32 stream_id, const udp::Endpoint& endpoint);
+
+  // true if at least one output is still connected
+  bool connected() const;
+
+  // send RTCP receiver report to the sender of |stream|
+  void send_report(u32 stream_id, Stream& stream);
 
   // metrics
   usize m_received{ 0 };
@@ -42,12 +92,41 @@ private:
   udp::Socket m_socket;
   udp::Endpoint m_endpoint;
 
-  // rtp session state
-  std::optional<udp::Endpoint> m_sender;
-  u16 m_sequence{ 0 };
-  u32 m_timestamp{ 0 }; // current timestamp
-  bool m_drop{ true }; // true if drop occured
-  Depacketizer m_depacketizer;
+  // SSRC -> output
+  std::unordered_map<u32, Output> m_outputs;
+  Output* m_fallback{ nullptr }; // output passed to run()
+  bool m_fallback_used{ false };
+
+  // SSRC -> stream
+  // NOTE: only streams with output are kept, so unknown
+  //       SSRCs sent by a peer don't grow it
+  std::unordered_map<u32, Stream> m_streams;
+
+#ifdef SHAR_IO_URING
+  // buffer of one recvmsg() queued in io_uring
+  struct Slot {
+    std::vector<u8> m_data;
+    iovec m_iov;
+    msghdr m_message;
+    udp::Endpoint m_sender;
+  };
+
+  // set up io_uring backend, falls back to receive_from() on failure
+  void setup_ring();
+
+  // wait for packets received by queued recvmsg() and queue them again
+  void receive_ring();
+
+  // cancel queued operations and wait until kernel is done with slots
+  void stop_ring();
+
+  void queue(usize slot);
+
+  // NOTE: slots should outlive operations queued in |m_ring|
+  std::vector<Slot> m_slots;
+  std::unique_ptr<Ring> m_ring; // empty if io_uring is not available
+  bool m_waiting{ false };      // true if timeout is queued
+#endif
 };
 
 }
@@ -2,12 +2,54 @@
 
 #include "packet.hpp"
 #include "time.hpp"
+#include "net/rtcp/header.hpp"
+#include "net/rtcp/receiver_report.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <thread>
 
 
 namespace shar::net::rtp {
 
 static const u16 MTU = 1000;
 
+// Clock rate (number of ticks in 1 second) for H264 video. (RFC 6184 Section 8.2.1)
+static const double CLOCK_RATE = 90000.0;
+
+// packets are sent at PACING_FACTOR * target bitrate, so that
+// spikes (e.g. IDR frames) don't overflow queues along the path
+static const usize PACING_FACTOR = 3;
+
+// max amount of time packets can be sent ahead of the pacing schedule
+static const Microseconds PACING_BURST = Milliseconds(5);
+
+// if more than MAX_QUEUED_UNITS are waiting to be sent, all units
+// except IDR are dropped, until the queue is drained
+static const usize MAX_QUEUED_UNITS = 10;
+
+static const usize PACKET_SIZE = MTU + rtp::Packet::MIN_SIZE;
+
+#ifdef SHAR_IO_URING
+// max number of packets submitted to io_uring at once
+static const usize BATCH_SIZE = 64;
+#endif
+
+PacketSender::Feedback::Feedback(MetricsPtr metrics, std::optional<Sender<usize>> output, usize kbits)
+    : m_estimator(std::max<usize>(kbits / 10, 100), kbits)
+    , m_target(metrics, "ABR target", Metrics::Format::Bits)
+    , m_send_rate(metrics, "ABR send rate", Metrics::Format::Bits)
+    , m_loss(metrics, "ABR loss %", Metrics::Format::Count)
+    , m_delay(metrics, "ABR jitter ms", Metrics::Format::Count)
+    , m_overuse(metrics, "ABR overuse", Metrics::Format::Count)
+    {
+      if (output) {
+        m_reporter.emplace(std::move(*output), kbits);
+      }
+      m_target.set(kbits * 1024);
+    }
+
 PacketSender::PacketSender(Context context, IpAddress ip, Port port)
     : Context(std::move(context))
     , m_endpoint(std::move(ip), port)
@@ -15,11 +57,17 @@ PacketSender::PacketSender(Context context, IpAddress ip, Port port)
     , m_socket(m_context)
     , m_packetizer(MTU)
     , m_sequence(0)
+    , m_stream_id(static_cast<u32>(m_config->stream_id))
     , m_bytes_sent(0)
-    , m_fragments_sent(0)
+    , m_target(m_config->bitrate)
+    , m_next_send(Clock::now())
     , m_client(m_context)
     {}
 
+void PacketSender::set_bitrate_output(Sender<usize> bitrate) {
+  m_feedback.emplace(m_metrics, std::move(bitrate), m_config->bitrate);
+}
+
 void PacketSender::connect() {
   // 1. Connect to shar server
   // 2. Create session
@@ -71,8 +119,20 @@ void PacketSender::connect() {
 }
 
 void PacketSender::run(Receiver<Unit> packets) {
+  std::vector<Layer> layers;
+  layers.push_back(Layer{ m_config->bitrate, std::move(packets) });
+  run_simulcast(std::move(layers));
+}
+
+void PacketSender::run_simulcast(std::vector<Layer> layers) {
+  assert(!layers.empty());
   connect();
 
+  if (layers.size() > 1 && !m_feedback) {
+    // bandwidth estimation is required to pick a layer
+    m_feedback.emplace(m_metrics, std::nullopt, m_config->bitrate);
+  }
+
   m_socket.open(udp::v4());
 
   // TODO: use port range instead of constant
@@ -80,21 +140,86 @@ void PacketSender::run(Receiver<Unit> packets) {
   auto endpoint = udp::Endpoint(ip, Port{44444});
   m_socket.bind(endpoint);
 
+#ifdef SHAR_IO_URING
+  setup_ring();
+#endif
+
   auto sent = Metric(m_metrics, "bytes sent", Metrics::Format::Bytes);
-  while (auto packet = packets.receive()) {
+  auto dropped = Metric(m_metrics, "RTP units dropped", Metrics::Format::Count);
+  usize active = 0;
+  while (auto packet = layers[active].m_units.receive()) {
     if (m_running.expired()) {
       break;
     }
 
+    const usize selected = select_layer(layers);
+    if (auto idr = drain_layers(layers, active, selected)) {
+      LOG_INFO("RTP sender: switching from layer {} to {}", active, selected);
+      active = selected;
+      packet = std::move(idr);
+      m_dropping = false;
+    }
+
+    auto& packets = layers[active].m_units;
+
+    // keep latency of the send queue bounded
+    // NOTE: only with bandwidth estimation, otherwise encoder doesn't
+    //       adapt and sender would drop units until the end of stream
+    if (m_feedback && packets.size() > MAX_QUEUED_UNITS && !m_dropping) {
+      LOG_WARN("RTP sender is too slow, dropping units until next IDR");
+      m_dropping = true;
+    }
+
+    if (m_dropping) {
+      if (packet->type() != Unit::Type::IDR) {
+        dropped += 1;
+        continue;
+      }
+
+      m_dropping = false;
+    }
+
     sent += packet->size();
     set_packet(std::move(*packet));
     send();
+    receive_feedback();
   }
 
   shutdown();
   m_socket.close();
 }
 
+usize PacketSender::select_layer(const std::vector<Layer>& layers) const {
+  for (usize i = 0; i < layers.size(); ++i) {
+    if (layers[i].m_bitrate <= m_target) {
+      return i;
+    }
+  }
+
+  return layers.size() - 1;
+}
+
+std::optional<Unit> PacketSender::drain_layers(std::vector<Layer>& layers,
+                                               usize active,
+                                               usize selected) {
+  std::optional<Unit> idr;
+  for (usize i = 0; i < layers.size(); ++i) {
+    if (i == active) {
+      continue;
+    }
+
+    while (auto unit = layers[i].m_units.try_receive()) {
+      // NOTE: layer can only be switched on IDR
+      if (i == selected && unit->type() == Unit::Type::IDR) {
+        idr = std::move(unit);
+        break;
+      }
+    }
+  }
+
+  return idr;
+}
+
 void PacketSender::shutdown() {
     m_running.cancel();
 }
@@ -108,39 +233,200 @@ void PacketSender::set_packet(Unit packet) {
 
 void PacketSender::send() {
   static const usize HEADER_SIZE = rtp::Packet::MIN_SIZE;
-  std::array<u8, MTU + HEADER_SIZE> buffer;
+  std::array<u8, PACKET_SIZE> buffer;
 
   while (auto fragment = m_packetizer.next()) {
-    // sleep for 1ms every 128 fragments
-    if ((++m_fragments_sent & (128 - 1)) == 0) {
-      std::this_thread::sleep_for(Milliseconds(1));
-    }
-
+    pace(fragment.size() + HEADER_SIZE);
     assert(buffer.size() >= fragment.size() + HEADER_SIZE);
 
+    u8* data = buffer.data();
+#ifdef SHAR_IO_URING
+    if (m_ring) {
+      // NOTE: packet is built in place in registered buffer
+      data = m_batch.data() + m_batched * PACKET_SIZE;
+    }
+#endif
+
     // setup packet
-    std::memset(buffer.data(), 0, HEADER_SIZE);
-    std::memcpy(buffer.data() + HEADER_SIZE, fragment.data(), fragment.size());
+    std::memset(data, 0, HEADER_SIZE);
+    std::memcpy(data + HEADER_SIZE, fragment.data(), fragment.size());
 
-    rtp::Packet packet(buffer.data(), HEADER_SIZE + fragment.size());
+    rtp::Packet packet(data, HEADER_SIZE + fragment.size());
     packet.set_version(2);
     packet.set_has_padding(false);
     packet.set_has_extensions(false);
     packet.set_contributors_count(0);
-    packet.set_marked(false);
+    packet.set_marked(m_packetizer.done()); // last packet of access unit
     packet.set_payload_type(96);
     packet.set_sequence(m_sequence++);
     packet.set_timestamp(m_current_packet.timestamp());
-    packet.set_stream_id(0);
+    packet.set_stream_id(m_stream_id);
+
+#ifdef SHAR_IO_URING
+    if (m_ring) {
+      m_ring->prepare_write_fixed(m_socket.native_handle(), BytesRef(packet.data(), packet.len()), 0);
+      if (++m_batched == BATCH_SIZE) {
+        flush();
+      }
+      continue;
+    }
+#endif
 
     ErrorCode ec;
     m_socket.send_to(span(packet), m_endpoint, 0, ec);
 
     if (ec) {
       LOG_ERROR("Failed to send rtp packet: {}", ec.message());
+      continue;
     }
 
+    if (m_feedback) {
+      m_feedback->m_estimator.on_sent(packet.len());
+    }
   }
+
+  flush();
+}
+
+void PacketSender::pace(usize size) {
+  if (!m_feedback) {
+    // NOTE: without estimation target is just configured bitrate,
+    //       so packets are only spaced out a bit: sleep for 1ms every 128 packets
+    if ((++m_packets_sent & (128 - 1)) == 0) {
+      flush();
+      std::this_thread::sleep_for(Milliseconds(1));
+    }
+    return;
+  }
+
+  const double bytes_per_second = static_cast<double>(m_target * 1024 / 8 * PACING_FACTOR);
+  const auto duration = Microseconds(static_cast<i64>(static_cast<double>(size) * 1e6 / bytes_per_second));
+
+  const auto now = Clock::now();
+  // don't accumulate credit while idle
+  m_next_send = std::max(m_next_send, now - PACING_BURST);
+  if (m_next_send > now) {
+    // packets of the burst are sent before sleeping
+    flush();
+    std::this_thread::sleep_until(m_next_send);
+  }
+
+  m_next_send += duration;
+}
+
+void PacketSender::flush() {
+#ifdef SHAR_IO_URING
+  if (!m_ring || m_batched == 0) {
+    return;
+  }
+
+  // NOTE: UDP writes complete without blocking, so waiting for all of
+  //       them doesn't need an extra syscall
+  auto submitted = m_ring->submit(m_batched);
+  if (auto ec = submitted.err()) {
+    LOG_ERROR("Failed to submit rtp packets: {}", ec.message());
+  }
+
+  m_ring->reap([this](u64 /* user_data */, i32 result) {
+    if (result < 0) {
+      LOG_ERROR("Failed to send rtp packet: {}", std::strerror(-result));
+      return;
+    }
+
+    if (m_feedback) {
+      m_feedback->m_estimator.on_sent(static_cast<usize>(result));
+    }
+  });
+  m_batched = 0;
+#endif
 }
 
-}
\ No newline at end of file
+#ifdef SHAR_IO_URING
+void PacketSender::setup_ring() {
+  auto ring = Ring::create(BATCH_SIZE);
+  if (auto ec = ring.err()) {
+    LOG_WARN("io_uring is not available, falling back to send_to(): {}", ec.message());
+    return;
+  }
+
+  m_batch.assign(BATCH_SIZE * PACKET_SIZE, 0);
+  if (auto ec = (*ring)->register_buffer(BytesRefMut(m_batch.data(), m_batch.size()))) {
+    LOG_WARN("Failed to register io_uring buffer: {}", ec.message());
+  }
+
+  // NOTE: io_uring writes have no destination address
+  ErrorCode ec;
+  m_socket.connect(m_endpoint, ec);
+  if (ec) {
+    LOG_WARN("Failed to connect rtp socket, falling back to send_to(): {}", ec.message());
+    return;
+  }
+
+  m_ring = std::move(*ring);
+  LOG_INFO("RTP sender: using io_uring");
+}
+#endif
+
+void PacketSender::receive_feedback() {
+  static const usize MAX_RTCP_SIZE = 1500;
+  alignas(u32) std::array<u8, MAX_RTCP_SIZE> buffer;
+
+  ErrorCode ec;
+  while (m_socket.available(ec) != 0 && !ec) {
+    udp::Endpoint endpoint;
+    usize n = m_socket.receive_from(span(buffer.data(), buffer.size()), endpoint, 0, ec);
+    if (ec) {
+      LOG_ERROR("Failed to receive rtcp packet: {}", ec.message());
+      return;
+    }
+
+    if (!m_feedback) {
+      continue;
+    }
+
+    // NOTE: RTCP is multiplexed with RTP (RFC 5761), so only RTCP packets are expected here
+    rtcp::Header header{buffer.data(), n};
+    while (header.valid() && header.packet_size() <= header.size()) {
+      if (header.packet_type() == rtcp::PacketType::RECEIVER_REPORT) {
+        rtcp::ReceiverReport report{header.data(), header.packet_size()};
+        if (report.valid()) {
+          // NOTE: receiver may report several streams, pick ours
+          for (usize i = 0; i < report.nblocks(); ++i) {
+            auto block = report.block(i);
+            if (block.valid() && block.stream_id() == m_stream_id) {
+              on_report(block);
+            }
+          }
+        }
+      }
+
+      header = header.next();
+    }
+  }
+}
+
+void PacketSender::on_report(const rtcp::Block& block) {
+  assert(m_feedback);
+  const double jitter_ms = block.jitter() * 1000.0 / CLOCK_RATE;
+
+  auto& feedback = *m_feedback;
+  auto& estimator = feedback.m_estimator;
+  const auto state = estimator.state();
+  estimator.on_feedback(block.fraction_lost(), jitter_ms, Clock::now());
+
+  m_target = estimator.target();
+  feedback.m_target.set(m_target * 1024);
+  feedback.m_send_rate.set(estimator.send_rate() * 1024);
+  feedback.m_loss.set(estimator.loss());
+  feedback.m_delay.set(static_cast<usize>(jitter_ms));
+  if (state != estimator.state() &&
+      estimator.state() == BandwidthEstimator::State::Decrease) {
+    feedback.m_overuse += 1;
+  }
+
+  if (feedback.m_reporter) {
+    feedback.m_reporter->report(m_target);
+  }
+}
+
+}
@@ -1,15 +1,24 @@
 #pragma once
 
 #include <array>
+#include <optional>
+#include <vector>
 
 #include "cancellation.hpp"
 #include "channel.hpp"
 #include "context.hpp"
 #include "net/sender.hpp"
+#include "net/bandwidth_estimator.hpp"
+#include "net/rtcp/block.hpp"
 #include "net/ice/client.hpp"
 #include "net/types.hpp"
+#ifdef SHAR_IO_URING
+#include "net/uring.hpp"
+#endif
 #include "codec/ffmpeg/unit.hpp"
 #include "packetizer.hpp"
+#include "time.hpp"
+#include "metrics.hpp"
 
 
 namespace shar::net::rtp {
@@ -29,14 +38,36 @@ public:
     ~PacketSender() override = default;
 
     void run(Receiver<Unit> packets) override;
+    void run_simulcast(std::vector<Layer> layers) override;
     void shutdown() override;
+    void set_bitrate_output(Sender<usize> bitrate) override;
 
 private:
     void set_packet(Unit packet);
     void send();
 
+    // wait until |size| bytes can be sent without exceeding pacing rate
+    // NOTE: packets are paced only if bandwidth is estimated
+    void pace(usize size);
+
+    // send packets queued in io_uring, if any
+    void flush();
+
+    // process RTCP packets received from the other side, if any
+    void receive_feedback();
+
+    // update bandwidth estimation with RTCP report block for our stream
+    void on_report(const rtcp::Block& block);
+
     void connect();
 
+    // returns best layer that fits into current target bitrate
+    usize select_layer(const std::vector<Layer>& layers) const;
+
+    // discard units of layers other than |active|. Returns IDR of |selected|
+    // layer if there is one, so that sender can switch to it.
+    std::optional<Unit> drain_layers(std::vector<Layer>& layers, usize active, usize selected);
+
     Cancellation m_running;
 
     udp::Endpoint m_endpoint;
@@ -47,11 +78,46 @@ private:
     Packetizer m_packetizer;
 
     u16  m_sequence;
+    u32  m_stream_id; // SSRC
 
     usize m_bytes_sent;
-    usize m_fragments_sent;
+    usize m_packets_sent{ 0 };
+
+    // current target bitrate (in kbits)
+    usize m_target;
+    TimePoint m_next_send;
+
+    // true if units are being dropped until next IDR
+    bool m_dropping{ false };
+
+    struct Feedback {
+      Feedback(MetricsPtr metrics, std::optional<Sender<usize>> output, usize kbits);
+
+      // NOTE: empty if estimation is used only for simulcast layer selection
+      std::optional<TargetReporter> m_reporter;
+      BandwidthEstimator m_estimator;
+
+      Metric m_target;
+      Metric m_send_rate;
+      Metric m_loss;
+      Metric m_delay;
+      Metric m_overuse;
+    };
+
+    // congestion control state, only present if bitrate output was set
+    std::optional<Feedback> m_feedback;
 
     ice::Client m_client;
+
+#ifdef SHAR_IO_URING
+    // set up io_uring backend, falls back to plain send_to() on failure
+    void setup_ring();
+
+    // packets sent within a pacing burst are submitted with one syscall
+    std::unique_ptr<Ring> m_ring; // empty if io_uring is not available
+    std::vector<u8> m_batch;      // registered buffer for BATCH_SIZE packets
+    usize m_batched{ 0 };         // number of packets queued in |m_ring|
+#endif
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,85 @@
+#include "statistics.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+
+namespace shar::net::rtp {
+
+// sequence numbers further than this are considered to be reordered
+static const u16 MAX_DROPOUT = 3000;
+
+void Statistics::update(u16 sequence, u32 timestamp, u32 arrival) noexcept {
+  if (!m_initialized) {
+    m_initialized = true;
+    m_max_sequence = sequence;
+    m_base_sequence = sequence;
+    m_transit = static_cast<i64>(arrival) - static_cast<i64>(timestamp);
+  }
+
+  const u16 delta = static_cast<u16>(sequence - m_max_sequence);
+  if (delta < MAX_DROPOUT) {
+    // in order, with permissible gap
+    if (sequence < m_max_sequence) {
+      // sequence number wrapped
+      m_cycles += u32{1} << 16;
+    }
+    m_max_sequence = sequence;
+  }
+  // else: duplicate or reordered packet
+
+  m_received += 1;
+
+  // D(i-1,i) = (Ri - Si) - (Ri-1 - Si-1)
+  // J(i) = J(i-1) + (|D(i-1,i)| - J(i-1))/16
+  const i64 transit = static_cast<i64>(arrival) - static_cast<i64>(timestamp);
+  const i64 d = std::abs(transit - m_transit);
+  m_transit = transit;
+  m_jitter += (static_cast<double>(d) - m_jitter) / 16.0;
+}
+
+void Statistics::report(rtcp::Block& block) noexcept {
+  const u32 expected = this->expected();
+  const u32 lost = expected > m_received ? expected - m_received : 0;
+
+  const u32 expected_interval = expected - m_expected_prior;
+  const u32 received_interval = m_received - m_received_prior;
+  m_expected_prior = expected;
+  m_received_prior = m_received;
+
+  u8 fraction = 0;
+  if (expected_interval != 0 && expected_interval > received_interval) {
+    const u32 lost_interval = expected_interval - received_interval;
+    fraction = static_cast<u8>(std::min<u32>((lost_interval << 8) / expected_interval, 255));
+  }
+
+  block.set_fraction_lost(fraction);
+  block.set_packets_lost(std::min<u32>(lost, 0x7fffff));
+  block.set_last_sequence(extended_sequence());
+  block.set_jitter(jitter());
+  // sender reports are not supported (yet)
+  block.set_last_sender_report_timestamp(0);
+  block.set_delay_since_last_sender_report(0);
+}
+
+void Statistics::reset() noexcept {
+  *this = Statistics();
+}
+
+u32 Statistics::extended_sequence() const noexcept {
+  return m_cycles + m_max_sequence;
+}
+
+u32 Statistics::expected() const noexcept {
+  return m_initialized ? extended_sequence() - m_base_sequence + 1 : 0;
+}
+
+u32 Statistics::received() const noexcept {
+  return m_received;
+}
+
+u32 Statistics::jitter() const noexcept {
+  return static_cast<u32>(m_jitter);
+}
+
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "int.hpp"
+#include "net/rtcp/block.hpp"
+
+
+namespace shar::net::rtp {
+
+// Per-source reception statistics, as described in RFC 3550 (Appendix A.1, A.3, A.8)
+// Used to fill RTCP report blocks.
+class Statistics {
+public:
+  Statistics() noexcept = default;
+
+  // account received packet
+  // |arrival| - arrival time, in same units as |timestamp|
+  void update(u16 sequence, u32 timestamp, u32 arrival) noexcept;
+
+  // fill report block with current statistics
+  // NOTE: resets per-interval counters (used for fraction lost)
+  void report(rtcp::Block& block) noexcept;
+
+  void reset() noexcept;
+
+  // extended highest sequence number received
+  u32 extended_sequence() const noexcept;
+
+  // number of packets expected since start of reception
+  u32 expected() const noexcept;
+
+  // number of packets received since start of reception
+  u32 received() const noexcept;
+
+  // interarrival jitter, in timestamp units
+  u32 jitter() const noexcept;
+
+private:
+  bool m_initialized{ false };
+
+  u16 m_max_sequence{ 0 };
+  u32 m_cycles{ 0 };       // shifted count of sequence number cycles
+  u32 m_base_sequence{ 0 };
+  u32 m_received{ 0 };
+
+  u32 m_expected_prior{ 0 };
+  u32 m_received_prior{ 0 };
+
+  i64 m_transit{ 0 };
+  double m_jitter{ 0.0 };
+};
+
+}
@@ -16,6 +16,7 @@
 #include <array>
 #include <cstring>
 #include <iterator> // std::size
+#include <vector>
 
 using namespace shar;
 using namespace shar::net;
@@ -79,3 +80,40 @@ TEST(depacketizer, big_units) {
               depacketizer.buffer()[i + 1]); /* + 1 for long prefix */
   }
 }
+
+TEST(depacketizer, mixed_units) {
+  const u8 NAL_UNIT[] = {
+      0x00, 0x00, 0x00, 0x01, 0x09, 0x10,
+      0x00, 0x00, 0x01, 0x68, 0xce, 0x3c, 0x80,
+      0x00, 0x00, 0x01, 0x67, 0x42, 0x00, 0x20, 0xe9, 0x00, 0x80, 0x0c, 0x32,
+      0x00, 0x00, 0x01, 0x65, 0x88, 0x80, 0x1a, 0x01, 0x02, 0x03, 0x04, 0x05,
+      0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10,
+  };
+
+  std::array<u8, 1024> buffer;
+  std::memcpy(buffer.data(), NAL_UNIT, std::size(NAL_UNIT));
+
+  // STAP-A (AUD + PPS), single NAL (SPS) and FU-A (IDR)
+  rtp::Packetizer packetizer{11};
+  packetizer.set(buffer.data(), std::size(NAL_UNIT));
+
+  std::vector<u8> types;
+  rtp::Depacketizer depacketizer;
+  while (auto fragment = packetizer.next()) {
+    types.push_back(fragment.packet_type());
+    depacketizer.push(fragment);
+  }
+
+  ASSERT_GE(types.size(), 4);
+  EXPECT_EQ(types[0], 24);
+  EXPECT_EQ(types[1], 7);
+  EXPECT_EQ(types[2], 28);
+  EXPECT_EQ(types.back(), 28);
+
+  ASSERT_TRUE(depacketizer.completed());
+  const auto& result = depacketizer.buffer();
+  ASSERT_EQ(result.size(), std::size(NAL_UNIT));
+  for (usize i = 0; i < result.size(); ++i) {
+    EXPECT_EQ(NAL_UNIT[i], result[i]);
+  }
+}
@@ -20,87 +20,82 @@ TEST(packetizer, small_units) {
   rtp::Packetizer packetizer{1100};
   packetizer.set(&NAL_UNIT[0], std::size(NAL_UNIT));
 
-  // first nal
+  // all units are aggregated into single STAP-A packet
   auto fragment = packetizer.next();
   ASSERT_TRUE(fragment.valid());
-  EXPECT_EQ(fragment.size(), 3);
-
-  EXPECT_EQ(fragment.nri(), 0);
-  EXPECT_EQ(fragment.packet_type(), 28);
+  EXPECT_EQ(fragment.size(), 1 + (2 + 2) + (2 + 9) + (2 + 4));
 
+  EXPECT_EQ(fragment.nri(), 3);
+  EXPECT_EQ(fragment.packet_type(), 24);
+  EXPECT_FALSE(fragment.is_fragmented());
   EXPECT_TRUE(fragment.is_first());
-  EXPECT_FALSE(fragment.is_last());
+  EXPECT_TRUE(fragment.is_last());
   EXPECT_EQ(fragment.nal_type(), 0x9);
 
-  EXPECT_EQ(fragment.payload_size(), 1);
-  EXPECT_EQ(fragment.payload()[0], 0x10);
+  const u8 EXPECTED[] = {
+    0x00, 0x02, 0x09, 0x10,
+    0x00, 0x09, 0x67, 0x42, 0x00, 0x20, 0xe9, 0x00, 0x80, 0x0c, 0x32,
+    0x00, 0x04, 0x68, 0xce, 0x3c, 0x80
+  };
+  for (usize i = 0; i < std::size(EXPECTED); ++i) {
+    EXPECT_EQ(fragment.data()[i + 1], EXPECTED[i]);
+  }
 
-  // empty fragment with end flag
-  fragment = packetizer.next();
-  ASSERT_TRUE(fragment.valid());
-  EXPECT_EQ(fragment.size(), 2);
-
-  EXPECT_EQ(fragment.nri(), 0);
-  EXPECT_EQ(fragment.packet_type(), 28);
-
-  EXPECT_FALSE(fragment.is_first());
-  EXPECT_TRUE(fragment.is_last());
-  EXPECT_EQ(fragment.nal_type(), 0x9);
+  EXPECT_TRUE(packetizer.done());
 
-  EXPECT_EQ(fragment.payload_size(), 0);
+  // no more data
+  fragment = packetizer.next();
+  ASSERT_FALSE(fragment.valid());
 
-  // second nal
   fragment = packetizer.next();
-  ASSERT_TRUE(fragment.valid());
-  EXPECT_EQ(fragment.size(), 10);
+  ASSERT_FALSE(fragment.valid());
+}
 
-  EXPECT_EQ(fragment.nri(), 3);
-  EXPECT_EQ(fragment.packet_type(), 28);
+TEST(packetizer, single_units) {
+  u8 NAL_UNIT[] = {
+		0x00, 0x00, 0x01, 0x09, 0x10,
+		0x00, 0x00, 0x01, 0x67, 0x42, 0x00, 0x20, 0xe9, 0x00, 0x80, 0x0c, 0x32,
+		0x00, 0x00, 0x01, 0x68, 0xce, 0x3c, 0x80
+	};
 
-  EXPECT_TRUE(fragment.is_first());
-  EXPECT_FALSE(fragment.is_last());
-  EXPECT_EQ(fragment.nal_type(), 7);
+  // units fit into mtu, but can't be aggregated
+  rtp::Packetizer packetizer{10};
+  packetizer.set(&NAL_UNIT[0], std::size(NAL_UNIT));
 
-  fragment = packetizer.next();
+  // first nal
+  auto fragment = packetizer.next();
   ASSERT_TRUE(fragment.valid());
   EXPECT_EQ(fragment.size(), 2);
 
-  EXPECT_EQ(fragment.nri(), 3);
-  EXPECT_EQ(fragment.packet_type(), 28);
-
-  EXPECT_FALSE(fragment.is_first());
-  EXPECT_TRUE(fragment.is_last());
-  EXPECT_EQ(fragment.nal_type(), 7);
+  EXPECT_EQ(fragment.nri(), 0);
+  EXPECT_EQ(fragment.packet_type(), 9);
+  EXPECT_FALSE(fragment.is_fragmented());
+  EXPECT_EQ(fragment.nal_type(), 0x9);
+  EXPECT_EQ(fragment.data()[1], 0x10);
+  EXPECT_FALSE(packetizer.done());
 
-  // third nal
+  // second nal
   fragment = packetizer.next();
   ASSERT_TRUE(fragment.valid());
-  EXPECT_EQ(fragment.size(), 5);
+  EXPECT_EQ(fragment.size(), 9);
 
   EXPECT_EQ(fragment.nri(), 3);
-  EXPECT_EQ(fragment.packet_type(), 28);
-
-  EXPECT_TRUE(fragment.is_first());
-  EXPECT_FALSE(fragment.is_last());
-  EXPECT_EQ(fragment.nal_type(), 8);
+  EXPECT_EQ(fragment.packet_type(), 7);
+  EXPECT_EQ(fragment.nal_type(), 7);
+  EXPECT_FALSE(packetizer.done());
 
+  // third nal
   fragment = packetizer.next();
   ASSERT_TRUE(fragment.valid());
-  EXPECT_EQ(fragment.size(), 2);
+  EXPECT_EQ(fragment.size(), 4);
 
   EXPECT_EQ(fragment.nri(), 3);
-  EXPECT_EQ(fragment.packet_type(), 28);
-
-  EXPECT_FALSE(fragment.is_first());
-  EXPECT_TRUE(fragment.is_last());
+  EXPECT_EQ(fragment.packet_type(), 8);
   EXPECT_EQ(fragment.nal_type(), 8);
+  EXPECT_TRUE(packetizer.done());
 
   // no more data
-  fragment = packetizer.next();
-  ASSERT_FALSE(fragment.valid());
-
-  fragment = packetizer.next();
-  ASSERT_FALSE(fragment.valid());
+  ASSERT_FALSE(packetizer.next().valid());
 }
 
 TEST(packetizer, big_units) {
@@ -179,5 +174,6 @@ TEST(packetizer, big_units) {
   EXPECT_EQ(fragment.payload()[0], 0x0c);
   EXPECT_EQ(fragment.payload()[1], 0x32);
 
+  EXPECT_TRUE(packetizer.done());
   ASSERT_FALSE(packetizer.next().valid());
 }
\ No newline at end of file
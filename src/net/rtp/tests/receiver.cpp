@@ -0,0 +1,149 @@
+#include "net/rtp/receiver.hpp"
+
+// NOTE: gtest defines FAIL macro
+#ifdef FAIL
+#undef FAIL
+#endif
+
+// clang-format off
+#include "disable_warnings_push.hpp"
+#include <gtest/gtest.h>
+#include "disable_warnings_pop.hpp"
+// clang-format on
+
+#include <array>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <thread>
+
+using namespace shar;
+using namespace shar::net;
+
+using Unit = rtp::Receiver::Unit;
+
+static Context make_context() {
+  return Context{ std::make_shared<Config>(), std::make_shared<Metrics>(16) };
+}
+
+static const udp::Endpoint SENDER{ IpAddress{ IPv4::loopback() }, 44444 };
+
+static const u8 NAL_UNIT[] = { 0x65, 0x88, 0x80, 0x1a };
+
+using Buffer = std::array<u8, rtp::Packet::MIN_SIZE + sizeof(NAL_UNIT)>;
+
+// single NAL unit packet of |stream_id|
+static void write_packet(Buffer& buffer, u32 stream_id, u16 sequence, u32 timestamp) {
+  std::memcpy(buffer.data() + rtp::Packet::MIN_SIZE, NAL_UNIT, sizeof(NAL_UNIT));
+
+  rtp::Packet packet{ buffer.data(), buffer.size() };
+  packet.set_version(2);
+  packet.set_payload_type(96);
+  packet.set_sequence(sequence);
+  packet.set_timestamp(timestamp);
+  packet.set_stream_id(stream_id);
+}
+
+static void receive(rtp::Receiver& receiver, u32 stream_id, u16 sequence, u32 timestamp,
+                    TimePoint now = Clock::now()) {
+  alignas(u32) Buffer buffer{};
+  write_packet(buffer, stream_id, sequence, timestamp);
+  receiver.process(buffer.data(), buffer.size(), SENDER, now);
+}
+
+TEST(rtp_receiver, demultiplex) {
+  rtp::Receiver receiver{ make_context(), IpAddress{ IPv4::loopback() }, 0 };
+
+  auto [first_tx, first_rx] = channel<Unit>(8);
+  auto [second_tx, second_rx] = channel<Unit>(8);
+  receiver.add_stream(1, std::move(first_tx));
+  receiver.add_stream(2, std::move(second_tx));
+
+  // unit is complete once packet with next timestamp arrives
+  receive(receiver, 1, 1, 100);
+  receive(receiver, 2, 1, 100);
+  receive(receiver, 3, 1, 100);
+  receive(receiver, 1, 2, 200);
+  EXPECT_TRUE(first_rx.try_receive());
+  EXPECT_FALSE(second_rx.try_receive());
+
+  receive(receiver, 2, 2, 200);
+  EXPECT_TRUE(second_rx.try_receive());
+  EXPECT_FALSE(first_rx.try_receive());
+
+  // stream without output has no state
+  EXPECT_EQ(receiver.streams(), 2);
+}
+
+TEST(rtp_receiver, unknown_streams) {
+  rtp::Receiver receiver{ make_context(), IpAddress{ IPv4::loopback() }, 0 };
+
+  auto [tx, rx] = channel<Unit>(8);
+  receiver.add_stream(1, std::move(tx));
+
+  for (u32 stream_id = 2; stream_id < 10000; ++stream_id) {
+    receive(receiver, stream_id, 1, 100);
+  }
+  EXPECT_EQ(receiver.streams(), 0);
+
+  receive(receiver, 1, 1, 100);
+  receive(receiver, 1, 2, 200);
+  EXPECT_TRUE(rx.try_receive());
+  EXPECT_EQ(receiver.streams(), 1);
+}
+
+TEST(rtp_receiver, expire) {
+  rtp::Receiver receiver{ make_context(), IpAddress{ IPv4::loopback() }, 0 };
+
+  auto [tx, rx] = channel<Unit>(8);
+  receiver.add_stream(1, std::move(tx));
+
+  const auto start = Clock::now();
+  receive(receiver, 1, 1, 100, start);
+  EXPECT_EQ(receiver.streams(), 1);
+
+  receiver.expire(start + Seconds(1));
+  EXPECT_EQ(receiver.streams(), 1);
+
+  receiver.expire(start + Seconds(10));
+  EXPECT_EQ(receiver.streams(), 0);
+
+  // stream is received again after its state is dropped
+  receive(receiver, 1, 5, 300, start + Seconds(11));
+  receive(receiver, 1, 6, 400, start + Seconds(11));
+  EXPECT_TRUE(rx.try_receive());
+  EXPECT_EQ(receiver.streams(), 1);
+}
+
+TEST(rtp_receiver, run) {
+  // NOTE: receiver doesn't expose bound port
+  static const Port PORT = 45454;
+  const udp::Endpoint endpoint{ IpAddress{ IPv4::loopback() }, PORT };
+  rtp::Receiver receiver{ make_context(), endpoint.address(), PORT };
+
+  auto [tx, rx] = channel<Unit>(8);
+  std::thread thread{ [&receiver, tx = std::move(tx)]() mutable { receiver.run(std::move(tx)); } };
+
+  IOContext context;
+  udp::Socket socket{ context, udp::Endpoint{ IpAddress{ IPv4::loopback() }, 0 } };
+  const auto send = [&](u16 sequence, u32 timestamp) {
+    alignas(u32) Buffer buffer{};
+    write_packet(buffer, 1, sequence, timestamp);
+    socket.send_to(span(buffer.data(), buffer.size()), endpoint);
+  };
+
+  // NOTE: packets sent before receiver is bound are lost
+  std::optional<Unit> unit;
+  for (u16 i = 0; i < 100 && !unit; ++i) {
+    send(static_cast<u16>(2 * i), 100u * i);
+    send(static_cast<u16>(2 * i + 1), 100u * i + 50);
+    std::this_thread::sleep_for(Milliseconds(10));
+    unit = rx.try_receive();
+  }
+  EXPECT_TRUE(unit);
+
+  // NOTE: blocking receive is interrupted by the next packet
+  receiver.shutdown();
+  send(0, 0);
+  thread.join();
+}
@@ -0,0 +1,78 @@
+#include "net/rtp/statistics.hpp"
+
+// clang-format off
+#include "disable_warnings_push.hpp"
+#include <gtest/gtest.h>
+#include "disable_warnings_pop.hpp"
+// clang-format on
+
+#include <array>
+
+using namespace shar;
+using namespace shar::net;
+
+TEST(rtp_statistics, no_loss) {
+  rtp::Statistics statistics;
+  for (u16 i = 0; i < 100; ++i) {
+    statistics.update(i, i * 3000u, i * 3000u);
+  }
+
+  std::array<u8, rtcp::Block::MIN_SIZE> buffer{};
+  rtcp::Block block{buffer.data(), buffer.size()};
+  statistics.report(block);
+
+  EXPECT_EQ(block.fraction_lost(), 0);
+  EXPECT_EQ(block.packets_lost(), 0);
+  EXPECT_EQ(block.last_sequence(), 99);
+  EXPECT_EQ(block.jitter(), 0);
+}
+
+TEST(rtp_statistics, loss) {
+  rtp::Statistics statistics;
+  for (u16 i = 0; i < 100; ++i) {
+    // drop every 4th packet
+    if (i % 4 != 1) {
+      statistics.update(i, 0, 0);
+    }
+  }
+
+  std::array<u8, rtcp::Block::MIN_SIZE> buffer{};
+  rtcp::Block block{buffer.data(), buffer.size()};
+  statistics.report(block);
+
+  EXPECT_EQ(block.packets_lost(), 25);
+  EXPECT_EQ(block.fraction_lost(), 64); // 25%
+
+  // no packets lost since last report
+  for (u16 i = 100; i < 200; ++i) {
+    statistics.update(i, 0, 0);
+  }
+
+  statistics.report(block);
+  EXPECT_EQ(block.packets_lost(), 25);
+  EXPECT_EQ(block.fraction_lost(), 0);
+}
+
+TEST(rtp_statistics, sequence_wrap) {
+  rtp::Statistics statistics;
+  for (u32 i = 65500; i < 65600; ++i) {
+    statistics.update(static_cast<u16>(i), 0, 0);
+  }
+
+  EXPECT_EQ(statistics.extended_sequence(), 65599);
+  EXPECT_EQ(statistics.expected(), 100);
+  EXPECT_EQ(statistics.received(), 100);
+}
+
+TEST(rtp_statistics, jitter) {
+  rtp::Statistics statistics;
+  for (u16 i = 0; i < 100; ++i) {
+    // every second packet arrives 160 ticks late
+    u32 delay = (i % 2) * 160;
+    statistics.update(i, i * 3000u, i * 3000u + delay);
+  }
+
+  // converges to |D| = 160
+  EXPECT_GT(statistics.jitter(), 150);
+  EXPECT_LE(statistics.jitter(), 160);
+}
@@ -0,0 +1,527 @@
+#include "connection.hpp"
+
+#include "bufwriter.hpp"
+#include "error.hpp"
+#include "server.hpp"
+
+#include <algorithm> // copy, fill, find, min
+#include <array>
+#include <charconv>
+#include <cstring>
+
+
+namespace shar::net::rtsp {
+
+// max size of incoming data that can't be processed yet,
+// enough for biggest interleaved packet
+static const usize MAX_INPUT_SIZE = 128 * 1024;
+
+// max number of segments written at once
+static const usize MAX_WRITE_BATCH = 64;
+
+// bigger interleaved packets from client are ignored
+static const usize MAX_RTCP_SIZE = 1500;
+
+// request body is not used, but it has to be skipped
+static std::optional<usize> content_length(Request& request) {
+  auto header = request.m_headers.get("Content-Length");
+  if (!header) {
+    return 0;
+  }
+
+  usize length = 0;
+  const auto value = header->value;
+  auto [end, ec] = std::from_chars(value.char_ptr(), value.char_ptr() + value.len(), length);
+  if (ec != std::errc() || end != value.char_ptr() + value.len()) {
+    return std::nullopt;
+  }
+
+  return length;
+}
+
+// Session header value is "<id>[;timeout=<seconds>]"
+static BytesRef session_id(BytesRef value) {
+  const u8* end = std::find(value.begin(), value.end(), ';');
+  return BytesRef(value.data(), end);
+}
+
+// value of Session header of response
+static BytesRef session_header(BufWriter& writer, const Session& session) {
+  const usize begin = writer.written_bytes();
+  writer.write(BytesRef(session.id().data(), session.id().size()));
+  writer.write(";timeout=");
+  writer.format(Server::SESSION_TIMEOUT);
+  return BytesRef(writer.data() + begin, writer.data() + writer.written_bytes());
+}
+
+Connection::Connection(Server& server, usize id, tcp::Socket socket)
+    : m_server(server)
+    , m_id(id)
+    , m_strand(server.m_context.get_executor())
+    , m_socket(std::move(socket))
+    , m_in(4096, 0)
+    , m_received_bytes(0)
+    , m_out(4096, 0)
+    , m_headers(10)
+    , m_headers_buffer(256, 0)
+    , m_rtt(server.m_metrics, "RTSP client " + std::to_string(id) + " rtt (us)", Metrics::Format::Count)
+    , m_cwnd(server.m_metrics, "RTSP client " + std::to_string(id) + " cwnd", Metrics::Format::Count)
+    , m_retransmits(server.m_metrics, "RTSP client " + std::to_string(id) + " retransmits", Metrics::Format::Count)
+    , m_delivery_rate(server.m_metrics, "RTSP client " + std::to_string(id) + " delivery rate", Metrics::Format::Bits) {}
+
+const Strand& Connection::strand() const noexcept {
+  return m_strand;
+}
+
+usize Connection::unsent_bytes() const noexcept {
+  return m_unsent_bytes;
+}
+
+void Connection::start() {
+  receive();
+}
+
+void Connection::close() {
+  if (m_closed) {
+    return;
+  }
+
+  m_closed = true;
+
+  // NOTE: UDP sessions are kept until timeout or TEARDOWN
+  for (const auto& id : m_sessions) {
+    m_server.remove_session(BytesRef(id.data(), id.size()));
+  }
+  m_sessions.clear();
+
+  // NOTE: socket may be already closed by peer
+  ErrorCode ec;
+  m_socket.shutdown(tcp::Socket::shutdown_both, ec);
+  m_socket.close(ec);
+}
+
+void Connection::update_tcp_info() {
+  if (m_closed) {
+    return;
+  }
+
+  auto info = tcp_info(m_socket);
+  if (info.err()) {
+    return;
+  }
+
+  m_rtt.set(static_cast<usize>(info->rtt.count()));
+  m_cwnd.set(info->cwnd);
+  m_retransmits.set(info->retransmits);
+  m_delivery_rate.set(info->delivery_rate * 8);
+}
+
+void Connection::receive() {
+  if (m_received_bytes == m_in.size()) {
+    if (m_in.size() >= MAX_INPUT_SIZE) {
+      LOG_INFO("Client {}: buffer overflow", m_id);
+      close();
+      return;
+    }
+
+    m_in.resize(std::min(m_in.size() * 2, MAX_INPUT_SIZE));
+  }
+
+  auto buffer = span(m_in.data() + m_received_bytes,
+                     m_in.size() - m_received_bytes);
+  m_socket.async_receive(
+      buffer,
+      asio::bind_executor(m_strand, [this, self = shared_from_this()](const ErrorCode& ec, const usize size) {
+        if (m_closed) {
+          return;
+        }
+
+        if (ec) {
+          LOG_ERROR("Socket read error (Client {}): {}", m_id, ec.message());
+          close();
+          return;
+        }
+
+        m_received_bytes += size;
+
+        // NOTE: failure to handle a request only affects this connection
+        bool more = false;
+        try {
+          more = process_input();
+        } catch (const std::exception& e) {
+          LOG_ERROR("Client {}: failed to process request: {}", m_id, e.what());
+          close();
+        }
+
+        if (more) {
+          receive();
+        }
+      }));
+}
+
+bool Connection::process_input() {
+  // NOTE: several requests and interleaved packets can be received at once
+  usize offset = 0;
+  while (offset != m_received_bytes) {
+    auto input = BytesRef(m_in.data() + offset, m_received_bytes - offset);
+
+    // interleaved packets sent by client (e.g. RTCP reports)
+    if (input.data()[0] == Segment::INTERLEAVED_MAGIC) {
+      if (input.len() < Segment::INTERLEAVED_HEADER_SIZE) {
+        break;
+      }
+
+      const usize packet_size = Segment::INTERLEAVED_HEADER_SIZE +
+                                (static_cast<usize>(input.data()[2]) << 8 | input.data()[3]);
+      if (input.len() < packet_size) {
+        break;
+      }
+
+      process_interleaved(input.data()[1], input.slice(Segment::INTERLEAVED_HEADER_SIZE, packet_size));
+      offset += packet_size;
+      continue;
+    }
+
+    // NOTE: header slots are reused, clear values left by previous request
+    std::fill(m_headers.begin(), m_headers.end(), Header());
+    Request request{Headers{m_headers.data(), m_headers.size()}};
+
+    auto request_size = request.parse(input);
+    if (auto e = request_size.err()) {
+      // incomplete request, receive more data
+      if (e == make_error_code(Error::NotEnoughData)) {
+        break;
+      }
+
+      // invalid request, disconnect
+      // FIXME: respond with 400 Bad Request instead
+      LOG_WARN("Client {} request parsing error: {}", m_id, e.message());
+      close();
+      return false;
+    }
+
+    auto body_size = content_length(request);
+    if (!body_size) {
+      LOG_WARN("Client {}: invalid Content-Length", m_id);
+      close();
+      return false;
+    }
+
+    // NOTE: request body is not used, but has to be skipped
+    if (input.len() - *request_size < *body_size) {
+      break;
+    }
+
+    auto response = process_request(request);
+    auto response_size = response.serialize(m_out.data(), m_out.size());
+    if (auto e = response_size.err()) {
+      LOG_WARN("Client {} response serialization error: {}", m_id, e.message());
+      close();
+      return false;
+    }
+
+    // responses are sent in order of requests
+    auto bytes = std::make_shared<std::vector<u8>>(m_out.data(), m_out.data() + *response_size);
+    Segment segment;
+    segment.m_payload = BytesRef(bytes->data(), bytes->size());
+    segment.m_owner = std::move(bytes);
+    write(std::move(segment));
+
+    offset += *request_size + *body_size;
+  }
+
+  // move incomplete data to start of buffer
+  m_received_bytes -= offset;
+  std::memmove(m_in.data(), m_in.data() + offset, m_received_bytes);
+  return true;
+}
+
+void Connection::process_interleaved(u8 channel, BytesRef packet) {
+  if (packet.len() > MAX_RTCP_SIZE) {
+    return;
+  }
+
+  // NOTE: finding session also refreshes its timeout
+  for (const auto& id : m_sessions) {
+    auto session = m_server.find_session(BytesRef(id.data(), id.size()));
+    if (session && session->transport().rtcp == channel) {
+      // NOTE: rtcp packets are parsed in place, so they should be 4-byte aligned
+      alignas(u32) std::array<u8, MAX_RTCP_SIZE> buffer;
+      std::copy(packet.begin(), packet.end(), buffer.begin());
+      session->on_rtcp(buffer.data(), packet.len());
+      return;
+    }
+  }
+}
+
+Response Connection::process_request(Request request) {
+  assert(request.m_type.has_value());
+  Headers headers{m_headers.data(), m_headers.size()};
+
+  // NOTE: references |m_in| buffer
+  auto cseq = request.m_headers.get("CSeq");
+  if (!cseq) {
+    LOG_WARN("CSeq header wasn't found. Client {}", m_id);
+    return response(headers)
+        .with_status(400, "Bad Request")
+        .with_header("Reason", "No CSeq header");
+  }
+
+  switch (request.m_type.value()) {
+    case Request::Type::OPTIONS: {
+      return response(headers)
+          .with_status(200, "OK")
+          .with_header(*cseq)
+          .with_header("Public", "DESCRIBE, SETUP, TEARDOWN, PLAY, GET_PARAMETER");
+    }
+
+    case Request::Type::DESCRIBE: {
+      // address client has connected to
+      ErrorCode ec;
+      m_sdp = m_server.describe(m_socket.local_endpoint(ec).address());
+      auto sdp = BytesRef(m_sdp.data(), m_sdp.size());
+
+      BufWriter writer{m_headers_buffer.data(), m_headers_buffer.size()};
+      auto content_length = writer.format(sdp.len());
+      assert(content_length.has_value());
+
+      return response(headers)
+          .with_status(200, "OK")
+          .with_header(*cseq)
+          .with_header("Content-Type", "application/sdp")
+          .with_header("Content-Length", *content_length)
+          .with_body(sdp);
+    }
+
+    case Request::Type::SETUP: {
+      if (auto client_transport = request.m_headers.get("Transport")) {
+        if (auto transport = parse_transport(client_transport->value)) {
+          auto session = setup_session(*transport);
+          if (!session) {
+            return response(headers)
+                .with_status(500, "Internal Server Error")
+                .with_header(*cseq);
+          }
+
+          BufWriter writer{m_headers_buffer.data(), m_headers_buffer.size()};
+
+          // setup transport header
+          if (transport->type == Transport::Type::Interleaved) {
+            writer.write("RTP/AVP/TCP;unicast;interleaved=");
+            writer.format(transport->rtp);
+            writer.write("-");
+            writer.format(transport->rtcp);
+          } else {
+            const auto server_port = session->server_port();
+
+            writer.write("RTP/AVP;unicast;client_port=");
+            writer.format(transport->rtp);
+            writer.write("-");
+            writer.format(transport->rtcp);
+            // NOTE: rtcp from client is not processed yet
+            writer.write(";server_port=");
+            writer.format(server_port);
+            writer.write("-");
+            writer.format(server_port + 1u);
+          }
+          writer.write(";ssrc=");
+          writer.format(session->stream_id(), 16);
+
+          auto transport_header = BytesRef(writer.data(), writer.written_bytes());
+          auto session_value = session_header(writer, *session);
+
+          return response(headers)
+              .with_status(200, "OK")
+              .with_header(*cseq)
+              .with_header("Transport", transport_header)
+              .with_header("Session", session_value)
+              .with_header("Media-Properties",
+                           "No-Seeking, Time-Progressing, Time-Duration=0.0");
+        }
+
+        return response(headers)
+            .with_status(461, "Unsupported Transport")
+            .with_header(*cseq);
+      }
+
+      return response(headers)
+          .with_status(402, "Payment Required")
+          .with_header(*cseq);
+    }
+
+    case Request::Type::TEARDOWN: {
+      if (auto session = request.m_headers.get("Session")) {
+        const auto id = session_id(session->value);
+        if (m_server.remove_session(id)) {
+          auto it = std::find(m_sessions.begin(), m_sessions.end(), std::string(id.char_ptr(), id.len()));
+          if (it != m_sessions.end()) {
+            m_sessions.erase(it);
+          }
+          return response(headers).with_status(200, "OK").with_header(*cseq);
+        }
+      }
+
+      return response(headers)
+          .with_status(454, "Session Not Found")
+          .with_header(*cseq);
+    }
+
+    case Request::Type::PLAY: {
+      if (auto session = find_session(request)) {
+        LOG_INFO("Client {}: starting stream of session {}", m_id, session->id());
+        session->play();
+
+        BufWriter writer{m_headers_buffer.data(), m_headers_buffer.size()};
+        return response(headers)
+            .with_status(200, "OK")
+            .with_header(*cseq)
+            .with_header("Session", session_header(writer, *session));
+      }
+
+      return response(headers)
+          .with_status(454, "Session Not Found")
+          .with_header(*cseq);
+    }
+
+    case Request::Type::GET_PARAMETER: {
+      // NOTE: used by clients as keep-alive, parameters are not supported,
+      //       so the body of request is ignored
+      if (!request.m_headers.get("Session")) {
+        return response(headers).with_status(200, "OK").with_header(*cseq);
+      }
+
+      if (auto session = find_session(request)) {
+        BufWriter writer{m_headers_buffer.data(), m_headers_buffer.size()};
+        return response(headers)
+            .with_status(200, "OK")
+            .with_header(*cseq)
+            .with_header("Session", session_header(writer, *session));
+      }
+
+      return response(headers)
+          .with_status(454, "Session Not Found")
+          .with_header(*cseq);
+    }
+
+    case Request::Type::PAUSE:
+    case Request::Type::SET_PARAMETER:
+    case Request::Type::REDIRECT:
+    case Request::Type::ANNOUNCE:
+    case Request::Type::RECORD: {
+      return response(headers)
+          .with_status(501, "Not implemented")
+          .with_header(*cseq);
+    }
+
+    default: {
+      assert(false);
+      throw std::runtime_error("Unknown request type.");
+    }
+  }
+}
+
+SessionPtr Connection::setup_session(Transport transport) {
+  const bool interleaved = transport.type == Transport::Type::Interleaved;
+
+  udp::Socket socket{m_socket.get_executor()};
+  if (!interleaved) {
+    ErrorCode ec;
+    socket.open(udp::v4(), ec);
+    if (!ec) {
+      // any free port
+      socket.bind(udp::Endpoint(IpAddress(IPv4::any()), 0), ec);
+    }
+
+    if (ec) {
+      LOG_ERROR("Client {}: failed to create rtp socket: {}", m_id, ec.message());
+      return nullptr;
+    }
+  }
+
+  // NOTE: client might have reset the connection already
+  ErrorCode ec;
+  const auto remote = m_socket.remote_endpoint(ec);
+  if (ec) {
+    LOG_WARN("Client {}: failed to get remote address: {}", m_id, ec.message());
+    return nullptr;
+  }
+
+  // NOTE: interleaved session writes to the connection, so it uses the same strand,
+  //       UDP session is independent of the connection
+  Strand strand = interleaved ? m_strand : Strand(m_server.m_context.get_executor());
+  auto session = m_server.create_session(std::move(strand),
+                                         remote.address(),
+                                         transport,
+                                         std::move(socket),
+                                         interleaved ? weak_from_this() : std::weak_ptr<Connection>());
+  if (interleaved) {
+    m_sessions.push_back(session->id());
+  }
+
+  LOG_INFO("Client {}: session {} created", m_id, session->id());
+  return session;
+}
+
+SessionPtr Connection::find_session(Request& request) {
+  auto header = request.m_headers.get("Session");
+  if (!header) {
+    return nullptr;
+  }
+
+  return m_server.find_session(session_id(header->value));
+}
+
+void Connection::write(Segment segment) {
+  m_queued_bytes += segment.m_header_size + segment.m_payload.len();
+  m_queue.emplace_back(std::move(segment));
+  flush();
+}
+
+void Connection::flush() {
+  if (m_closed || m_writing != 0 || m_queue.empty()) {
+    return;
+  }
+
+  m_buffers.clear();
+  for (const auto& segment : m_queue) {
+    if (m_writing == MAX_WRITE_BATCH) {
+      break;
+    }
+
+    if (segment.m_header_size != 0) {
+      m_buffers.push_back(span(segment.m_header.data(), segment.m_header_size));
+    }
+    m_buffers.push_back(span(segment.m_payload));
+    ++m_writing;
+  }
+
+  asio::async_write(
+      m_socket,
+      m_buffers,
+      asio::bind_executor(m_strand, [this, self = shared_from_this()](const ErrorCode& ec, usize /* size */) {
+        if (m_closed) {
+          return;
+        }
+
+        if (ec) {
+          LOG_ERROR("Socket send error (Client {}): {}", m_id, ec.message());
+          close();
+          return;
+        }
+
+        for (usize i = 0; i < m_writing; ++i) {
+          const auto& segment = m_queue.front();
+          m_queued_bytes -= segment.m_header_size + segment.m_payload.len();
+          m_queue.pop_front();
+        }
+
+        m_writing = 0;
+        auto queue = send_queue(m_socket);
+        if (!queue.err()) {
+          m_unsent_bytes = queue->unsent;
+        }
+        flush();
+      }));
+}
+
+} // namespace shar::net::rtsp
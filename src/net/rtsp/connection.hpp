@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bytes_ref.hpp"
+#include "int.hpp"
+#include "metrics.hpp"
+#include "net/types.hpp"
+#include "header.hpp"
+#include "request.hpp"
+#include "response.hpp"
+#include "session.hpp"
+#include "transport.hpp"
+
+
+namespace shar::net::rtsp {
+
+class Server;
+
+// RTSP control connection. Sessions set up over it are kept in server's
+// session table, interleaved ones are closed along with the connection.
+// NOTE: all methods except constructor should be called on connection's strand
+class Connection : public std::enable_shared_from_this<Connection> {
+public:
+  Connection(Server& server, usize id, tcp::Socket socket);
+  Connection(const Connection&) = delete;
+  Connection(Connection&&) = delete;
+  Connection& operator=(const Connection&) = delete;
+  Connection& operator=(Connection&&) = delete;
+  ~Connection() = default;
+
+  const Strand& strand() const noexcept;
+
+  // bytes in kernel send buffer not sent yet, sampled after each write
+  // NOTE: thread-safe
+  usize unsent_bytes() const noexcept;
+
+  // start processing requests
+  void start();
+
+  void close();
+
+  // export TCP_INFO of the connection
+  void update_tcp_info();
+
+private:
+  friend class Session;
+
+  void receive();
+
+  // process all complete requests in input buffer,
+  // returns false if connection was closed
+  bool process_input();
+  Response process_request(Request request);
+
+  // pass interleaved packet sent by client to session it belongs to
+  void process_interleaved(u8 channel, BytesRef packet);
+
+  // returns nullptr if session socket could not be created
+  SessionPtr setup_session(Transport transport);
+
+  // returns session referenced by request, refreshing its timeout
+  SessionPtr find_session(Request& request);
+
+  // add segment to write queue and start writing if idle
+  void write(Segment segment);
+  void flush();
+
+  Server& m_server;
+  usize m_id;
+  Strand m_strand;
+  tcp::Socket m_socket;
+  bool m_closed{ false };
+
+  std::vector<u8> m_in;   // buffer for incoming messages, grows up to MAX_INPUT_SIZE
+  usize m_received_bytes; // how many bytes have we received
+
+  std::vector<u8> m_out;  // buffer for response serialization
+  std::string m_sdp;      // body of last DESCRIBE response
+
+  // NOTE: responses and interleaved packets share the connection,
+  //       so all writes go through the queue
+  std::deque<Segment> m_queue;
+  usize m_queued_bytes{ 0 };
+  usize m_writing{ 0 };             // number of segments at the front of queue being written
+  std::vector<ConstBuffer> m_buffers; // buffers of segments being written
+  std::atomic<usize> m_unsent_bytes{ 0 };
+
+  std::vector<Header> m_headers;    // list of headers, NOTE: Header is non-owning struct
+  std::vector<u8> m_headers_buffer; // buffer to store headers values
+
+  std::vector<std::string> m_sessions; // ids of interleaved sessions
+
+  Metric m_rtt;           // in microseconds
+  Metric m_cwnd;          // in segments
+  Metric m_retransmits;   // total segments retransmitted
+  Metric m_delivery_rate;
+};
+
+using ConnectionPtr = std::shared_ptr<Connection>;
+
+}
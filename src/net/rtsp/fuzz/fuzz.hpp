@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "int.hpp"
+
+// libFuzzer entry point, implemented by each fuzz target
+extern "C" int LLVMFuzzerTestOneInput(const shar::u8* data, shar::usize size);
+
+// invariant violations are reported as crashes, so fuzzer saves the input
+#define FUZZ_CHECK(cond)                                                     \
+  do {                                                                       \
+    if (!(cond)) {                                                           \
+      std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+                   #cond);                                                   \
+      std::abort();                                                          \
+    }                                                                        \
+  } while (false)
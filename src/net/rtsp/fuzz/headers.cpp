@@ -0,0 +1,26 @@
+#include <array>
+
+#include "fuzz.hpp"
+#include "net/rtsp/parser.hpp"
+
+
+using namespace shar;
+using namespace shar::net;
+
+extern "C" int LLVMFuzzerTestOneInput(const u8* data, usize size) {
+  const auto* begin = reinterpret_cast<const char*>(data);
+
+  std::array<rtsp::Header, 16> headers;
+  auto headers_size = rtsp::parse_headers(begin, size, rtsp::Headers{headers.data(), headers.size()});
+  if (!headers_size.err()) {
+    FUZZ_CHECK(*headers_size <= size);
+  }
+
+  if (auto header = rtsp::parse_header(begin, size); !header.err()) {
+    FUZZ_CHECK(header->name.len() + header->value.len() + 2 <= size);
+  }
+
+  rtsp::parse_version(begin, size);
+  rtsp::parse_status_code(begin, size);
+  return 0;
+}
@@ -0,0 +1,26 @@
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+#include "fuzz.hpp"
+
+
+// replaces libFuzzer's main when fuzz targets are built without it,
+// runs the target on each file passed in command line, e.g. to reproduce a crash
+int main(int argc, char* argv[]) {
+  for (int i = 1; i < argc; ++i) {
+    std::ifstream file{argv[i], std::ios::binary};
+    if (!file) {
+      std::cerr << "Failed to open " << argv[i] << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    const std::vector<shar::u8> data{std::istreambuf_iterator<char>(file),
+                                     std::istreambuf_iterator<char>()};
+    LLVMFuzzerTestOneInput(data.data(), data.size());
+    std::cout << argv[i] << ": ok" << std::endl;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,41 @@
+#include <array>
+
+#include "fuzz.hpp"
+#include "net/rtsp/request.hpp"
+
+
+using namespace shar;
+using namespace shar::net;
+
+static bool contains(BytesRef outer, BytesRef inner) {
+  return inner.data() >= outer.data() && inner.data() + inner.len() <= outer.data() + outer.len();
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const u8* data, usize size) {
+  const BytesRef input(data, size);
+
+  std::array<rtsp::Header, 16> headers;
+  rtsp::Request request{rtsp::Headers{headers.data(), headers.size()}};
+
+  auto request_size = request.parse(input);
+  if (request_size.err()) {
+    return 0;
+  }
+
+  FUZZ_CHECK(*request_size <= size);
+  FUZZ_CHECK(request.m_type.has_value());
+  FUZZ_CHECK(request.m_address.has_value() && contains(input, *request.m_address));
+  FUZZ_CHECK(request.m_version == 1 || request.m_version == 2);
+
+  // parsed headers reference the request itself
+  const BytesRef parsed(data, *request_size);
+  for (const auto& header : headers) {
+    if (!header.empty()) {
+      FUZZ_CHECK(contains(parsed, header.name));
+      FUZZ_CHECK(contains(parsed, header.value));
+    }
+  }
+
+  rtsp::Headers{headers.data(), headers.size()}.get("CSeq");
+  return 0;
+}
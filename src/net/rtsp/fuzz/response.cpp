@@ -0,0 +1,38 @@
+#include <array>
+#include <vector>
+
+#include "fuzz.hpp"
+#include "net/rtsp/response.hpp"
+
+
+using namespace shar;
+using namespace shar::net;
+
+extern "C" int LLVMFuzzerTestOneInput(const u8* data, usize size) {
+  std::array<rtsp::Header, 16> headers;
+  rtsp::Response response{rtsp::Headers{headers.data(), headers.size()}};
+
+  auto response_size = response.parse(BytesRef(data, size));
+  if (response_size.err()) {
+    return 0;
+  }
+
+  FUZZ_CHECK(*response_size <= size);
+  FUZZ_CHECK(response.status_code() >= 100 && response.status_code() <= 600);
+
+  // serialized response should be parsed back to the same status line and headers
+  std::vector<u8> buffer(size + 64);
+  auto serialized_size = response.serialize(buffer.data(), buffer.size());
+  if (serialized_size.err()) {
+    return 0;
+  }
+
+  std::array<rtsp::Header, 16> reparsed_headers;
+  rtsp::Response reparsed{rtsp::Headers{reparsed_headers.data(), reparsed_headers.size()}};
+  auto reparsed_size = reparsed.parse(BytesRef(buffer.data(), *serialized_size));
+  FUZZ_CHECK(!reparsed_size.err());
+  FUZZ_CHECK(reparsed.status_code() == response.status_code());
+  FUZZ_CHECK(reparsed.reason() == response.reason());
+  FUZZ_CHECK(reparsed_headers == headers);
+  return 0;
+}
@@ -0,0 +1,16 @@
+#include "fuzz.hpp"
+#include "net/rtsp/transport.hpp"
+
+
+using namespace shar;
+using namespace shar::net;
+
+extern "C" int LLVMFuzzerTestOneInput(const u8* data, usize size) {
+  auto transport = rtsp::parse_transport(BytesRef(data, size));
+  if (transport && transport->type == rtsp::Transport::Type::Interleaved) {
+    // channel numbers are sent in a single byte of interleaved header
+    FUZZ_CHECK(transport->rtp <= 255 && transport->rtcp <= 255);
+  }
+
+  return 0;
+}
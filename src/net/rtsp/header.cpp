@@ -4,9 +4,23 @@
 
 namespace shar::net::rtsp {
 
+static u8 to_lower(u8 c) noexcept {
+  return c >= 'A' && c <= 'Z' ? static_cast<u8>(c | 0x20) : c;
+}
+
+u32 hash_name(BytesRef name) noexcept {
+  // FNV-1a of lowercase name
+  u32 hash = 2166136261u;
+  for (u8 c : name) {
+    hash = (hash ^ to_lower(c)) * 16777619u;
+  }
+  return hash;
+}
+
 Header::Header(BytesRef n, BytesRef v)
     : name(std::move(n))
-    , value(std::move(v)) {}
+    , value(std::move(v))
+    , name_hash(hash_name(name)) {}
 
 bool Header::operator==(const Header &rhs) const {
   return name == rhs.name && value == rhs.value;
@@ -27,8 +41,13 @@ Header *Headers::end() {
 }
 
 std::optional<Header> Headers::get(BytesRef name) {
-  auto it = std::find_if(begin(), end(), [name](const auto &h) {
-    return h.name == name;
+  // NOTE: names are only compared if their hashes match
+  const u32 hash = hash_name(name);
+  auto it = std::find_if(begin(), end(), [name, hash](const auto &h) {
+    return h.name_hash == hash && h.name.len() == name.len() &&
+           std::equal(name.begin(), name.end(), h.name.begin(), [](u8 a, u8 b) {
+             return to_lower(a) == to_lower(b);
+           });
   });
 
   if (it == end()) {
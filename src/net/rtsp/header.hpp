@@ -3,6 +3,7 @@
 #include <optional>
 
 #include "bytes_ref.hpp"
+#include "int.hpp"
 
 
 namespace shar::net::rtsp {
@@ -22,8 +23,12 @@ struct Header {
 
   BytesRef name;
   BytesRef value;
+  u32 name_hash{ 0 }; // case-insensitive hash of |name|, see hash_name()
 };
 
+// case-insensitive hash of header name
+u32 hash_name(BytesRef name) noexcept;
+
 struct Headers {
   Headers(Header* ptr, usize size);
   Headers(const Headers&) = default;
@@ -31,6 +36,7 @@ struct Headers {
   Header* begin();
   Header* end();
 
+  // NOTE: header names are case-insensitive
   std::optional<Header> get(BytesRef name);
 
   Header* data{ nullptr };
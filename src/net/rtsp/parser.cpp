@@ -4,14 +4,117 @@
 
 #include <algorithm>
 #include <charconv>
+#include <cstring> // memchr
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SHAR_RTSP_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SHAR_RTSP_SSE2
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 namespace shar::net::rtsp {
 
+#if defined(SHAR_RTSP_AVX2) || defined(SHAR_RTSP_SSE2)
+static u32 count_trailing_zeros(u32 mask) noexcept {
+#if defined(_MSC_VER)
+  unsigned long index = 0;
+  _BitScanForward(&index, mask);
+  return static_cast<u32>(index);
+#else
+  return static_cast<u32>(__builtin_ctz(mask));
+#endif
+}
+#endif
+
+#if defined(SHAR_RTSP_AVX2)
+
+// checks 32 bytes at once, returns pointer to first byte
+// which was not checked if delimiter was not found
+static const char *find_delimiter_simd(const char *p, const char *end) noexcept {
+  const __m256i colon = _mm256_set1_epi8(':');
+  const __m256i cr = _mm256_set1_epi8('\r');
+
+  while (end - p >= 32) {
+    const auto bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    const auto matches = _mm256_or_si256(_mm256_cmpeq_epi8(bytes, colon),
+                                         _mm256_cmpeq_epi8(bytes, cr));
+    const auto mask = static_cast<u32>(_mm256_movemask_epi8(matches));
+    if (mask != 0) {
+      return p + count_trailing_zeros(mask);
+    }
+
+    p += 32;
+  }
+
+  return p;
+}
+
+#elif defined(SHAR_RTSP_SSE2)
+
+// checks 16 bytes at once, returns pointer to first byte
+// which was not checked if delimiter was not found
+static const char *find_delimiter_simd(const char *p, const char *end) noexcept {
+  const __m128i colon = _mm_set1_epi8(':');
+  const __m128i cr = _mm_set1_epi8('\r');
+
+  while (end - p >= 16) {
+    const auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    const auto matches = _mm_or_si128(_mm_cmpeq_epi8(bytes, colon),
+                                      _mm_cmpeq_epi8(bytes, cr));
+    const auto mask = static_cast<u32>(_mm_movemask_epi8(matches));
+    if (mask != 0) {
+      return p + count_trailing_zeros(mask);
+    }
+
+    p += 16;
+  }
+
+  return p;
+}
+
+#else
+
+static const char *find_delimiter_simd(const char *p, const char * /* end */) noexcept {
+  return p;
+}
+
+#endif
+
+// returns first ':' or '\r' in [begin, end) or |end| if there is none
+static const char *find_delimiter(const char *begin, const char *end) noexcept {
+  const char *p = find_delimiter_simd(begin, end);
+  while (p != end && *p != ':' && *p != '\r') {
+    ++p;
+  }
+  return p;
+}
+
+// returns first '\r' in [begin, end) or |end| if there is none
+static const char *find_cr(const char *begin, const char *end) noexcept {
+  if (begin == end) {
+    return end;
+  }
+
+  const void *p = std::memchr(begin, '\r', static_cast<usize>(end - begin));
+  return p ? static_cast<const char *>(p) : end;
+}
+
 ErrorOr<u8> parse_version(const char *begin, usize size) {
   if (size > 8) {
     FAIL(Error::InvalidProtocol);
   }
 
+  // NOTE: |begin| may be nullptr if there is no data
+  if (size == 0) {
+    FAIL(Error::NotEnoughData);
+  }
+
   int i = std::memcmp(begin, "RTSP/1.0", size);
   if ((size == 8) && i == 0) {
     return u8{1};
@@ -44,47 +147,68 @@ ErrorOr<Header> parse_header(const char *begin, usize size) {
 }
 
 ErrorOr<usize> parse_headers(const char *begin, usize size, Headers headers) {
-  const char *header_begin = begin;
   const char *end = begin + size;
-  auto header_end = find_line_ending(header_begin, size);
+  const char *line = begin;
   usize index = 0;
 
-  while (!header_end.err() && header_begin != *header_end) {
+  while (true) {
+    if (line == end) {
+      FAIL(Error::MissingCRLF);
+    }
+
+    // NOTE: end of name and end of line are found in a single pass
+    //       over the line, i.e. each byte of header block is visited once
+    const char *colon = find_delimiter(line, end);
+    const char *line_end = colon;
+    if (colon != end && *colon == ':') {
+      line_end = find_cr(colon + 1, end);
+    } else {
+      colon = nullptr;
+    }
 
-    if (*header_end == end) {
+    if (line_end == end - 1) {
       FAIL(Error::NotEnoughData);
     }
-    usize header_size = static_cast<usize>(*header_end - header_begin);
+    if (line_end != end && line_end[1] != '\n') {
+      FAIL(Error::MissingCRLF);
+    }
+
+    // empty line, end of headers
+    if (line_end == line) {
+      return static_cast<usize>(line - begin + 2);
+    }
+
+    if (line_end == end) {
+      FAIL(Error::NotEnoughData);
+    }
+
+    // same checks as in parse_header()
+    if (colon == nullptr || colon == line || line_end - colon <= 2 || colon[1] != ' ') {
+      FAIL(Error::InvalidHeader);
+    }
 
-    auto header = parse_header(header_begin, header_size);
-    TRY(header);
     if (index == headers.len) {
       FAIL(Error::ExcessHeaders);
     }
-    auto [key, value] = *header;
-    headers.data[index] = Header(std::move(key), std::move(value));
 
-    header_begin = *header_end + 2; // Move to first symbol after line_ending
-    header_end = find_line_ending(header_begin, static_cast<usize>(end - header_begin));
-    index++;
+    headers.data[index] = Header(BytesRef(line, colon), BytesRef(colon + 2, line_end));
+    line = line_end + 2; // move to first symbol after line ending
+    ++index;
   }
-
-  TRY(header_end);
-  if (*header_end == end) {
-    FAIL(Error::NotEnoughData);
-  }
-
-  return static_cast<usize>(header_begin - begin + 2);
 }
 
 ErrorOr<const char *> find_line_ending(const char *begin, usize size) {
+  if (size == 0) {
+    FAIL(Error::MissingCRLF);
+  }
+
   const char *end = begin + size;
   const char *it = std::find(begin, end, '\r');
 
   if (it == end - 1) {
     FAIL(Error::NotEnoughData);
   }
-  if (begin == end || (it != end && *it == '\r' && *(it + 1) != '\n')) {
+  if (it != end && *(it + 1) != '\n') {
     FAIL(Error::MissingCRLF);
   }
   return it;
@@ -12,6 +12,10 @@ namespace shar::net::rtsp {
 Request::Request(Headers headers) : m_headers(std::move(headers)) {}
 
 static ErrorOr<Request::Type> parse_type(const char* begin, usize size) {
+  if (size == 0) {
+    FAIL(Error::InvalidType);
+  }
+
   int i = 0;
   usize len = 0;
 
@@ -63,6 +67,9 @@ ErrorOr<usize> Request::parse(BytesRef bytes) {
   const char* current = bytes.char_ptr();
   const char* begin = current;
   const char* end = current + bytes.len();
+  if (current == end) {
+    FAIL(Error::NotEnoughData);
+  }
 
   const char* type_end = std::find(current, end, ' ');
 
@@ -158,6 +165,11 @@ ErrorOr<bool> Request::serialize(u8* dst, usize size) {
   TRY_SERIALIZE(serializer.write("RTSP/1.0\r\n"));
   //serialize headers
   for (usize i = 0; i < m_headers.len; ++i) {
+    // NOTE: parsed message has unused header slots
+    if (m_headers.data[i].empty()) {
+      continue;
+    }
+
     TRY_SERIALIZE(serializer.write(m_headers.data[i].name));
     TRY_SERIALIZE(serializer.write(": "));
     TRY_SERIALIZE(serializer.write(m_headers.data[i].value));
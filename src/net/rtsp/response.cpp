@@ -6,6 +6,7 @@
 #include <algorithm>
 #include <cassert>
 #include <charconv>
+#include <limits>
 
 namespace shar::net::rtsp {
 
@@ -41,6 +42,9 @@ ErrorOr<usize> Response::parse(BytesRef bytes) {
   const char *current = bytes.char_ptr();
   const char *begin = current;
   const char *end = begin + bytes.len();
+  if (current == end) {
+    FAIL(Error::NotEnoughData);
+  }
 
   const char *version_end = std::find(current, end, ' ');
   auto version = parse_version(current, static_cast<usize>(version_end - current));
@@ -112,6 +116,11 @@ ErrorOr<usize> Response::serialize(u8 *dst, usize size) {
   TRY_SERIALIZE(serializer.write("\r\n"));
   // serialize headers
   for (usize i = 0; i < m_headers.len; ++i) {
+    // NOTE: parsed message has unused header slots
+    if (m_headers.data[i].empty()) {
+      continue;
+    }
+
     TRY_SERIALIZE(serializer.write(m_headers.data[i].name));
     TRY_SERIALIZE(serializer.write(": "));
     TRY_SERIALIZE(serializer.write(m_headers.data[i].value));
@@ -0,0 +1,346 @@
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "net/types.hpp"
+#include "net/dns.hpp"
+#include "net/rtp/packet.hpp"
+#include "error.hpp"
+#include "response.hpp"
+#include "time.hpp"
+
+
+using namespace shar;
+using namespace shar::net;
+
+// RTSP load generator. Opens many sessions to RTSP server (e.g. shar
+// started with rtsp:// url) and reports how many of them actually
+// receive the stream, to find out how many viewers one machine can serve.
+
+// session is considered stalled if nothing was received for this long
+static const Milliseconds STALL_TIMEOUT{ 2000 };
+
+struct Session : std::enable_shared_from_this<Session> {
+  enum class State {
+    Connecting,
+    Describe,
+    Setup,
+    Play,
+    Streaming,
+    Failed
+  };
+
+  Session(IOContext& context, usize id, bool interleaved)
+    : m_id(id)
+    , m_interleaved(interleaved)
+    , m_control(context)
+    , m_rtp(context)
+    , m_in(64 * 1024)
+    , m_headers(16)
+  {}
+
+  void start(const tcp::Endpoint& server) {
+    m_url = "rtsp://" + server.address().to_string() + ":" + std::to_string(server.port()) + "/";
+    m_control.async_connect(server, [this, self = shared_from_this()](const ErrorCode& ec) {
+      if (ec) {
+        fail("connect", ec);
+        return;
+      }
+
+      m_state = State::Describe;
+      request("DESCRIBE", "Accept: application/sdp\r\n");
+      receive_control();
+    });
+  }
+
+  void request(const char* method, const std::string& headers) {
+    auto message = std::make_shared<std::string>(
+      std::string(method) + " " + m_url + " RTSP/1.0\r\n" +
+      "CSeq: " + std::to_string(++m_cseq) + "\r\n" + headers + "\r\n");
+
+    asio::async_write(m_control, span(message->data(), message->size()),
+                      [this, self = shared_from_this(), message](const ErrorCode& ec, usize) {
+                        if (ec) {
+                          fail("send", ec);
+                        }
+                      });
+  }
+
+  void receive_control() {
+    if (m_received == m_in.size()) {
+      fail("receive", make_error_code(std::errc::no_buffer_space));
+      return;
+    }
+
+    auto buffer = span(m_in.data() + m_received, m_in.size() - m_received);
+    m_control.async_receive(buffer, [this, self = shared_from_this()](const ErrorCode& ec, usize size) {
+      if (ec) {
+        fail("receive", ec);
+        return;
+      }
+
+      m_received += size;
+      if (!process_control()) {
+        return;
+      }
+
+      receive_control();
+    });
+  }
+
+  // returns false on failure
+  bool process_control() {
+    usize offset = 0;
+    while (offset != m_received) {
+      const u8* data = m_in.data() + offset;
+      const usize size = m_received - offset;
+
+      if (data[0] == '$') {
+        if (size < 4) {
+          break;
+        }
+
+        const usize packet_size = 4 + (static_cast<usize>(data[2]) << 8 | data[3]);
+        if (size < packet_size) {
+          break;
+        }
+
+        if (data[1] == 0) {
+          on_packet(BytesRef(data + 4, packet_size - 4));
+        }
+        offset += packet_size;
+        continue;
+      }
+
+      std::fill(m_headers.begin(), m_headers.end(), rtsp::Header());
+      rtsp::Response response{rtsp::Headers{m_headers.data(), m_headers.size()}};
+      auto response_size = response.parse(BytesRef(data, size));
+      if (auto e = response_size.err()) {
+        if (e == make_error_code(rtsp::Error::NotEnoughData)) {
+          break;
+        }
+
+        fail("parse", e);
+        return false;
+      }
+
+      usize body_size = 0;
+      if (auto length = response.headers().get("Content-Length")) {
+        std::from_chars(length->value.char_ptr(), length->value.char_ptr() + length->value.len(), body_size);
+      }
+
+      if (size - *response_size < body_size) {
+        break;
+      }
+
+      if (response.status_code() != 200) {
+        fail("request", make_error_code(std::errc::protocol_error));
+        return false;
+      }
+
+      if (auto session = response.headers().get("Session")) {
+        m_session.assign(session->value.char_ptr(), session->value.len());
+      }
+
+      on_response();
+      offset += *response_size + body_size;
+    }
+
+    m_received -= offset;
+    std::memmove(m_in.data(), m_in.data() + offset, m_received);
+    return true;
+  }
+
+  void on_response() {
+    switch (m_state) {
+      case State::Describe: {
+        m_state = State::Setup;
+        if (m_interleaved) {
+          request("SETUP", "Transport: RTP/AVP/TCP;unicast;interleaved=0-1\r\n");
+          return;
+        }
+
+        ErrorCode ec;
+        m_rtp.open(udp::v4(), ec);
+        if (!ec) {
+          m_rtp.bind(udp::Endpoint(IpAddress(IPv4::any()), 0), ec);
+        }
+        if (ec) {
+          fail("bind", ec);
+          return;
+        }
+
+        const auto port = m_rtp.local_endpoint(ec).port();
+        request("SETUP", "Transport: RTP/AVP;unicast;client_port=" + std::to_string(port) +
+                         "-" + std::to_string(port + 1) + "\r\n");
+        receive_rtp();
+        return;
+      }
+
+      case State::Setup:
+        m_state = State::Play;
+        request("PLAY", "Session: " + m_session + "\r\nRange: npt=0.000-\r\n");
+        return;
+
+      case State::Play:
+        m_state = State::Streaming;
+        m_last_packet = Clock::now();
+        return;
+
+      default:
+        return;
+    }
+  }
+
+  void receive_rtp() {
+    m_rtp.async_receive(span(m_datagram.data(), m_datagram.size()),
+                        [this, self = shared_from_this()](const ErrorCode& ec, usize size) {
+                          if (ec) {
+                            if (m_state != State::Failed) {
+                              fail("receive rtp", ec);
+                            }
+                            return;
+                          }
+
+                          on_packet(BytesRef(m_datagram.data(), size));
+                          receive_rtp();
+                        });
+  }
+
+  void on_packet(BytesRef bytes) {
+    if (bytes.len() < rtp::Packet::MIN_SIZE) {
+      return;
+    }
+
+    const u16 sequence = static_cast<u16>(bytes.data()[2] << 8 | bytes.data()[3]);
+    if (m_packets != 0) {
+      const u16 expected = static_cast<u16>(m_sequence + 1);
+      m_lost += static_cast<u16>(sequence - expected);
+    }
+
+    m_sequence = sequence;
+    m_packets += 1;
+    m_bytes += bytes.len();
+    m_last_packet = Clock::now();
+  }
+
+  void fail(const char* what, const ErrorCode& ec) {
+    if (m_state == State::Failed) {
+      return;
+    }
+
+    std::cerr << "Session " << m_id << ": " << what << " failed: " << ec.message() << std::endl;
+    m_state = State::Failed;
+
+    ErrorCode ignored;
+    m_control.close(ignored);
+    m_rtp.close(ignored);
+  }
+
+  usize m_id;
+  bool m_interleaved;
+  State m_state{ State::Connecting };
+  std::string m_url;
+  std::string m_session;
+  usize m_cseq{ 0 };
+
+  tcp::Socket m_control;
+  udp::Socket m_rtp;
+  std::vector<u8> m_in;
+  usize m_received{ 0 };
+  std::vector<rtsp::Header> m_headers;
+  alignas(u32) std::array<u8, 2048> m_datagram;
+
+  usize m_bytes{ 0 };
+  usize m_packets{ 0 };
+  usize m_lost{ 0 };
+  u16 m_sequence{ 0 };
+  TimePoint m_last_packet;
+};
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    std::cout << "Usage: rtspload <address> <port> [sessions=100] [tcp|udp] [seconds=30]" << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  const char* hostname = argv[1];
+  const auto port = static_cast<Port>(std::stoi(argv[2]));
+  const usize count = argc > 3 ? static_cast<usize>(std::stoul(argv[3])) : 100;
+  const bool interleaved = argc > 4 ? std::string(argv[4]) != "udp" : true;
+  const usize duration = argc > 5 ? static_cast<usize>(std::stoul(argv[5])) : 30;
+
+  try {
+    auto address = dns::resolve(hostname, port);
+    if (auto e = address.err()) {
+      std::cerr << "Failed to resolve " << hostname << ':' << e.message() << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    IOContext context;
+    const tcp::Endpoint server{ *address, port };
+
+    std::vector<std::shared_ptr<Session>> sessions;
+    for (usize i = 0; i < count; ++i) {
+      sessions.push_back(std::make_shared<Session>(context, i, interleaved));
+      sessions.back()->start(server);
+    }
+
+    std::vector<usize> last_bytes(count, 0);
+    for (usize second = 1; second <= duration; ++second) {
+      context.run_for(Seconds(1));
+
+      const auto now = Clock::now();
+      usize streaming = 0;
+      usize stalled = 0;
+      usize failed = 0;
+      usize lost = 0;
+      usize total = 0;
+      usize slowest = std::numeric_limits<usize>::max();
+
+      for (usize i = 0; i < count; ++i) {
+        const auto& session = *sessions[i];
+        const usize rate = session.m_bytes - last_bytes[i];
+        last_bytes[i] = session.m_bytes;
+        lost += session.m_lost;
+
+        if (session.m_state == Session::State::Failed) {
+          ++failed;
+          continue;
+        }
+
+        if (session.m_state != Session::State::Streaming) {
+          continue;
+        }
+
+        ++streaming;
+        total += rate;
+        slowest = std::min(slowest, rate);
+        if (now - session.m_last_packet > STALL_TIMEOUT) {
+          ++stalled;
+        }
+      }
+
+      std::cout << second << "s: "
+                << streaming << "/" << count << " streaming, "
+                << stalled << " stalled, "
+                << failed << " failed, "
+                << lost << " packets lost, "
+                << total * 8 / (1024 * 1024) << " Mbit/s total, "
+                << (streaming != 0 ? slowest * 8 / 1024 : 0) << " kbit/s slowest"
+                << std::endl;
+    }
+  }
+  catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,119 @@
+#include "sdp.hpp"
+
+#include "annexb.hpp"
+
+#include <algorithm>
+
+
+namespace shar::net::rtsp {
+
+static const u8 NAL_TYPE_MASK = 0b00011111;
+static const u8 NAL_TYPE_IDR = 5;
+static const u8 NAL_TYPE_SPS = 7;
+static const u8 NAL_TYPE_PPS = 8;
+
+static void append_base64(std::string& out, BytesRef bytes) {
+  static const char ALPHABET[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+  const u8* p = bytes.begin();
+  usize n = bytes.len();
+  for (; n >= 3; p += 3, n -= 3) {
+    const u32 v = static_cast<u32>(p[0]) << 16 | static_cast<u32>(p[1]) << 8 | p[2];
+    out += ALPHABET[(v >> 18) & 0x3f];
+    out += ALPHABET[(v >> 12) & 0x3f];
+    out += ALPHABET[(v >> 6) & 0x3f];
+    out += ALPHABET[v & 0x3f];
+  }
+
+  if (n != 0) {
+    const u32 v = static_cast<u32>(p[0]) << 16 | (n == 2 ? static_cast<u32>(p[1]) << 8 : 0);
+    out += ALPHABET[(v >> 18) & 0x3f];
+    out += ALPHABET[(v >> 12) & 0x3f];
+    out += n == 2 ? ALPHABET[(v >> 6) & 0x3f] : '=';
+    out += '=';
+  }
+}
+
+static void append_hex(std::string& out, BytesRef bytes) {
+  static const char DIGITS[] = "0123456789ABCDEF";
+  for (u8 byte : bytes) {
+    out += DIGITS[byte >> 4];
+    out += DIGITS[byte & 0xf];
+  }
+}
+
+static bool assign(std::vector<u8>& dst, BytesRef src) {
+  if (dst.size() == src.len() && std::equal(src.begin(), src.end(), dst.begin())) {
+    return false;
+  }
+
+  dst.assign(src.begin(), src.end());
+  return true;
+}
+
+bool Sdp::update(BytesRef unit) {
+  bool changed = false;
+
+  NalIterator it{unit};
+  while (auto nal = it.next()) {
+    const u8 type = nal.data()[0] & NAL_TYPE_MASK;
+    if (type == NAL_TYPE_SPS) {
+      changed |= assign(m_sps, nal);
+    } else if (type == NAL_TYPE_PPS) {
+      changed |= assign(m_pps, nal);
+    } else if (type == NAL_TYPE_IDR) {
+      // parameter sets precede slices, no need to scan the rest
+      break;
+    }
+  }
+
+  m_changed |= changed;
+  return changed;
+}
+
+BytesRef Sdp::generate(const std::string& address, bool ipv6, usize fps) {
+  if (!m_changed && address == m_address) {
+    return BytesRef(m_text.data(), m_text.size());
+  }
+
+  m_changed = false;
+  m_address = address;
+  ++m_version;
+
+  const std::string network = ipv6 ? "IN IP6 " : "IN IP4 ";
+
+  std::string& text = m_text;
+  text.clear();
+  text += "v=0\r\n";
+  text += "o=- 1815849 " + std::to_string(m_version) + " " + network + address + "\r\n";
+  text += "s=shar\r\n";
+  text += "c=" + network + address + "\r\n";
+  text += "t=0 0\r\n";
+  text += "a=control:*\r\n";
+  text += "a=range:npt=0-\r\n";
+  // NOTE: ports are negotiated in SETUP
+  text += "m=video 0 RTP/AVP 96\r\n";
+  text += "a=rtpmap:96 H264/90000\r\n";
+  text += "a=fmtp:96 packetization-mode=1";
+
+  if (m_sps.size() >= 4) {
+    // profile_idc, constraint flags and level_idc
+    text += ";profile-level-id=";
+    append_hex(text, BytesRef(m_sps.data() + 1, 3));
+  }
+
+  if (!m_sps.empty() && !m_pps.empty()) {
+    text += ";sprop-parameter-sets=";
+    append_base64(text, BytesRef(m_sps.data(), m_sps.size()));
+    text += ',';
+    append_base64(text, BytesRef(m_pps.data(), m_pps.size()));
+  }
+
+  text += "\r\n";
+  text += "a=framerate:" + std::to_string(fps) + "\r\n";
+
+  return BytesRef(m_text.data(), m_text.size());
+}
+
+}
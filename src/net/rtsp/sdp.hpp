@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "bytes_ref.hpp"
+#include "int.hpp"
+
+
+namespace shar::net::rtsp {
+
+// Session description (RFC 4566) of H264 stream (RFC 6184 Section 8.2.1)
+// NOTE: encoder sends parameter sets in-band, so they are taken from IDR units
+class Sdp {
+public:
+  Sdp() = default;
+
+  // look for SPS and PPS in access unit (Annex B byte stream)
+  // returns true if they have changed, e.g. because encoder was reopened
+  bool update(BytesRef unit);
+
+  // returns SDP for stream served from |address|
+  // NOTE: cached until parameter sets or |address| change
+  BytesRef generate(const std::string& address, bool ipv6, usize fps);
+
+private:
+  std::vector<u8> m_sps;
+  std::vector<u8> m_pps;
+
+  std::string m_address; // address used for |m_text|
+  usize m_version{0};    // incremented every time description changes
+  bool m_changed{true};  // true if |m_text| should be regenerated
+  std::string m_text;
+};
+
+}
@@ -1,24 +1,40 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <thread>
 #include <vector>
-#include <cstdlib> // usize
-#include <unordered_map>
 
 #include "context.hpp"
 #include "cancellation.hpp"
+#include "metrics.hpp"
 #include "net/sender.hpp"
 #include "net/types.hpp"
-#include "response.hpp"
-#include "request.hpp"
+#include "net/socket_profile.hpp"
+#include "net/rtp/packetizer.hpp"
+#include "connection.hpp"
+#include "sdp.hpp"
+#include "session.hpp"
+#include "session_table.hpp"
 
 
 namespace shar::net::rtsp {
 
 using codec::ffmpeg::Unit;
 
+// RTSP server, serves the stream to any number of clients.
+// Connections are processed by pool of io threads, each connection
+// is bound to its own strand. Units are packetized once and shared
+// between all sessions. Sessions are kept in the session table until
+// TEARDOWN or timeout, independently of connections they were set up on.
 class Server
   : public IPacketSender
   , protected Context
 {
 public:
+  // seconds of inactivity after which session is closed
+  static const usize SESSION_TIMEOUT = 60;
+
   Server(Context context, IpAddress ip, Port port);
   Server(const Server&) = delete;
   Server(Server&&) = delete;
@@ -30,52 +46,61 @@ public:
   void shutdown() override;
 
 private:
-  struct Session {
-    usize number; // identifier of the session
-    IpAddress ip; // client ip address
-    Port rtp;     // client rtp port
-    Port rtcp;    // client rtcp port
-  };
-
-  struct Client {
-    explicit Client(tcp::Socket&& socket);
-
-    tcp::Socket m_socket;   // client socket
+  friend class Connection;
+  friend class Session;
 
-    std::vector<u8> m_in;   // buffer for incoming messages
-    usize m_received_bytes; // how many bytes have we received
-
-    std::vector<u8> m_out;  // buffer for outgoing messages
-    usize m_response_size;  // how many bytes we have to send
-    usize m_sent_bytes;     // how many bytes we have already sent
+  void start_accepting();
 
-    std::vector<Header> m_headers;    // list of headers, NOTE: Header is non-owning struct
-    std::vector<u8> m_headers_buffer; // buffer to store headers values
+  // remove expired sessions and closed connections every second
+  void start_reaping();
 
-    std::optional<Session> m_session;
-  };
+  // split unit into rtp payloads and pass them to all sessions
+  void stream(Unit unit);
 
-  using ClientId = usize;
-  using Clients = std::unordered_map<ClientId, Client>;
-  using ClientPos = Clients::iterator;
+  // NOTE: session table methods are thread-safe
+  SessionPtr create_session(Strand strand,
+                            IpAddress ip,
+                            Transport transport,
+                            udp::Socket socket,
+                            std::weak_ptr<Connection> connection);
 
-  void start_accepting();
-  void receive_request(ClientPos client);
-  void send_response(ClientPos client);
-  void disconnect(ClientPos client);
+  // returns session with |id| and refreshes its timeout
+  SessionPtr find_session(BytesRef id);
 
-  void setup_session(ClientPos client, Port rtp, Port rtcp);
-  void teardown_session(ClientPos client);
+  // returns false if there is no session with |id|
+  bool remove_session(BytesRef id);
 
-  Response process_request(ClientPos client, Request request);
+  // returns SDP of the stream served from |address|
+  // NOTE: thread-safe
+  std::string describe(const IpAddress& address);
 
   Cancellation   m_running;
 
   IpAddress      m_ip;
   Port           m_port;
   IOContext      m_context;
-  tcp::Socket    m_current_socket;
   tcp::Acceptor  m_acceptor;
-  Clients        m_clients;
+  Timer          m_timer;
+  std::vector<std::thread> m_threads;
+
+  std::mutex     m_connections_mutex;
+  std::vector<std::weak_ptr<Connection>> m_connections;
+  usize          m_next_id{ 0 };
+
+  std::mutex     m_sessions_mutex;
+  SessionTable<Session> m_sessions;
+
+  std::mutex     m_sdp_mutex;
+  Sdp            m_sdp;
+
+  rtp::Packetizer m_packetizer;
+  SocketProfile  m_profile;      // applied to accepted connections
+
+  Metric         m_dropped;     // units dropped for slow clients
+  Metric         m_connected;   // number of active connections
+  Metric         m_active;      // number of active sessions
+  Metric         m_unsent;      // bytes in kernel send buffers of all connections
+  Metric         m_reports;     // RTCP receiver reports from interleaved clients
 };
-}
\ No newline at end of file
+
+}
@@ -0,0 +1,264 @@
+#include "session.hpp"
+
+#include "connection.hpp"
+#include "server.hpp"
+#include "net/rtcp/receiver_report.hpp"
+#include "net/rtcp/sender_report.hpp"
+
+#include <array>
+#include <cstring>
+
+
+namespace shar::net::rtsp {
+
+// if more than MAX_QUEUED_BYTES are waiting to be sent to interleaved client,
+// units are dropped until next IDR
+static const usize MAX_QUEUED_BYTES = 1024 * 1024;
+
+// interleaved sessions send RTCP SR after the first unit sent once this interval passes
+static const Milliseconds REPORT_INTERVAL{ 1000 };
+
+static const double CLOCK_RATE = 90000.0;
+
+// seconds between NTP (1900) and unix (1970) epochs
+static const u64 NTP_OFFSET = 2208988800;
+
+// RTCP SR without report blocks, sent after interleaved header
+struct Report {
+  alignas(u32) std::array<u8, rtcp::SenderReport::MIN_SIZE> m_data{};
+};
+
+static u64 ntp_now() {
+  const auto since_epoch = std::chrono::duration_cast<Microseconds>(SystemClock::now().time_since_epoch());
+  const u64 us = static_cast<u64>(since_epoch.count());
+  const u64 seconds = us / 1'000'000 + NTP_OFFSET;
+  const u64 fraction = ((us % 1'000'000) << 32) / 1'000'000;
+  return (seconds << 32) | fraction;
+}
+
+Session::Session(Server& server,
+                 std::string id,
+                 Strand strand,
+                 IpAddress ip,
+                 Transport transport,
+                 udp::Socket socket,
+                 std::weak_ptr<Connection> connection,
+                 u16 sequence,
+                 u32 stream_id)
+    : m_server(server)
+    , m_id(std::move(id))
+    , m_strand(std::move(strand))
+    , m_ip(ip)
+    , m_transport(transport)
+    , m_socket(std::move(socket))
+    , m_connection(std::move(connection))
+    , m_sequence(sequence)
+    , m_stream_id(stream_id) {}
+
+const std::string& Session::id() const noexcept {
+  return m_id;
+}
+
+const Strand& Session::strand() const noexcept {
+  return m_strand;
+}
+
+const Transport& Session::transport() const noexcept {
+  return m_transport;
+}
+
+u32 Session::stream_id() const noexcept {
+  return m_stream_id;
+}
+
+Port Session::server_port() const {
+  ErrorCode ec;
+  return m_socket.local_endpoint(ec).port();
+}
+
+bool Session::interleaved() const noexcept {
+  return m_transport.type == Transport::Type::Interleaved;
+}
+
+bool Session::connected() const noexcept {
+  return interleaved() && !m_connection.expired();
+}
+
+void Session::play() noexcept {
+  m_playing = true;
+}
+
+void Session::send(const PacketsPtr& packets) {
+  if (!m_playing) {
+    return;
+  }
+
+  const bool interleaved = this->interleaved();
+  ConnectionPtr connection;
+  if (interleaved) {
+    // NOTE: session shares connection's strand
+    connection = m_connection.lock();
+    if (!connection || connection->m_closed) {
+      return;
+    }
+  }
+
+  const usize queued = interleaved ? connection->m_queued_bytes : 0;
+  if (interleaved && !m_waiting_idr && queued > MAX_QUEUED_BYTES) {
+    LOG_WARN("Session {} is too slow, dropping units until next IDR", m_id);
+    m_waiting_idr = true;
+  }
+
+  // NOTE: stream can't be decoded without IDR
+  if (m_waiting_idr) {
+    // slow client should drain its queue before it gets IDR
+    const bool drained = queued < MAX_QUEUED_BYTES / 2;
+    if (!packets->m_idr || !drained) {
+      m_server.m_dropped += 1;
+      return;
+    }
+
+    m_waiting_idr = false;
+  }
+
+  const udp::Endpoint endpoint{m_ip, m_transport.rtp};
+  for (usize i = 0; i < packets->m_ends.size(); ++i) {
+    Segment segment;
+    write_header(segment, *packets, i, interleaved);
+    ++m_packets_sent;
+    m_bytes_sent += static_cast<u32>(segment.m_payload.len());
+
+    if (interleaved) {
+      // NOTE: payload is shared, not copied
+      segment.m_owner = packets;
+      connection->write(std::move(segment));
+      continue;
+    }
+
+    const u8* header = segment.m_header.data() + Segment::INTERLEAVED_HEADER_SIZE;
+    const std::array<ConstBuffer, 2> buffers = {
+      span(header, rtp::Packet::MIN_SIZE),
+      span(segment.m_payload)
+    };
+
+    ErrorCode ec;
+    m_socket.send_to(buffers, endpoint, 0, ec);
+    if (ec) {
+      LOG_ERROR("Session {}: failed to send rtp packet: {}", m_id, ec.message());
+      return;
+    }
+  }
+
+  // NOTE: UDP sessions have no rtcp socket, so they don't send reports
+  if (interleaved && Clock::now() >= m_next_report) {
+    connection->write(make_report(packets->m_timestamp));
+  }
+}
+
+void Session::on_rtcp(u8* data, usize size) {
+  rtcp::Header header{data, size};
+  while (header.valid() && header.packet_size() <= header.size()) {
+    if (header.packet_type() == rtcp::PacketType::RECEIVER_REPORT) {
+      rtcp::ReceiverReport report{header.data(), header.packet_size()};
+      if (report.valid()) {
+        // NOTE: receiver may report several streams, pick ours
+        for (usize i = 0; i < report.nblocks(); ++i) {
+          auto block = report.block(i);
+          if (block.valid() && block.stream_id() == m_stream_id) {
+            on_report(block);
+          }
+        }
+      }
+    }
+
+    header = header.next();
+  }
+}
+
+void Session::write_header(Segment& segment, const Packets& packets, usize index, bool interleaved) {
+  const usize begin = index == 0 ? 0 : packets.m_ends[index - 1];
+  const usize end = packets.m_ends[index];
+  segment.m_payload = BytesRef(packets.m_data.data() + begin, packets.m_data.data() + end);
+
+  u8* header = segment.m_header.data() + Segment::INTERLEAVED_HEADER_SIZE;
+  std::memset(header, 0, rtp::Packet::MIN_SIZE);
+
+  rtp::Packet packet(header, rtp::Packet::MIN_SIZE);
+  packet.set_version(2);
+  packet.set_has_padding(false);
+  packet.set_has_extensions(false);
+  packet.set_contributors_count(0);
+  packet.set_marked(index + 1 == packets.m_ends.size()); // last packet of access unit
+  packet.set_payload_type(96);
+  packet.set_sequence(m_sequence++);
+  packet.set_timestamp(packets.m_timestamp);
+  packet.set_stream_id(m_stream_id);
+
+  if (!interleaved) {
+    return;
+  }
+
+  const usize size = rtp::Packet::MIN_SIZE + segment.m_payload.len();
+  segment.m_header[0] = Segment::INTERLEAVED_MAGIC;
+  segment.m_header[1] = static_cast<u8>(m_transport.rtp);
+  segment.m_header[2] = static_cast<u8>(size >> 8);
+  segment.m_header[3] = static_cast<u8>(size & 0xff);
+  segment.m_header_size = Segment::INTERLEAVED_HEADER_SIZE + rtp::Packet::MIN_SIZE;
+}
+
+Segment Session::make_report(u32 timestamp) {
+  const auto report = std::make_shared<Report>();
+  const u64 ntp = ntp_now();
+
+  rtcp::SenderReport sr{report->m_data.data(), report->m_data.size()};
+  sr.set_version(2);
+  sr.set_has_padding(false);
+  sr.set_nblocks(0);
+  sr.set_packet_type(rtcp::PacketType::SENDER_REPORT);
+  sr.set_length(rtcp::SenderReport::NWORDS - 1);
+  sr.set_stream_id(m_stream_id);
+  sr.set_ntp_timestamp(ntp);
+  // NOTE: report is sent right after the unit, so they are sampled at the same time
+  sr.set_rtp_timestamp(timestamp);
+  sr.set_npackets(m_packets_sent);
+  sr.set_nbytes(m_bytes_sent);
+
+  Segment segment;
+  const usize size = report->m_data.size();
+  segment.m_header[0] = Segment::INTERLEAVED_MAGIC;
+  segment.m_header[1] = static_cast<u8>(m_transport.rtcp);
+  segment.m_header[2] = static_cast<u8>(size >> 8);
+  segment.m_header[3] = static_cast<u8>(size & 0xff);
+  segment.m_header_size = Segment::INTERLEAVED_HEADER_SIZE;
+  segment.m_payload = BytesRef(report->m_data.data(), report->m_data.data() + size);
+  segment.m_owner = report;
+
+  const auto now = Clock::now();
+  m_last_report = static_cast<u32>(ntp >> 16);
+  m_last_report_time = now;
+  m_next_report = now + REPORT_INTERVAL;
+  return segment;
+}
+
+Microseconds Session::rtt() const noexcept {
+  return m_rtt;
+}
+
+void Session::on_report(const rtcp::Block& block) {
+  m_server.m_reports += 1;
+
+  // round trip time (RFC 3550 Section 6.4.1), DLSR is in 1/65536 seconds
+  // NOTE: only reports of the last SR are used, older SR send times are not kept
+  if (m_last_report != 0 && block.last_sender_report_timestamp() == m_last_report) {
+    const auto delay = Microseconds(u64{ block.delay_since_last_sender_report() } * 1'000'000 / 65536);
+    const auto elapsed = std::chrono::duration_cast<Microseconds>(Clock::now() - m_last_report_time);
+    if (elapsed > delay) {
+      m_rtt = elapsed - delay;
+    }
+  }
+
+  LOG_DEBUG("Session {}: lost {}/256, jitter {:.1f}ms, rtt {}us",
+            m_id, block.fraction_lost(), block.jitter() * 1000.0 / CLOCK_RATE, m_rtt.count());
+}
+
+} // namespace shar::net::rtsp
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bytes_ref.hpp"
+#include "int.hpp"
+#include "net/types.hpp"
+#include "net/rtp/packet.hpp"
+#include "net/rtcp/block.hpp"
+#include "time.hpp"
+#include "transport.hpp"
+
+
+namespace shar::net::rtsp {
+
+class Connection;
+class Server;
+
+// access unit split into RTP payloads, shared by all sessions
+struct Packets {
+  std::vector<u8> m_data;    // payloads of all packets
+  std::vector<usize> m_ends; // end of each payload in |m_data|
+  u32 m_timestamp{ 0 };
+  bool m_idr{ false };
+};
+
+using PacketsPtr = std::shared_ptr<const Packets>;
+
+// chunk of data queued for sending over RTSP connection,
+// |m_header| is sent before |m_payload|
+struct Segment {
+  static const u8 INTERLEAVED_MAGIC = '$';
+  static const usize INTERLEAVED_HEADER_SIZE = 4;
+
+  // NOTE: rtp header is placed right after interleaved header, so it is 4-byte aligned
+  alignas(u32) std::array<u8, INTERLEAVED_HEADER_SIZE + rtp::Packet::MIN_SIZE> m_header;
+  usize m_header_size{ 0 };
+  BytesRef m_payload;
+  std::shared_ptr<const void> m_owner; // keeps |m_payload| alive
+};
+
+// RTSP session (RFC 2326 Section 3).
+// UDP sessions outlive connection they were created on and are kept alive
+// by requests with their id, interleaved sessions are bound to their
+// connection and share its strand. They also send RTCP SRs on the rtcp
+// channel and get client reports from the connection.
+// NOTE: send() should be called on session's strand
+class Session {
+public:
+  // |socket| should be opened for UDP transport,
+  // |connection| is only used by interleaved session
+  Session(Server& server,
+          std::string id,
+          Strand strand,
+          IpAddress ip,
+          Transport transport,
+          udp::Socket socket,
+          std::weak_ptr<Connection> connection,
+          u16 sequence,
+          u32 stream_id);
+  Session(const Session&) = delete;
+  Session(Session&&) = delete;
+  Session& operator=(const Session&) = delete;
+  Session& operator=(Session&&) = delete;
+  ~Session() = default;
+
+  const std::string& id() const noexcept;
+  const Strand& strand() const noexcept;
+  const Transport& transport() const noexcept;
+  u32 stream_id() const noexcept;
+  Port server_port() const;
+  bool interleaved() const noexcept;
+
+  // true if session is interleaved and its connection is still open
+  bool connected() const noexcept;
+
+  void play() noexcept;
+
+  // send unit to client if session is in playing state
+  void send(const PacketsPtr& packets);
+
+  // process RTCP packets received on interleaved rtcp channel
+  // NOTE: |data| should be 4-byte aligned
+  void on_rtcp(u8* data, usize size);
+
+  // RTCP SR queued after the unit with rtp |timestamp|,
+  // its send time is kept to compute round trip time
+  // NOTE: called by send(), public for tests
+  Segment make_report(u32 timestamp);
+
+  // round trip time from the last receiver report, 0 if unknown
+  Microseconds rtt() const noexcept;
+
+private:
+  // fill rtp (and interleaved, if |interleaved|) header of |segment|
+  void write_header(Segment& segment, const Packets& packets, usize index, bool interleaved);
+
+  void on_report(const rtcp::Block& block);
+
+  Server& m_server;
+  std::string m_id;
+  Strand m_strand;
+
+  IpAddress m_ip;          // client ip address
+  Transport m_transport;   // client ports or interleaved channels
+  udp::Socket m_socket;    // socket rtp packets are sent from, not used if interleaved
+  std::weak_ptr<Connection> m_connection; // connection of interleaved session
+
+  u16 m_sequence;          // rtp sequence number
+  u32 m_stream_id;         // SSRC
+  std::atomic<bool> m_playing{ false }; // true if PLAY request was received
+  bool m_waiting_idr{ true };           // true until next IDR is sent to client
+
+  // sender report state, only used by interleaved session
+  u32 m_packets_sent{ 0 };   // wrap around as in RTCP SR
+  u32 m_bytes_sent{ 0 };     // payload bytes
+  TimePoint m_next_report;
+  u32 m_last_report{ 0 };    // middle 32 bits of NTP timestamp of last SR
+  TimePoint m_last_report_time;
+  Microseconds m_rtt{ 0 };   // round trip time from last receiver report
+};
+
+using SessionPtr = std::shared_ptr<Session>;
+
+}
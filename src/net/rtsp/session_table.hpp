@@ -0,0 +1,142 @@
+#pragma once
+
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "bytes_ref.hpp"
+#include "int.hpp"
+
+
+namespace shar::net::rtsp {
+
+// RTSP sessions indexed by session id.
+// Session expires if it wasn't accessed for |timeout| ticks. Expiration
+// is tracked by timer wheel with slot per tick, so refreshing a session
+// is O(1) and each tick only visits sessions that might have expired.
+// NOTE: not thread-safe
+template <typename T>
+class SessionTable {
+public:
+  using Ptr = std::shared_ptr<T>;
+
+  explicit SessionTable(usize timeout)
+      : m_timeout(timeout)
+      , m_wheel(timeout + 1) {}
+
+  // returns random number from OS entropy source
+  u32 random() {
+    return m_random();
+  }
+
+  // returns unique unpredictable session id, 16 hex digits
+  std::string generate_id() {
+    static const char DIGITS[] = "0123456789abcdef";
+
+    std::string id(16, '0');
+    do {
+      const u64 value = static_cast<u64>(random()) << 32 | random();
+      for (usize i = 0; i < id.size(); ++i) {
+        id[i] = DIGITS[(value >> (4 * i)) & 0xf];
+      }
+    } while (m_sessions.count(id) != 0);
+
+    return id;
+  }
+
+  void insert(const std::string& id, Ptr session) {
+    const usize deadline = m_tick + m_timeout;
+    m_sessions[id] = Entry{std::move(session), deadline};
+    m_wheel[deadline % m_wheel.size()].push_back(id);
+  }
+
+  // returns session with |id| and postpones its expiration
+  Ptr find(BytesRef id) {
+    auto it = m_sessions.find(std::string(id.char_ptr(), id.len()));
+    if (it == m_sessions.end()) {
+      return nullptr;
+    }
+
+    it->second.deadline = m_tick + m_timeout;
+    return it->second.session;
+  }
+
+  Ptr remove(BytesRef id) {
+    auto it = m_sessions.find(std::string(id.char_ptr(), id.len()));
+    if (it == m_sessions.end()) {
+      return nullptr;
+    }
+
+    // NOTE: id is removed from the wheel when its slot is visited
+    auto session = std::move(it->second.session);
+    m_sessions.erase(it);
+    return session;
+  }
+
+  // advance timer wheel by one tick and remove expired sessions,
+  // sessions for which |keep| returns true are refreshed instead
+  template <typename F>
+  std::vector<Ptr> tick(F keep) {
+    ++m_tick;
+
+    std::vector<Ptr> expired;
+    auto ids = std::move(m_wheel[m_tick % m_wheel.size()]);
+    m_wheel[m_tick % m_wheel.size()].clear();
+
+    for (auto& id : ids) {
+      auto it = m_sessions.find(id);
+      if (it == m_sessions.end()) {
+        continue; // removed
+      }
+
+      auto& entry = it->second;
+      if (entry.deadline <= m_tick) {
+        if (keep(*entry.session)) {
+          entry.deadline = m_tick + m_timeout;
+        } else {
+          expired.push_back(std::move(entry.session));
+          m_sessions.erase(it);
+          continue;
+        }
+      }
+
+      // session was refreshed, move it to the slot of its new deadline
+      m_wheel[entry.deadline % m_wheel.size()].push_back(std::move(id));
+    }
+
+    return expired;
+  }
+
+  std::vector<Ptr> tick() {
+    return tick([](const T&) { return false; });
+  }
+
+  template <typename F>
+  void for_each(F f) const {
+    for (const auto& [id, entry] : m_sessions) {
+      f(entry.session);
+    }
+  }
+
+  usize size() const noexcept {
+    return m_sessions.size();
+  }
+
+private:
+  struct Entry {
+    Ptr session;
+    usize deadline; // tick at which session expires
+  };
+
+  usize m_timeout;
+  usize m_tick{ 0 };
+  std::unordered_map<std::string, Entry> m_sessions;
+  std::vector<std::vector<std::string>> m_wheel; // ids of sessions by deadline
+
+  // NOTE: std::random_device reads from OS CSPRNG on all supported platforms
+  std::random_device m_random;
+};
+
+}
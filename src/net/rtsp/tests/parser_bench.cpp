@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <array>
+#include <iterator> // size
+#include <string>
+#include <vector>
+
+#include "int.hpp"
+#include "net/rtsp/request.hpp"
+#include "net/rtsp/response.hpp"
+#include "net/rtsp/transport.hpp"
+
+// clang-format off
+#include "disable_warnings_push.hpp"
+#include <benchmark/benchmark.h>
+#include "disable_warnings_pop.hpp"
+// clang-format on
+
+
+using namespace shar;
+using namespace shar::net;
+
+// requests of a typical session as sent by ffmpeg / VLC
+static const char* REQUESTS[] = {
+  "OPTIONS rtsp://192.168.1.10:1337/ RTSP/1.0\r\n"
+  "CSeq: 1\r\n"
+  "User-Agent: Lavf58.29.100\r\n"
+  "\r\n",
+
+  "DESCRIBE rtsp://192.168.1.10:1337/ RTSP/1.0\r\n"
+  "Accept: application/sdp\r\n"
+  "CSeq: 2\r\n"
+  "User-Agent: LibVLC/3.0.16 (LIVE555 Streaming Media v2016.11.28)\r\n"
+  "\r\n",
+
+  "SETUP rtsp://192.168.1.10:1337/ RTSP/1.0\r\n"
+  "Transport: RTP/AVP/UDP;unicast;client_port=27322-27323\r\n"
+  "CSeq: 3\r\n"
+  "User-Agent: Lavf58.29.100\r\n"
+  "\r\n",
+
+  "PLAY rtsp://192.168.1.10:1337/ RTSP/1.0\r\n"
+  "Range: npt=0.000-\r\n"
+  "CSeq: 4\r\n"
+  "User-Agent: Lavf58.29.100\r\n"
+  "Session: 9f86d081884c7d65\r\n"
+  "\r\n",
+
+  "GET_PARAMETER rtsp://192.168.1.10:1337/ RTSP/1.0\r\n"
+  "CSeq: 5\r\n"
+  "User-Agent: LibVLC/3.0.16 (LIVE555 Streaming Media v2016.11.28)\r\n"
+  "Session: 9f86d081884c7d65\r\n"
+  "\r\n",
+
+  "TEARDOWN rtsp://192.168.1.10:1337/ RTSP/1.0\r\n"
+  "CSeq: 6\r\n"
+  "User-Agent: Lavf58.29.100\r\n"
+  "Session: 9f86d081884c7d65\r\n"
+  "\r\n",
+};
+
+static const char* RESPONSES[] = {
+  "RTSP/1.0 200 OK\r\n"
+  "CSeq: 1\r\n"
+  "Public: DESCRIBE, SETUP, TEARDOWN, PLAY, GET_PARAMETER\r\n"
+  "\r\n",
+
+  "RTSP/1.0 200 OK\r\n"
+  "CSeq: 3\r\n"
+  "Transport: RTP/AVP;unicast;client_port=27322-27323;server_port=40000-40001;ssrc=1a2b3c4d\r\n"
+  "Session: 9f86d081884c7d65;timeout=60\r\n"
+  "Media-Properties: No-Seeking, Time-Progressing, Time-Duration=0.0\r\n"
+  "\r\n",
+
+  "RTSP/1.0 454 Session Not Found\r\n"
+  "CSeq: 4\r\n"
+  "\r\n",
+};
+
+static const char* TRANSPORTS[] = {
+  "RTP/AVP;unicast;client_port=27322-27323",
+  "RTP/AVP/TCP;unicast;interleaved=0-1",
+  "RTP/AVP;multicast;ttl=127;mode=\"PLAY\",RTP/AVP;unicast;client_port=3456-3457;mode=\"PLAY\"",
+};
+
+// messages concatenated as they would be received on a pipelined connection
+template <usize N>
+static std::vector<u8> concat(const char* (&messages)[N]) {
+  std::vector<u8> data;
+  for (const char* message : messages) {
+    const std::string s{message};
+    data.insert(data.end(), s.begin(), s.end());
+  }
+  return data;
+}
+
+static void request(benchmark::State& state) {
+  const auto requests = concat(REQUESTS);
+  std::array<rtsp::Header, 16> headers;
+
+  for (auto _ : state) {
+    BytesRef input(requests.data(), requests.size());
+    while (!input.empty()) {
+      // NOTE: same as rtsp::Connection does before each request
+      std::fill(headers.begin(), headers.end(), rtsp::Header());
+      rtsp::Request request{rtsp::Headers{headers.data(), headers.size()}};
+      auto size = request.parse(input);
+      if (size.err() || !request.m_headers.get("cseq")) {
+        state.SkipWithError("failed to parse request");
+        return;
+      }
+
+      benchmark::DoNotOptimize(request);
+      input = input.slice(*size, input.len());
+    }
+  }
+
+  state.SetItemsProcessed(static_cast<i64>(state.iterations() * std::size(REQUESTS)));
+  state.SetBytesProcessed(static_cast<i64>(state.iterations() * requests.size()));
+}
+
+static void response(benchmark::State& state) {
+  const auto responses = concat(RESPONSES);
+  std::array<rtsp::Header, 16> headers;
+
+  for (auto _ : state) {
+    BytesRef input(responses.data(), responses.size());
+    while (!input.empty()) {
+      rtsp::Response response{rtsp::Headers{headers.data(), headers.size()}};
+      auto size = response.parse(input);
+      if (size.err()) {
+        state.SkipWithError("failed to parse response");
+        return;
+      }
+
+      benchmark::DoNotOptimize(response);
+      input = input.slice(*size, input.len());
+    }
+  }
+
+  state.SetItemsProcessed(static_cast<i64>(state.iterations() * std::size(RESPONSES)));
+  state.SetBytesProcessed(static_cast<i64>(state.iterations() * responses.size()));
+}
+
+static void transport(benchmark::State& state) {
+  usize size = 0;
+  for (const char* transport : TRANSPORTS) {
+    size += std::string(transport).size();
+  }
+
+  for (auto _ : state) {
+    for (const char* transport : TRANSPORTS) {
+      auto parsed = rtsp::parse_transport(transport);
+      if (!parsed) {
+        state.SkipWithError("failed to parse transport");
+        return;
+      }
+
+      benchmark::DoNotOptimize(parsed);
+    }
+  }
+
+  state.SetItemsProcessed(static_cast<i64>(state.iterations() * std::size(TRANSPORTS)));
+  state.SetBytesProcessed(static_cast<i64>(state.iterations() * size));
+}
+
+BENCHMARK(request);
+BENCHMARK(response);
+BENCHMARK(transport);
+
+// NOTE: should be built in release mode to get meaningful numbers
+BENCHMARK_MAIN();
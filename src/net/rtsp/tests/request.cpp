@@ -187,3 +187,36 @@ TEST(rtsp_request, incomplete_headers) {
   EXPECT_EQ(request.m_version, 1);
   EXPECT_EQ(request.m_headers.data[0], rtsp::Header("CSeq", "10"));
 }
+
+TEST(rtsp_request, pipelined_requests) {
+  BytesRef data = "OPTIONS rtsp://example.com/media.mp4 RTSP/1.0\r\n"
+                  "CSeq: 1\r\n"
+                  "\r\n"
+                  "DESCRIBE rtsp://example.com/media.mp4 RTSP/1.0\r\n"
+                  "CSeq: 2\r\n"
+                  "\r\n"
+                  "PLAY rtsp://exa";
+
+  std::array<rtsp::Header, 16> headers;
+  rtsp::Request first(rtsp::Headers{headers.data(), headers.size()});
+  auto first_size = first.parse(data);
+  ASSERT_FALSE(first_size.err());
+  EXPECT_EQ(first.m_type, rtsp::Request::Type::OPTIONS);
+  EXPECT_EQ(first.m_headers.get("cseq"), rtsp::Header("CSeq", "1"));
+
+  data = data.slice(*first_size, data.len());
+  rtsp::Request second(rtsp::Headers{headers.data(), headers.size()});
+  auto second_size = second.parse(data);
+  ASSERT_FALSE(second_size.err());
+  EXPECT_EQ(second.m_type, rtsp::Request::Type::DESCRIBE);
+  EXPECT_EQ(second.m_headers.get("CSeq"), rtsp::Header("CSeq", "2"));
+
+  data = data.slice(*second_size, data.len());
+  rtsp::Request third(rtsp::Headers{headers.data(), headers.size()});
+  EXPECT_EQ(third.parse(data).err(),
+            make_error_code(rtsp::Error::NotEnoughData));
+}
+
+TEST(rtsp_request, empty_type) {
+  assert_fails(" rtsp://example.com RTSP/1.0\r\n\r\n", rtsp::Error::InvalidType);
+}
@@ -181,3 +181,19 @@ TEST(rtsp_response, too_many_headers) {
 
   assert_fails(response_too_many_headers, rtsp::Error::ExcessHeaders);
 }
+
+TEST(rtsp_response, serialize_parsed) {
+  BytesRef text = "RTSP/1.0 454 Session Not Found\r\n"
+                  "CSeq: 9\r\n"
+                  "\r\n";
+
+  std::array<rtsp::Header, 16> headers;
+  rtsp::Response response(rtsp::Headers{headers.data(), headers.size()});
+  ASSERT_FALSE(response.parse(text).err());
+
+  // unused header slots are not serialized
+  std::array<u8, 256> buffer;
+  auto size = response.serialize(buffer.data(), buffer.size());
+  ASSERT_FALSE(size.err());
+  EXPECT_EQ(BytesRef(buffer.data(), *size), text);
+}
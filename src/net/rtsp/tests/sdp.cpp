@@ -0,0 +1,67 @@
+#include "net/rtsp/sdp.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <string>
+
+// clang-format off
+#include "disable_warnings_push.hpp"
+#include <gtest/gtest.h>
+#include "disable_warnings_pop.hpp"
+// clang-format on
+
+using namespace shar;
+using namespace shar::net;
+
+static const u8 IDR_UNIT[] = {
+  0x00, 0x00, 0x00, 0x01, 0x67, 0x42, 0xc0, 0x1f, 0xda, // SPS
+  0x00, 0x00, 0x00, 0x01, 0x68, 0xce, 0x3c, 0x80,       // PPS
+  0x00, 0x00, 0x01, 0x65, 0x88, 0x84, 0x00              // IDR slice
+};
+
+static std::string to_string(BytesRef bytes) {
+  return std::string(bytes.char_ptr(), bytes.len());
+}
+
+TEST(rtsp_sdp, without_parameter_sets) {
+  rtsp::Sdp sdp;
+  auto text = to_string(sdp.generate("192.168.1.2", false, 30));
+
+  EXPECT_NE(text.find("o=- 1815849 1 IN IP4 192.168.1.2\r\n"), std::string::npos);
+  EXPECT_NE(text.find("c=IN IP4 192.168.1.2\r\n"), std::string::npos);
+  EXPECT_NE(text.find("a=fmtp:96 packetization-mode=1\r\n"), std::string::npos);
+  EXPECT_NE(text.find("a=framerate:30\r\n"), std::string::npos);
+}
+
+TEST(rtsp_sdp, parameter_sets) {
+  rtsp::Sdp sdp;
+  EXPECT_TRUE(sdp.update(BytesRef(IDR_UNIT, sizeof(IDR_UNIT))));
+  EXPECT_FALSE(sdp.update(BytesRef(IDR_UNIT, sizeof(IDR_UNIT))));
+
+  auto text = to_string(sdp.generate("::1", true, 60));
+  EXPECT_NE(text.find("c=IN IP6 ::1\r\n"), std::string::npos);
+  EXPECT_NE(text.find("a=fmtp:96 packetization-mode=1;"
+                      "profile-level-id=42C01F;"
+                      "sprop-parameter-sets=Z0LAH9o=,aM48gA==\r\n"),
+            std::string::npos);
+}
+
+TEST(rtsp_sdp, cached) {
+  rtsp::Sdp sdp;
+  sdp.update(BytesRef(IDR_UNIT, sizeof(IDR_UNIT)));
+
+  auto first = sdp.generate("10.0.0.1", false, 30);
+  auto second = sdp.generate("10.0.0.1", false, 30);
+  EXPECT_EQ(first, second);
+  EXPECT_NE(to_string(second).find("o=- 1815849 1 "), std::string::npos);
+
+  // encoder was reopened with different parameters
+  u8 unit[sizeof(IDR_UNIT)];
+  std::copy(std::begin(IDR_UNIT), std::end(IDR_UNIT), unit);
+  unit[7] = 0x28; // level 4.0
+  EXPECT_TRUE(sdp.update(BytesRef(unit, sizeof(unit))));
+
+  auto text = to_string(sdp.generate("10.0.0.1", false, 30));
+  EXPECT_NE(text.find("o=- 1815849 2 "), std::string::npos);
+  EXPECT_NE(text.find("profile-level-id=42C028"), std::string::npos);
+}
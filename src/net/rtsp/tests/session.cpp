@@ -0,0 +1,166 @@
+#include "net/rtsp/server.hpp"
+#include "net/rtsp/session.hpp"
+#include "net/rtcp/receiver_report.hpp"
+#include "net/rtcp/sender_report.hpp"
+
+// clang-format off
+#include "disable_warnings_push.hpp"
+#include <gtest/gtest.h>
+#include "disable_warnings_pop.hpp"
+// clang-format on
+
+#include <array>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace shar;
+using namespace shar::net;
+
+static const u32 STREAM_ID = 0x12345678;
+
+// receiver report with a single block, as sent by client
+static const usize REPORT_SIZE = rtcp::ReceiverReport::MIN_SIZE + rtcp::Block::MIN_SIZE;
+
+// DLSR is in 1/65536 seconds
+static const u32 DELAY = 65536 / 100;
+static const Milliseconds DELAY_MS{ 10 };
+
+static Context make_context() {
+  return Context{ std::make_shared<Config>(), std::make_shared<Metrics>(16) };
+}
+
+class rtsp_session : public ::testing::Test {
+protected:
+  rtsp_session()
+    : m_server(make_context(), IpAddress{ IPv4::loopback() }, 0)
+    , m_session(m_server,
+                "session",
+                Strand(m_context.get_executor()),
+                IpAddress{ IPv4::loopback() },
+                rtsp::Transport{ rtsp::Transport::Type::Interleaved, 2, 3 },
+                udp::Socket{ m_context },
+                {},
+                0,
+                STREAM_ID)
+  {}
+
+  // middle 32 bits of NTP timestamp of the SR sent by session
+  u32 send_report() {
+    const auto segment = m_session.make_report(1234);
+    EXPECT_EQ(segment.m_header[0], '$');
+    EXPECT_EQ(segment.m_header[1], 3);
+    EXPECT_EQ(usize{ segment.m_header[2] } << 8 | segment.m_header[3], segment.m_payload.len());
+
+    alignas(u32) std::array<u8, rtcp::SenderReport::MIN_SIZE> data{};
+    EXPECT_EQ(segment.m_payload.len(), data.size());
+    std::memcpy(data.data(), segment.m_payload.data(), data.size());
+
+    rtcp::SenderReport sr{ data.data(), data.size() };
+    EXPECT_TRUE(sr.valid());
+    EXPECT_EQ(sr.stream_id(), STREAM_ID);
+    EXPECT_EQ(sr.rtp_timestamp(), 1234u);
+    return static_cast<u32>(sr.ntp_timestamp() >> 16);
+  }
+
+  IOContext m_context;
+  rtsp::Server m_server;
+  rtsp::Session m_session;
+};
+
+// write receiver report about |stream_id| at the start of |data|
+static void write_report(u8* data, u32 stream_id, u32 lsr, u32 dlsr) {
+  rtcp::ReceiverReport report{ data, REPORT_SIZE };
+  report.set_version(2);
+  report.set_nblocks(1);
+  report.set_packet_type(rtcp::PacketType::RECEIVER_REPORT);
+  report.set_length(REPORT_SIZE / sizeof(u32) - 1);
+  report.set_stream_id(1);
+
+  auto block = report.block();
+  block.set_stream_id(stream_id);
+  block.set_last_sender_report_timestamp(lsr);
+  block.set_delay_since_last_sender_report(dlsr);
+}
+
+TEST_F(rtsp_session, rtt) {
+  EXPECT_EQ(m_session.rtt().count(), 0);
+
+  const auto sent = Clock::now();
+  const u32 lsr = send_report();
+  std::this_thread::sleep_for(DELAY_MS * 2);
+
+  // compound packet, the first report is about other stream
+  alignas(u32) std::array<u8, REPORT_SIZE * 2> data{};
+  write_report(data.data(), STREAM_ID + 1, lsr + 1, 0);
+  write_report(data.data() + REPORT_SIZE, STREAM_ID, lsr, DELAY);
+
+  m_session.on_rtcp(data.data(), data.size());
+  const auto elapsed = std::chrono::duration_cast<Microseconds>(Clock::now() - sent);
+
+  // rtt is time since SR was sent minus time client held it
+  const auto rtt = m_session.rtt();
+  EXPECT_GE(rtt, DELAY_MS - Milliseconds{ 1 });
+  EXPECT_LE(rtt, elapsed - DELAY_MS + Milliseconds{ 1 });
+}
+
+TEST_F(rtsp_session, report_of_other_sr_is_ignored) {
+  const u32 lsr = send_report();
+  std::this_thread::sleep_for(DELAY_MS);
+
+  alignas(u32) std::array<u8, REPORT_SIZE> data{};
+  write_report(data.data(), STREAM_ID, lsr - 1, 0);
+  m_session.on_rtcp(data.data(), data.size());
+  EXPECT_EQ(m_session.rtt().count(), 0);
+
+  // client can't hold SR longer than it took to return it
+  write_report(data.data(), STREAM_ID, lsr, DELAY * 100);
+  m_session.on_rtcp(data.data(), data.size());
+  EXPECT_EQ(m_session.rtt().count(), 0);
+}
+
+TEST_F(rtsp_session, truncated_compound) {
+  const u32 lsr = send_report();
+  std::this_thread::sleep_for(Milliseconds{ 1 });
+
+  // only the second report is about the last SR
+  alignas(u32) std::array<u8, REPORT_SIZE * 2> data{};
+  write_report(data.data(), STREAM_ID, lsr - 1, 0);
+  write_report(data.data() + REPORT_SIZE, STREAM_ID, lsr, 0);
+
+  // second report is cut off
+  for (usize size = 0; size < data.size(); ++size) {
+    m_session.on_rtcp(data.data(), size);
+  }
+  EXPECT_EQ(m_session.rtt().count(), 0);
+
+  // length of the first report exceeds the buffer
+  rtcp::Header header{ data.data(), data.size() };
+  header.set_length(0xffff);
+  m_session.on_rtcp(data.data(), data.size());
+  EXPECT_EQ(m_session.rtt().count(), 0);
+
+  header.set_length(REPORT_SIZE / sizeof(u32) - 1);
+  m_session.on_rtcp(data.data(), data.size());
+  EXPECT_GT(m_session.rtt().count(), 0);
+}
+
+TEST_F(rtsp_session, oversized_compound) {
+  const u32 lsr = send_report();
+  std::this_thread::sleep_for(DELAY_MS * 2);
+
+  // 64KB packet of other type is skipped, report after it is still found
+  const usize skipped = 0x10000;
+  std::vector<u32> storage((skipped + REPORT_SIZE) / sizeof(u32));
+  u8* data = reinterpret_cast<u8*>(storage.data());
+
+  rtcp::Header header{ data, skipped };
+  header.set_version(2);
+  header.set_packet_type(rtcp::PacketType::APP);
+  header.set_length(static_cast<u16>(skipped / sizeof(u32) - 1));
+  write_report(data + skipped, STREAM_ID, lsr, DELAY);
+
+  m_session.on_rtcp(data, storage.size() * sizeof(u32));
+  EXPECT_GE(m_session.rtt(), DELAY_MS - Milliseconds{ 1 });
+}
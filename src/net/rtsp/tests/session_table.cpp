@@ -0,0 +1,120 @@
+#include "net/rtsp/session_table.hpp"
+
+#include <set>
+
+// clang-format off
+#include "disable_warnings_push.hpp"
+#include <gtest/gtest.h>
+#include "disable_warnings_pop.hpp"
+// clang-format on
+
+using namespace shar;
+using namespace shar::net;
+
+using Table = rtsp::SessionTable<int>;
+
+static BytesRef ref(const std::string& s) {
+  return BytesRef(s.data(), s.size());
+}
+
+TEST(rtsp_session_table, generate_id) {
+  Table table{10};
+
+  std::set<std::string> ids;
+  for (usize i = 0; i < 1000; ++i) {
+    auto id = table.generate_id();
+    ASSERT_EQ(id.size(), 16);
+    ASSERT_EQ(id.find_first_not_of("0123456789abcdef"), std::string::npos);
+    ids.insert(id);
+  }
+
+  EXPECT_EQ(ids.size(), 1000);
+}
+
+TEST(rtsp_session_table, find_and_remove) {
+  Table table{10};
+  const auto id = table.generate_id();
+  table.insert(id, std::make_shared<int>(42));
+
+  auto session = table.find(ref(id));
+  ASSERT_NE(session, nullptr);
+  EXPECT_EQ(*session, 42);
+  EXPECT_EQ(table.find("0123456789abcdef"), nullptr);
+
+  EXPECT_EQ(table.remove(ref(id)), session);
+  EXPECT_EQ(table.remove(ref(id)), nullptr);
+  EXPECT_EQ(table.find(ref(id)), nullptr);
+  EXPECT_EQ(table.size(), 0);
+
+  // removed session doesn't expire again
+  for (usize i = 0; i < 20; ++i) {
+    EXPECT_TRUE(table.tick().empty());
+  }
+}
+
+TEST(rtsp_session_table, expiration) {
+  Table table{3};
+  const auto id = table.generate_id();
+  table.insert(id, std::make_shared<int>(1));
+
+  EXPECT_TRUE(table.tick().empty());
+  EXPECT_TRUE(table.tick().empty());
+
+  auto expired = table.tick();
+  ASSERT_EQ(expired.size(), 1);
+  EXPECT_EQ(*expired[0], 1);
+  EXPECT_EQ(table.size(), 0);
+}
+
+TEST(rtsp_session_table, refresh) {
+  Table table{3};
+  const auto active = table.generate_id();
+  table.insert(active, std::make_shared<int>(1));
+  const auto idle = table.generate_id();
+  table.insert(idle, std::make_shared<int>(2));
+
+  // keep-alive every other tick, much longer than timeout
+  for (usize i = 0; i < 10; ++i) {
+    auto expired = table.tick();
+    if (i == 2) {
+      ASSERT_EQ(expired.size(), 1);
+      EXPECT_EQ(*expired[0], 2);
+    } else {
+      EXPECT_TRUE(expired.empty()) << "tick " << i;
+    }
+
+    if (i % 2 == 0) {
+      ASSERT_NE(table.find(ref(active)), nullptr);
+    }
+  }
+
+  EXPECT_EQ(table.size(), 1);
+
+  // not refreshed anymore
+  usize ticks = 0;
+  while (table.tick().empty()) {
+    ASSERT_LT(++ticks, 10);
+  }
+  EXPECT_EQ(table.size(), 0);
+}
+
+TEST(rtsp_session_table, keep) {
+  Table table{2};
+  table.insert(table.generate_id(), std::make_shared<int>(1));
+  table.insert(table.generate_id(), std::make_shared<int>(2));
+
+  for (usize i = 0; i < 10; ++i) {
+    auto expired = table.tick([](int session) { return session == 1; });
+    if (i == 1) {
+      ASSERT_EQ(expired.size(), 1);
+      EXPECT_EQ(*expired[0], 2);
+    } else {
+      EXPECT_TRUE(expired.empty());
+    }
+  }
+
+  EXPECT_EQ(table.size(), 1);
+  usize total = 0;
+  table.for_each([&](const Table::Ptr& session) { total += *session; });
+  EXPECT_EQ(total, 1);
+}
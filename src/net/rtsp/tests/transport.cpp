@@ -0,0 +1,60 @@
+#include "net/rtsp/transport.hpp"
+
+// clang-format off
+#include "disable_warnings_push.hpp"
+#include <gtest/gtest.h>
+#include "disable_warnings_pop.hpp"
+// clang-format on
+
+using namespace shar;
+using namespace shar::net;
+
+using Type = rtsp::Transport::Type;
+
+TEST(rtsp_transport, udp) {
+  auto transport = rtsp::parse_transport("RTP/AVP;unicast;client_port=8000-8001");
+  ASSERT_TRUE(transport);
+  EXPECT_EQ(*transport, (rtsp::Transport{Type::UDP, 8000, 8001}));
+
+  transport = rtsp::parse_transport("RTP/AVP/UDP;unicast;client_port=5000-5001;mode=play");
+  ASSERT_TRUE(transport);
+  EXPECT_EQ(*transport, (rtsp::Transport{Type::UDP, 5000, 5001}));
+
+  transport = rtsp::parse_transport("RTP/AVP;unicast;client_port=6000");
+  ASSERT_TRUE(transport);
+  EXPECT_EQ(*transport, (rtsp::Transport{Type::UDP, 6000, 6001}));
+}
+
+TEST(rtsp_transport, interleaved) {
+  auto transport = rtsp::parse_transport("RTP/AVP/TCP;unicast;interleaved=0-1");
+  ASSERT_TRUE(transport);
+  EXPECT_EQ(*transport, (rtsp::Transport{Type::Interleaved, 0, 1}));
+
+  transport = rtsp::parse_transport("RTP/AVP/TCP;interleaved=2-3");
+  ASSERT_TRUE(transport);
+  EXPECT_EQ(*transport, (rtsp::Transport{Type::Interleaved, 2, 3}));
+
+  // server picks channels
+  transport = rtsp::parse_transport("RTP/AVP/TCP;unicast");
+  ASSERT_TRUE(transport);
+  EXPECT_EQ(*transport, (rtsp::Transport{Type::Interleaved, 0, 1}));
+}
+
+TEST(rtsp_transport, first_supported) {
+  auto transport = rtsp::parse_transport(
+    "RTP/SAVP;unicast;client_port=4000-4001,"
+    "RTP/AVP;multicast;client_port=4000-4001,"
+    "RTP/AVP/TCP;unicast;interleaved=0-1"
+  );
+  ASSERT_TRUE(transport);
+  EXPECT_EQ(*transport, (rtsp::Transport{Type::Interleaved, 0, 1}));
+}
+
+TEST(rtsp_transport, invalid) {
+  EXPECT_FALSE(rtsp::parse_transport(""));
+  EXPECT_FALSE(rtsp::parse_transport("RTP/AVP;unicast"));
+  EXPECT_FALSE(rtsp::parse_transport("RTP/AVP;unicast;client_port=abc-1"));
+  EXPECT_FALSE(rtsp::parse_transport("RTP/AVP;unicast;client_port=70000-70001"));
+  EXPECT_FALSE(rtsp::parse_transport("RTP/AVP/TCP;interleaved=300-301"));
+  EXPECT_FALSE(rtsp::parse_transport("RAW/RAW/UDP;unicast;client_port=8000-8001"));
+}
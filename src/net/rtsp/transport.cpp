@@ -0,0 +1,123 @@
+#include "transport.hpp"
+
+#include <charconv>
+#include <utility> // pair
+
+
+namespace shar::net::rtsp {
+
+static const u16 MAX_CHANNEL = 255;
+
+bool Transport::operator==(const Transport& rhs) const noexcept {
+  return type == rhs.type && rtp == rhs.rtp && rtcp == rhs.rtcp;
+}
+
+// returns bytes before |delim| and advances |bytes| past it
+static BytesRef next_token(BytesRef& bytes, u8 delim) {
+  const u8* end = bytes.find(delim);
+  if (!end) {
+    auto token = bytes;
+    bytes = BytesRef(bytes.end(), bytes.end());
+    return token;
+  }
+
+  auto token = BytesRef(bytes.begin(), end);
+  bytes = BytesRef(end + 1, bytes.end());
+  return token;
+}
+
+static std::optional<u16> parse_number(BytesRef bytes) {
+  u16 number = 0;
+  auto [end, ec] = std::from_chars(bytes.char_ptr(),
+                                   bytes.char_ptr() + bytes.len(),
+                                   number);
+
+  if (ec != std::errc() || reinterpret_cast<const u8*>(end) != bytes.end()) {
+    return std::nullopt;
+  }
+
+  return number;
+}
+
+// 8000-8001 or just 8000
+static std::optional<std::pair<u16, u16>> parse_range(BytesRef bytes) {
+  auto first = parse_number(next_token(bytes, '-'));
+  if (!first) {
+    return std::nullopt;
+  }
+
+  if (bytes.empty()) {
+    return std::make_pair(*first, static_cast<u16>(*first + 1));
+  }
+
+  if (auto second = parse_number(bytes)) {
+    return std::make_pair(*first, *second);
+  }
+
+  return std::nullopt;
+}
+
+static std::optional<Transport> parse_spec(BytesRef spec) {
+  static const BytesRef CLIENT_PORT = "client_port=";
+  static const BytesRef INTERLEAVED = "interleaved=";
+
+  Transport transport;
+
+  auto profile = next_token(spec, ';');
+  if (profile == "RTP/AVP" || profile == "RTP/AVP/UDP") {
+    transport.type = Transport::Type::UDP;
+  } else if (profile == "RTP/AVP/TCP") {
+    transport.type = Transport::Type::Interleaved;
+    // NOTE: server may choose channels if client didn't
+    transport.rtp = 0;
+    transport.rtcp = 1;
+  } else {
+    return std::nullopt;
+  }
+
+  bool has_ports = false;
+  while (!spec.empty()) {
+    auto parameter = next_token(spec, ';');
+    if (parameter == "multicast") {
+      return std::nullopt;
+    }
+
+    const bool udp = transport.type == Transport::Type::UDP;
+    const BytesRef& name = udp ? CLIENT_PORT : INTERLEAVED;
+    if (!parameter.starts_with(name)) {
+      // unicast, mode, ttl, etc
+      continue;
+    }
+
+    auto range = parse_range(parameter.slice(name.len(), parameter.len()));
+    if (!range) {
+      return std::nullopt;
+    }
+
+    if (!udp && (range->first > MAX_CHANNEL || range->second > MAX_CHANNEL)) {
+      return std::nullopt;
+    }
+
+    transport.rtp = range->first;
+    transport.rtcp = range->second;
+    has_ports = true;
+  }
+
+  if (transport.type == Transport::Type::UDP && !has_ports) {
+    return std::nullopt;
+  }
+
+  return transport;
+}
+
+std::optional<Transport> parse_transport(BytesRef header) {
+  while (!header.empty()) {
+    if (auto transport = parse_spec(next_token(header, ','))) {
+      return transport;
+    }
+  }
+
+  return std::nullopt;
+}
+
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <optional>
+
+#include "bytes_ref.hpp"
+#include "int.hpp"
+
+
+namespace shar::net::rtsp {
+
+// value of Transport header
+struct Transport {
+  enum class Type {
+    UDP,         // RTP/AVP;unicast;client_port=8000-8001
+    Interleaved  // RTP/AVP/TCP;unicast;interleaved=0-1
+  };
+
+  bool operator==(const Transport& rhs) const noexcept;
+
+  Type type{Type::UDP};
+  u16 rtp{0};  // client rtp port or interleaved channel
+  u16 rtcp{0}; // client rtcp port or interleaved channel
+};
+
+// returns first supported transport from comma separated list
+// NOTE: multicast is not supported
+std::optional<Transport> parse_transport(BytesRef header);
+
+}
@@ -1,17 +1,41 @@
 #pragma once
 
+#include <cassert>
+#include <vector>
+
 #include "channel.hpp"
 #include "codec/ffmpeg/unit.hpp"
 
 
 namespace shar::net {
 
+// one of simulcast streams
+struct Layer {
+  usize m_bitrate; // nominal bitrate (in kbits)
+  Receiver<codec::ffmpeg::Unit> m_units;
+};
+
 class IPacketSender {
 public:
   virtual ~IPacketSender() {}
 
   virtual void run(Receiver<codec::ffmpeg::Unit> units) = 0;
   virtual void shutdown() = 0;
+
+  // |layers| carry the same stream encoded with decreasing quality,
+  // layers[0] being the best one. Senders pick a layer for each viewer.
+  // Default implementation sends only the first layer and disconnects others.
+  virtual void run_simulcast(std::vector<Layer> layers) {
+    assert(!layers.empty());
+    auto units = std::move(layers.front().m_units);
+    layers.clear();
+    run(std::move(units));
+  }
+
+  // set destination for target bitrate estimations (in kbits).
+  // NOTE: should be called before run(). Senders without congestion
+  //       control ignore it
+  virtual void set_bitrate_output(Sender<usize> /* bitrate */) {}
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,225 @@
+#include "socket_profile.hpp"
+
+#include "logger.hpp"
+
+#include <cstddef> // offsetof
+
+#include <cerrno>
+#include <cstring> // strerror
+
+#ifdef __linux__
+#include <linux/sockios.h> // SIOCOUTQ, SIOCOUTQNSD
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#endif
+
+#if defined(__APPLE__)
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#endif
+
+
+namespace shar::net {
+
+// units are written as soon as previous ones are sent, so the kernel doesn't
+// need to hold more than a few segments of unsent data
+static const usize LATENCY_NOT_SENT_LOWAT = 16 * 1024;
+
+// receiver spins on socket for this long before going to sleep
+static const usize LATENCY_BUSY_POLL = 50;
+
+// large enough for ~100Mbit/s over 200ms RTT
+static const usize THROUGHPUT_BUFFER_SIZE = 4 * 1024 * 1024;
+
+#ifdef __linux__
+// struct tcp_info from <linux/tcp.h>, glibc version of it lacks newer fields
+// and both headers can't be included at once.
+// NOTE: kernel only appends fields, older kernels return shorter struct
+struct KernelTcpInfo {
+  u8  state;
+  u8  ca_state;
+  u8  retransmits;
+  u8  probes;
+  u8  backoff;
+  u8  options;
+  u8  wscale;
+  u8  flags;          // delivery_rate_app_limited:1, fastopen_client_fail:2
+
+  u32 rto;
+  u32 ato;
+  u32 snd_mss;
+  u32 rcv_mss;
+
+  u32 unacked;
+  u32 sacked;
+  u32 lost;
+  u32 retrans;
+  u32 fackets;
+
+  u32 last_data_sent;
+  u32 last_ack_sent;
+  u32 last_data_recv;
+  u32 last_ack_recv;
+
+  u32 pmtu;
+  u32 rcv_ssthresh;
+  u32 rtt;            // in microseconds
+  u32 rttvar;         // in microseconds
+  u32 snd_ssthresh;
+  u32 snd_cwnd;
+  u32 advmss;
+  u32 reordering;
+
+  u32 rcv_rtt;
+  u32 rcv_space;
+
+  u32 total_retrans;
+
+  u64 pacing_rate;
+  u64 max_pacing_rate;
+  u64 bytes_acked;    // since linux 4.1
+  u64 bytes_received;
+  u32 segs_out;
+  u32 segs_in;
+
+  u32 notsent_bytes;  // since linux 4.6
+  u32 min_rtt;
+  u32 data_segs_in;
+  u32 data_segs_out;
+
+  u64 delivery_rate;  // since linux 4.9
+};
+
+// true if kernel filled |field| of KernelTcpInfo
+#define HAS_FIELD(size, field) \
+  ((size) >= offsetof(KernelTcpInfo, field) + sizeof(KernelTcpInfo::field))
+#endif
+
+SocketProfile SocketProfile::from_config(const Config& config, Role role) {
+  SocketProfile profile;
+  if (config.socket_profile == "latency") {
+    // bytes waiting in kernel send buffer are pure latency
+    profile.no_delay = true;
+    if (role == Role::Sender) {
+      profile.not_sent_lowat = LATENCY_NOT_SENT_LOWAT;
+    } else {
+      profile.busy_poll = LATENCY_BUSY_POLL;
+    }
+  } else if (config.socket_profile == "throughput") {
+    profile.no_delay = true;
+    if (role == Role::Sender) {
+      profile.send_buffer = THROUGHPUT_BUFFER_SIZE;
+    } else {
+      profile.receive_buffer = THROUGHPUT_BUFFER_SIZE;
+    }
+  }
+
+  // NOTE: "default" profile keeps OS defaults
+  return profile;
+}
+
+#if defined(__linux__) || defined(__APPLE__)
+static void set_native(tcp::Socket& socket, int level, int name, usize value, const char* option) {
+  const int v = static_cast<int>(value);
+  if (::setsockopt(socket.native_handle(), level, name, &v, sizeof(v)) != 0) {
+    LOG_WARN("Failed to set {}: {}", option, std::strerror(errno));
+  }
+}
+#endif
+
+void apply(const SocketProfile& profile, tcp::Socket& socket) {
+  ErrorCode ec;
+  if (profile.no_delay) {
+    socket.set_option(tcp::Protocol::no_delay(true), ec);
+    if (ec) {
+      LOG_WARN("Failed to set TCP_NODELAY: {}", ec.message());
+    }
+  }
+
+  if (profile.send_buffer != 0) {
+    socket.set_option(asio::socket_base::send_buffer_size(static_cast<int>(profile.send_buffer)), ec);
+    if (ec) {
+      LOG_WARN("Failed to set SO_SNDBUF: {}", ec.message());
+    }
+  }
+
+  if (profile.receive_buffer != 0) {
+    socket.set_option(asio::socket_base::receive_buffer_size(static_cast<int>(profile.receive_buffer)), ec);
+    if (ec) {
+      LOG_WARN("Failed to set SO_RCVBUF: {}", ec.message());
+    }
+  }
+
+#if defined(__linux__) || defined(__APPLE__)
+  if (profile.not_sent_lowat != 0) {
+    set_native(socket, IPPROTO_TCP, TCP_NOTSENT_LOWAT, profile.not_sent_lowat, "TCP_NOTSENT_LOWAT");
+  }
+#endif
+
+#if defined(__linux__) && defined(SO_BUSY_POLL)
+  // NOTE: might require CAP_NET_ADMIN, depending on net.core.busy_poll
+  if (profile.busy_poll != 0) {
+    set_native(socket, SOL_SOCKET, SO_BUSY_POLL, profile.busy_poll, "SO_BUSY_POLL");
+  }
+#endif
+}
+
+ErrorOr<SendQueue> send_queue(tcp::Socket& socket) {
+#ifdef __linux__
+  int queued = 0;
+  int unsent = 0;
+  if (::ioctl(socket.native_handle(), SIOCOUTQ, &queued) != 0 ||
+      ::ioctl(socket.native_handle(), SIOCOUTQNSD, &unsent) != 0) {
+    FAIL(static_cast<std::errc>(errno));
+  }
+
+  SendQueue queue;
+  queue.queued = static_cast<usize>(queued);
+  queue.unsent = static_cast<usize>(unsent);
+  return queue;
+#else
+  (void)socket;
+  FAIL(std::errc::operation_not_supported);
+#endif
+}
+
+ErrorOr<TcpInfo> tcp_info(tcp::Socket& socket) {
+#ifdef __linux__
+  KernelTcpInfo kernel{};
+  socklen_t size = sizeof(kernel);
+  if (::getsockopt(socket.native_handle(), IPPROTO_TCP, TCP_INFO, &kernel, &size) != 0) {
+    FAIL(static_cast<std::errc>(errno));
+  }
+
+  const usize len = size;
+  if (!HAS_FIELD(len, total_retrans)) {
+    FAIL(std::errc::operation_not_supported);
+  }
+
+  TcpInfo info;
+  info.rtt = Microseconds(kernel.rtt);
+  info.rtt_var = Microseconds(kernel.rttvar);
+  info.cwnd = kernel.snd_cwnd;
+  info.retransmits = kernel.total_retrans;
+  if (HAS_FIELD(len, segs_out)) {
+    info.bytes_acked = static_cast<usize>(kernel.bytes_acked);
+    info.segments_out = kernel.segs_out;
+  }
+  if (HAS_FIELD(len, min_rtt)) {
+    info.min_rtt = Microseconds(kernel.min_rtt);
+  }
+  if (HAS_FIELD(len, delivery_rate)) {
+    info.delivery_rate = static_cast<usize>(kernel.delivery_rate);
+    info.app_limited = (kernel.flags & 1) != 0;
+  }
+  return info;
+#else
+  (void)socket;
+  FAIL(std::errc::operation_not_supported);
+#endif
+}
+
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "config.hpp"
+#include "error_or.hpp"
+#include "int.hpp"
+#include "time.hpp"
+#include "types.hpp"
+
+
+namespace shar::net {
+
+// kernel options of TCP stream connection
+struct SocketProfile {
+  enum class Role {
+    Sender,  // mostly writes units, e.g. tcp::PacketSender or RTSP server
+    Receiver // mostly reads units
+  };
+
+  bool  no_delay{ false };      // TCP_NODELAY
+  usize send_buffer{ 0 };       // SO_SNDBUF, 0 means system default
+  usize receive_buffer{ 0 };    // SO_RCVBUF, 0 means system default
+  usize not_sent_lowat{ 0 };    // TCP_NOTSENT_LOWAT, 0 means not set
+  usize busy_poll{ 0 };         // SO_BUSY_POLL (in microseconds), 0 means not set
+
+  // profile selected by |config.socket_profile| for connections of |role|
+  static SocketProfile from_config(const Config& config, Role role);
+};
+
+// apply |profile| to opened |socket|
+// NOTE: options that are not supported by OS are ignored, failures are logged
+void apply(const SocketProfile& profile, tcp::Socket& socket);
+
+// state of socket's send buffer
+struct SendQueue {
+  usize queued{ 0 }; // bytes not yet acknowledged by peer (SIOCOUTQ)
+  usize unsent{ 0 }; // bytes not yet sent (SIOCOUTQNSD)
+};
+
+// NOTE: only supported on linux
+ErrorOr<SendQueue> send_queue(tcp::Socket& socket);
+
+// congestion state of connected socket (TCP_INFO)
+struct TcpInfo {
+  Microseconds rtt{ 0 };     // smoothed round trip time
+  Microseconds rtt_var{ 0 }; // mean deviation of |rtt|
+  Microseconds min_rtt{ 0 }; // 0 if not reported by kernel
+  usize cwnd{ 0 };           // congestion window (in segments)
+  usize segments_out{ 0 };   // total number of segments sent
+  usize retransmits{ 0 };    // total number of segments retransmitted
+  usize bytes_acked{ 0 };    // total number of bytes acknowledged by peer
+  usize delivery_rate{ 0 };  // recent delivery rate (bytes per second), 0 if not reported
+  bool  app_limited{ false };// true if |delivery_rate| was limited by sender, not network
+};
+
+// NOTE: only supported on linux
+ErrorOr<TcpInfo> tcp_info(tcp::Socket& socket);
+
+}
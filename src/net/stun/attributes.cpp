@@ -23,6 +23,9 @@ bool Attributes::read(Attribute &attr) noexcept {
   attr.type = read_u16_big_endian(p);
   attr.length = read_u16_big_endian(p + 2);
   attr.data = p + 4;
+  if (attr.length > m_size - m_pos - 4) {
+    return false;
+  }
 
   usize padding = (attr.length & 0b11) == 0 ? 0 : (4 - attr.length & 0b11);
   m_pos += 4 + attr.length + padding;
@@ -46,7 +49,7 @@ bool Attributes::append(Attribute attr) noexcept {
   }
 
   usize padding = (attr.length & 0b11) == 0 ? 0 : (4 - attr.length & 0b11);
-  m_pos = 4 + attr.length + padding;
+  m_pos += 4 + attr.length + padding;
   assert(valid());
   return true;
 }
@@ -1,3 +1,4 @@
+#include <algorithm> // copy
 #include <random>
 
 #include "request.hpp"
@@ -9,7 +10,8 @@
 namespace shar::net::stun {
 
 Request::Request() {
-  m_gen.seed(0xd34d10cc);
+  // NOTE: concurrent requests should have different transaction ids
+  m_gen.seed(std::random_device{}());
 }
 
 stun::Message::Transaction Request::generate_id() {
@@ -24,8 +26,8 @@ stun::Message::Transaction Request::generate_id() {
 }
 
 ErrorCode Request::send(udp::Socket& socket, udp::Endpoint server_address) {
-  assert(!m_id.has_value());
-  auto id = generate_id();
+  // NOTE: retransmissions use the same transaction id (RFC 5389 Section 7.2.1)
+  auto id = m_id ? *m_id : generate_id();
 
   std::array<u8, stun::Message::MIN_SIZE> buffer;
   stun::Message request{ buffer.data(), buffer.size() };
@@ -112,4 +114,34 @@ void Request::reset() {
   m_id.reset();
 }
 
+bool Request::matches(const stun::Message& message) const {
+  return m_id.has_value() && message.transaction() == *m_id;
+}
+
+usize write_binding_response(BytesRefMut buffer, const Message::Transaction& id,
+                             const udp::Endpoint& mapped) {
+  static const usize ATTRIBUTE_SIZE = 4 + 8;
+  if (!mapped.address().is_v4() || buffer.len() < Message::MIN_SIZE + ATTRIBUTE_SIZE) {
+    return 0;
+  }
+
+  stun::Message response{ buffer.data(), Message::MIN_SIZE + ATTRIBUTE_SIZE };
+  response.set_message_type(0x0101); // binding success response
+  response.set_length(ATTRIBUTE_SIZE);
+  response.set_cookie(stun::Message::MAGIC);
+  response.set_transaction(id);
+
+  // XOR_MAPPED_ADDRESS (RFC 5389 Section 15.2)
+  std::array<u8, 8> value{};
+  value[1] = 1; // IPv4
+  const auto port = to_big_endian(static_cast<u16>(mapped.port() ^ (stun::Message::MAGIC >> 16)));
+  const auto ip = to_big_endian(mapped.address().to_v4().to_uint() ^ stun::Message::MAGIC);
+  std::copy(port.begin(), port.end(), value.begin() + 2);
+  std::copy(ip.begin(), ip.end(), value.begin() + 4);
+
+  stun::Attributes attributes{ response.payload(), ATTRIBUTE_SIZE };
+  attributes.append(stun::Attribute{ 0x0020, static_cast<u16>(value.size()), value.data() });
+  return Message::MIN_SIZE + ATTRIBUTE_SIZE;
+}
+
 }
\ No newline at end of file
@@ -20,8 +20,12 @@ public:
   Request& operator=(Request&&) = default;
   ~Request() = default;
 
+  // send binding request, or retransmit it if it was sent already
   ErrorCode send(udp::Socket& socket, udp::Endpoint server_address);
   ErrorOr<udp::Endpoint> process_response(stun::Message& response);
+
+  // true if |message| is a response to this request
+  bool matches(const stun::Message& message) const;
   void reset();
 
 private:
@@ -34,4 +38,10 @@ private:
   std::optional<stun::Message::Transaction> m_id;
 };
 
+// write success response to binding request |id| with |mapped| address of
+// the requester (as XOR-MAPPED-ADDRESS) into |buffer|
+// returns size of response, 0 if |mapped| is not IPv4 or buffer is too small
+usize write_binding_response(BytesRefMut buffer, const Message::Transaction& id,
+                             const udp::Endpoint& mapped);
+
 }
\ No newline at end of file
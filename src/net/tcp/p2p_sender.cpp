@@ -2,27 +2,55 @@
 
 #include "time.hpp"
 
+#include <algorithm>
+#include <optional>
+
 
 namespace shar::net::tcp {
 
-static const usize PACKETS_HIGH_WATERMARK = 120;
-static const usize PACKETS_LOW_WATERMARK  = 80;
+// client is considered congested if it has more packets queued
+static const usize CONGESTION_THRESHOLD = 30;
+
+// client is moved to better layer after this many seconds without congestion
+static const usize LAYER_UPGRADE_DELAY = 10;
+
+// layer is chosen so that its bitrate is below measured throughput
+// with some margin (in percents)
+static const usize LAYER_HEADROOM = 120;
 
 
-P2PSender::Client::Client(Socket socket)
+P2PSender::Client::Client(Socket socket, ClientId id, const MetricsPtr& metrics)
     : m_length({0, 0, 0, 0})
     , m_state(State::SendingLength)
     , m_bytes_sent(0)
     , m_is_running(false)
-    , m_overflown(false)
     , m_socket(std::move(socket))
     , m_packets()
-    , m_stream_state(StreamState::Initial) {}
+    , m_layer(0)
+    , m_next_layer(0)
+    , m_window_bytes(0)
+    , m_drained(false)
+    , m_overflown(false)
+    , m_stable(0)
+    , m_lag(metrics, "Client " + std::to_string(id) + " lag (ms)", Metrics::Format::Count)
+    , m_dropped(metrics, "Client " + std::to_string(id) + " units dropped", Metrics::Format::Count)
+    , m_unsent(metrics, "Client " + std::to_string(id) + " unsent bytes", Metrics::Format::Bytes)
+    , m_info()
+    , m_estimator()
+    , m_rtt(metrics, "Client " + std::to_string(id) + " rtt (us)", Metrics::Format::Count)
+    , m_rtt_var(metrics, "Client " + std::to_string(id) + " rtt var (us)", Metrics::Format::Count)
+    , m_cwnd(metrics, "Client " + std::to_string(id) + " cwnd", Metrics::Format::Count)
+    , m_retransmits(metrics, "Client " + std::to_string(id) + " retransmits", Metrics::Format::Count)
+    , m_delivery_rate(metrics, "Client " + std::to_string(id) + " delivery rate", Metrics::Format::Bits) {}
 
 bool P2PSender::Client::is_running() const {
   return m_is_running;
 }
 
+bool P2PSender::Client::is_sending() const {
+  return m_is_running || m_bytes_sent != 0 || m_state == State::SendingContent;
+}
+
 P2PSender::P2PSender(Context context, IpAddress ip, Port port)
     : Context(std::move(context))
     , m_ip(ip)
@@ -31,24 +59,53 @@ P2PSender::P2PSender(Context context, IpAddress ip, Port port)
     , m_context()
     , m_current_socket(m_context)
     , m_acceptor(m_context)
-    , m_overflown_count(0)
+    , m_profile(SocketProfile::from_config(*m_config, SocketProfile::Role::Sender))
     , m_packets_sent(m_metrics, "Packets sent", Metrics::Format::Count)
     , m_bytes_sent(m_metrics, "Bytes sent", Metrics::Format::Bytes)
+    , m_dropped(m_metrics, "Units dropped", Metrics::Format::Count)
+    , m_target(m_metrics, "ABR target", Metrics::Format::Bits)
     {}
 
 
 void P2PSender::run(Receiver<Unit> receiver) {
+  std::vector<Layer> layers;
+  layers.push_back(Layer{ m_config->bitrate, std::move(receiver) });
+  run_simulcast(std::move(layers));
+}
+
+void P2PSender::run_simulcast(std::vector<Layer> layers) {
+  assert(!layers.empty());
   setup();
 
-  while (!m_running.expired() && receiver.connected()) {
-    auto unit = receiver.try_receive();
-    if (unit) {
-      schedule_send(std::move(*unit));
+  m_layers.clear();
+  for (const auto& layer: layers) {
+    m_layers.push_back(layer.m_bitrate);
+  }
+  m_gops.assign(layers.size(), {});
+
+  auto last_update = Clock::now();
+  while (!m_running.expired() && layers.front().m_units.connected()) {
+    for (usize i = 0; i < layers.size(); ++i) {
+      auto unit = layers[i].m_units.try_receive();
+      if (unit) {
+        schedule_send(i, std::move(*unit));
+      }
     }
 
-    do {
-      m_context.run_for(Milliseconds(10));
-    } while (m_overflown_count != 0);
+    feed_bursts();
+
+    // NOTE: slow clients drop their queues instead of blocking this loop
+    m_context.run_for(Milliseconds(10));
+
+    const auto now = Clock::now();
+    if (last_update + Seconds(1) < now) {
+      if (layers.size() > 1) {
+        update_layers(std::chrono::duration_cast<Milliseconds>(now - last_update));
+      }
+      update_lag(now);
+      update_tcp_info(now);
+      last_update = now;
+    }
   }
 
   shutdown();
@@ -59,23 +116,188 @@ void P2PSender::shutdown() {
   m_running.cancel();
 }
 
-void P2PSender::schedule_send(Unit packet) {
+void P2PSender::set_bitrate_output(Sender<usize> bitrate) {
+  m_bitrate_output.emplace(std::move(bitrate), m_config->bitrate);
+}
+
+void P2PSender::schedule_send(usize layer, Unit packet) {
   const auto shared_packet = std::make_shared<Unit>(std::move(packet));
-  for (auto& client: m_clients) {
-    client.second.m_packets.push(shared_packet);
-    if (client.second.m_packets.size() == PACKETS_HIGH_WATERMARK) {
-      m_overflown_count += 1;
-      client.second.m_overflown = true;
+  const bool is_idr = shared_packet->type() == Unit::Type::IDR;
+  const auto now = Clock::now();
+  cache_unit(layer, shared_packet);
+
+  for (auto& [id, client]: m_clients) {
+    if (client.m_next_layer == layer && is_idr) {
+      // NOTE: decoder on the other side is able to handle resolution change on IDR
+      client.m_layer = layer;
+    }
+
+    if (client.m_layer != layer) {
+      continue;
+    }
 
-      LOG_WARN("Client {}: packets queue overflow", client.first);
+    if (client.m_packets.overflown()) {
+      LOG_WARN("Client {}: packets queue overflow, waiting for next IDR", id);
+      drop_queue(id, client);
+    }
+
+    if (!client.m_packets.push(shared_packet, now)) {
+      if (client.m_packets.state() == UnitQueue::State::Recovering) {
+        client.m_dropped += 1;
+        m_dropped += 1;
+      }
+      continue;
     }
 
-    if (!client.second.is_running()) {
-      run_client(client.first);
+    if (!client.is_running()) {
+      run_client(id);
     }
   }
 }
 
+void P2PSender::cache_unit(usize layer, const std::shared_ptr<Unit>& unit) {
+  auto& gop = m_gops[layer];
+  if (unit->type() == Unit::Type::IDR) {
+    gop.clear();
+  } else if (gop.empty()) {
+    // no IDR yet or GOP is too long
+    return;
+  }
+
+  // longer GOPs are not sent to joining clients anyway
+  if (gop.size() == UnitQueue::MAX_BURST) {
+    gop.clear();
+    return;
+  }
+
+  gop.push_back(unit);
+}
+
+void P2PSender::feed_bursts() {
+  const auto now = Clock::now();
+  for (auto& [id, client]: m_clients) {
+    client.m_packets.feed(now);
+    if (!client.is_running()) {
+      run_client(id);
+    }
+  }
+}
+
+void P2PSender::drop_queue(ClientId id, Client& client) {
+  // first packet can't be dropped if it is partially sent
+  const usize dropped = client.m_packets.drop(client.is_sending());
+  client.m_overflown = true;
+  client.m_dropped += dropped;
+  m_dropped += dropped;
+  LOG_DEBUG("Client {}: {} units dropped", id, dropped);
+}
+
+void P2PSender::update_layers(Milliseconds elapsed) {
+  const auto ms = std::max<usize>(static_cast<usize>(elapsed.count()), 1);
+  for (auto& [id, client]: m_clients) {
+    // throughput is only meaningful if client was busy all the time
+    const usize kbits = client.m_window_bytes * 8 / 1024 * 1000 / ms;
+    const bool congested = client.m_overflown ||
+                           (!client.m_drained && client.m_packets.size() > CONGESTION_THRESHOLD);
+    client.m_overflown = false;
+
+    usize layer = client.m_layer;
+    if (congested) {
+      client.m_stable = 0;
+
+      // best layer that fits into measured throughput, but at least one step down
+      layer = m_layers.size() - 1;
+      for (usize i = client.m_layer + 1; i < m_layers.size(); ++i) {
+        if (m_layers[i] * LAYER_HEADROOM / 100 <= kbits) {
+          layer = i;
+          break;
+        }
+      }
+    } else if (++client.m_stable >= LAYER_UPGRADE_DELAY && client.m_layer != 0) {
+      // probe better layer, it will be reverted if client can't keep up
+      client.m_stable = 0;
+      layer = client.m_layer - 1;
+    }
+
+    if (layer != client.m_layer && layer != client.m_next_layer) {
+      LOG_INFO("Client {}: switching from layer {} to {} (throughput {}kb/s)",
+               id, client.m_layer, layer, kbits);
+      client.m_next_layer = layer;
+    }
+
+    client.m_window_bytes = 0;
+    client.m_drained = client.m_packets.empty();
+  }
+}
+
+void P2PSender::update_lag(TimePoint now) {
+  for (auto& [id, client]: m_clients) {
+    usize lag = 0;
+    if (!client.m_packets.empty()) {
+      const auto waiting = now - client.m_packets.front().queued_at;
+      lag = static_cast<usize>(std::chrono::duration_cast<Milliseconds>(waiting).count());
+    }
+
+    client.m_lag.set(lag);
+
+    auto queue = send_queue(client.m_socket);
+    if (!queue.err()) {
+      client.m_unsent.set(queue->unsent);
+    }
+  }
+}
+
+void P2PSender::update_tcp_info(TimePoint now) {
+  std::optional<usize> target;
+  for (auto& [id, client]: m_clients) {
+    auto info = tcp_info(client.m_socket);
+    if (info.err()) {
+      continue;
+    }
+
+    client.m_rtt.set(static_cast<usize>(info->rtt.count()));
+    client.m_rtt_var.set(static_cast<usize>(info->rtt_var.count()));
+    client.m_cwnd.set(info->cwnd);
+    client.m_retransmits.set(info->retransmits);
+    client.m_delivery_rate.set(info->delivery_rate * 8);
+
+    if (m_bitrate_output) {
+      if (!client.m_estimator) {
+        const usize kbits = m_config->bitrate;
+        client.m_estimator.emplace(std::max<usize>(kbits / 10, 100), kbits);
+      }
+
+      // NOTE: first sample only sets the baseline for counters
+      if (client.m_info) {
+        const auto& prev = *client.m_info;
+        const usize segments = info->segments_out - prev.segments_out;
+        const usize retransmits = info->retransmits - prev.retransmits;
+        const usize fraction_lost = segments != 0
+                                        ? std::min<usize>(retransmits * 256 / segments, 255)
+                                        : 0;
+
+        // rtt above minimal one is time spent in queues along the path
+        const auto queuing = info->rtt > info->min_rtt ? info->rtt - info->min_rtt : Microseconds(0);
+        const double delay_ms = static_cast<double>(queuing.count()) / 1000.0;
+
+        auto& estimator = *client.m_estimator;
+        estimator.on_sent(info->bytes_acked - prev.bytes_acked);
+        estimator.on_feedback(static_cast<u8>(fraction_lost), delay_ms, now);
+        target = std::min(target.value_or(estimator.target()), estimator.target());
+      }
+    }
+
+    client.m_info = *info;
+  }
+
+  if (!m_bitrate_output || !target) {
+    return;
+  }
+
+  m_target.set(*target * 1024);
+  m_bitrate_output->report(*target);
+}
+
 void P2PSender::start_accepting() {
   m_acceptor.async_accept(m_current_socket, [this](const ErrorCode& ec) {
     if (ec) {
@@ -88,8 +310,17 @@ void P2PSender::start_accepting() {
 
     const auto id = static_cast<ClientId>(m_current_socket.native_handle());
     LOG_INFO("Client {}: connected", id);
-
-    m_clients.emplace(id, std::move(m_current_socket));
+    apply(m_profile, m_current_socket);
+
+    auto [it, inserted] = m_clients.try_emplace(id, std::move(m_current_socket), id, m_metrics);
+    if (inserted && !m_gops.empty()) {
+      // start from cached GOP instead of waiting for next IDR
+      auto& client = it->second;
+      const auto& gop = m_gops[client.m_layer];
+      if (client.m_packets.start_burst(gop)) {
+        LOG_INFO("Client {}: sending {} cached units", id, gop.size());
+      }
+    }
     m_current_socket = Socket {m_context};
 
     // schedule another async_accept
@@ -109,16 +340,7 @@ void P2PSender::run_client(ClientId id) {
     return;
   }
 
-  auto& packet = client.m_packets.front();
-  if (client.m_stream_state == Client::StreamState::Initial) {
-    if (packet->type() != Unit::Type::IDR) {
-      // don't send P or B frames before IDR is received
-      client.m_packets.pop();
-      return;
-    }
-    client.m_stream_state = Client::StreamState::IDRReceived;
-  }
-
+  auto& packet = client.m_packets.front().unit;
   client.m_is_running = true;
   switch (client.m_state) {
     case Client::State::SendingLength: {
@@ -135,7 +357,6 @@ void P2PSender::run_client(ClientId id) {
       client.m_socket.async_send(buffer, [this, id](const ErrorCode& ec, usize bytes_sent) {
         if (ec) {
           LOG_ERROR("Client {}: failed to send packet length ({})", id, ec.message());
-          reset_overflown_state(id);
           m_clients.erase(id);
           return;
         }
@@ -151,7 +372,6 @@ void P2PSender::run_client(ClientId id) {
       client.m_socket.async_send(buffer, [this, id](const ErrorCode& ec, usize bytes_sent) {
         if (ec) {
           LOG_ERROR("Client {}: failed to send packet ({})", id, ec.message());
-          reset_overflown_state(id);
           m_clients.erase(id);
           return;
         }
@@ -174,6 +394,7 @@ void P2PSender::handle_write(usize bytes_sent, ClientId id) {
 
   auto& client        = it->second;
   client.m_bytes_sent += bytes_sent;
+  client.m_window_bytes += bytes_sent;
   client.m_is_running = false;
 
   assert(!client.m_packets.empty());
@@ -188,20 +409,18 @@ void P2PSender::handle_write(usize bytes_sent, ClientId id) {
       break;
 
     case Client::State::SendingContent:
-      assert(client.m_bytes_sent <= client.m_packets.front()->size());
-      usize packet_size = client.m_packets.front()->size();
+      assert(client.m_bytes_sent <= client.m_packets.front().unit->size());
+      usize packet_size = client.m_packets.front().unit->size();
       if (packet_size == client.m_bytes_sent) {
         client.m_bytes_sent = 0;
-        if (client.m_overflown && client.m_packets.size() == PACKETS_LOW_WATERMARK) {
-          m_overflown_count -= 1;
-          client.m_overflown = false;
-        }
-
         m_packets_sent += 1;
         m_bytes_sent += packet_size + client.m_length.size();
 
         client.m_packets.pop();
         client.m_state = Client::State::SendingLength;
+        if (client.m_packets.empty()) {
+          client.m_drained = true;
+        }
       }
       break;
   }
@@ -209,20 +428,6 @@ void P2PSender::handle_write(usize bytes_sent, ClientId id) {
   run_client(id);
 }
 
-void P2PSender::reset_overflown_state(ClientId id) {
-  const auto it = m_clients.find(id);
-  if (it == m_clients.end()) {
-    assert(false);
-    return;
-  }
-
-  auto& client = it->second;
-  if (client.m_overflown) {
-    client.m_overflown = false;
-    m_overflown_count -= 1;
-  }
-}
-
 void P2PSender::setup() {
   Endpoint endpoint {m_ip, m_port};
   m_acceptor.open(endpoint.protocol());
@@ -1,21 +1,32 @@
 #pragma once
 
-#include <queue>
+#include <optional>
+#include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "context.hpp"
 #include "cancellation.hpp"
 #include "channel.hpp"
 #include "net/types.hpp"
 #include "net/sender.hpp"
+#include "net/socket_profile.hpp"
+#include "net/bandwidth_estimator.hpp"
 #include "codec/ffmpeg/unit.hpp"
+#include "unit_queue.hpp"
 #include "metrics.hpp"
+#include "time.hpp"
 
 
 namespace shar::net::tcp {
 
 using codec::ffmpeg::Unit;
 
+// Sends units to any number of clients over TCP. Each client has its own
+// queue, client that can't keep up loses its queued units and resumes
+// from next IDR, so it never blocks other clients. Units since last IDR
+// are cached, so new clients start from cached GOP instead of waiting
+// for next IDR.
 class P2PSender
   : public IPacketSender
   , protected Context
@@ -26,52 +37,96 @@ public:
   ~P2PSender() override = default;
 
   void run(Receiver<Unit> receiver) override;
+  void run_simulcast(std::vector<Layer> layers) override;
   void shutdown() override;
 
+  // target bitrate is the lowest estimation among clients,
+  // each estimation is based on TCP_INFO of client's socket
+  void set_bitrate_output(Sender<usize> bitrate) override;
+
 private:
   void setup();
-  void schedule_send(Unit packet);
+  void schedule_send(usize layer, Unit packet);
   void teardown();
 
+  // pick simulcast layer for each client based on its throughput
+  void update_layers(Milliseconds elapsed);
+
+  // export how long units wait in each client's queue
+  // and how many bytes wait in its kernel send buffer
+  void update_lag(TimePoint now);
+
+  // sample TCP_INFO of each client and update bitrate estimations
+  void update_tcp_info(TimePoint now);
+
+  // add unit to GOP cache of |layer|
+  void cache_unit(usize layer, const std::shared_ptr<Unit>& unit);
+
+  // move a few units of cached GOP to queues of joining clients
+  void feed_bursts();
+
   using SharedPacket = std::shared_ptr<Unit>;
   using ClientId = usize;
 
   struct Client {
-    enum class StreamState {
-      Initial,
-      IDRReceived
-    };
-
     // TODO: move packet serialization outside of PacketSender
     enum class State {
       SendingLength,
       SendingContent
     };
 
-    explicit Client(Socket socket);
+    Client(Socket socket, ClientId id, const MetricsPtr& metrics);
     Client(const Client&) = delete;
 
     bool is_running() const;
 
+    // true if first packet in queue is partially sent
+    bool is_sending() const;
+
     using U32LE = std::array<u8, 4>;
-    using PacketsQueue = std::queue<SharedPacket>;
 
     U32LE       m_length;
     State       m_state;
     usize m_bytes_sent;
 
     bool         m_is_running;
-    bool         m_overflown;
     Socket       m_socket;
-    PacketsQueue m_packets;
-    StreamState  m_stream_state;
+    UnitQueue    m_packets;
+
+    // simulcast layer that is sent to this client, and the one it
+    // should be switched to on next IDR (same as |m_layer| if none)
+    usize m_layer;
+    usize m_next_layer;
+
+    // throughput measurement
+    usize m_window_bytes; // bytes sent since last update_layers()
+    bool  m_drained;      // true if queue was empty since last update_layers()
+    bool  m_overflown;    // true if queue overflowed since last update_layers()
+    usize m_stable;       // number of updates without congestion
+
+    Metric m_lag;         // how long first unit in queue waits (in ms)
+    Metric m_dropped;     // units dropped because client is too slow
+    Metric m_unsent;      // bytes in kernel send buffer not sent yet
+
+    // TCP_INFO telemetry, empty until first sample
+    std::optional<TcpInfo> m_info;
+    std::optional<BandwidthEstimator> m_estimator; // only if bitrate output is set
+
+    Metric m_rtt;           // in microseconds
+    Metric m_rtt_var;       // in microseconds
+    Metric m_cwnd;          // in segments
+    Metric m_retransmits;   // total segments retransmitted
+    Metric m_delivery_rate;
   };
 
   using Clients = std::unordered_map<ClientId, Client>;
   void start_accepting();
   void run_client(ClientId id);
   void handle_write(usize bytes_sent, ClientId to_client);
-  void reset_overflown_state(ClientId id);
+
+  // drop queued units that aren't being sent yet, client
+  // will receive nothing until next IDR
+  void drop_queue(ClientId id, Client& client);
 
 
   Cancellation m_running;
@@ -82,11 +137,22 @@ private:
   IOContext m_context;
   Socket    m_current_socket;
   Acceptor  m_acceptor;
+  SocketProfile m_profile;
+
+  // nominal bitrates of simulcast layers (in kbits)
+  std::vector<usize> m_layers;
+
+  // units since last IDR of each layer, shared with joining clients,
+  // empty if there was no IDR yet or GOP is too long to be cached
+  std::vector<std::vector<SharedPacket>> m_gops;
 
-  usize m_overflown_count;
+  // destination of target bitrate (in kbits), if any
+  std::optional<TargetReporter> m_bitrate_output;
 
   Metric m_packets_sent;
   Metric m_bytes_sent;
+  Metric m_dropped;
+  Metric m_target;
 };
 
 } // namespace shar::tcp
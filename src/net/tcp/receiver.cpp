@@ -1,9 +1,20 @@
 #include "receiver.hpp"
 #include "time.hpp"
 
+#include <cstring>
+
 
 namespace shar::net::tcp {
 
+#ifdef SHAR_IO_URING
+// max time receive_ring() waits for data, so that shutdown is noticed
+static const Milliseconds RECEIVE_TIMEOUT{ 250 };
+
+// user data of queued operations
+static const u64 RECV_ID = 0;
+static const u64 TIMEOUT_ID = 1;
+#endif
+
 PacketReceiver::PacketReceiver(Context context, IpAddress server, Port port)
     : Context(std::move(context))
     , m_reader()
@@ -20,11 +31,24 @@ void PacketReceiver::run(Sender<codec::ffmpeg::Unit> sender) {
   m_sender = &sender; // TODO: remove this hack
   Endpoint endpoint{ m_server_address, m_port };
   // FIXME: throws exception
+  // NOTE: buffer sizes should be set before connection is established
+  m_receiver.open(endpoint.protocol());
+  apply(SocketProfile::from_config(*m_config, SocketProfile::Role::Receiver), m_receiver);
   m_receiver.connect(endpoint);
 
+#ifdef SHAR_IO_URING
+  setup_ring();
+#endif
+
   start_read();
 
   while (!m_running.expired() && sender.connected()) {
+#ifdef SHAR_IO_URING
+    if (m_ring) {
+      receive_ring();
+      continue;
+    }
+#endif
     m_context.run_for(Milliseconds(250));
   }
 
@@ -32,6 +56,15 @@ void PacketReceiver::run(Sender<codec::ffmpeg::Unit> sender) {
 
   // close the connection
   m_receiver.shutdown(Socket::shutdown_both);
+
+#ifdef SHAR_IO_URING
+  // NOTE: queued recv() completes once connection is shut down
+  while (m_ring && m_ring->inflight() != 0 && !m_ring->submit(1).err()) {
+    m_ring->reap([](u64 /* user_data */, i32 /* result */) {});
+  }
+  m_ring.reset();
+#endif
+
   m_receiver.close();
 
   m_sender = nullptr;
@@ -42,6 +75,13 @@ void PacketReceiver::shutdown() {
 }
 
 void PacketReceiver::start_read() {
+#ifdef SHAR_IO_URING
+  if (m_ring) {
+    m_ring->prepare_recv(m_receiver.native_handle(), BytesRefMut(m_buffer.data(), m_buffer.size()), RECV_ID);
+    return;
+  }
+#endif
+
   m_receiver.async_read_some(
       span(m_buffer.data(), m_buffer.size()),
       [this](const ErrorCode& ec, usize received) {
@@ -51,17 +91,63 @@ void PacketReceiver::start_read() {
           return;
         }
 
-        auto packets = m_reader.update(m_buffer, received);
-
-        m_bytes_received += received;
-        m_packets_received += packets.size();
-        for (auto& packet: packets) {
-          m_sender->send(std::move(packet));
-        }
-
+        on_read(received);
         start_read();
       }
   );
 }
 
+void PacketReceiver::on_read(usize received) {
+  auto packets = m_reader.update(m_buffer, received);
+
+  m_bytes_received += received;
+  m_packets_received += packets.size();
+  for (auto& packet: packets) {
+    m_sender->send(std::move(packet));
+  }
+}
+
+#ifdef SHAR_IO_URING
+void PacketReceiver::setup_ring() {
+  auto ring = Ring::create(2);
+  if (auto ec = ring.err()) {
+    LOG_WARN("io_uring is not available, falling back to asio: {}", ec.message());
+    return;
+  }
+
+  m_ring = std::move(*ring);
+  LOG_INFO("TCP receiver: using io_uring");
+}
+
+void PacketReceiver::receive_ring() {
+  if (!m_waiting) {
+    m_waiting = m_ring->prepare_timeout(RECEIVE_TIMEOUT, 1, TIMEOUT_ID);
+  }
+
+  auto submitted = m_ring->submit(1);
+  if (auto ec = submitted.err()) {
+    LOG_ERROR("Receiver failed: {}", ec.message());
+    shutdown();
+    return;
+  }
+
+  m_ring->reap([this](u64 user_data, i32 result) {
+    if (user_data == TIMEOUT_ID) {
+      m_waiting = false;
+      return;
+    }
+
+    if (result <= 0) {
+      // NOTE: same as asio, closed connection is reported as an error
+      LOG_ERROR("Receiver failed: {}", result == 0 ? "End of file" : std::strerror(-result));
+      shutdown();
+      return;
+    }
+
+    on_read(static_cast<usize>(result));
+    start_read();
+  });
+}
+#endif
+
 }
\ No newline at end of file
@@ -6,6 +6,10 @@
 #include "packet_parser.hpp"
 #include "net/receiver.hpp"
 #include "net/types.hpp"
+#include "net/socket_profile.hpp"
+#ifdef SHAR_IO_URING
+#include "net/uring.hpp"
+#endif
 
 
 namespace shar::net::tcp {
@@ -23,6 +27,17 @@ public:
 private:
   void start_read();
 
+  // pass |received| bytes of |m_buffer| to the parser
+  void on_read(usize received);
+
+#ifdef SHAR_IO_URING
+  // set up io_uring backend, falls back to asio on failure
+  void setup_ring();
+
+  // wait for completion of recv() queued by start_read()
+  void receive_ring();
+#endif
+
   using Buffer = std::vector<u8>;
 
   // NOTE: only valid inside run() call
@@ -38,6 +53,12 @@ private:
 
   Metric m_packets_received;
   Metric m_bytes_received;
+
+#ifdef SHAR_IO_URING
+  // NOTE: |m_buffer| should outlive recv() queued in |m_ring|
+  std::unique_ptr<Ring> m_ring; // empty if io_uring is not available
+  bool m_waiting{ false };      // true if timeout is queued
+#endif
 };
 
 }
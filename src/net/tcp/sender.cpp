@@ -1,10 +1,22 @@
-#include <chrono>
+#include <algorithm> // min
+#ifdef SHAR_IO_URING
+#include <unistd.h>
+
+#include <cerrno>
+#include <optional>
+#endif
 
 #include "sender.hpp"
 
 
 namespace shar::net::tcp {
 
+// if more units are waiting to be sent, they are dropped until next IDR
+static const usize MAX_QUEUED_UNITS = 120;
+
+static const Milliseconds MIN_RECONNECT_DELAY{ 100 };
+static const Milliseconds MAX_RECONNECT_DELAY{ 5000 };
+
 PacketSender::PacketSender(Context context, IpAddress ip, Port port)
   : Context(std::move(context))
   , m_ip(std::move(ip))
@@ -13,92 +25,142 @@ PacketSender::PacketSender(Context context, IpAddress ip, Port port)
   , m_socket(m_context)
   , m_timer(m_context)
   , m_state(State::Disconnected)
+  , m_waiting_idr(true)
+  , m_backoff(MIN_RECONNECT_DELAY)
   , m_length()
-  , m_bytes_sent(0)
+  , m_profile(SocketProfile::from_config(*m_config, SocketProfile::Role::Sender))
+  , m_dropped(m_metrics, "Units dropped", Metrics::Format::Count)
+  , m_unsent(m_metrics, "Unsent bytes", Metrics::Format::Bytes)
 {}
 
 void PacketSender::run(Receiver<Unit> packets) {
+#ifdef SHAR_IO_URING
+  setup_ring();
+#endif
+
+  auto work = asio::make_work_guard(m_context);
+  asio::post(m_context, [this] { connect(); });
+  m_thread = std::thread([this] {
+    try {
+      m_context.run();
+    } catch (const std::exception& e) {
+      LOG_ERROR("Sender thread failed: {}", e.what());
+      shutdown();
+    }
+  });
+
+  // NOTE: units are passed to io thread as soon as they are received,
+  //       so encoder is never blocked by the network
   while (auto packet = packets.receive()) {
     if (m_running.expired()) {
       break;
     }
 
-    set_packet(std::move(*packet));
-    m_context.reset();
-
-    schedule();
-    m_context.run();
+    auto unit = std::make_shared<Unit>(std::move(*packet));
+    asio::post(m_context, [this, unit] { enqueue(unit); });
   }
 
   shutdown();
-  if (m_state != State::Disconnected) {
-    m_socket.shutdown(Socket::shutdown_both);
-    m_socket.close();
+  m_thread.join();
+
+  ErrorCode ec;
+  m_socket.shutdown(Socket::shutdown_both, ec);
+
+#ifdef SHAR_IO_URING
+  // NOTE: queued write completes once connection is shut down
+  while (m_ring && m_ring->inflight() != 0 && !m_ring->submit(1).err()) {
+    m_ring->reap([](u64 /* user_data */, i32 /* result */) {});
   }
+#endif
+
+  m_socket.close(ec);
 }
 
 void PacketSender::shutdown() {
   m_running.cancel();
+  m_context.stop();
 }
 
-void PacketSender::set_packet(Unit packet) {
-  m_current_packet = std::move(packet);
+void PacketSender::enqueue(SharedUnit unit) {
+  if (m_queue.size() >= MAX_QUEUED_UNITS) {
+    LOG_WARN("Too many units queued, dropping until next IDR");
+    drop_queue();
+  }
 
-  const auto size = m_current_packet.size();
-  m_length = {
-      static_cast<u8>((size >> 0) & 0xffu),
-      static_cast<u8>((size >> 8) & 0xffu),
-      static_cast<u8>((size >> 16) & 0xffu),
-      static_cast<u8>((size >> 24) & 0xffu)
-  };
-  m_bytes_sent = 0;
+  // receiver can't decode anything before IDR
+  if (m_waiting_idr) {
+    if (unit->type() != Unit::Type::IDR) {
+      m_dropped += 1;
+      return;
+    }
+    m_waiting_idr = false;
+  }
+
+  m_queue.push_back(std::move(unit));
+  send();
 }
 
-void PacketSender::schedule() {
+void PacketSender::connect() {
   if (m_running.expired()) {
     return;
   }
 
-  switch (m_state) {
-    case State::Disconnected:
-      connect();
-      break;
-    case State::SendingLength:
-      send_length();
-      break;
-    case State::SendingContent:
-      send_content();
-      break;
-  }
-}
+  m_state = State::Connecting;
+  Endpoint endpoint{ m_ip, m_port };
 
-void PacketSender::connect() {
-  assert(m_state == State::Disconnected);
+  // NOTE: buffer sizes should be set before connection is established
+  ErrorCode ec;
+  m_socket.open(endpoint.protocol(), ec);
+  if (ec) {
+    LOG_ERROR("Failed to open socket: {}", ec.message());
+    reconnect();
+    return;
+  }
+  apply(m_profile, m_socket);
 
-  Endpoint endpoint{ m_ip, m_port };
   m_socket.async_connect(endpoint, [this](const ErrorCode& ec) {
     if (ec) {
-      LOG_ERROR("Reconnect failed: {}", ec.message());
-
-      m_timer.expires_from_now(std::chrono::seconds(1));
-      m_timer.async_wait([this](const ErrorCode& code) {
-        if (code) {
-          LOG_ERROR("Timer failed: {}", code.message());
-        }
+      LOG_ERROR("Connection failed: {}", ec.message());
 
-        schedule();
-      });
+      ErrorCode ignored;
+      m_socket.close(ignored);
+      reconnect();
       return;
     }
 
-    LOG_INFO("Connection restored");
-    // start sending packets
-    m_state = State::SendingLength;
-    set_packet(std::move(m_current_packet));
-    schedule();
+    LOG_INFO("Connection established");
+
+#ifdef SHAR_IO_URING
+    // NOTE: io_uring doesn't wait for non-blocking sockets (which is
+    //       what asio makes them), short writes are finished by asio
+    ErrorCode blocking;
+    if (m_ring && m_socket.native_non_blocking(false, blocking)) {
+      LOG_WARN("Failed to make socket blocking: {}", blocking.message());
+    }
+#endif
+
+    m_state = State::Idle;
+    m_backoff = MIN_RECONNECT_DELAY;
+    send();
   });
 }
 
+void PacketSender::reconnect() {
+  m_state = State::Disconnected;
+  LOG_INFO("Reconnecting in {}ms", m_backoff.count());
+
+  m_timer.expires_after(m_backoff);
+  m_timer.async_wait([this](const ErrorCode& ec) {
+    if (ec) {
+      LOG_ERROR("Timer failed: {}", ec.message());
+    }
+
+    connect();
+  });
+
+  m_backoff = std::min(m_backoff * 2, MAX_RECONNECT_DELAY);
+}
+
 void PacketSender::on_connection_close(const ErrorCode& ec) {
   if (ec) {
     LOG_ERROR("Connection aborted due to error: {}", ec.message());
@@ -106,60 +168,176 @@ void PacketSender::on_connection_close(const ErrorCode& ec) {
     LOG_INFO("Connection closed");
   }
 
-  m_socket.shutdown(Socket::shutdown_both);
-  m_socket.close();
+  ErrorCode ignored;
+  m_socket.shutdown(Socket::shutdown_both, ignored);
+  m_socket.close(ignored);
+
+  // partially sent unit is lost, so stream has to be restarted from IDR
   m_state = State::Disconnected;
+  drop_until_idr();
+  reconnect();
+}
 
-  schedule();
+void PacketSender::send() {
+  if (m_state != State::Idle || m_queue.empty()) {
+    return;
+  }
+
+  m_state = State::Sending;
+  const auto& unit = *m_queue.front();
+  const auto size = unit.size();
+  m_length = {
+      static_cast<u8>((size >> 0) & 0xffu),
+      static_cast<u8>((size >> 8) & 0xffu),
+      static_cast<u8>((size >> 16) & 0xffu),
+      static_cast<u8>((size >> 24) & 0xffu)
+  };
+
+#ifdef SHAR_IO_URING
+  if (m_ring) {
+    send_ring();
+    return;
+  }
+#endif
+
+  const std::array<ConstBuffer, 2> buffers = {
+    span(m_length.data(), m_length.size()),
+    span(unit.data(), unit.size())
+  };
+
+  asio::async_write(m_socket, buffers, [this](const ErrorCode& ec, usize /* size */) {
+    on_sent(ec);
+  });
 }
 
-void PacketSender::send_length() {
-  assert(m_state == State::SendingLength);
+void PacketSender::on_sent(const ErrorCode& ec) {
+  if (ec) {
+    on_connection_close(ec);
+    return;
+  }
 
-  auto buffer = span(m_length.data() + m_bytes_sent,
-                     m_length.size() - m_bytes_sent);
+  m_queue.pop_front();
+  m_state = State::Idle;
+  auto queue = send_queue(m_socket);
+  if (!queue.err()) {
+    m_unsent.set(queue->unsent);
+  }
+  send();
+}
+
+#ifdef SHAR_IO_URING
+void PacketSender::setup_ring() {
+  auto ring = Ring::create(2);
+  if (auto ec = ring.err()) {
+    LOG_WARN("io_uring is not available, falling back to asio: {}", ec.message());
+    return;
+  }
+
+  // NOTE: descriptor closes its own copy of ring fd
+  const int fd = ::dup((*ring)->fd());
+  ErrorCode ec;
+  if (fd < 0) {
+    ec = ErrorCode(errno, std::system_category());
+  } else {
+    m_completions.assign(fd, ec);
+  }
+
+  if (ec) {
+    LOG_WARN("Failed to watch io_uring completions, falling back to asio: {}", ec.message());
+    return;
+  }
+
+  m_ring = std::move(*ring);
+  LOG_INFO("TCP sender: using io_uring");
+}
 
-  m_socket.async_send(buffer, [this](const ErrorCode& ec, usize bytes_sent) {
-    if (ec || bytes_sent == 0) {
-      on_connection_close(ec);
+void PacketSender::send_ring() {
+  const auto& unit = *m_queue.front();
+  m_iov[0].iov_base = m_length.data();
+  m_iov[0].iov_len = m_length.size();
+  m_iov[1].iov_base = const_cast<u8*>(unit.data());
+  m_iov[1].iov_len = unit.size();
+
+  m_ring->prepare_writev(m_socket.native_handle(), m_iov.data(), m_iov.size(), 0);
+  if (auto ec = m_ring->submit().err()) {
+    on_sent(ec);
+    return;
+  }
+
+  wait_written();
+}
+
+void PacketSender::wait_written() {
+  m_completions.async_wait(asio::posix::stream_descriptor::wait_read, [this](const ErrorCode& ec) {
+    if (ec) {
+      // NOTE: only cancelled on shutdown
       return;
     }
 
-    m_bytes_sent += bytes_sent;
-    if (m_bytes_sent >= m_length.size()) {
-      m_bytes_sent = 0;
-      m_state = State::SendingContent;
-      schedule();
+    std::optional<i32> result;
+    m_ring->reap([&](u64 /* user_data */, i32 res) { result = res; });
+    if (!result) {
+      wait_written();
       return;
     }
 
-    schedule();
+    on_written(*result);
   });
 }
 
-void PacketSender::send_content() {
-  assert(m_state == State::SendingContent);
+void PacketSender::on_written(i32 result) {
+  if (result < 0 && result != -EAGAIN) {
+    on_sent(ErrorCode(-result, std::system_category()));
+    return;
+  }
 
-  auto buffer = span(m_current_packet.data() + m_bytes_sent,
-                     m_current_packet.size() - m_bytes_sent);
+  const auto& unit = *m_queue.front();
+  const usize written = result < 0 ? 0 : static_cast<usize>(result);
+  if (written == m_length.size() + unit.size()) {
+    on_sent(ErrorCode());
+    return;
+  }
 
-  m_socket.async_send(buffer, [this](const ErrorCode& ec, usize bytes_sent) {
-    if (ec || bytes_sent == 0) {
-      on_connection_close(ec);
-      return;
-    }
+  const usize header = std::min(written, m_length.size());
+  const std::array<ConstBuffer, 2> buffers = {
+    span(m_length.data(), m_length.size()) + header,
+    span(unit.data(), unit.size()) + (written - header)
+  };
 
-    m_bytes_sent += bytes_sent;
-    if (m_bytes_sent >= m_current_packet.size()) {
-      // packet content was sent, reset state
-      m_state = State::SendingLength;
-      set_packet(Unit());
-      // no tasks to schedule
-      return;
-    }
+  asio::async_write(m_socket, buffers, [this](const ErrorCode& ec, usize /* size */) {
+    // NOTE: asio makes socket non-blocking again
+    ErrorCode ignored;
+    m_socket.native_non_blocking(false, ignored);
+    on_sent(ec);
+  });
+}
+#endif
+
+void PacketSender::drop_queue() {
+  // unit that is being sent is referenced by the socket
+  const usize keep = m_state == State::Sending ? 1 : 0;
+  const usize dropped = m_queue.size() - keep;
 
-    schedule();
+  m_queue.resize(keep);
+  m_waiting_idr = true;
+  m_dropped += dropped;
+}
+
+void PacketSender::drop_until_idr() {
+  auto idr = std::find_if(m_queue.rbegin(), m_queue.rend(), [](const SharedUnit& unit) {
+    return unit->type() == Unit::Type::IDR;
   });
+
+  if (idr == m_queue.rend()) {
+    m_dropped += m_queue.size();
+    m_queue.clear();
+    m_waiting_idr = true;
+    return;
+  }
+
+  const auto first = std::prev(idr.base());
+  m_dropped += static_cast<usize>(first - m_queue.begin());
+  m_queue.erase(m_queue.begin(), first);
 }
 
-}
\ No newline at end of file
+}
@@ -1,18 +1,37 @@
 #include <array>
 #include <cstdlib> // usize
+#include <deque>
+#include <memory>
+#include <thread>
 
 #include "context.hpp"
 #include "net/sender.hpp"
 #include "net/types.hpp"
+#include "net/socket_profile.hpp"
 #include "codec/ffmpeg/unit.hpp"
 #include "channel.hpp"
 #include "cancellation.hpp"
+#include "metrics.hpp"
+#include "time.hpp"
+#ifdef SHAR_IO_URING
+#include <sys/uio.h>
+
+#include "disable_warnings_push.hpp"
+#include <asio/posix/stream_descriptor.hpp>
+#include "disable_warnings_pop.hpp"
+
+#include "net/uring.hpp"
+#endif
 
 
 namespace shar::net::tcp {
 
 using codec::ffmpeg::Unit;
 
+// Sends units to a single receiver over TCP. Connection is served by its
+// own io thread, so new units are queued while previous ones are being sent.
+// Connection is restored with exponential backoff, units queued before
+// the last IDR are dropped on reconnect.
 class PacketSender
   : public IPacketSender
   , protected Context
@@ -29,12 +48,23 @@ public:
   void shutdown() override;
 
 private:
-  void set_packet(Unit packet);
-  void schedule();
+  using SharedUnit = std::shared_ptr<Unit>;
+
+  // NOTE: all methods below are called on io thread
+  void enqueue(SharedUnit unit);
   void connect();
+  void reconnect();
   void on_connection_close(const ErrorCode& ec);
-  void send_length();
-  void send_content();
+  void send();
+
+  // called when first unit in queue is written
+  void on_sent(const ErrorCode& ec);
+
+  // drop units that aren't being sent, nothing is queued until next IDR
+  void drop_queue();
+
+  // drop units before last IDR in queue
+  void drop_until_idr();
 
   Cancellation m_running;
 
@@ -43,20 +73,48 @@ private:
   IOContext m_context;
   Socket    m_socket;
   Timer     m_timer;
-
-  Unit m_current_packet;
+  std::thread m_thread;
 
   enum class State {
-    Disconnected,
-    SendingLength,
-    SendingContent
+    Disconnected, // waiting for reconnect
+    Connecting,
+    Idle,         // connected, nothing to send
+    Sending
   };
 
   State m_state;
 
+  std::deque<SharedUnit> m_queue; // first unit is being sent in Sending state
+  bool m_waiting_idr;             // true if units are dropped until next IDR
+  Milliseconds m_backoff;         // delay before next reconnect
+
   using U32LE = std::array<u8, 4>;
   U32LE m_length;
-  usize m_bytes_sent;
+
+  SocketProfile m_profile;
+
+  Metric m_dropped;
+  Metric m_unsent; // bytes in kernel send buffer
+
+#ifdef SHAR_IO_URING
+  // set up io_uring backend, falls back to asio on failure
+  void setup_ring();
+
+  // write first unit in queue with one io_uring operation
+  void send_ring();
+
+  // wait for completion of write queued by send_ring()
+  void wait_written();
+
+  // |result| is return value of writev() or -errno
+  void on_written(i32 result);
+
+  // NOTE: units are written by the kernel, io thread only waits for
+  //       ring descriptor to become readable
+  std::unique_ptr<Ring> m_ring; // empty if io_uring is not available
+  asio::posix::stream_descriptor m_completions{ m_context };
+  std::array<iovec, 2> m_iov{};
+#endif
 };
 
-}
\ No newline at end of file
+}
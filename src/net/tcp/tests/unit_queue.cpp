@@ -0,0 +1,182 @@
+#include "net/tcp/unit_queue.hpp"
+
+// clang-format off
+#include "disable_warnings_push.hpp"
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+#include <gtest/gtest.h>
+#include "disable_warnings_pop.hpp"
+// clang-format on
+
+#include <memory>
+#include <vector>
+
+using namespace shar;
+using namespace shar::net::tcp;
+
+using SharedUnit = UnitQueue::SharedUnit;
+
+static SharedUnit make_unit(u8 tag, bool idr = false) {
+  auto unit = Unit::from_data(&tag, 1);
+  if (idr) {
+    unit.raw()->flags |= AV_PKT_FLAG_KEY;
+  }
+  return std::make_shared<Unit>(std::move(unit));
+}
+
+// same as P2PSender::schedule_send, returns false if queue was dropped
+static bool schedule(UnitQueue& queue, const SharedUnit& unit, bool sending = false) {
+  const bool overflown = queue.overflown();
+  if (overflown) {
+    queue.drop(sending);
+  }
+
+  queue.push(unit, Clock::now());
+  return !overflown;
+}
+
+static u8 front_tag(const UnitQueue& queue) {
+  return *queue.front().unit->data();
+}
+
+TEST(unit_queue, waits_for_idr) {
+  UnitQueue queue;
+  EXPECT_FALSE(queue.push(make_unit(1), Clock::now()));
+  EXPECT_TRUE(queue.empty());
+
+  EXPECT_TRUE(queue.push(make_unit(2, true), Clock::now()));
+  EXPECT_TRUE(queue.push(make_unit(3), Clock::now()));
+  EXPECT_EQ(queue.state(), UnitQueue::State::IDRReceived);
+  EXPECT_EQ(queue.size(), 2u);
+  EXPECT_EQ(front_tag(queue), 2);
+}
+
+TEST(unit_queue, slow_client_doesnt_block_fast_one) {
+  UnitQueue slow;
+  UnitQueue fast;
+
+  const usize count = UnitQueue::HIGH_WATERMARK + 10;
+  bool slow_dropped = false;
+  for (usize i = 0; i < count; ++i) {
+    const auto unit = make_unit(static_cast<u8>(i), i == 0);
+    slow_dropped |= !schedule(slow, unit);
+    EXPECT_TRUE(schedule(fast, unit));
+
+    // fast client sends everything right away
+    ASSERT_EQ(fast.size(), 1u);
+    EXPECT_EQ(front_tag(fast), static_cast<u8>(i));
+    fast.pop();
+  }
+
+  EXPECT_TRUE(slow_dropped);
+  EXPECT_EQ(slow.state(), UnitQueue::State::Recovering);
+  EXPECT_LT(slow.size(), usize{ UnitQueue::HIGH_WATERMARK });
+  EXPECT_EQ(fast.state(), UnitQueue::State::IDRReceived);
+}
+
+TEST(unit_queue, keeps_partially_sent_unit) {
+  UnitQueue queue;
+  queue.push(make_unit(0, true), Clock::now());
+  for (u8 i = 1; i < 10; ++i) {
+    queue.push(make_unit(i), Clock::now());
+  }
+
+  EXPECT_EQ(queue.drop(true), 9u);
+  ASSERT_EQ(queue.size(), 1u);
+  EXPECT_EQ(front_tag(queue), 0);
+
+  EXPECT_EQ(queue.drop(false), 1u);
+  EXPECT_TRUE(queue.empty());
+}
+
+TEST(unit_queue, resumes_on_idr) {
+  UnitQueue queue;
+  queue.push(make_unit(0, true), Clock::now());
+  queue.push(make_unit(1), Clock::now());
+  queue.drop(false);
+  EXPECT_EQ(queue.state(), UnitQueue::State::Recovering);
+
+  // P frames can't be decoded without units that were dropped
+  EXPECT_FALSE(queue.push(make_unit(2), Clock::now()));
+  EXPECT_TRUE(queue.empty());
+
+  EXPECT_TRUE(queue.push(make_unit(3, true), Clock::now()));
+  EXPECT_TRUE(queue.push(make_unit(4), Clock::now()));
+  EXPECT_EQ(queue.state(), UnitQueue::State::IDRReceived);
+  EXPECT_EQ(queue.size(), 2u);
+  EXPECT_EQ(front_tag(queue), 3);
+}
+
+static std::vector<SharedUnit> make_gop(usize size) {
+  std::vector<SharedUnit> gop;
+  for (usize i = 0; i < size; ++i) {
+    gop.push_back(make_unit(static_cast<u8>(i), i == 0));
+  }
+  return gop;
+}
+
+TEST(unit_queue, long_cached_gop_doesnt_overflow) {
+  UnitQueue queue;
+  ASSERT_TRUE(queue.start_burst(make_gop(UnitQueue::HIGH_WATERMARK + 40)));
+  EXPECT_EQ(queue.state(), UnitQueue::State::IDRReceived);
+
+  // first live units after joining
+  for (u8 i = 0; i < 10; ++i) {
+    EXPECT_TRUE(schedule(queue, make_unit(i)));
+    queue.feed(Clock::now());
+  }
+
+  EXPECT_EQ(queue.state(), UnitQueue::State::IDRReceived);
+  EXPECT_EQ(queue.size() + queue.burst_size(), UnitQueue::HIGH_WATERMARK + 50);
+}
+
+TEST(unit_queue, too_long_gop_isnt_sent) {
+  UnitQueue queue;
+  EXPECT_FALSE(queue.start_burst(make_gop(UnitQueue::MAX_BURST + 1)));
+  EXPECT_FALSE(queue.start_burst({}));
+  EXPECT_EQ(queue.state(), UnitQueue::State::Initial);
+  EXPECT_EQ(queue.burst_size(), 0u);
+}
+
+TEST(unit_queue, slow_joining_client_overflows) {
+  UnitQueue queue;
+  ASSERT_TRUE(queue.start_burst(make_gop(100)));
+
+  // nothing is sent, live units pile up after the burst
+  bool dropped = false;
+  for (usize i = 0; i < UnitQueue::HIGH_WATERMARK + 1; ++i) {
+    dropped |= !schedule(queue, make_unit(static_cast<u8>(i)));
+  }
+
+  EXPECT_TRUE(dropped);
+  EXPECT_EQ(queue.state(), UnitQueue::State::Recovering);
+  EXPECT_EQ(queue.burst_size(), 0u);
+}
+
+TEST(unit_queue, burst_is_sent_before_live_units) {
+  UnitQueue queue;
+  const usize cached = 20;
+  ASSERT_TRUE(queue.start_burst(make_gop(cached)));
+
+  std::vector<u8> sent;
+  u8 live = 100;
+  while (sent.size() != cached + 10) {
+    if (live < 110) {
+      schedule(queue, make_unit(live++));
+    }
+
+    queue.feed(Clock::now());
+    EXPECT_LE(queue.size(), usize{ UnitQueue::BURST_QUEUE_LIMIT });
+
+    // client sends one unit per tick
+    ASSERT_FALSE(queue.empty());
+    sent.push_back(front_tag(queue));
+    queue.pop();
+  }
+
+  for (usize i = 0; i < sent.size(); ++i) {
+    EXPECT_EQ(sent[i], i < cached ? i : 100 + (i - cached));
+  }
+  EXPECT_EQ(queue.burst_size(), 0u);
+}
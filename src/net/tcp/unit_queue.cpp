@@ -0,0 +1,102 @@
+#include "unit_queue.hpp"
+
+#include <cassert>
+#include <optional>
+
+
+namespace shar::net::tcp {
+
+UnitQueue::State UnitQueue::state() const noexcept {
+  return m_state;
+}
+
+bool UnitQueue::empty() const noexcept {
+  return m_units.empty();
+}
+
+usize UnitQueue::size() const noexcept {
+  return m_units.size();
+}
+
+const UnitQueue::Queued& UnitQueue::front() const {
+  assert(!m_units.empty());
+  return m_units.front();
+}
+
+void UnitQueue::pop() {
+  assert(!m_units.empty());
+  m_units.pop();
+}
+
+usize UnitQueue::burst_size() const noexcept {
+  return m_burst.size();
+}
+
+bool UnitQueue::overflown() const noexcept {
+  // NOTE: cached units that were already fed are counted too,
+  //       there are at most BURST_QUEUE_LIMIT of them
+  return m_units.size() + m_burst.size() - m_cached >= HIGH_WATERMARK;
+}
+
+bool UnitQueue::start_burst(const std::vector<SharedUnit>& gop) {
+  if (gop.empty() || gop.size() > MAX_BURST) {
+    return false;
+  }
+
+  assert(gop.front()->type() == Unit::Type::IDR);
+  m_burst.assign(gop.begin(), gop.end());
+  m_cached = gop.size();
+  m_state = State::IDRReceived;
+  return true;
+}
+
+bool UnitQueue::push(SharedUnit unit, TimePoint now) {
+  // don't send P or B frames before IDR
+  if (m_state != State::IDRReceived) {
+    if (unit->type() != Unit::Type::IDR) {
+      return false;
+    }
+    m_state = State::IDRReceived;
+  }
+
+  // joining client gets live units after cached ones
+  if (!m_burst.empty()) {
+    m_burst.push_back(std::move(unit));
+    return true;
+  }
+
+  m_units.push(Queued{std::move(unit), now});
+  return true;
+}
+
+void UnitQueue::feed(TimePoint now) {
+  usize budget = BURST_UNITS_PER_FEED;
+  while (budget != 0 && !m_burst.empty() && m_units.size() < BURST_QUEUE_LIMIT) {
+    m_units.push(Queued{std::move(m_burst.front()), now});
+    m_burst.pop_front();
+    if (m_cached != 0) {
+      --m_cached;
+    }
+    --budget;
+  }
+}
+
+usize UnitQueue::drop(bool keep_front) {
+  std::optional<Queued> front;
+  if (keep_front && !m_units.empty()) {
+    front = std::move(m_units.front());
+  }
+
+  const usize dropped = m_units.size() + m_burst.size() - (front ? 1 : 0);
+  m_units = std::queue<Queued>();
+  m_burst.clear();
+  m_cached = 0;
+  if (front) {
+    m_units.push(std::move(*front));
+  }
+
+  m_state = State::Recovering;
+  return dropped;
+}
+
+}
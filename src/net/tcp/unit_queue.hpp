@@ -0,0 +1,86 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <queue>
+#include <vector>
+
+#include "codec/ffmpeg/unit.hpp"
+#include "int.hpp"
+#include "time.hpp"
+
+
+namespace shar::net::tcp {
+
+using codec::ffmpeg::Unit;
+
+// Units waiting to be sent to one P2P client. Client that can't keep up
+// loses its queued units and resumes from next IDR. Joining client may
+// start from cached GOP, which is moved to the queue gradually by feed(),
+// live units are queued after it.
+class UnitQueue {
+public:
+  using SharedUnit = std::shared_ptr<Unit>;
+
+  enum class State {
+    Initial,     // new client, waiting for IDR
+    Recovering,  // too slow client, waiting for IDR
+    IDRReceived
+  };
+
+  struct Queued {
+    SharedUnit unit;
+    TimePoint  queued_at;
+  };
+
+  // if this many live units are queued, they should be dropped until next IDR
+  // NOTE: cached units don't count, they are bounded by MAX_BURST
+  static const usize HIGH_WATERMARK = 120;
+
+  // longer GOPs are not sent to joining clients
+  static const usize MAX_BURST = 240;
+
+  // max number of cached units moved to the queue per feed() (i.e. per
+  // ~10ms), cached GOP is sent faster than realtime, but doesn't take
+  // the whole uplink at once
+  static const usize BURST_UNITS_PER_FEED = 2;
+
+  // cached units are only moved to the queue if it is shorter than that
+  static const usize BURST_QUEUE_LIMIT = 8;
+
+  State state() const noexcept;
+
+  // units ready to be sent, cached units not fed yet are not included
+  bool empty() const noexcept;
+  usize size() const noexcept;
+  const Queued& front() const;
+  void pop();
+
+  // cached and live units waiting for feed()
+  usize burst_size() const noexcept;
+
+  // true if client is too slow and queue should be dropped
+  bool overflown() const noexcept;
+
+  // start from cached |gop| (starting with IDR) instead of waiting for next IDR,
+  // returns false if |gop| is empty or longer than MAX_BURST
+  bool start_burst(const std::vector<SharedUnit>& gop);
+
+  // returns false if unit was skipped because client waits for IDR
+  bool push(SharedUnit unit, TimePoint now);
+
+  void feed(TimePoint now);
+
+  // drop all units, except the first one if |keep_front| (e.g. it is
+  // partially sent), client will get nothing until next IDR.
+  // Returns number of dropped units
+  usize drop(bool keep_front);
+
+private:
+  std::queue<Queued> m_units;
+  std::deque<SharedUnit> m_burst;
+  usize m_cached{ 0 }; // cached units at the front of |m_burst|
+  State m_state{ State::Initial };
+};
+
+}
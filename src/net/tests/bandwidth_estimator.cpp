@@ -0,0 +1,108 @@
+#include "net/bandwidth_estimator.hpp"
+
+// clang-format off
+#include "disable_warnings_push.hpp"
+#include <gtest/gtest.h>
+#include "disable_warnings_pop.hpp"
+// clang-format on
+
+using namespace shar;
+using namespace shar::net;
+
+TEST(bandwidth_estimator, starts_from_max) {
+  BandwidthEstimator estimator{500, 5000};
+  EXPECT_EQ(estimator.target(), 5000);
+  EXPECT_EQ(estimator.state(), BandwidthEstimator::State::Increase);
+}
+
+TEST(bandwidth_estimator, decreases_on_high_loss) {
+  BandwidthEstimator estimator{500, 5000};
+  auto now = Clock::now();
+
+  for (int i = 0; i < 10; ++i) {
+    now += Seconds(1);
+    estimator.on_feedback(64 /* 25% */, 1.0, now);
+  }
+
+  EXPECT_EQ(estimator.loss(), 25);
+  EXPECT_LT(estimator.target(), 5000 / 2);
+  EXPECT_GE(estimator.target(), 500);
+}
+
+TEST(bandwidth_estimator, recovers_without_loss) {
+  BandwidthEstimator estimator{500, 5000};
+  auto now = Clock::now();
+
+  for (int i = 0; i < 10; ++i) {
+    now += Seconds(1);
+    estimator.on_feedback(128 /* 50% */, 1.0, now);
+  }
+  EXPECT_EQ(estimator.target(), 500);
+
+  usize previous = estimator.target();
+  for (int i = 0; i < 10; ++i) {
+    now += Seconds(1);
+    estimator.on_feedback(0, 1.0, now);
+    EXPECT_GE(estimator.target(), previous);
+    previous = estimator.target();
+  }
+
+  EXPECT_GT(estimator.target(), 500);
+}
+
+TEST(bandwidth_estimator, decreases_on_growing_delay) {
+  BandwidthEstimator estimator{100, 5000};
+  auto now = Clock::now();
+
+  // 1000kbit/s
+  estimator.on_sent(128 * 1024);
+  estimator.on_feedback(0, 1.0, now);
+
+  double delay = 1.0;
+  for (int i = 0; i < 3; ++i) {
+    now += Seconds(1);
+    delay += 50.0;
+    estimator.on_sent(128 * 1024);
+    estimator.on_feedback(0, delay, now);
+  }
+
+  EXPECT_EQ(estimator.send_rate(), 1024);
+  EXPECT_EQ(estimator.state(), BandwidthEstimator::State::Decrease);
+  EXPECT_LE(estimator.target(), 1024);
+}
+
+TEST(bandwidth_estimator, respects_bounds) {
+  BandwidthEstimator estimator{300, 1000};
+  auto now = Clock::now();
+
+  for (int i = 0; i < 100; ++i) {
+    now += Seconds(1);
+    estimator.on_feedback(0, 1.0, now);
+    EXPECT_LE(estimator.target(), 1000);
+  }
+
+  for (int i = 0; i < 100; ++i) {
+    now += Seconds(1);
+    estimator.on_feedback(255, 1.0, now);
+    EXPECT_GE(estimator.target(), 300);
+  }
+}
+
+TEST(target_reporter, skips_small_changes) {
+  auto [sender, receiver] = channel<usize>(4);
+  TargetReporter reporter{ std::move(sender), 1000 };
+
+  // less than 5% of reported target
+  reporter.report(1040);
+  reporter.report(960);
+  EXPECT_EQ(receiver.try_receive(), std::nullopt);
+
+  reporter.report(1100);
+  EXPECT_EQ(receiver.try_receive(), 1100);
+
+  // compared with last reported target, not the initial one
+  reporter.report(1060);
+  EXPECT_EQ(receiver.try_receive(), std::nullopt);
+  reporter.report(1000);
+  EXPECT_EQ(receiver.try_receive(), 1000);
+}
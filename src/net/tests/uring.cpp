@@ -0,0 +1,212 @@
+#include "net/uring.hpp"
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// clang-format off
+#include "disable_warnings_push.hpp"
+#include <gtest/gtest.h>
+#include "disable_warnings_pop.hpp"
+// clang-format on
+
+using namespace shar;
+using namespace shar::net;
+
+// NOTE: io_uring may be disabled (e.g. by seccomp in containers)
+static std::unique_ptr<Ring> create_ring(usize entries) {
+  auto ring = Ring::create(entries);
+  if (ring.err()) {
+    std::cerr << "io_uring is not available: " << ring.err().message() << std::endl;
+    return nullptr;
+  }
+  return std::move(*ring);
+}
+
+TEST(uring, batched_writes) {
+  auto ring = create_ring(8);
+  if (!ring) {
+    return;
+  }
+
+  std::array<int, 2> fds;
+  ASSERT_EQ(::socketpair(AF_UNIX, SOCK_DGRAM, 0, fds.data()), 0);
+
+  std::vector<u8> buffer(3 * 100);
+  ASSERT_FALSE(ring->register_buffer(BytesRefMut(buffer.data(), buffer.size())));
+
+  for (usize i = 0; i < 3; ++i) {
+    std::memset(buffer.data() + i * 100, static_cast<int>('a' + i), 100);
+    ASSERT_TRUE(ring->prepare_write_fixed(fds[0], BytesRef(buffer.data() + i * 100, 10 + i), i));
+  }
+  EXPECT_EQ(ring->pending(), 3);
+
+  auto submitted = ring->submit(3);
+  ASSERT_FALSE(submitted.err()) << submitted.err().message();
+  EXPECT_EQ(*submitted, 3);
+  EXPECT_EQ(ring->pending(), 0);
+  EXPECT_EQ(ring->syscalls(), 1);
+
+  std::vector<std::pair<u64, i32>> completions;
+  ring->reap([&](u64 user_data, i32 res) { completions.emplace_back(user_data, res); });
+  ASSERT_EQ(completions.size(), 3);
+  for (const auto& [user_data, res] : completions) {
+    EXPECT_EQ(res, static_cast<i32>(10 + user_data));
+  }
+
+  // datagrams arrive in order of submission
+  for (usize i = 0; i < 3; ++i) {
+    std::array<u8, 100> received;
+    ASSERT_EQ(::recv(fds[1], received.data(), received.size(), 0), static_cast<ssize_t>(10 + i));
+    EXPECT_EQ(received[0], 'a' + i);
+  }
+
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+
+TEST(uring, full_queue) {
+  auto ring = create_ring(2);
+  if (!ring) {
+    return;
+  }
+
+  std::array<int, 2> fds;
+  ASSERT_EQ(::socketpair(AF_UNIX, SOCK_DGRAM, 0, fds.data()), 0);
+
+  // without registered buffer writes are not fixed
+  std::array<u8, 4> data = {1, 2, 3, 4};
+  EXPECT_TRUE(ring->prepare_write_fixed(fds[0], BytesRef(data.data(), data.size()), 0));
+  EXPECT_TRUE(ring->prepare_write_fixed(fds[0], BytesRef(data.data(), data.size()), 1));
+  EXPECT_FALSE(ring->prepare_write_fixed(fds[0], BytesRef(data.data(), data.size()), 2));
+
+  ASSERT_FALSE(ring->submit(2).err());
+  EXPECT_EQ(ring->reap([](u64, i32 res) { EXPECT_EQ(res, 4); }), 2);
+  EXPECT_EQ(ring->reap([](u64, i32) {}), 0);
+
+  // queue is free again
+  EXPECT_TRUE(ring->prepare_write_fixed(fds[0], BytesRef(data.data(), data.size()), 3));
+  ASSERT_FALSE(ring->submit(1).err());
+  EXPECT_EQ(ring->reap([](u64, i32 res) { EXPECT_EQ(res, 4); }), 1);
+
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+
+TEST(uring, writev_and_recv) {
+  auto ring = create_ring(4);
+  if (!ring) {
+    return;
+  }
+
+  std::array<int, 2> fds;
+  ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds.data()), 0);
+
+  // length prefix and payload are written with one operation
+  std::array<u8, 4> length = {5, 0, 0, 0};
+  std::array<u8, 5> payload = {'h', 'e', 'l', 'l', 'o'};
+  std::array<iovec, 2> iov = {
+    iovec{ length.data(), length.size() },
+    iovec{ payload.data(), payload.size() }
+  };
+  ASSERT_TRUE(ring->prepare_writev(fds[0], iov.data(), iov.size(), 1));
+
+  std::array<u8, 16> received{};
+  ASSERT_TRUE(ring->prepare_recv(fds[1], BytesRefMut(received.data(), received.size()), 2));
+  ASSERT_FALSE(ring->submit(2).err());
+  EXPECT_EQ(ring->inflight(), 2);
+
+  std::vector<std::pair<u64, i32>> completions;
+  ring->reap([&](u64 user_data, i32 res) { completions.emplace_back(user_data, res); });
+  ASSERT_EQ(completions.size(), 2);
+  EXPECT_EQ(ring->inflight(), 0);
+  for (const auto& [user_data, res] : completions) {
+    EXPECT_EQ(res, 9) << user_data;
+  }
+  EXPECT_EQ(received[0], 5);
+  EXPECT_EQ(received[4], 'h');
+  EXPECT_EQ(received[8], 'o');
+
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+
+TEST(uring, recvmsg_sender) {
+  auto ring = create_ring(4);
+  if (!ring) {
+    return;
+  }
+
+  std::array<int, 2> fds;
+  ASSERT_EQ(::socketpair(AF_UNIX, SOCK_DGRAM, 0, fds.data()), 0);
+
+  std::array<u8, 16> buffer{};
+  iovec iov{ buffer.data(), buffer.size() };
+  sockaddr_storage address{};
+  msghdr message{};
+  message.msg_name = &address;
+  message.msg_namelen = sizeof(address);
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+
+  // nothing is sent yet, so receive is waiting in kernel
+  ASSERT_TRUE(ring->prepare_recvmsg(fds[1], &message, 7));
+  ASSERT_FALSE(ring->submit().err());
+  EXPECT_EQ(ring->inflight(), 1);
+  EXPECT_EQ(ring->reap([](u64, i32) {}), 0);
+
+  ASSERT_EQ(::send(fds[0], "abc", 3, 0), 3);
+  ASSERT_FALSE(ring->submit(1).err());
+  EXPECT_EQ(ring->reap([](u64 user_data, i32 res) {
+    EXPECT_EQ(user_data, 7);
+    EXPECT_EQ(res, 3);
+  }), 1);
+  EXPECT_EQ(ring->inflight(), 0);
+  EXPECT_EQ(buffer[2], 'c');
+
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+
+TEST(uring, timeout_and_cancel) {
+  auto ring = create_ring(4);
+  if (!ring) {
+    return;
+  }
+
+  std::array<int, 2> fds;
+  ASSERT_EQ(::socketpair(AF_UNIX, SOCK_DGRAM, 0, fds.data()), 0);
+
+  std::array<u8, 16> buffer{};
+  ASSERT_TRUE(ring->prepare_recv(fds[1], BytesRefMut(buffer.data(), buffer.size()), 1));
+
+  // wait is bounded by timeout if nothing is received
+  ASSERT_TRUE(ring->prepare_timeout(Milliseconds(10), 1, 2));
+  ASSERT_FALSE(ring->submit(1).err());
+  EXPECT_EQ(ring->reap([](u64 user_data, i32 res) {
+    EXPECT_EQ(user_data, 2);
+    EXPECT_EQ(res, -ETIME);
+  }), 1);
+
+  // waiting receive is completed by cancellation
+  ASSERT_TRUE(ring->prepare_cancel(1, 3));
+  while (ring->inflight() != 0 || ring->pending() != 0) {
+    ASSERT_FALSE(ring->submit(1).err());
+    ring->reap([](u64 user_data, i32 res) {
+      if (user_data == 1) {
+        EXPECT_EQ(res, -ECANCELED);
+      } else {
+        EXPECT_EQ(res, 0);
+      }
+    });
+  }
+
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
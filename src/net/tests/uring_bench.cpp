@@ -0,0 +1,95 @@
+#include <sys/resource.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "int.hpp"
+#include "net/types.hpp"
+#include "net/uring.hpp"
+
+
+using namespace shar;
+using namespace shar::net;
+
+// size of RTP packet as sent by rtp::PacketSender
+static const usize PACKET_SIZE = 1012;
+
+// CPU time (user + system) consumed by the process, in seconds
+static double cpu_time() {
+  rusage usage{};
+  ::getrusage(RUSAGE_SELF, &usage);
+  const auto seconds = [](const timeval& t) {
+    return static_cast<double>(t.tv_sec) + static_cast<double>(t.tv_usec) / 1e6;
+  };
+  return seconds(usage.ru_utime) + seconds(usage.ru_stime);
+}
+
+static void report(const char* name, usize frames, usize packets, usize syscalls, double cpu) {
+  const double gbits = static_cast<double>(frames * packets * PACKET_SIZE * 8) / 1e9;
+  std::cout << name << ": "
+            << static_cast<double>(syscalls) / static_cast<double>(frames) << " syscalls/frame, "
+            << cpu * 1000.0 / gbits << " ms CPU/Gbit" << std::endl;
+}
+
+// usage: uringbench [frames] [packets per frame]
+// NOTE: should be built in release mode to get meaningful numbers
+int main(int argc, char* argv[]) {
+  const usize frames = argc > 1 ? static_cast<usize>(std::stoul(argv[1])) : 10000;
+  const usize packets = argc > 2 ? static_cast<usize>(std::stoul(argv[2])) : 40;
+
+  IOContext context;
+  udp::Socket receiver{context, udp::Endpoint(IPv4::loopback(), 0)};
+  const auto endpoint = receiver.local_endpoint();
+
+  // NOTE: packets are dropped by receiver's kernel buffer, only sending is measured
+  std::vector<u8> buffer(packets * PACKET_SIZE, 0x42);
+
+  {
+    udp::Socket socket{context, udp::v4()};
+    const double start = cpu_time();
+    for (usize frame = 0; frame < frames; ++frame) {
+      for (usize i = 0; i < packets; ++i) {
+        socket.send_to(span(buffer.data() + i * PACKET_SIZE, PACKET_SIZE), endpoint);
+      }
+    }
+    report("asio", frames, packets, frames * packets, cpu_time() - start);
+  }
+
+  auto created = Ring::create(packets);
+  if (created.err()) {
+    std::cerr << "io_uring is not available: " << created.err().message() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  auto& ring = *created;
+  if (auto ec = ring->register_buffer(BytesRefMut(buffer.data(), buffer.size()))) {
+    std::cerr << "Failed to register buffer: " << ec.message() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  udp::Socket socket{context, udp::v4()};
+  socket.connect(endpoint);
+
+  usize failed = 0;
+  const double start = cpu_time();
+  for (usize frame = 0; frame < frames; ++frame) {
+    for (usize i = 0; i < packets; ++i) {
+      ring->prepare_write_fixed(socket.native_handle(), BytesRef(buffer.data() + i * PACKET_SIZE, PACKET_SIZE), i);
+    }
+
+    if (ring->submit(packets).err()) {
+      return EXIT_FAILURE;
+    }
+
+    ring->reap([&](u64, i32 result) { failed += result < 0; });
+  }
+  report("io_uring", frames, packets, ring->syscalls(), cpu_time() - start);
+
+  if (failed != 0) {
+    std::cerr << failed << " writes failed" << std::endl;
+  }
+
+  return EXIT_SUCCESS;
+}
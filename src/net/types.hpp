@@ -7,6 +7,11 @@
 
 #include "disable_warnings_push.hpp"
 #include <asio/io_context.hpp>
+#include <asio/bind_executor.hpp>
+#include <asio/executor_work_guard.hpp>
+#include <asio/post.hpp>
+#include <asio/strand.hpp>
+#include <asio/write.hpp>
 #include <asio/ip/address.hpp>
 #include <asio/ip/host_name.hpp>
 #include <asio/steady_timer.hpp>
@@ -27,7 +32,9 @@ using IPv4 = asio::ip::address_v4;
 using Port = u16;
 
 using IOContext = asio::io_context;
+using Strand = asio::strand<IOContext::executor_type>;
 using Timer = asio::steady_timer;
+using ConstBuffer = asio::const_buffer;
 
 inline auto host_name(ErrorCode& ec) {
   return asio::ip::host_name(ec);
@@ -0,0 +1,291 @@
+#include "uring.hpp"
+
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm> // max
+#include <cerrno>
+#include <cstring>
+
+
+namespace shar::net {
+
+static_assert(sizeof(io_uring_cqe) == 16, "unexpected size of io_uring_cqe");
+static_assert(sizeof(__kernel_timespec) == 2 * sizeof(i64), "unexpected size of __kernel_timespec");
+
+static int io_uring_setup(unsigned entries, io_uring_params* params) {
+  return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int io_uring_enter(int fd, unsigned submit, unsigned wait, unsigned flags) {
+  return static_cast<int>(::syscall(__NR_io_uring_enter, fd, submit, wait, flags, nullptr, 0));
+}
+
+static int io_uring_register(int fd, unsigned opcode, const void* args, unsigned nargs) {
+  return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, args, nargs));
+}
+
+static ErrorCode last_error() {
+  return ErrorCode(errno, std::system_category());
+}
+
+template <typename T>
+static T* at(void* base, u32 offset) {
+  return reinterpret_cast<T*>(static_cast<u8*>(base) + offset);
+}
+
+ErrorOr<std::unique_ptr<Ring>> Ring::create(usize entries) {
+  io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+
+  std::unique_ptr<Ring> ring{ new Ring() };
+  ring->m_fd = io_uring_setup(static_cast<unsigned>(entries), &params);
+  if (ring->m_fd < 0) {
+    return last_error();
+  }
+
+  ring->m_sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(u32);
+  ring->m_cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single_mmap) {
+    ring->m_sq_ring_size = std::max(ring->m_sq_ring_size, ring->m_cq_ring_size);
+  }
+
+  void* sq = ::mmap(nullptr, ring->m_sq_ring_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring->m_fd, IORING_OFF_SQ_RING);
+  if (sq == MAP_FAILED) {
+    return last_error();
+  }
+  ring->m_sq_ring = sq;
+
+  void* cq = sq;
+  if (!single_mmap) {
+    cq = ::mmap(nullptr, ring->m_cq_ring_size, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, ring->m_fd, IORING_OFF_CQ_RING);
+    if (cq == MAP_FAILED) {
+      return last_error();
+    }
+    ring->m_cq_ring = cq;
+  }
+
+  ring->m_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+  void* sqes = ::mmap(nullptr, ring->m_sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->m_fd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    return last_error();
+  }
+  ring->m_sqes = sqes;
+
+  ring->m_sq_head = at<u32>(sq, params.sq_off.head);
+  ring->m_sq_tail = at<u32>(sq, params.sq_off.tail);
+  ring->m_sq_array = at<u32>(sq, params.sq_off.array);
+  ring->m_sq_mask = *at<u32>(sq, params.sq_off.ring_mask);
+  ring->m_sq_entries = params.sq_entries;
+  ring->m_queued_tail = *ring->m_sq_tail;
+
+  ring->m_cq_head = at<u32>(cq, params.cq_off.head);
+  ring->m_cq_tail = at<u32>(cq, params.cq_off.tail);
+  ring->m_cq_mask = *at<u32>(cq, params.cq_off.ring_mask);
+  ring->m_cqes = at<Completion>(cq, params.cq_off.cqes);
+  return ring;
+}
+
+Ring::~Ring() {
+  if (m_sqes) {
+    ::munmap(m_sqes, m_sqes_size);
+  }
+  if (m_cq_ring) {
+    ::munmap(m_cq_ring, m_cq_ring_size);
+  }
+  if (m_sq_ring) {
+    ::munmap(m_sq_ring, m_sq_ring_size);
+  }
+  if (m_fd >= 0) {
+    // NOTE: registered buffers are released along with the ring
+    ::close(m_fd);
+  }
+}
+
+ErrorCode Ring::register_buffer(BytesRefMut buffer) {
+  if (m_registered) {
+    return std::make_error_code(std::errc::device_or_resource_busy);
+  }
+
+  iovec iov;
+  iov.iov_base = buffer.data();
+  iov.iov_len = buffer.len();
+  if (io_uring_register(m_fd, IORING_REGISTER_BUFFERS, &iov, 1) != 0) {
+    return last_error();
+  }
+
+  m_registered = true;
+  return ErrorCode();
+}
+
+io_uring_sqe* Ring::next_sqe() noexcept {
+  const u32 head = __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE);
+  if (m_queued_tail - head >= m_sq_entries) {
+    return nullptr;
+  }
+
+  const u32 index = m_queued_tail & m_sq_mask;
+  auto* sqe = static_cast<io_uring_sqe*>(m_sqes) + index;
+  std::memset(sqe, 0, sizeof(*sqe));
+
+  m_sq_array[index] = index;
+  ++m_queued_tail;
+  return sqe;
+}
+
+bool Ring::prepare_write_fixed(int fd, BytesRef data, u64 user_data) {
+  auto* sqe = next_sqe();
+  if (!sqe) {
+    return false;
+  }
+
+  sqe->opcode = m_registered ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+  sqe->fd = fd;
+  sqe->addr = reinterpret_cast<u64>(data.data());
+  sqe->len = static_cast<u32>(data.len());
+  sqe->off = static_cast<u64>(-1); // current position, i.e. sockets and pipes
+  sqe->buf_index = 0;
+  sqe->user_data = user_data;
+  return true;
+}
+
+bool Ring::prepare_writev(int fd, const iovec* iov, usize count, u64 user_data) {
+  auto* sqe = next_sqe();
+  if (!sqe) {
+    return false;
+  }
+
+  sqe->opcode = IORING_OP_WRITEV;
+  sqe->fd = fd;
+  sqe->addr = reinterpret_cast<u64>(iov);
+  sqe->len = static_cast<u32>(count);
+  sqe->off = static_cast<u64>(-1);
+  sqe->user_data = user_data;
+  return true;
+}
+
+bool Ring::prepare_recv(int fd, BytesRefMut buffer, u64 user_data) {
+  auto* sqe = next_sqe();
+  if (!sqe) {
+    return false;
+  }
+
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = fd;
+  sqe->addr = reinterpret_cast<u64>(buffer.data());
+  sqe->len = static_cast<u32>(buffer.len());
+  sqe->user_data = user_data;
+  return true;
+}
+
+bool Ring::prepare_recvmsg(int fd, msghdr* message, u64 user_data) {
+  auto* sqe = next_sqe();
+  if (!sqe) {
+    return false;
+  }
+
+  sqe->opcode = IORING_OP_RECVMSG;
+  sqe->fd = fd;
+  sqe->addr = reinterpret_cast<u64>(message);
+  sqe->len = 1;
+  sqe->user_data = user_data;
+  return true;
+}
+
+bool Ring::prepare_timeout(Microseconds timeout, usize count, u64 user_data) {
+  auto* sqe = next_sqe();
+  if (!sqe) {
+    return false;
+  }
+
+  const auto us = timeout.count();
+  m_timeout[0] = us / 1'000'000;
+  m_timeout[1] = (us % 1'000'000) * 1000;
+
+  sqe->opcode = IORING_OP_TIMEOUT;
+  sqe->fd = -1;
+  sqe->addr = reinterpret_cast<u64>(&m_timeout[0]);
+  sqe->len = 1;
+  sqe->off = count;
+  sqe->user_data = user_data;
+  return true;
+}
+
+bool Ring::prepare_cancel(u64 target, u64 user_data) {
+  auto* sqe = next_sqe();
+  if (!sqe) {
+    return false;
+  }
+
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->fd = -1;
+  sqe->addr = target;
+  sqe->user_data = user_data;
+  return true;
+}
+
+ErrorOr<usize> Ring::submit(usize wait) {
+  const u32 tail = *m_sq_tail;
+  const auto submitted = static_cast<unsigned>(m_queued_tail - tail);
+  if (submitted == 0 && wait == 0) {
+    return usize{ 0 };
+  }
+
+  __atomic_store_n(m_sq_tail, m_queued_tail, __ATOMIC_RELEASE);
+
+  const unsigned flags = wait != 0 ? IORING_ENTER_GETEVENTS : 0;
+  int ret = 0;
+  do {
+    ++m_syscalls;
+    ret = io_uring_enter(m_fd, submitted, static_cast<unsigned>(wait), flags);
+  } while (ret < 0 && errno == EINTR);
+
+  if (ret < 0) {
+    return last_error();
+  }
+
+  m_inflight += static_cast<usize>(ret);
+  return static_cast<usize>(ret);
+}
+
+usize Ring::pending() const noexcept {
+  return m_queued_tail - *m_sq_tail;
+}
+
+usize Ring::syscalls() const noexcept {
+  return m_syscalls;
+}
+
+usize Ring::inflight() const noexcept {
+  return m_inflight;
+}
+
+int Ring::fd() const noexcept {
+  return m_fd;
+}
+
+const Ring::Completion* Ring::peek() const noexcept {
+  const u32 head = *m_cq_head;
+  const u32 tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+  if (head == tail) {
+    return nullptr;
+  }
+
+  return &m_cqes[head & m_cq_mask];
+}
+
+void Ring::advance() noexcept {
+  --m_inflight;
+  __atomic_store_n(m_cq_head, *m_cq_head + 1, __ATOMIC_RELEASE);
+}
+
+}
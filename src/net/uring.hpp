@@ -0,0 +1,134 @@
+#pragma once
+
+#include <memory>
+
+#include "bytes_ref.hpp"
+#include "error_or.hpp"
+#include "int.hpp"
+#include "time.hpp"
+
+struct io_uring_sqe;
+struct iovec;
+struct msghdr;
+
+namespace shar::net {
+
+// Minimal io_uring (linux 5.1+) wrapper over raw syscalls.
+// Operations are queued with prepare_*() and passed to the kernel in one
+// batch by submit(), so sending N packets costs one syscall instead of N.
+// NOTE: not thread-safe
+class Ring {
+public:
+  // |entries| is the max number of operations queued at once
+  static ErrorOr<std::unique_ptr<Ring>> create(usize entries);
+
+  Ring(const Ring&) = delete;
+  Ring(Ring&&) = delete;
+  Ring& operator=(const Ring&) = delete;
+  Ring& operator=(Ring&&) = delete;
+  ~Ring();
+
+  // pin |buffer| in kernel, so that write_fixed() doesn't have to map
+  // user pages on each operation
+  // NOTE: only one buffer can be registered
+  ErrorCode register_buffer(BytesRefMut buffer);
+
+  // queue write of |data| to |fd|, |data| should stay alive until operation
+  // is completed and be located in registered buffer, if there is one.
+  // returns false if submission queue is full
+  bool prepare_write_fixed(int fd, BytesRef data, u64 user_data);
+
+  // queue gathered write of |count| buffers to |fd|, |iov| and buffers it
+  // points to should stay alive until operation is completed
+  bool prepare_writev(int fd, const iovec* iov, usize count, u64 user_data);
+
+  // queue recv() of at most |buffer.len()| bytes from |fd| (linux 5.6+)
+  bool prepare_recv(int fd, BytesRefMut buffer, u64 user_data);
+
+  // queue recvmsg() from |fd|, e.g. to get address of datagram sender.
+  // |message| should stay alive until operation is completed
+  bool prepare_recvmsg(int fd, msghdr* message, u64 user_data);
+
+  // queue operation that completes with -ETIME after |timeout|, or with 0
+  // as soon as |count| other operations are completed (linux 5.4+).
+  // Used to bound submit(wait) with a timeout
+  bool prepare_timeout(Microseconds timeout, usize count, u64 user_data);
+
+  // queue cancellation of operation queued with |target| user data (linux 5.5+)
+  bool prepare_cancel(u64 target, u64 user_data);
+
+  // pass queued operations to the kernel and wait for at least |wait| completions
+  ErrorOr<usize> submit(usize wait = 0);
+
+  // call |f(user_data, result)| for each completed operation, |result| is
+  // the same as return value of the corresponding syscall or -errno
+  template <typename F>
+  usize reap(F f) {
+    usize n = 0;
+    while (auto* cqe = peek()) {
+      f(cqe->user_data, cqe->res);
+      advance();
+      ++n;
+    }
+    return n;
+  }
+
+  // number of operations queued but not submitted yet
+  usize pending() const noexcept;
+
+  // number of operations submitted, but not reaped yet.
+  // NOTE: buffers of these operations should stay alive
+  usize inflight() const noexcept;
+
+  // number of io_uring_enter() calls made so far
+  usize syscalls() const noexcept;
+
+  // ring descriptor, it becomes readable when there are completions to reap
+  int fd() const noexcept;
+
+private:
+  struct Completion {
+    u64 user_data;
+    i32 res;
+    u32 flags;
+  };
+
+  Ring() = default;
+
+  // returns next free submission queue entry or nullptr if queue is full
+  io_uring_sqe* next_sqe() noexcept;
+
+  const Completion* peek() const noexcept;
+  void advance() noexcept;
+
+  int m_fd{ -1 };
+
+  // submission queue
+  void* m_sq_ring{ nullptr };
+  usize m_sq_ring_size{ 0 };
+  u32* m_sq_head{ nullptr };
+  u32* m_sq_tail{ nullptr };
+  u32* m_sq_array{ nullptr };
+  u32  m_sq_mask{ 0 };
+  u32  m_sq_entries{ 0 };
+  void* m_sqes{ nullptr };
+  usize m_sqes_size{ 0 };
+  u32  m_queued_tail{ 0 }; // tail including not submitted operations
+
+  // completion queue, shares mapping with submission queue if kernel supports it
+  void* m_cq_ring{ nullptr };
+  usize m_cq_ring_size{ 0 };
+  u32* m_cq_head{ nullptr };
+  u32* m_cq_tail{ nullptr };
+  u32  m_cq_mask{ 0 };
+  Completion* m_cqes{ nullptr };
+
+  // NOTE: kernel copies timeout on submit (linux 5.4+)
+  i64   m_timeout[2]{ 0, 0 }; // __kernel_timespec of last prepare_timeout()
+
+  bool  m_registered{ false };
+  usize m_inflight{ 0 };
+  usize m_syscalls{ 0 };
+};
+
+}
@@ -1,12 +1,16 @@
 #include <cstdlib>
+#include <string>
 
 #include "logger.hpp"
 #include "server.hpp"
 
-int main() {
+// usage: server [threads] [relay]
+int main(int argc, char* argv[]) {
   try {
     shar::init_log(".", shar::LogLevel::Info);
-    shar::Server server;
+    const auto threads = argc > 1 ? static_cast<shar::usize>(std::stoul(argv[1])) : 0;
+    const bool relay = argc > 2 && std::string(argv[2]) == "relay";
+    shar::Server server{threads, relay};
     server.run();
     return EXIT_SUCCESS;
   } catch (const std::exception& e) {
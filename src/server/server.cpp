@@ -7,7 +7,9 @@
 #include <protocol.pb.h>
 #include "disable_warnings_pop.hpp"
 
+#include <algorithm> // find, remove_if, max
 #include <cassert>
+#include <cstring>
 
 
 namespace shar {
@@ -20,122 +22,250 @@ inline static auto any_addr() {
   };
 }
 
-Server::Server()
-  : m_context()
-  , m_listener(m_context)
-  , m_next_client(m_context)
-  , m_clients()
+#ifdef SO_REUSEPORT
+// each shard has its own listener, kernel balances connections between them
+using ReusePort = asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+#endif
+
+Server::Shard::Shard(usize index)
+  : index(index)
+  , context()
+  , listener(context)
+  , next_client(context)
+  , clients()
+  , pool()
+  , arena_block(ARENA_BLOCK_SIZE)
+  , arena(arena_block.data(), arena_block.size())
 {}
 
+Server::Server(usize threads, bool relay, net::Port port)
+  : m_relay_enabled(relay)
+  , m_port(port)
+{
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+#ifndef SO_REUSEPORT
+  if (threads != 1) {
+    LOG_WARN("SO_REUSEPORT is not supported, using single thread");
+    threads = 1;
+  }
+#endif
+
+  for (usize i = 0; i < threads; ++i) {
+    m_shards.push_back(std::make_unique<Shard>(i));
+  }
+}
+
+Server::~Server() {
+  stop();
+}
+
+void Server::start() {
+  for (auto& shard : m_shards) {
+    auto& listener = shard->listener;
+    listener.open(net::tcp::v4());
+    listener.set_option(net::tcp::Acceptor::reuse_address(true));
+#ifdef SO_REUSEPORT
+    listener.set_option(ReusePort(true));
+#endif
+    // NOTE: other shards share the port picked for the first one
+    listener.bind({any_addr(), m_port});
+    m_port = listener.local_endpoint().port();
+    listener.listen(net::tcp::Acceptor::max_listen_connections);
+    start_accept(*shard);
+  }
+
+  const auto addr = m_shards.front()->listener.local_endpoint();
+  LOG_INFO("Starting on {}:{} with {} threads", addr.address().to_string(), addr.port(), m_shards.size());
+
+  for (auto& shard : m_shards) {
+    m_threads.emplace_back([&context = shard->context] {
+      auto work = asio::make_work_guard(context);
+      context.run();
+    });
+  }
+}
+
 void Server::run() {
-  m_listener.open(net::tcp::v4());
-  m_listener.set_option(net::tcp::Acceptor::reuse_address(true));
-  m_listener.bind({any_addr(), net::Port{1337}});
-  m_listener.listen(5);
+  start();
+  for (auto& thread : m_threads) {
+    thread.join();
+  }
+  m_threads.clear();
+}
 
-  const auto addr = m_listener.local_endpoint();
-  LOG_INFO("Starting on {}:{}", addr.address().to_string(), addr.port());
+void Server::stop() {
+  for (auto& shard : m_shards) {
+    shard->context.stop();
+  }
 
-  start_accept();
-  while (true) {
-    m_context.run_for(Milliseconds(100));
+  for (auto& thread : m_threads) {
+    thread.join();
   }
+  m_threads.clear();
 }
 
-void Server::start_accept() {
-  m_listener.async_accept(
-      m_next_client,
-      m_next_client_address,
-      [this](ErrorCode ec) {
-        on_accept(ec);
+net::Port Server::port() const noexcept {
+  return m_port;
+}
+
+void Server::start_accept(Shard& shard) {
+  shard.listener.async_accept(
+      shard.next_client,
+      shard.next_client_address,
+      [this, &shard](ErrorCode ec) {
+        on_accept(shard, ec);
       }
   );
 }
 
-void Server::on_accept(ErrorCode ec) {
+void Server::on_accept(Shard& shard, ErrorCode ec) {
   if (ec) {
     LOG_ERROR("Accept() failed: {}", ec.message());
     return;
   }
 
-  auto& addr = m_next_client_address;
-  auto [it, _] = m_clients.emplace(
+  auto& addr = shard.next_client_address;
+  const ClientID id = shard.next_client_id++ * m_shards.size() + shard.index;
+  auto [it, _] = shard.clients.emplace(
     std::piecewise_construct,
-    std::forward_as_tuple(m_next_client_id++),
+    std::forward_as_tuple(id),
     std::forward_as_tuple(
       fmt::format("{}:{}", addr.address().to_string(), addr.port()),
-      std::move(m_next_client)
+      addr.address(),
+      std::move(shard.next_client)
     )
   );
 
   LOG_INFO("[{}] New client connected", it->second.address);
-  start_read(it);
-  start_accept();
+
+  // NOTE: data is read only when socket is readable, see on_readable()
+  it->second.socket.non_blocking(true, ec);
+  if (ec) {
+    on_close(shard, it, ec);
+    start_accept(shard);
+    return;
+  }
+
+  start_read(shard, it);
+  start_accept(shard);
 }
 
-void Server::start_read(ClientIter it) {
+void Server::start_read(Shard& shard, ClientIter it) {
   auto id = it->first;
   auto& client = it->second;
-  assert(client.to_receive > client.received);
-
-  u8* p = client.recv_buffer.data() + client.received;
-  usize n = client.to_receive - client.received;
-  client.socket.async_read_some(
-    net::span(p, n),
-    [this, id](ErrorCode ec, usize n) {
-      auto it = m_clients.find(id);
-      if (it == m_clients.end()) {
+
+  // NOTE: buffer is only taken when there is something to read,
+  //       so idle clients don't hold any
+  client.socket.async_wait(
+    net::tcp::Socket::wait_read,
+    [this, &shard, id](ErrorCode ec) {
+      auto it = shard.clients.find(id);
+      if (it == shard.clients.end()) {
+        return;
+      }
+
+      if (ec) {
+        on_close(shard, it, ec);
         return;
       }
 
-      on_read(it, ec, n);
+      on_readable(shard, it);
     }
   );
 }
 
-void Server::on_read(ClientIter it, ErrorCode ec, usize n) {
+void Server::on_readable(Shard& shard, ClientIter it) {
   auto& client = it->second;
+  auto& buffer = client.recv_buffer;
+  if (buffer.empty()) {
+    buffer = acquire_buffer(shard);
+    buffer.resize(INITIAL_BUFFER_SIZE);
+  } else if (client.received == buffer.size()) {
+    // NOTE: message size is checked before buffer is full, see on_read()
+    buffer.resize(std::min(buffer.size() * 2, sizeof(u32) + MAX_MESSAGE_SIZE));
+  }
+
+  ErrorCode ec;
+  const usize n = client.socket.read_some(
+    net::span(buffer.data() + client.received, buffer.size() - client.received),
+    ec
+  );
+
+  if (ec == std::errc::operation_would_block) {
+    start_read(shard, it);
+    return;
+  }
+
+  on_read(shard, it, ec, n);
+}
+
+void Server::on_read(Shard& shard, ClientIter it, ErrorCode ec, usize n) {
   if (ec) {
-    on_close(it, ec);
+    on_close(shard, it, ec);
     return;
   }
 
-  client.received += n;
-  while (auto message_size = client.message_size()) {
+  it->second.received += n;
+  while (true) {
+    auto& client = it->second;
+    auto message_size = client.message_size();
+    if (!message_size) {
+      break;
+    }
+
     if (*message_size >= MAX_MESSAGE_SIZE) {
       LOG_ERROR(
         "[{}] Client request size ({}) exceeds max allowed message size ({})",
         client.address, *message_size, MAX_MESSAGE_SIZE
       );
-      on_close(it, ec);
+      on_close(shard, it, ec);
       return;
     }
 
-    client.to_receive = sizeof(u32) + *message_size;
-    if (client.received < client.to_receive) {
+    const usize to_receive = sizeof(u32) + *message_size;
+    if (client.received < to_receive) {
+      if (client.recv_buffer.size() < to_receive) {
+        client.recv_buffer.resize(to_receive);
+      }
       break;
     }
 
-    proto::ClientMessage message;
+    // NOTE: message and responses to it are allocated on arena,
+    //       which is reset as soon as message is handled
+    auto* message = google::protobuf::Arena::CreateMessage<proto::ClientMessage>(&shard.arena);
     auto* p = client.recv_buffer.data() + sizeof(u32);
-    if (!message.ParseFromArray(p, *message_size)) {
+    if (!message->ParseFromArray(p, static_cast<int>(*message_size))) {
+      shard.arena.Reset();
       LOG_ERROR("[{}] Client request is invalid", client.address);
-      on_close(it, ec);
+      on_close(shard, it, ec);
       return;
     }
 
-    on_message(it, message);
-    auto extra_bytes = client.to_receive - client.received;
+    const usize extra_bytes = client.received - to_receive;
     std::memmove(client.recv_buffer.data(), p + *message_size, extra_bytes);
-
     client.received = extra_bytes;
-    client.to_receive = sizeof(client.recv_buffer);
+
+    // NOTE: message handler might close the connection
+    const auto id = it->first;
+    on_message(shard, it, *message);
+    shard.arena.Reset();
+    it = shard.clients.find(id);
+    if (it == shard.clients.end()) {
+      return;
+    }
   }
 
-  start_read(it);
+  if (it->second.received == 0) {
+    release_buffer(shard, std::move(it->second.recv_buffer));
+  }
+
+  start_read(shard, it);
 }
 
-void Server::on_close(ClientIter it, ErrorCode ec) {
+void Server::on_close(Shard& shard, ClientIter it, ErrorCode ec) {
   auto& client = it->second;
   if (ec) {
     LOG_ERROR("[{}] Closing connection due to error: {}", client.address, ec.message());
@@ -143,26 +273,481 @@ void Server::on_close(ClientIter it, ErrorCode ec) {
     LOG_INFO("[{}] Closing connection", client.address);
   }
 
-  client.socket.shutdown(net::tcp::Socket::shutdown_both);
-  client.socket.close();
-  m_clients.erase(it);
+  {
+    std::lock_guard<std::mutex> lock(m_sessions_mutex);
+
+    // owner won't get requests of this client anymore
+    for (const auto& id : client.connecting) {
+      auto session = m_sessions.find(id);
+      if (session == m_sessions.end()) {
+        continue;
+      }
+
+      const auto is_client = [&](const PendingConnect& p) { return p.client == it->first; };
+      auto& pending = session->second.pending;
+      pending.erase(std::remove_if(pending.begin(), pending.end(), is_client), pending.end());
+      auto& answered = session->second.answered;
+      answered.erase(std::remove_if(answered.begin(), answered.end(), is_client), answered.end());
+    }
+
+    // sessions are closed along with their owner,
+    // clients that are still waiting for connection info are notified
+    for (const auto& id : client.sessions) {
+      auto session = m_sessions.find(id);
+      if (session == m_sessions.end()) {
+        continue;
+      }
+
+      cancel_pending(shard, id, session->second.pending);
+      LOG_INFO("[{}] Session {} closed", client.address, id);
+      m_sessions.erase(session);
+    }
+  }
+
+  for (const auto& relay : client.relays) {
+    const auto& stats = relay->stats();
+    LOG_INFO("[{}] Relay closed, {} packets ({} bytes) relayed, {} dropped",
+             client.address, stats.packets, stats.bytes, stats.dropped);
+    relay->stop();
+  }
+
+  // NOTE: socket may be already closed by peer
+  ErrorCode ignored;
+  client.socket.shutdown(net::tcp::Socket::shutdown_both, ignored);
+  client.socket.close(ignored);
+  release_buffer(shard, std::move(client.recv_buffer));
+  shard.clients.erase(it);
 }
 
-void Server::on_message(ClientIter it, const proto::ClientMessage& message) {
+void Server::on_message(Shard& shard, ClientIter it, const proto::ClientMessage& message) {
   auto& client = it->second;
-  LOG_INFO("[{}] Received: {}", client.address, message.DebugString());
+  if (LOG_ENABLED(debug)) {
+    LOG_DEBUG("[{}] Received: {}", client.address, message.ShortDebugString());
+  }
 
   if (message.has_open()) {
-
+    on_open(shard, it, message);
   } else if (message.has_connect()) {
-
+    on_connect(shard, it, message);
   } else if (message.has_close()) {
-
+    on_session_close(shard, it, message);
   } else if (message.has_list()) {
-
+    on_list(shard, it, message);
+  } else if (message.has_relay()) {
+    on_relay(shard, it, message);
   } else {
-    // send error
+    // NOTE: protocol has no error response
+    LOG_WARN("[{}] Unknown request {}", client.address, message.request_id());
+  }
+}
+
+void Server::on_open(Shard& shard, ClientIter it, const proto::ClientMessage& message) {
+  auto& client = it->second;
+
+  auto& response = create_message(shard);
+  response.set_request_id(message.request_id());
+  auto* open = response.mutable_open();
+
+  const auto& name = message.open().name();
+  if (name.empty()) {
+    open->set_success(false);
+    send(shard, it, response);
+    return;
+  }
+
+  SessionID id;
+  {
+    std::lock_guard<std::mutex> lock(m_sessions_mutex);
+    id = generate_id();
+    m_sessions.emplace(id, Session{name, it->first, client.ip, {}, {}});
+  }
+
+  client.sessions.push_back(id);
+  LOG_INFO("[{}] Session {} ({}) opened", client.address, id, name);
+
+  open->set_success(true);
+  open->set_id(std::move(id));
+  send(shard, it, response);
+}
+
+void Server::on_session_close(Shard& shard, ClientIter it, const proto::ClientMessage& message) {
+  auto& client = it->second;
+  const auto& id = message.close().id();
+
+  auto& response = create_message(shard);
+  response.set_request_id(message.request_id());
+  auto* close = response.mutable_close();
+  close->set_id(id);
+
+  {
+    std::lock_guard<std::mutex> lock(m_sessions_mutex);
+
+    // only owner can close the session
+    auto session = m_sessions.find(id);
+    if (session == m_sessions.end() || session->second.owner != it->first) {
+      close->set_success(false);
+      send(shard, it, response);
+      return;
+    }
+
+    cancel_pending(shard, id, session->second.pending);
+    m_sessions.erase(session);
+  }
+
+  auto& sessions = client.sessions;
+  sessions.erase(std::find(sessions.begin(), sessions.end(), id));
+  LOG_INFO("[{}] Session {} closed", client.address, id);
+
+  close->set_success(true);
+  send(shard, it, response);
+}
+
+// Connect request of a client is relayed to session owner along with client's
+// connection info, under request id assigned by server. Owner answers with
+// Connect request for its own session with the same request id, its
+// connection info is relayed back to the client. Empty address in
+// response means that connection is not possible.
+void Server::on_connect(Shard& shard, ClientIter it, const proto::ClientMessage& message) {
+  const auto& id = message.connect().id();
+
+  std::unique_lock<std::mutex> lock(m_sessions_mutex);
+  auto session = m_sessions.find(id);
+  if (session == m_sessions.end()) {
+    lock.unlock();
+
+    auto& response = create_message(shard);
+    response.set_request_id(message.request_id());
+    response.mutable_connect()->set_id(id);
+    send(shard, it, response);
+    return;
+  }
+
+  auto& pending = session->second.pending;
+  if (session->second.owner == it->first) {
+    // owner's answer carries id of the relayed request
+    // NOTE: requests of disconnected clients are removed in on_close(),
+    //       answers to them are dropped here
+    auto answered = std::find_if(pending.begin(), pending.end(), [&](const PendingConnect& p) {
+      return p.relay_id == message.request_id();
+    });
+
+    if (answered == pending.end()) {
+      lock.unlock();
+      LOG_WARN("[{}] Unexpected answer {} for session {}", it->second.address, message.request_id(), id);
+      return;
+    }
+
+    const auto request = *answered;
+    pending.erase(answered);
+
+    // client may request a relay for this session from now on
+    auto& connected = session->second.answered;
+    auto previous = std::find_if(connected.begin(), connected.end(), [&](const PendingConnect& p) {
+      return p.client == request.client;
+    });
+    if (previous != connected.end()) {
+      *previous = request;
+    } else {
+      connected.push_back(request);
+    }
+    lock.unlock();
+
+    auto& response = create_message(shard);
+    response.set_request_id(request.request_id);
+    *response.mutable_connect() = message.connect();
+    send_to(shard, request.client, response);
+    return;
   }
+
+  auto& connecting = it->second.connecting;
+  if (std::find(connecting.begin(), connecting.end(), id) == connecting.end()) {
+    connecting.push_back(id);
+  }
+
+  // NOTE: ids of client requests aren't unique across clients
+  const u32 relay_id = session->second.next_relay_id++;
+
+  auto& request = create_message(shard);
+  request.set_request_id(relay_id);
+  auto* connect = request.mutable_connect();
+  connect->set_id(id);
+  // fall back to address observed by server
+  connect->set_address(message.connect().address().empty() ? it->second.address
+                                                           : message.connect().address());
+
+  pending.push_back(PendingConnect{it->first, message.request_id(), relay_id});
+  post_to(shard, session->second.owner, request);
+}
+
+void Server::on_list(Shard& shard, ClientIter it, const proto::ClientMessage& message) {
+  auto& response = create_message(shard);
+  response.set_request_id(message.request_id());
+  auto* list = response.mutable_list();
+
+  {
+    std::lock_guard<std::mutex> lock(m_sessions_mutex);
+
+    // NOTE: list is truncated to fit into single message,
+    //       each entry also takes a few bytes for tag and length
+    usize size = response.ByteSizeLong();
+    for (const auto& [id, session] : m_sessions) {
+      size += session.name.size() + id.size() + 10;
+      if (size >= MAX_MESSAGE_SIZE) {
+        LOG_WARN("[{}] List of sessions is truncated to {} entries", it->second.address, list->sessions_size());
+        break;
+      }
+
+      auto* description = list->add_sessions();
+      description->set_name(session.name);
+      description->set_id(id);
+    }
+  }
+
+  send(shard, it, response);
+}
+
+// Relay request of a client allocates two relay ports, client gets one of
+// them in response and session owner gets the other one under relay id of
+// client's Connect request. Only clients with pending or answered Connect
+// for the session may request a relay. Relay lives on the shard of the
+// client until the client disconnects.
+void Server::on_relay(Shard& shard, ClientIter it, const proto::ClientMessage& message) {
+  auto& client = it->second;
+  const auto& id = message.relay().id();
+
+  auto& response = create_message(shard);
+  response.set_request_id(message.request_id());
+  auto* relay_response = response.mutable_relay();
+  relay_response->set_id(id);
+
+  if (!m_relay_enabled || client.relays.size() >= MAX_RELAYS_PER_CLIENT) {
+    relay_response->set_success(false);
+    send(shard, it, response);
+    return;
+  }
+
+  std::optional<ClientID> owner;
+  net::IpAddress owner_ip;
+  u32 relay_id = 0;
+  {
+    std::lock_guard<std::mutex> lock(m_sessions_mutex);
+    auto session = m_sessions.find(id);
+    if (session != m_sessions.end()) {
+      const auto is_client = [&](const PendingConnect& p) { return p.client == it->first; };
+      const auto& pending = session->second.pending;
+      const auto& answered = session->second.answered;
+
+      // NOTE: latest request is used, owner may have dropped earlier ones
+      auto request = std::find_if(pending.rbegin(), pending.rend(), is_client);
+      if (request != pending.rend()) {
+        owner = session->second.owner;
+        relay_id = request->relay_id;
+      } else if (auto request = std::find_if(answered.begin(), answered.end(), is_client);
+                 request != answered.end()) {
+        owner = session->second.owner;
+        relay_id = request->relay_id;
+      }
+      owner_ip = session->second.owner_ip;
+    }
+  }
+
+  if (!owner) {
+    LOG_WARN("[{}] Relay for session {} requested without Connect", client.address, id);
+    relay_response->set_success(false);
+    send(shard, it, response);
+    return;
+  }
+
+  // NOTE: port 0 is for the owner, port 1 for the client
+  auto relay = net::ice::Relay::create(shard.context, any_addr(), { owner_ip, client.ip });
+  if (auto e = relay.err()) {
+    LOG_ERROR("[{}] Failed to allocate relay: {}", client.address, e.message());
+    relay_response->set_success(false);
+    send(shard, it, response);
+    return;
+  }
+
+  (*relay)->start();
+  client.relays.push_back(*relay);
+  const auto ports = (*relay)->ports();
+  LOG_INFO("[{}] Relay {}-{} allocated for session {}", client.address, ports[0], ports[1], id);
+
+  relay_response->set_success(true);
+  relay_response->set_port(ports[0]);
+  response.set_request_id(relay_id);
+  send_to(shard, *owner, response);
+
+  relay_response->set_port(ports[1]);
+  response.set_request_id(message.request_id());
+  send(shard, it, response);
+}
+
+void Server::send(Shard& shard, ClientIter it, const proto::ServerMessage& message) {
+  auto& client = it->second;
+  auto& queue = client.send_queue;
+  if (queue.capacity() == 0) {
+    queue = acquire_buffer(shard);
+  }
+
+  // NOTE: message is serialized right into the write queue
+  if (!append_message(queue, message)) {
+    LOG_ERROR("[{}] Failed to serialize response", client.address);
+    return;
+  }
+
+  if (!client.sending) {
+    start_write(shard, it);
+  }
+}
+
+void Server::send(Shard& shard, ClientIter it, const Buffer& messages) {
+  auto& client = it->second;
+  auto& queue = client.send_queue;
+  if (queue.capacity() == 0) {
+    queue = acquire_buffer(shard);
+  }
+
+  queue.insert(queue.end(), messages.begin(), messages.end());
+  if (!client.sending) {
+    start_write(shard, it);
+  }
+}
+
+void Server::send_to(Shard& current, ClientID id, const proto::ServerMessage& message) {
+  auto& shard = *m_shards[id % m_shards.size()];
+  if (&shard != &current) {
+    post_to(current, id, message);
+    return;
+  }
+
+  auto it = shard.clients.find(id);
+  if (it != shard.clients.end()) {
+    send(shard, it, message);
+  }
+}
+
+void Server::post_to(Shard& current, ClientID id, const proto::ServerMessage& message) {
+  // NOTE: message is serialized by current shard, so it doesn't
+  //       have to be copied out of the arena
+  auto data = acquire_buffer(current);
+  if (!append_message(data, message)) {
+    LOG_ERROR("Failed to serialize message for client {}", id);
+    release_buffer(current, std::move(data));
+    return;
+  }
+
+  auto& shard = *m_shards[id % m_shards.size()];
+  asio::post(shard.context, [this, &shard, id, data = std::move(data)]() mutable {
+    auto it = shard.clients.find(id);
+    if (it != shard.clients.end()) {
+      send(shard, it, data);
+    }
+
+    release_buffer(shard, std::move(data));
+  });
+}
+
+bool Server::append_message(Buffer& buffer, const proto::ServerMessage& message) {
+  const usize size = message.ByteSizeLong();
+  if (size >= MAX_MESSAGE_SIZE) {
+    // NOTE: list of sessions is truncated, so it shouldn't happen
+    return false;
+  }
+
+  const usize offset = buffer.size();
+  buffer.resize(offset + sizeof(u32) + size);
+  write_u32_le(buffer.data() + offset, static_cast<u32>(size));
+  if (!message.SerializeToArray(buffer.data() + offset + sizeof(u32), static_cast<int>(size))) {
+    buffer.resize(offset);
+    return false;
+  }
+
+  return true;
+}
+
+proto::ServerMessage& Server::create_message(Shard& shard) {
+  return *google::protobuf::Arena::CreateMessage<proto::ServerMessage>(&shard.arena);
+}
+
+void Server::cancel_pending(Shard& shard, const SessionID& id, const std::deque<PendingConnect>& pending) {
+  for (const auto& request : pending) {
+    proto::ServerMessage response;
+    response.set_request_id(request.request_id);
+    response.mutable_connect()->set_id(id);
+    send_to(shard, request.client, response);
+  }
+}
+
+void Server::start_write(Shard& shard, ClientIter it) {
+  auto id = it->first;
+  auto& client = it->second;
+  if (client.send_queue.empty()) {
+    return;
+  }
+
+  // NOTE: messages queued while writing are sent with next write
+  std::swap(client.send_buffer, client.send_queue);
+  client.sending = true;
+  asio::async_write(
+    client.socket,
+    net::span(client.send_buffer.data(), client.send_buffer.size()),
+    [this, &shard, id](ErrorCode ec, usize /* n */) {
+      auto it = shard.clients.find(id);
+      if (it == shard.clients.end()) {
+        return;
+      }
+
+      auto& client = it->second;
+      client.sending = false;
+      if (ec) {
+        on_close(shard, it, ec);
+        return;
+      }
+
+      release_buffer(shard, std::move(client.send_buffer));
+
+      start_write(shard, it);
+    }
+  );
+}
+
+Server::Buffer Server::acquire_buffer(Shard& shard) {
+  if (shard.pool.empty()) {
+    Buffer buffer;
+    buffer.reserve(INITIAL_BUFFER_SIZE);
+    return buffer;
+  }
+
+  auto buffer = std::move(shard.pool.back());
+  shard.pool.pop_back();
+  return buffer;
+}
+
+void Server::release_buffer(Shard& shard, Buffer&& buffer) {
+  Buffer released = std::move(buffer);
+  buffer = Buffer();
+
+  // NOTE: buffers grown by large messages are freed
+  if (released.capacity() != INITIAL_BUFFER_SIZE || shard.pool.size() >= MAX_POOLED_BUFFERS) {
+    return;
+  }
+
+  released.clear();
+  shard.pool.push_back(std::move(released));
+}
+
+Server::SessionID Server::generate_id() {
+  static const char DIGITS[] = "0123456789abcdef";
+
+  SessionID id(16, '0');
+  do {
+    const u64 value = static_cast<u64>(m_random()) << 32 | m_random();
+    for (usize i = 0; i < id.size(); ++i) {
+      id[i] = DIGITS[(value >> (4 * i)) & 0xf];
+    }
+  } while (m_sessions.count(id) != 0);
+
+  return id;
 }
 
-} // namespace shar
\ No newline at end of file
+} // namespace shar
@@ -1,38 +1,85 @@
 #pragma once
 
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <thread>
 #include <unordered_map>
 #include <string>
+#include <vector>
 
 #include "net/types.hpp"
+#include "net/ice/relay.hpp"
 #include "byteorder.hpp"
 
+#include "disable_warnings_push.hpp"
+#include <google/protobuf/arena.h>
+#include "disable_warnings_pop.hpp"
+
 
 namespace proto {
 class ClientMessage;
+class ServerMessage;
 }
 
 namespace shar {
 
+// Signaling server. Keeps registry of open sessions and relays
+// connection info between session owner and clients connecting to it.
+// Clients are sharded across threads, each shard has its own io_context
+// and listener (SO_REUSEPORT), so accepted connections are spread by kernel.
+// Optionally allocates UDP relays for peers that can't connect directly.
 class Server {
 public:
-  Server();
+  // |threads| is number of shards, 0 means one per CPU core,
+  // |port| 0 means any free port
+  explicit Server(usize threads = 0, bool relay = false, net::Port port = 1337);
+  ~Server();
+
+  // start() doesn't block, run() waits until the server is stopped
+  void start();
   void run();
+  void stop();
+
+  // NOTE: valid after start()
+  net::Port port() const noexcept;
 
 private:
   static const usize MAX_MESSAGE_SIZE = 1024 * 16 - sizeof(u32);
 
+  // buffers are taken from the pool only while client has data to read
+  // or write, they start small and grow up to MAX_MESSAGE_SIZE on demand
+  static const usize INITIAL_BUFFER_SIZE = 256;
+
+  // max number of free buffers kept in the pool of each shard
+  static const usize MAX_POOLED_BUFFERS = 1024;
+
+  // size of arena block reused for each message, large enough
+  // for any request and response to it
+  static const usize ARENA_BLOCK_SIZE = 64 * 1024;
+
+  // max number of relays requested by one client at once
+  static const usize MAX_RELAYS_PER_CLIENT = 4;
+
+  using Buffer = std::vector<u8>;
+
+  // NOTE: shard of the client is |id % shards|
   using ClientID = usize;
+  using SessionID = std::string;
+
   struct Client {
-    Client(std::string addr, net::tcp::Socket s)
+    Client(std::string addr, net::IpAddress client_ip, net::tcp::Socket s)
       : address(std::move(addr))
+      , ip(client_ip)
       , socket(std::move(s))
     {}
 
     std::string address;
+    net::IpAddress ip;
     net::tcp::Socket socket;
 
-    using Buffer = std::array<u8, MAX_MESSAGE_SIZE>;
-
     std::optional<u32> message_size() {
       if (received < 4) {
         return std::nullopt;
@@ -41,30 +88,115 @@ private:
       return read_u32_le(recv_buffer.data());
     }
 
-    Buffer recv_buffer;
+    Buffer recv_buffer; // empty if there is no partially received message
     usize received{0};
-    usize to_receive{sizeof(Buffer)};
 
-    Buffer send_buffer;
-    usize sent{0};
-    usize to_send{0};
+    Buffer send_buffer; // messages being written
+    Buffer send_queue;  // messages queued while previous ones are being written
+    bool sending{false};
+
+    std::vector<SessionID> sessions;   // sessions opened by this client
+    std::vector<SessionID> connecting; // sessions this client sent Connect request for
+
+    // relays requested by this client, they are stopped when it disconnects
+    std::vector<std::shared_ptr<net::ice::Relay>> relays;
   };
   using ClientMap = std::unordered_map<ClientID, Client>;
   using ClientIter = ClientMap::iterator;
 
-  void start_accept();
-  void on_accept(ErrorCode ec);
-  void start_read(ClientIter it);
-  void on_read(ClientIter it, ErrorCode ec, usize n);
-  void on_close(ClientIter it, ErrorCode ec);
-  void on_message(ClientIter it, const proto::ClientMessage&);
-
-  net::IOContext m_context;
-  net::tcp::Acceptor m_listener;
-  net::tcp::Endpoint m_next_client_address;
-  net::tcp::Socket m_next_client;
-  usize m_next_client_id{ 0 };
-  ClientMap m_clients;
+  // clients served by one thread
+  // NOTE: all fields are only accessed from the shard's thread
+  struct Shard {
+    Shard(usize index);
+
+    usize index;
+    net::IOContext context;
+    net::tcp::Acceptor listener;
+    net::tcp::Endpoint next_client_address;
+    net::tcp::Socket next_client;
+    usize next_client_id{ 0 };
+    ClientMap clients;
+    std::vector<Buffer> pool;
+
+    // NOTE: reset after each message, its first block is never freed
+    std::vector<char> arena_block;
+    google::protobuf::Arena arena;
+  };
+
+  // client waiting for session owner's connection info,
+  // kept as answered after the owner replies
+  struct PendingConnect {
+    ClientID client;
+    u32 request_id; // id of client's request
+    u32 relay_id;   // id of request relayed to owner, owner answers with it
+  };
+
+  struct Session {
+    std::string name;
+    ClientID owner;
+    net::IpAddress owner_ip; // only relay port of the owner accepts datagrams from it
+    std::deque<PendingConnect> pending;
+    std::vector<PendingConnect> answered; // latest answered request of each client
+    u32 next_relay_id{ 0 };
+  };
+  using SessionMap = std::unordered_map<SessionID, Session>;
+
+  void start_accept(Shard& shard);
+  void on_accept(Shard& shard, ErrorCode ec);
+  void start_read(Shard& shard, ClientIter it);
+  void on_readable(Shard& shard, ClientIter it);
+  void on_read(Shard& shard, ClientIter it, ErrorCode ec, usize n);
+  void on_close(Shard& shard, ClientIter it, ErrorCode ec);
+  void on_message(Shard& shard, ClientIter it, const proto::ClientMessage&);
+
+  void on_open(Shard& shard, ClientIter it, const proto::ClientMessage&);
+  void on_session_close(Shard& shard, ClientIter it, const proto::ClientMessage&);
+  void on_connect(Shard& shard, ClientIter it, const proto::ClientMessage&);
+  void on_list(Shard& shard, ClientIter it, const proto::ClientMessage&);
+  void on_relay(Shard& shard, ClientIter it, const proto::ClientMessage&);
+
+  // add |message| to write queue of client
+  void send(Shard& shard, ClientIter it, const proto::ServerMessage& message);
+
+  // add already serialized |messages| to write queue of client
+  void send(Shard& shard, ClientIter it, const Buffer& messages);
+  void start_write(Shard& shard, ClientIter it);
+
+  // send |message| to client that might belong to other shard
+  // NOTE: does nothing if client is disconnected
+  void send_to(Shard& current, ClientID id, const proto::ServerMessage& message);
+
+  // same as send_to(), but message is always queued to client's shard,
+  // so messages posted with |m_sessions_mutex| locked keep that order
+  void post_to(Shard& current, ClientID id, const proto::ServerMessage& message);
+
+  // append |message| prefixed with its size to |buffer|
+  static bool append_message(Buffer& buffer, const proto::ServerMessage& message);
+
+  // message allocated on arena of |shard|, valid until
+  // handling of current client message is finished
+  static proto::ServerMessage& create_message(Shard& shard);
+
+  // notify clients waiting for connection info that session is gone
+  void cancel_pending(Shard& shard, const SessionID& id, const std::deque<PendingConnect>& pending);
+
+  Buffer acquire_buffer(Shard& shard);
+
+  // return |buffer| to the pool, leaves it empty
+  void release_buffer(Shard& shard, Buffer&& buffer);
+
+  // NOTE: should be called with |m_sessions_mutex| locked
+  SessionID generate_id();
+
+  bool m_relay_enabled;
+  net::Port m_port;
+  std::vector<std::unique_ptr<Shard>> m_shards;
+  std::vector<std::thread> m_threads;
+
+  // NOTE: session registry is shared by all shards
+  std::mutex m_sessions_mutex;
+  SessionMap m_sessions;
+  std::random_device m_random;
 };
 
-}
\ No newline at end of file
+}
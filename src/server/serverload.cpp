@@ -0,0 +1,229 @@
+#include <array>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "byteorder.hpp"
+#include "net/types.hpp"
+#include "net/dns.hpp"
+#include "time.hpp"
+
+#include "disable_warnings_push.hpp"
+#include <asio/read.hpp>
+#include <protocol.pb.h>
+#include "disable_warnings_pop.hpp"
+
+
+using namespace shar;
+using namespace shar::net;
+
+// Signaling server scale test. Connects many clients and reports resident
+// memory of the server (if its pid is given). In idle mode each client sends
+// one List request and then stays idle, to find out how much each idle client
+// costs. In busy mode each client opens a session and then sends List requests
+// back to back, to measure throughput of the server.
+
+struct Client : std::enable_shared_from_this<Client> {
+  enum class State {
+    Connecting,
+    Waiting,   // request sent
+    Idle,      // response received
+    Failed
+  };
+
+  Client(IOContext& context, bool busy)
+    : m_socket(context)
+    , m_busy(busy)
+  {}
+
+  void start(const tcp::Endpoint& server) {
+    m_socket.async_connect(server, [this, self = shared_from_this()](const ErrorCode& ec) {
+      if (ec) {
+        m_state = State::Failed;
+        return;
+      }
+
+      proto::ClientMessage message;
+      message.set_request_id(m_next_request_id++);
+      if (m_busy) {
+        message.mutable_open()->set_name("serverload");
+      } else {
+        message.mutable_list();
+      }
+
+      request(message);
+    });
+  }
+
+  void request(const proto::ClientMessage& message) {
+    const auto size = static_cast<u32>(message.ByteSizeLong());
+    m_out.resize(sizeof(u32) + size);
+    write_u32_le(m_out.data(), size);
+    message.SerializeToArray(m_out.data() + sizeof(u32), static_cast<int>(size));
+
+    m_state = State::Waiting;
+    asio::async_write(m_socket, span(m_out.data(), m_out.size()),
+                      [this, self = shared_from_this()](const ErrorCode& ec, usize /* size */) {
+      if (ec) {
+        m_state = State::Failed;
+        return;
+      }
+
+      if (m_busy) {
+        receive_response();
+      } else {
+        receive();
+      }
+    });
+  }
+
+  void receive() {
+    m_socket.async_read_some(span(m_in.data(), m_in.size()),
+                             [this, self = shared_from_this()](const ErrorCode& ec, usize /* size */) {
+      if (ec) {
+        m_state = State::Failed;
+        return;
+      }
+
+      // NOTE: response is not parsed, it only proves that server is alive
+      m_state = State::Idle;
+      receive();
+    });
+  }
+
+  // read one length-prefixed response and send next List request
+  void receive_response() {
+    asio::async_read(m_socket, span(m_in.data(), sizeof(u32)),
+                     [this, self = shared_from_this()](const ErrorCode& ec, usize /* size */) {
+      if (ec) {
+        m_state = State::Failed;
+        return;
+      }
+
+      m_response.resize(read_u32_le(m_in.data()));
+      asio::async_read(m_socket, span(m_response.data(), m_response.size()),
+                       [this, self](const ErrorCode& ec, usize /* size */) {
+        proto::ServerMessage response;
+        if (ec || !response.ParseFromArray(m_response.data(), static_cast<int>(m_response.size()))) {
+          m_state = State::Failed;
+          return;
+        }
+
+        if (response.has_open() && !response.open().success()) {
+          m_state = State::Failed;
+          return;
+        }
+
+        m_state = State::Idle;
+        m_responses += response.has_list();
+
+        proto::ClientMessage message;
+        message.set_request_id(m_next_request_id++);
+        message.mutable_list();
+        request(message);
+      });
+    });
+  }
+
+  State m_state{ State::Connecting };
+  tcp::Socket m_socket;
+  bool m_busy;
+  u32 m_next_request_id{ 1 };
+  usize m_responses{ 0 }; // List responses received in busy mode
+  std::vector<u8> m_out;
+  std::vector<u8> m_response;
+  std::array<u8, 256> m_in;
+};
+
+// VmRSS of process with |pid| (in kbytes), 0 if unknown
+static usize resident_memory(const std::string& pid) {
+  std::ifstream status("/proc/" + pid + "/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.rfind("VmRSS:", 0) == 0) {
+      return static_cast<usize>(std::stoul(line.substr(6)));
+    }
+  }
+  return 0;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    std::cout << "Usage: serverload <address> <port> [clients=1000] [server pid|-] [seconds=10] [idle|busy] [threads=1]" << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  const char* hostname = argv[1];
+  const auto port = static_cast<Port>(std::stoi(argv[2]));
+  const usize count = argc > 3 ? static_cast<usize>(std::stoul(argv[3])) : 1000;
+  const std::string pid = argc > 4 && std::string(argv[4]) != "-" ? argv[4] : "";
+  const usize duration = argc > 5 ? static_cast<usize>(std::stoul(argv[5])) : 10;
+  const bool busy = argc > 6 && std::string(argv[6]) == "busy";
+  const usize threads = argc > 7 ? static_cast<usize>(std::stoul(argv[7])) : 1;
+
+  try {
+    auto address = dns::resolve(hostname, port);
+    if (auto e = address.err()) {
+      std::cerr << "Failed to resolve " << hostname << ':' << e.message() << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    // NOTE: memory of the server before any client is connected
+    const usize baseline = pid.empty() ? 0 : resident_memory(pid);
+
+    IOContext context;
+    const tcp::Endpoint server{ *address, port };
+
+    std::vector<std::shared_ptr<Client>> clients;
+    for (usize i = 0; i < count; ++i) {
+      clients.push_back(std::make_shared<Client>(context, busy));
+      clients.back()->start(server);
+    }
+
+    usize last_responses = 0;
+    for (usize second = 1; second <= duration; ++second) {
+      // NOTE: handlers of each client are never run concurrently,
+      //       threads are joined before clients are inspected
+      std::vector<std::thread> runners;
+      for (usize i = 0; i < threads; ++i) {
+        runners.emplace_back([&context] { context.run_for(Seconds(1)); });
+      }
+      for (auto& runner : runners) {
+        runner.join();
+      }
+
+      usize idle = 0;
+      usize failed = 0;
+      usize responses = 0;
+      for (const auto& client : clients) {
+        // NOTE: busy clients keep switching between waiting and idle
+        idle += busy ? client->m_state == Client::State::Waiting || client->m_state == Client::State::Idle
+                     : client->m_state == Client::State::Idle;
+        failed += client->m_state == Client::State::Failed;
+        responses += client->m_responses;
+      }
+
+      std::cout << second << "s: " << idle << "/" << count << (busy ? " active, " : " idle, ") << failed << " failed";
+      if (busy) {
+        std::cout << ", " << responses - last_responses << " requests/s";
+        last_responses = responses;
+      }
+      if (!pid.empty()) {
+        const usize rss = resident_memory(pid);
+        const usize growth = rss > baseline ? rss - baseline : 0;
+        std::cout << ", server RSS " << rss << " KB"
+                  << " (" << (idle != 0 ? growth * 1024 / idle : 0) << " bytes per client)";
+      }
+      std::cout << std::endl;
+    }
+  }
+  catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,129 @@
+#include <vector>
+
+#include "int.hpp"
+#include "byteorder.hpp"
+
+// clang-format off
+#include "disable_warnings_push.hpp"
+#include <benchmark/benchmark.h>
+#include <google/protobuf/arena.h>
+#include <protocol.pb.h>
+#include "disable_warnings_pop.hpp"
+// clang-format on
+
+
+using namespace shar;
+
+// Signaling server message path: parse a request, build a response and
+// serialize it into the write queue, as Server::on_read() does. Runs on a
+// single thread, so items per second are messages per second per core.
+
+using Buffer = std::vector<u8>;
+
+static void append_message(Buffer& buffer, const google::protobuf::MessageLite& message) {
+  const usize size = message.ByteSizeLong();
+  const usize offset = buffer.size();
+  buffer.resize(offset + sizeof(u32) + size);
+  write_u32_le(buffer.data() + offset, static_cast<u32>(size));
+  message.SerializeToArray(buffer.data() + offset + sizeof(u32), static_cast<int>(size));
+}
+
+// requests as received from clients, prefixed with their size
+static Buffer make_requests() {
+  Buffer requests;
+  for (u32 i = 0; i < 64; ++i) {
+    proto::ClientMessage message;
+    message.set_request_id(i);
+    if (i % 2 == 0) {
+      message.mutable_list();
+    } else {
+      auto* connect = message.mutable_connect();
+      connect->set_id("9f86d081884c7d65");
+      connect->set_address("192.168.1.10:40000");
+    }
+    append_message(requests, message);
+  }
+  return requests;
+}
+
+// fill |response| for |request|, list has a few sessions
+static void respond(const proto::ClientMessage& request, proto::ServerMessage& response) {
+  response.set_request_id(request.request_id());
+  if (request.has_list()) {
+    auto* list = response.mutable_list();
+    for (usize i = 0; i < 8; ++i) {
+      auto* description = list->add_sessions();
+      description->set_name("desktop");
+      description->set_id("9f86d081884c7d65");
+    }
+  } else {
+    *response.mutable_connect() = request.connect();
+  }
+}
+
+// handle all |requests| per iteration, |handle| returns false on error
+template <typename F>
+static void handle_all(benchmark::State& state, F handle) {
+  const auto requests = make_requests();
+  Buffer queue;
+  usize count = 0;
+
+  for (auto _ : state) {
+    usize offset = 0;
+    while (offset < requests.size()) {
+      const u32 size = read_u32_le(requests.data() + offset);
+      if (!handle(requests.data() + offset + sizeof(u32), size, queue)) {
+        state.SkipWithError("failed to parse request");
+        return;
+      }
+      offset += sizeof(u32) + size;
+      ++count;
+    }
+
+    // NOTE: same as a completed write
+    benchmark::DoNotOptimize(queue.data());
+    queue.clear();
+  }
+
+  state.SetItemsProcessed(static_cast<i64>(count));
+  state.SetBytesProcessed(static_cast<i64>(state.iterations() * requests.size()));
+}
+
+// fresh messages on the heap for each request
+static void heap(benchmark::State& state) {
+  handle_all(state, [](const u8* data, u32 size, Buffer& queue) {
+    proto::ClientMessage request;
+    if (!request.ParseFromArray(data, static_cast<int>(size))) {
+      return false;
+    }
+
+    proto::ServerMessage response;
+    respond(request, response);
+    append_message(queue, response);
+    return true;
+  });
+}
+
+// messages on arena with reused block, as in Server
+static void arena(benchmark::State& state) {
+  std::vector<char> block(64 * 1024);
+  google::protobuf::Arena arena(block.data(), block.size());
+  handle_all(state, [&](const u8* data, u32 size, Buffer& queue) {
+    auto* request = google::protobuf::Arena::CreateMessage<proto::ClientMessage>(&arena);
+    if (!request->ParseFromArray(data, static_cast<int>(size))) {
+      return false;
+    }
+
+    auto* response = google::protobuf::Arena::CreateMessage<proto::ServerMessage>(&arena);
+    respond(*request, *response);
+    append_message(queue, *response);
+    arena.Reset();
+    return true;
+  });
+}
+
+BENCHMARK(heap);
+BENCHMARK(arena);
+
+// NOTE: should be built in release mode to get meaningful numbers
+BENCHMARK_MAIN();
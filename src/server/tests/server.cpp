@@ -0,0 +1,338 @@
+#include "server/server.hpp"
+#include "byteorder.hpp"
+#include "time.hpp"
+
+#include <array>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// clang-format off
+#include "disable_warnings_push.hpp"
+#include <gtest/gtest.h>
+#include <protocol.pb.h>
+#include "disable_warnings_pop.hpp"
+// clang-format on
+
+using namespace shar;
+using namespace shar::net;
+
+// how long client waits for a message that should arrive
+static const Milliseconds TIMEOUT{ 2000 };
+
+// how long client waits to make sure that nothing arrives
+static const Milliseconds SILENCE{ 100 };
+
+// client connected to the server over loopback
+class Client {
+public:
+  explicit Client(Port port)
+    : m_socket(m_context)
+  {
+    m_socket.connect(tcp::Endpoint{ IPv4::loopback(), port });
+    m_socket.non_blocking(true);
+  }
+
+  void send(u32 request_id, proto::ClientMessage message) {
+    message.set_request_id(request_id);
+    const auto size = static_cast<u32>(message.ByteSizeLong());
+    std::vector<u8> data(sizeof(u32) + size);
+    write_u32_le(data.data(), size);
+    message.SerializeToArray(data.data() + sizeof(u32), static_cast<int>(size));
+
+    m_socket.non_blocking(false);
+    asio::write(m_socket, span(data.data(), data.size()));
+    m_socket.non_blocking(true);
+  }
+
+  std::optional<proto::ServerMessage> receive(Milliseconds timeout = TIMEOUT) {
+    const auto deadline = Clock::now() + timeout;
+    while (true) {
+      if (m_received.size() >= sizeof(u32)) {
+        const usize size = read_u32_le(m_received.data());
+        if (m_received.size() >= sizeof(u32) + size) {
+          proto::ServerMessage message;
+          EXPECT_TRUE(message.ParseFromArray(m_received.data() + sizeof(u32), static_cast<int>(size)));
+          m_received.erase(m_received.begin(), m_received.begin() + static_cast<std::ptrdiff_t>(sizeof(u32) + size));
+          return message;
+        }
+      }
+
+      if (Clock::now() >= deadline) {
+        return std::nullopt;
+      }
+
+      std::array<u8, 4096> buffer;
+      ErrorCode ec;
+      const usize n = m_socket.read_some(span(buffer.data(), buffer.size()), ec);
+      if (ec == std::errc::operation_would_block) {
+        std::this_thread::sleep_for(Milliseconds{ 1 });
+      } else if (ec) {
+        return std::nullopt;
+      } else {
+        m_received.insert(m_received.end(), buffer.begin(), buffer.begin() + static_cast<std::ptrdiff_t>(n));
+      }
+    }
+  }
+
+  void close() {
+    ErrorCode ignored;
+    m_socket.close(ignored);
+  }
+
+private:
+  IOContext m_context;
+  tcp::Socket m_socket;
+  std::vector<u8> m_received;
+};
+
+static proto::ClientMessage open_request(const std::string& name) {
+  proto::ClientMessage message;
+  message.mutable_open()->set_name(name);
+  return message;
+}
+
+static proto::ClientMessage close_request(const std::string& id) {
+  proto::ClientMessage message;
+  message.mutable_close()->set_id(id);
+  return message;
+}
+
+static proto::ClientMessage connect_request(const std::string& id, const std::string& address) {
+  proto::ClientMessage message;
+  auto* connect = message.mutable_connect();
+  connect->set_id(id);
+  connect->set_address(address);
+  return message;
+}
+
+static proto::ClientMessage list_request() {
+  proto::ClientMessage message;
+  message.mutable_list();
+  return message;
+}
+
+static proto::ClientMessage relay_request(const std::string& id) {
+  proto::ClientMessage message;
+  message.mutable_relay()->set_id(id);
+  return message;
+}
+
+// parameter is number of shards, with 2 shards clients are spread between
+// them by kernel, so most of the flows below cross shards
+class server : public ::testing::TestWithParam<usize> {
+protected:
+  void SetUp() override {
+    m_server = std::make_unique<Server>(GetParam(), true, Port{ 0 });
+    m_server->start();
+  }
+
+  void TearDown() override {
+    m_server->stop();
+  }
+
+  std::unique_ptr<Client> client() {
+    return std::make_unique<Client>(m_server->port());
+  }
+
+  // session opened by |owner|
+  std::string open_session(Client& owner, const std::string& name = "desk") {
+    owner.send(1, open_request(name));
+    auto response = owner.receive();
+    EXPECT_TRUE(response && response->has_open() && response->open().success());
+    return response ? response->open().id() : std::string{};
+  }
+
+  std::unique_ptr<Server> m_server;
+};
+
+TEST_P(server, open_and_list) {
+  auto owner = client();
+  owner->send(1, open_request(""));
+  auto rejected = owner->receive();
+  ASSERT_TRUE(rejected && rejected->has_open());
+  EXPECT_FALSE(rejected->open().success());
+
+  const auto id = open_session(*owner);
+  EXPECT_EQ(id.size(), 16u);
+
+  auto other = client();
+  other->send(7, list_request());
+  auto response = other->receive();
+  ASSERT_TRUE(response && response->has_list());
+  EXPECT_EQ(response->request_id(), 7u);
+  ASSERT_EQ(response->list().sessions_size(), 1);
+  EXPECT_EQ(response->list().sessions(0).name(), "desk");
+  EXPECT_EQ(response->list().sessions(0).id(), id);
+}
+
+TEST_P(server, list_is_truncated) {
+  auto owner = client();
+  const std::string name(200, 'x');
+  const usize count = 100;
+  for (usize i = 0; i < count; ++i) {
+    open_session(*owner, name);
+  }
+
+  auto other = client();
+  other->send(1, list_request());
+  auto response = other->receive();
+  ASSERT_TRUE(response && response->has_list());
+  EXPECT_GT(response->list().sessions_size(), 0);
+  EXPECT_LT(static_cast<usize>(response->list().sessions_size()), count);
+}
+
+TEST_P(server, connect_to_unknown_session) {
+  auto other = client();
+  other->send(3, connect_request("0123456789abcdef", "1.2.3.4:5"));
+  auto response = other->receive();
+  ASSERT_TRUE(response && response->has_connect());
+  EXPECT_EQ(response->request_id(), 3u);
+  EXPECT_EQ(response->connect().id(), "0123456789abcdef");
+  EXPECT_TRUE(response->connect().address().empty());
+}
+
+TEST_P(server, connect_and_answer) {
+  auto owner = client();
+  const auto id = open_session(*owner);
+
+  // NOTE: all clients use the same request id
+  std::vector<std::unique_ptr<Client>> clients;
+  std::vector<u32> relayed;
+  for (usize i = 0; i < 4; ++i) {
+    clients.push_back(client());
+    clients.back()->send(5, connect_request(id, "client" + std::to_string(i)));
+
+    auto request = owner->receive();
+    ASSERT_TRUE(request && request->has_connect());
+    EXPECT_EQ(request->connect().id(), id);
+    EXPECT_EQ(request->connect().address(), "client" + std::to_string(i));
+    relayed.push_back(request->request_id());
+  }
+
+  // owner answers in reverse order
+  for (usize i = clients.size(); i-- > 0;) {
+    owner->send(relayed[i], connect_request(id, "owner" + std::to_string(i)));
+    auto response = clients[i]->receive();
+    ASSERT_TRUE(response && response->has_connect());
+    EXPECT_EQ(response->request_id(), 5u);
+    EXPECT_EQ(response->connect().address(), "owner" + std::to_string(i));
+  }
+}
+
+// answer to a request of disconnected client must not reach anyone else
+TEST_P(server, stale_answer_is_dropped) {
+  auto owner = client();
+  const auto id = open_session(*owner);
+
+  auto gone = client();
+  gone->send(1, connect_request(id, "gone"));
+  auto stale = owner->receive();
+  ASSERT_TRUE(stale && stale->has_connect());
+
+  auto waiting = client();
+  waiting->send(1, connect_request(id, "waiting"));
+  auto request = owner->receive();
+  ASSERT_TRUE(request && request->has_connect());
+  EXPECT_NE(request->request_id(), stale->request_id());
+
+  gone->close();
+  // NOTE: close is observed by the server asynchronously
+  std::this_thread::sleep_for(SILENCE);
+
+  owner->send(stale->request_id(), connect_request(id, "for gone"));
+  EXPECT_FALSE(waiting->receive(SILENCE));
+
+  owner->send(request->request_id(), connect_request(id, "for waiting"));
+  auto response = waiting->receive();
+  ASSERT_TRUE(response && response->has_connect());
+  EXPECT_EQ(response->connect().address(), "for waiting");
+
+  // repeated answer is dropped as well
+  owner->send(request->request_id(), connect_request(id, "again"));
+  EXPECT_FALSE(waiting->receive(SILENCE));
+}
+
+TEST_P(server, close_cancels_pending) {
+  auto owner = client();
+  const auto id = open_session(*owner);
+
+  auto other = client();
+  other->send(2, connect_request(id, "other"));
+  ASSERT_TRUE(owner->receive());
+
+  // only owner can close the session
+  other->send(3, close_request(id));
+  auto rejected = other->receive();
+  ASSERT_TRUE(rejected && rejected->has_close());
+  EXPECT_FALSE(rejected->close().success());
+
+  owner->send(4, close_request(id));
+  auto closed = owner->receive();
+  ASSERT_TRUE(closed && closed->has_close());
+  EXPECT_TRUE(closed->close().success());
+  EXPECT_EQ(closed->close().id(), id);
+
+  auto cancelled = other->receive();
+  ASSERT_TRUE(cancelled && cancelled->has_connect());
+  EXPECT_EQ(cancelled->request_id(), 2u);
+  EXPECT_TRUE(cancelled->connect().address().empty());
+
+  other->send(5, list_request());
+  auto response = other->receive();
+  ASSERT_TRUE(response && response->has_list());
+  EXPECT_EQ(response->list().sessions_size(), 0);
+}
+
+TEST_P(server, owner_disconnect_cancels_pending) {
+  auto owner = client();
+  const auto id = open_session(*owner);
+
+  auto other = client();
+  other->send(2, connect_request(id, "other"));
+  ASSERT_TRUE(owner->receive());
+
+  owner->close();
+  auto cancelled = other->receive();
+  ASSERT_TRUE(cancelled && cancelled->has_connect());
+  EXPECT_EQ(cancelled->request_id(), 2u);
+  EXPECT_TRUE(cancelled->connect().address().empty());
+
+  other->send(3, list_request());
+  auto response = other->receive();
+  ASSERT_TRUE(response && response->has_list());
+  EXPECT_EQ(response->list().sessions_size(), 0);
+}
+
+TEST_P(server, relay_requires_connect) {
+  auto owner = client();
+  const auto id = open_session(*owner);
+
+  auto other = client();
+  other->send(2, relay_request(id));
+  auto rejected = other->receive();
+  ASSERT_TRUE(rejected && rejected->has_relay());
+  EXPECT_FALSE(rejected->relay().success());
+
+  other->send(3, connect_request(id, "other"));
+  auto request = owner->receive();
+  ASSERT_TRUE(request && request->has_connect());
+
+  // owner gets its port under id of the relayed request
+  other->send(4, relay_request(id));
+  auto response = other->receive();
+  ASSERT_TRUE(response && response->has_relay());
+  EXPECT_TRUE(response->relay().success());
+  EXPECT_EQ(response->request_id(), 4u);
+
+  auto notification = owner->receive();
+  ASSERT_TRUE(notification && notification->has_relay());
+  EXPECT_TRUE(notification->relay().success());
+  EXPECT_EQ(notification->request_id(), request->request_id());
+  EXPECT_EQ(notification->relay().id(), id);
+  EXPECT_NE(notification->relay().port(), response->relay().port());
+}
+
+INSTANTIATE_TEST_CASE_P(shards, server, ::testing::Values(1, 2));